@@ -4,7 +4,6 @@
 #include "LCD.h"
 #include "motors.h"
 #include "rtc.h"
-#include "serial.h"
 #include "servos.h"
 #include "testmode.h"
 #include "util.h"
@@ -41,9 +40,6 @@ int main()
 	//enable interrupts
 	sei();
 
-	//Initialize UART
-	uart0Init();
-
 	//configure digital pins 2-9 as inputs
 	DDRA = 0;
 	//enable pullup resistors for digital pins 2-9
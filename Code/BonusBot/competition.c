@@ -5,7 +5,6 @@
 #include "bonusbot.h"
 #include "motors.h"
 #include "rtc.h"
-#include "serial.h"
 #include "servos.h"
 #include "util.h"
 #include "utility.h"
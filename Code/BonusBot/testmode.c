@@ -4,7 +4,6 @@
 #include "bonusbot.h"
 #include "LCD.h"
 #include "motors.h"
-#include "serial.h"
 #include "servos.h"
 #include "util.h"
 #include "utility.h"
@@ -91,8 +90,8 @@ void testModeExec()
 					servo(SERVO_BACK_LEFT,   DRIVE_SLOW_SPEED);
 					break;
 				case TEST_Launcher:
-					motor0(LAUNCHER_LAUNCH_SPEED);
-					motor1(LAUNCHER_LAUNCH_SPEED);
+					motor0(MOTOR_SPEED_FROM_U08(LAUNCHER_LAUNCH_SPEED));
+					motor1(MOTOR_SPEED_FROM_U08(LAUNCHER_LAUNCH_SPEED));
 				default:
 					printString_P(PSTR("invalid testpage"));
 					break;
@@ -4,7 +4,6 @@
 #include "LCD.h"
 #include "motors.h"
 #include "rtc.h"
-#include "serial.h"
 #include "servos.h"
 #include "util.h"
 #include "utility.h"
@@ -164,8 +163,8 @@ void launcherExec()
 	else if (requestedLauncherSpeed < curLauncherSpeed)
 		curLauncherSpeed -= LAUNCHER_SPEED_STEP;
 
-	motor0(curLauncherSpeed);
-	motor1(curLauncherSpeed);
+	motor0(MOTOR_SPEED_FROM_U08(curLauncherSpeed));
+	motor1(MOTOR_SPEED_FROM_U08(curLauncherSpeed));
 }
 
 
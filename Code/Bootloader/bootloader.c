@@ -0,0 +1,287 @@
+/*! @file
+    Bootloader that reflashes the Launcher over the PC link, with the same packet protocol (Launcher/packetprotocol.c),
+    so it runs at whatever baud rate the PC negotiates with ::LINK_SET_BAUD.
+
+    It lives in the boot section at the top of flash, and the fuses make the chip start here after every reset.
+    After a plain reset it listens for ::BOOT_LISTEN_MS, then starts the Launcher unless the PC has talked to it.
+    When the PC sends the Launcher an ::ENTER_BOOTLOADER, the Launcher resets the chip with the watchdog and leaves a
+    request behind, and then the bootloader stays until the PC sends ::BOOT_START_APP (or stops talking for
+    ::BOOT_IDLE_TIMEOUT_MS). It also stays if there is no application to start.
+
+    Flash is updated a page at a time, so only the pages that changed need to be sent, and only their bytes that
+    changed: a page is assembled from its contents in flash and the ::BOOT_PAGE_DATA packets, then checked against the
+    CRC in ::BOOT_PAGE_WRITE before it is written. See Host/bootflash.cpp for the PC side.
+ */
+#include "bootloader.h"
+#include "packetprotocol.h"
+#include "protocol.h"
+#include "rtc.h"
+#include "uart.h"
+#include "utility.h"
+#include <avr/boot.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+#include <string.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+
+#if BOOT_PAGE_SIZE != SPM_PAGESIZE
+	#error "BOOT_PAGE_SIZE in Protocol/packets.schema doesn't match the flash page size"
+#endif
+
+//! The number of flash pages below the boot section, which the Launcher can use.
+#define APP_PAGES (u16)(BOOTLOADER_START / BOOT_PAGE_SIZE)
+//! How long (in milliseconds) to listen for the PC after a plain reset, before starting the Launcher.
+#define BOOT_LISTEN_MS 300
+//! How long (in milliseconds) to wait for the PC's next packet, once it has talked, before starting the Launcher.
+#define BOOT_IDLE_TIMEOUT_MS 30000UL
+//! Marks that no page is being assembled.
+#define NO_PAGE 0xFFFF
+
+//! Set if the Launcher asked for the bootloader. Kept out of .bss, since checkBootRequest() sets it before .bss is cleared.
+static u08 bootRequested __attribute__((section(".noinit")));
+//! The page being assembled from BOOT_PAGE_DATA packets, and its number, or ::NO_PAGE.
+static u08 pageBuffer[BOOT_PAGE_SIZE];
+static u16 assembledPage = NO_PAGE;
+//! Set once the PC has sent a packet.
+static bool pcTalked = FALSE;
+//! The time (from getUptimeMs()) of the last packet from the PC.
+static u32 lastPacketTime = 0;
+//! Set by BOOT_START_APP.
+static bool startRequested = FALSE;
+
+//Local prototypes
+static void checkBootRequest() __attribute__((naked, used, section(".init3")));
+static void execBootPacket(const u08 packetType, const u08 sequence, const u08 * const data, const u08 dataLength);
+static void sendInfo();
+static void sendPageCrcs(u16 page, u08 count);
+static void assemblePage(const u16 page, const u08 offset, const u08 *const data, const u08 length);
+static BootStatus writePage(const u16 page, const u16 crc);
+static void loadPage(const u16 page);
+static bool pageMatchesFlash(const u32 address);
+static u16 flashPageCrc(const u32 address);
+static bool applicationPresent();
+static void startApplication();
+
+//! Waits for the PC, and updates the Launcher when it asks, before starting the Launcher.
+int main()
+{
+	//the UART and timer5 interrupts are handled here, so use the boot section's interrupt vectors
+	MCUCR = _BV(IVCE);
+	MCUCR = _BV(IVSEL);
+
+	//only UART0 is enabled in the Makefile, so this only sets up the pins and the UART
+	initialize();
+	rtcInit();
+	initPacketDriver();
+	configPacketProcessor(protocolUplinkLengthValid, execBootPacket, LAST_BootCommand - 1);
+	sei();
+	//the LED shows that the robot is in the bootloader
+	ledOn();
+
+	while (!startRequested)
+	{
+		execPacketDriver();
+		const u32 timeout = (bootRequested || pcTalked) ? BOOT_IDLE_TIMEOUT_MS : BOOT_LISTEN_MS;
+		if (getUptimeMs() - lastPacketTime >= timeout && applicationPresent())
+			break;
+	}
+	startApplication();
+}
+
+/*! Runs in the startup code before RAM is initialized, to pick up the request left by the Launcher
+ *  (see enterBootloader() in Launcher/launcherPackets.c), and to turn off the watchdog that reset the chip.
+ */
+static void checkBootRequest()
+{
+	volatile u16 *const request = (volatile u16 *)BOOT_REQUEST_ADDRESS;
+	bootRequested = (*request == BOOT_REQUEST_MAGIC);
+	*request = 0;
+	//the watchdog stays on after a watchdog reset until its reset flag is cleared
+	MCUSR = 0;
+	wdt_disable();
+}
+
+//! Handles a packet from the PC.
+static void execBootPacket(const u08 packetType, const u08 sequence, const u08 * const data, const u08 dataLength)
+{
+	pcTalked = TRUE;
+	lastPacketTime = getUptimeMs();
+
+	switch (packetType)
+	{
+		case BOOT_GET_INFO:
+			sendInfo();
+			break;
+		case BOOT_GET_PAGE_CRCS:
+			sendPageCrcs(BOOT_GET_PAGE_CRCS_firstPage(data), BOOT_GET_PAGE_CRCS_count(data));
+			break;
+		case BOOT_PAGE_DATA:
+			assemblePage(BOOT_PAGE_DATA_page(data), BOOT_PAGE_DATA_offset(data), BOOT_PAGE_DATA_data(data), BOOT_PAGE_DATA_dataLength(dataLength));
+			break;
+		case BOOT_PAGE_WRITE:
+		{
+			u08 writtenData[3];
+			const BootStatus status = writePage(BOOT_PAGE_WRITE_page(data), BOOT_PAGE_WRITE_crc(data));
+			sendPacket(BOOT_PAGE_WRITTEN, writtenData, BOOT_PAGE_WRITTEN_encode(writtenData, BOOT_PAGE_WRITE_page(data), status));
+			break;
+		}
+		case BOOT_START_APP:
+			startRequested = TRUE;
+			break;
+	}
+}
+
+static void sendInfo()
+{
+	u08 infoData[6];
+	sendPacket(BOOT_INFO, infoData, BOOT_INFO_encode(infoData, BOOT_VERSION, BOOT_PAGE_SIZE, APP_PAGES, bootRequested));
+}
+
+//! Sends the CRCs of count pages from page onwards, or of as many as fit and are in the application section.
+static void sendPageCrcs(u16 page, u08 count)
+{
+	u08 crcData[MAX_PACKET_DATA];
+	u08 length = BOOT_PAGE_CRCS_encode(crcData, page);
+	for (; count > 0 && page < APP_PAGES && length + 2 <= MAX_PACKET_DATA; count--, page++)
+	{
+		const u16 crc = flashPageCrc((u32)page * BOOT_PAGE_SIZE);
+		crcData[length++] = (u08)(crc >> 8);
+		crcData[length++] = (u08)crc;
+	}
+	sendPacket(BOOT_PAGE_CRCS, crcData, length);
+}
+
+/*! Copies the bytes of a BOOT_PAGE_DATA into the page being assembled.
+ *  Bytes for another page first start that one again from flash, dropping any unwritten changes to the last one.
+ */
+static void assemblePage(const u16 page, const u08 offset, const u08 *const data, const u08 length)
+{
+	if (page >= APP_PAGES)
+		return;
+	if (page != assembledPage)
+		loadPage(page);
+	//bytes past the end of the page must have been meant for another page, so this one can't be right either
+	if ((u16)offset + length > BOOT_PAGE_SIZE)
+	{
+		assembledPage = NO_PAGE;
+		return;
+	}
+	memcpy(&pageBuffer[offset], data, length);
+}
+
+/*! Writes the assembled page to flash, if it matches the CRC, and checks that it reads back the same.
+ *  Interrupts are only held off for each SPM instruction, so the UART keeps receiving while the flash is busy.
+ */
+static BootStatus writePage(const u16 page, const u16 crc)
+{
+	if (page >= APP_PAGES)
+		return BOOT_BAD_PAGE;
+	if (page != assembledPage)
+		loadPage(page);
+
+	u16 assembledCrc = 0xFFFF;
+	for (u16 i = 0; i < BOOT_PAGE_SIZE; i++)
+		assembledCrc = _crc_ccitt_update(assembledCrc, pageBuffer[i]);
+	if (assembledCrc != crc)
+	{
+		//a BOOT_PAGE_DATA got lost, so start the page over from flash when the PC sends it again
+		assembledPage = NO_PAGE;
+		return BOOT_CRC_MISMATCH;
+	}
+
+	const u32 address = (u32)page * BOOT_PAGE_SIZE;
+	//a page that is already the same (such as when the PC repeats a write whose reply got lost) isn't worn out again
+	if (pageMatchesFlash(address))
+		return BOOT_OK;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		boot_page_erase(address);
+	}
+	boot_spm_busy_wait();
+	for (u16 i = 0; i < BOOT_PAGE_SIZE; i += 2)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			boot_page_fill(address + i, pageBuffer[i] | (pageBuffer[i + 1] << 8));
+		}
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		boot_page_write(address);
+	}
+	boot_spm_busy_wait();
+	//the application section can't be read until it is enabled again
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		boot_rww_enable();
+	}
+
+	if (!pageMatchesFlash(address))
+	{
+		assembledPage = NO_PAGE;
+		return BOOT_VERIFY_FAILED;
+	}
+	return BOOT_OK;
+}
+
+//! Starts assembling a page from its current contents in flash.
+static void loadPage(const u16 page)
+{
+	const u32 address = (u32)page * BOOT_PAGE_SIZE;
+	for (u16 i = 0; i < BOOT_PAGE_SIZE; i++)
+		pageBuffer[i] = pgm_read_byte_far(address + i);
+	assembledPage = page;
+}
+
+//! Checks if a page in flash is the same as the assembled page.
+static bool pageMatchesFlash(const u32 address)
+{
+	for (u16 i = 0; i < BOOT_PAGE_SIZE; i++)
+	{
+		if (pgm_read_byte_far(address + i) != pageBuffer[i])
+			return FALSE;
+	}
+	return TRUE;
+}
+
+//! Works out the CRC of a page in flash, the same way as a packet's CRC.
+static u16 flashPageCrc(const u32 address)
+{
+	u16 crc = 0xFFFF;
+	for (u16 i = 0; i < BOOT_PAGE_SIZE; i++)
+		crc = _crc_ccitt_update(crc, pgm_read_byte_far(address + i));
+	return crc;
+}
+
+//! Checks if there is an application to start, from its reset vector. Erased flash reads as 0xFF.
+static bool applicationPresent()
+{
+	return pgm_read_word_far(0) != 0xFFFF;
+}
+
+/*! Hands the chip over to the Launcher, with the hardware used here back the way the Launcher expects after a reset.
+ *  Doesn't return.
+ */
+static void startApplication()
+{
+	//let the last reply go out
+	while (!uartTxIdle(UART_PORT0))
+	{
+	}
+	cli();
+	//turn off the interrupts used here, which would otherwise go to the Launcher's handlers before it is ready for them
+	UCSR0B = 0;
+	TIMSK5 = 0;
+	TCCR5B = 0;
+	ledOff();
+	//move the interrupt vectors back to the application section
+	MCUCR = _BV(IVCE);
+	MCUCR = 0;
+
+	void (*const application)() = 0x0000;
+	application();
+}
@@ -0,0 +1,26 @@
+#ifndef BOOTLOADER_H
+#define BOOTLOADER_H
+
+#include "globals.h"
+
+/*! The byte address of the boot section, where the bootloader is linked (see Makefile).
+ *  The fuses must set a boot section of 4096 words (BOOTSZ = 00), and reset into it (BOOTRST programmed).
+ */
+#define BOOTLOADER_START 0x1E000UL
+
+/*! Where the Launcher leaves ::BOOT_REQUEST_MAGIC to ask for the bootloader across a watchdog reset.
+ *  It is the top of the stack, which nothing has written to yet when the bootloader's startup code checks it.
+ */
+#define BOOT_REQUEST_ADDRESS (RAMEND - 1)
+#define BOOT_REQUEST_MAGIC 0xB007
+
+//! The results of a BOOT_PAGE_WRITE, reported in BOOT_PAGE_WRITTEN.
+typedef enum
+{
+	BOOT_OK,             //!< The page in flash now matches the CRC.
+	BOOT_BAD_PAGE,       //!< The page isn't in the application section.
+	BOOT_CRC_MISMATCH,   //!< The assembled page didn't match the CRC, so nothing was written. Send all of its changes again.
+	BOOT_VERIFY_FAILED   //!< The page was written, but reads back differently.
+} BootStatus;
+
+#endif
@@ -0,0 +1,40 @@
+/*! @file
+    Generated by Protocol/packetgen.py from Protocol/packets.schema. Do not edit; edit the schema instead.
+
+    The allowed dataLength range of each uplink packet type.
+ */
+#include "packetprotocol.h"
+#include "protocol.h"
+
+#if MAX_PACKET_DATA != 200
+	#error "MAX_PACKET_DATA doesn't match Protocol/packets.schema"
+#endif
+
+//! The shortest and longest data section of a packet type.
+typedef struct
+{
+	u08 min;
+	u08 max;
+} LengthRange;
+
+//! In RAM, since pgm_read_byte() can't reach the bootloader's flash above 64 KiB.
+static const LengthRange bootCommandLengths[] =
+{
+	{0, 0}, //BOOT_GET_INFO
+	{3, 3}, //BOOT_GET_PAGE_CRCS
+	{4, 131}, //BOOT_PAGE_DATA
+	{4, 4}, //BOOT_PAGE_WRITE
+	{0, 0}, //BOOT_START_APP
+};
+
+//! Checks if a packet type is one the PC can send, and if its dataLength is allowed.
+bool protocolUplinkLengthValid(const u08 packetType, const u08 dataLength)
+{
+	const LengthRange *range;
+	if (packetType >= BOOT_GET_INFO && packetType < LAST_BootCommand)
+		range = &bootCommandLengths[packetType - BOOT_GET_INFO];
+	else
+		return FALSE;
+
+	return (dataLength >= range->min && dataLength <= range->max);
+}
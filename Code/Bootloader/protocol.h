@@ -0,0 +1,108 @@
+/*! @file
+    Generated by Protocol/packetgen.py from Protocol/packets.schema. Do not edit; edit the schema instead.
+
+    The packet types of the PC link, with accessors for the fields of uplink packets and encoders for the
+    fixed fields of downlink packets. All multi-byte fields are MSB first.
+ */
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "globals.h"
+
+#define LAUNCHER_UPLINK_FIRST 0x40
+//! The layout of STATS_DATA, sent as its first byte. Increase it whenever the fields change.
+#define STATS_VERSION 0x02
+#define BOOT_UPLINK_FIRST 0x60
+//! The version of the bootloader's packets, sent in BOOT_INFO. Increase it whenever they change.
+#define BOOT_VERSION 0x01
+//! The size of a flash page of the ATmega1281 in bytes, the unit the bootloader erases and writes.
+#define BOOT_PAGE_SIZE 0x100
+
+/*! The packets of the bootloader (see Bootloader/bootloader.c), which knows nothing else except the link control packets.
+ *  Flash is written a page at a time: a page is assembled from its current contents and BOOT_PAGE_DATA changes,
+ *  then written with BOOT_PAGE_WRITE, so the PC only sends the bytes that differ from the running image.
+ */
+typedef enum
+{
+	//! Answered with a BOOT_INFO.
+	BOOT_GET_INFO = BOOT_UPLINK_FIRST,
+	/*! Answered with a BOOT_PAGE_CRCS for count pages from firstPage, or for as many of them as fit in the packet
+	 *  and are in the application section.
+	 */
+	BOOT_GET_PAGE_CRCS,
+	/*! Copies data into the page being assembled, from offset onwards. A BOOT_PAGE_DATA for a different page first
+	 *  starts that one from its current contents in flash. Not answered.
+	 */
+	BOOT_PAGE_DATA,
+	/*! Writes the page being assembled, if its CRC matches, then reads it back. Answered with a BOOT_PAGE_WRITTEN.
+	 *  A page whose CRC doesn't match is thrown away, so the next BOOT_PAGE_DATA starts it again from flash.
+	 */
+	BOOT_PAGE_WRITE,
+	//! Leaves the bootloader and starts the Launcher. Not answered.
+	BOOT_START_APP,
+	LAST_BootCommand
+} BootCommand;
+
+//! The bootloader's replies.
+typedef enum
+{
+	/*! The BOOT_VERSION, the BOOT_PAGE_SIZE, and the number of pages in the application section,
+	 *  then 1 if the Launcher sent the robot here with ENTER_BOOTLOADER, or 0 if it came from a reset.
+	 */
+	BOOT_INFO = 0xD0,
+	//! The CRC of each page from firstPage on, as a u16. Worked out like a packet's CRC: CCITT, starting from 0xFFFF.
+	BOOT_PAGE_CRCS,
+	//! The BootStatus, see Bootloader/bootloader.h.
+	BOOT_PAGE_WRITTEN,
+	LAST_BootReply
+} BootReply;
+
+bool protocolUplinkLengthValid(const u08 packetType, const u08 dataLength);
+
+//BOOT_GET_PAGE_CRCS
+static inline u16 BOOT_GET_PAGE_CRCS_firstPage(const u08 *const data) { return (u16)(((u16)data[0] << 8) | data[1]); }
+static inline u08 BOOT_GET_PAGE_CRCS_count(const u08 *const data) { return data[2]; }
+
+//BOOT_PAGE_DATA
+static inline u16 BOOT_PAGE_DATA_page(const u08 *const data) { return (u16)(((u16)data[0] << 8) | data[1]); }
+static inline u08 BOOT_PAGE_DATA_offset(const u08 *const data) { return data[2]; }
+static inline const u08 *BOOT_PAGE_DATA_data(const u08 *const data) { return (const u08 *)&data[3]; }
+static inline u08 BOOT_PAGE_DATA_dataLength(const u08 dataLength) { return dataLength - 3; }
+
+//BOOT_PAGE_WRITE
+static inline u16 BOOT_PAGE_WRITE_page(const u08 *const data) { return (u16)(((u16)data[0] << 8) | data[1]); }
+static inline u16 BOOT_PAGE_WRITE_crc(const u08 *const data) { return (u16)(((u16)data[2] << 8) | data[3]); }
+
+//BOOT_INFO
+/*! Writes the fixed fields of a BOOT_INFO into data. @return 6, the length written. */
+static inline u08 BOOT_INFO_encode(u08 *const data, const u08 version, const u16 pageSize, const u16 appPages, const u08 requested)
+{
+	data[0] = version;
+	data[1] = (u08)(pageSize >> 8);
+	data[2] = (u08)pageSize;
+	data[3] = (u08)(appPages >> 8);
+	data[4] = (u08)appPages;
+	data[5] = requested;
+	return 6;
+}
+
+//BOOT_PAGE_CRCS
+/*! Writes the fixed fields of a BOOT_PAGE_CRCS into data. @return 2, the length written, where crcs goes. */
+static inline u08 BOOT_PAGE_CRCS_encode(u08 *const data, const u16 firstPage)
+{
+	data[0] = (u08)(firstPage >> 8);
+	data[1] = (u08)firstPage;
+	return 2;
+}
+
+//BOOT_PAGE_WRITTEN
+/*! Writes the fixed fields of a BOOT_PAGE_WRITTEN into data. @return 3, the length written. */
+static inline u08 BOOT_PAGE_WRITTEN_encode(u08 *const data, const u16 page, const u08 status)
+{
+	data[0] = (u08)(page >> 8);
+	data[1] = (u08)page;
+	data[2] = status;
+	return 3;
+}
+
+#endif
@@ -0,0 +1,303 @@
+/*! @file
+    Tests baud rate changes end to end: the PC's PacketLink on one side of a pty, and the Launcher's packetprotocol.c
+    (built for the PC, see firmware/hostfirmware.h) on the other, in a thread that moves bytes between the pty and its
+    UART. A pty has no baud rate, so the thread only passes bytes while both ends are set to the same rate, and never at
+    UNUSABLE_BAUD, as if the cable couldn't carry it.
+
+    usage: baudtest
+
+    Checks a change the PC asks for with PacketLink::requestBaud(), a change the robot proposes with
+    packetLinkProposeBaud(), both ends falling back to the boot rate when the new rate never works, and the robot giving
+    up after BAUD_MAX_FAILURES proposals that nobody answers. Run by "make test".
+ */
+
+#include "firmware/hostfirmware.h"
+#include "packetlink.h"
+#include "serialport.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+#include <functional>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace robolink;
+
+//! The packet type the robot echoes back, to check that packets get through at the current rate.
+static const uint8_t TEST_PACKET = 0x42;
+//! The UART the robot's end of the link is on.
+static const int PORT = 0;
+//! The rate both ends start at, UART0_BAUD in the Launcher's Makefile.
+static const unsigned BOOT_BAUD = 38400;
+//! A rate that works.
+static const unsigned FAST_BAUD = 115200;
+//! A rate both ends accept, but that no bytes get through at.
+static const unsigned UNUSABLE_BAUD = 230400;
+//! How long to wait for the robot to answer.
+static const int REPLY_TIMEOUT_MS = 1000;
+
+//The rates each end is set to, for deciding which bytes get through.
+static std::atomic<unsigned> pcBaud{BOOT_BAUD};
+static std::atomic<unsigned> robotBaud{BOOT_BAUD};
+//! Held by the robot's thread while it takes bytes off the pty, so the PC's rate doesn't change in the middle.
+static std::mutex wire;
+//The robot's side of a change, published by its thread.
+static std::atomic<bool> robotChanging{false};
+//! A rate for the robot's thread to propose, or 0 once it has.
+static std::atomic<unsigned> proposal{0};
+
+static bool wireWorks()
+{
+	return pcBaud == robotBaud && robotBaud != UNUSABLE_BAUD;
+}
+
+//! Echoes the test packets back to the PC.
+static void robotReceive(int port, uint8_t packetType, const uint8_t *data, uint8_t dataLength)
+{
+	if (packetType == TEST_PACKET)
+		hostLinkSend(port, packetType, data, dataLength);
+}
+
+//! Runs the robot's end of the link until stop is set: moves bytes between the pty and the UART, and runs the link.
+static void runRobot(int fd, const std::atomic<bool> &stop)
+{
+	std::vector<uint8_t> bytes(256);
+	while (!stop)
+	{
+		{
+			std::lock_guard<std::mutex> lock(wire);
+			pollfd readable = {fd, POLLIN, 0};
+			if (poll(&readable, 1, 1) > 0)
+			{
+				//bytes sent at another rate arrive as garbage, which the parser treats the same as nothing
+				const ssize_t length = read(fd, bytes.data(), bytes.size());
+				for (ssize_t fed = 0; fed < length && wireWorks(); )
+					fed += hostUartFeed(PORT, &bytes[fed], length - fed);
+			}
+		}
+
+		const unsigned baud = proposal;
+		if (baud != 0)
+			hostLinkProposeBaud(PORT, baud);
+		hostLinkExec(PORT);
+		robotBaud = hostUartBaud(PORT);
+		robotChanging = hostLinkBaudChanging(PORT);
+		//only after publishing the change, so the PC doesn't see the state from before it
+		if (baud != 0)
+			proposal = 0;
+
+		std::size_t length;
+		while ((length = hostUartTake(PORT, bytes.data(), bytes.size())) > 0)
+		{
+			if (wireWorks() && write(fd, bytes.data(), length) != (ssize_t)length)
+				std::fprintf(stderr, "baudtest: couldn't write to the pty\n");
+		}
+	}
+}
+
+/*! Changes the PC's rate once the robot's thread has taken everything the PC sent at the old rate.
+ *  @param master The pty master the robot's thread reads.
+ */
+static void setPcBaud(int fd, int master, unsigned baud)
+{
+	setSerialBaud(fd, baud);
+	for (;;)
+	{
+		int unread = 0;
+		{
+			std::lock_guard<std::mutex> lock(wire);
+			if (ioctl(master, FIONREAD, &unread) != 0 || unread == 0)
+			{
+				pcBaud = baud;
+				return;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+//! Polls the PC's end, so it answers the robot's link control packets, until done() or the timeout. @return done().
+static bool pollUntil(PacketLink &link, int timeoutMs, const std::function<bool()> &done)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	Packet packet;
+	while (!done())
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+			return false;
+		link.poll(10, packet);
+	}
+	return true;
+}
+
+//! Checks that a packet gets to the robot and back at the current rate.
+static bool echoes(PacketLink &link, uint8_t number)
+{
+	const std::vector<uint8_t> data = {number};
+	link.send(TEST_PACKET, data);
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(REPLY_TIMEOUT_MS);
+	Packet packet;
+	while (std::chrono::steady_clock::now() < deadline)
+	{
+		if (link.poll(10, packet) && packet.type == TEST_PACKET && packet.data == data)
+			return true;
+	}
+	return false;
+}
+
+static bool failed = false;
+
+//! Checks that both ends have settled at a rate, and can talk there.
+static void expectSettled(PacketLink &link, const char *step, unsigned baud, uint8_t number)
+{
+	if (!pollUntil(link, hostBaudConfirmTimeoutMs + REPLY_TIMEOUT_MS, [&]() { return !robotChanging && robotBaud == baud; }))
+	{
+		std::fprintf(stderr, "baudtest: after %s, the robot is at %u baud%s instead of %u\n",
+		             step, robotBaud.load(), robotChanging ? " and still changing" : "", baud);
+		failed = true;
+		return;
+	}
+	if (link.baud() != baud)
+	{
+		std::fprintf(stderr, "baudtest: after %s, the PC is at %u baud instead of %u\n", step, link.baud(), baud);
+		failed = true;
+		return;
+	}
+	if (!echoes(link, number))
+	{
+		std::fprintf(stderr, "baudtest: after %s, no packet got through at %u baud\n", step, baud);
+		failed = true;
+	}
+}
+
+//! Has the PC ask for a rate, and checks the outcome.
+static void testRequest(PacketLink &link, unsigned baud, bool works, uint8_t number)
+{
+	const std::string step = "the PC asked for " + std::to_string(baud) + " baud";
+	if (link.requestBaud(baud, REPLY_TIMEOUT_MS) != works)
+	{
+		std::fprintf(stderr, "baudtest: %s, requestBaud() returned %s\n", step.c_str(), works ? "false" : "true");
+		failed = true;
+	}
+	expectSettled(link, step.c_str(), works ? baud : BOOT_BAUD, number);
+}
+
+//! Has the robot propose a rate, and checks the outcome.
+static void testProposal(PacketLink &link, unsigned baud, bool works, uint8_t number)
+{
+	const std::string step = "the robot proposed " + std::to_string(baud) + " baud";
+	proposal = baud;
+	//a rate that doesn't work is proposed BAUD_MAX_FAILURES times, each followed by a wait
+	const int timeoutMs = hostBaudMaxFailures * (hostBaudProposeIntervalMs + hostBaudConfirmTimeoutMs) + REPLY_TIMEOUT_MS;
+	const auto start = std::chrono::steady_clock::now();
+	if (!pollUntil(link, REPLY_TIMEOUT_MS, [&]() { return proposal == 0; }) ||
+	    !pollUntil(link, timeoutMs, [&]() { return !robotChanging; }))
+	{
+		std::fprintf(stderr, "baudtest: %s, the change didn't finish in time\n", step.c_str());
+		failed = true;
+		return;
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	if (!works && elapsed < std::chrono::milliseconds((hostBaudMaxFailures - 1) * hostBaudProposeIntervalMs))
+	{
+		std::fprintf(stderr, "baudtest: %s, the robot gave up after %ld ms without trying again\n", step.c_str(),
+		             (long)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+		failed = true;
+	}
+	expectSettled(link, step.c_str(), works ? baud : BOOT_BAUD, number);
+}
+
+/*! Has the robot propose a rate to nothing, running its clock by hand, and checks that it stops after
+ *  BAUD_MAX_FAILURES proposals and stays at the boot rate.
+ */
+static void testUnanswered()
+{
+	hostUartReset();
+	hostLinkInit(PORT, false, nullptr);
+	hostClockSet(0);
+	hostLinkProposeBaud(PORT, FAST_BAUD);
+
+	//each proposal is a LINK_SET_BAUD frame after the start bytes
+	const uint8_t proposalStart[] = {0xA5, 0x5A, PacketLink::LINK_SET_BAUD};
+	unsigned proposals = 0;
+	std::vector<uint8_t> bytes(256);
+	for (uint32_t ms = 0; ms <= 10u * hostBaudMaxFailures * hostBaudProposeIntervalMs; ms += 10)
+	{
+		hostClockSet(ms * 1000);
+		hostLinkExec(PORT);
+		const std::size_t length = hostUartTake(PORT, bytes.data(), bytes.size());
+		for (std::size_t i = 0; i + sizeof(proposalStart) <= length; i++)
+			proposals += std::equal(proposalStart, proposalStart + sizeof(proposalStart), &bytes[i]);
+	}
+	if (proposals != hostBaudMaxFailures || hostLinkBaudChanging(PORT) || hostUartBaud(PORT) != BOOT_BAUD)
+	{
+		std::fprintf(stderr, "baudtest: the robot proposed %u times to nothing%s, and is at %u baud\n", proposals,
+		             hostLinkBaudChanging(PORT) ? " and is still proposing" : "", hostUartBaud(PORT));
+		failed = true;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	(void)argv;
+	if (argc != 1)
+	{
+		std::fprintf(stderr, "usage: baudtest\n");
+		return 2;
+	}
+
+	const int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+	{
+		std::perror("baudtest: can't open a pty");
+		return 1;
+	}
+
+	std::atomic<bool> stop{false};
+	std::thread robot;
+	try
+	{
+		const int fd = openSerialPort(ptsname(master), BOOT_BAUD);
+		PacketLink link(fd);
+		link.setBaudSetter(BOOT_BAUD, [fd, master](unsigned baud) { setPcBaud(fd, master, baud); });
+		hostUartReset();
+		hostLinkInit(PORT, false, robotReceive);
+		robot = std::thread(runRobot, master, std::cref(stop));
+
+		expectSettled(link, "starting", BOOT_BAUD, 0);
+		testRequest(link, FAST_BAUD, true, 1);
+		testRequest(link, BOOT_BAUD, true, 2);
+		testProposal(link, FAST_BAUD, true, 3);
+		testRequest(link, BOOT_BAUD, true, 4);
+		testRequest(link, UNUSABLE_BAUD, false, 5);
+		testProposal(link, UNUSABLE_BAUD, false, 6);
+
+		stop = true;
+		robot.join();
+		close(fd);
+	}
+	catch (const std::exception &e)
+	{
+		std::fprintf(stderr, "baudtest: %s\n", e.what());
+		failed = true;
+		stop = true;
+		if (robot.joinable())
+			robot.join();
+	}
+	close(master);
+
+	//the robot's clock stays stopped after this, so it goes last
+	testUnanswered();
+
+	std::printf("baudtest: %s\n", failed ? "FAILED" : "passed");
+	return failed ? 1 : 0;
+}
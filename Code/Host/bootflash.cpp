@@ -0,0 +1,370 @@
+/*! @file
+    Updates the Launcher through the bootloader (see Bootloader/bootloader.c), over the same serial port as the PC link.
+
+    usage: bootflash [--baud rate] [--fast rate] <device> [old.hex] <new.hex>
+
+    The robot can be running the Launcher, at --baud, or already be in the bootloader. The Launcher is sent an
+    ENTER_BOOTLOADER, then the link is switched to --fast (0 stays at the bootloader's boot rate) for the transfer.
+
+    The robot's page CRCs are compared against new.hex first, so only the pages that changed are written. When old.hex
+    is given and a page on the robot still matches it, only the bytes that differ from it are sent; any other page is
+    sent whole. Each page is checked against its CRC by the bootloader before it is written, and read back after.
+    The Launcher is started again at the end.
+
+    The device can be a pty connected to another end of the link, to try the tool without a robot.
+ */
+
+#include "packetlink.h"
+#include "protocol.h"
+#include "serialport.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace robolink;
+
+//! The rate the bootloader starts at, UART0_BAUD in Bootloader/Makefile.
+static const unsigned BOOTLOADER_BAUD = 38400;
+//! How long to wait for a reply from the bootloader.
+static const int REPLY_TIMEOUT_MS = 1000;
+//! How long to keep asking for the bootloader after sending ENTER_BOOTLOADER.
+static const int ENTER_TIMEOUT_MS = 5000;
+//! The most times a page is sent again before giving up.
+static const int PAGE_ATTEMPTS = 3;
+//! The most bytes in one BOOT_PAGE_DATA, and in one BOOT_PAGE_CRCS.
+static const std::size_t MAX_PAGE_DATA = 128;
+static const std::size_t MAX_PAGE_CRCS = (MAX_PACKET_DATA - 2) / 2;
+/*! Runs of changed bytes closer together than this are sent in one BOOT_PAGE_DATA, since the unchanged bytes between
+ *  them cost less than the packet overhead and the page and offset fields of another packet.
+ */
+static const std::size_t MERGE_GAP = 10;
+
+//! Same values as BootStatus in Bootloader/bootloader.h.
+enum BootStatus : uint8_t
+{
+	BOOT_OK,
+	BOOT_BAD_PAGE,
+	BOOT_CRC_MISMATCH,
+	BOOT_VERIFY_FAILED
+};
+
+static void printUsage()
+{
+	std::fprintf(stderr, "usage: bootflash [--baud rate] [--fast rate] <device> [old.hex] <new.hex>\n");
+}
+
+/*! Reads an Intel HEX file into a flash image, with the bytes it doesn't give left erased (0xFF).
+ *  The image is padded to a whole number of pages. Throws std::runtime_error if the file can't be read or is invalid.
+ */
+static std::vector<uint8_t> readHexFile(const std::string &path)
+{
+	std::ifstream file(path);
+	if (!file)
+		throw std::runtime_error("can't open " + path);
+
+	std::vector<uint8_t> image;
+	uint32_t base = 0;
+	std::string line;
+	for (unsigned lineNumber = 1; std::getline(file, line); lineNumber++)
+	{
+		const std::string where = path + ":" + std::to_string(lineNumber);
+		while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+			line.pop_back();
+		if (line.empty())
+			continue;
+		if (line[0] != ':' || line.size() < 11 || line.size() % 2 == 0
+		    || line.find_first_not_of("0123456789abcdefABCDEF", 1) != std::string::npos)
+			throw std::runtime_error(where + ": not an Intel HEX record");
+
+		std::vector<uint8_t> record;
+		uint8_t checksum = 0;
+		for (std::size_t i = 1; i < line.size(); i += 2)
+		{
+			record.push_back((uint8_t)std::stoul(line.substr(i, 2), nullptr, 16));
+			checksum += record.back();
+		}
+		if (checksum != 0)
+			throw std::runtime_error(where + ": bad checksum");
+		const std::size_t length = record[0];
+		if (record.size() != length + 5)
+			throw std::runtime_error(where + ": wrong record length");
+		const uint32_t address = (record[1] << 8) | record[2];
+		const uint8_t *const data = &record[4];
+
+		switch (record[3])
+		{
+			case 0x00: //data
+			{
+				const uint32_t start = base + address;
+				if (image.size() < start + length)
+					image.resize(start + length, 0xFF);
+				std::copy(data, data + length, image.begin() + start);
+				break;
+			}
+			case 0x01: //end of file
+				image.resize((image.size() + BOOT_PAGE_SIZE - 1) / BOOT_PAGE_SIZE * BOOT_PAGE_SIZE, 0xFF);
+				return image;
+			case 0x02: //extended segment address
+				base = ((data[0] << 8) | data[1]) << 4;
+				break;
+			case 0x04: //extended linear address
+				base = (uint32_t)((data[0] << 8) | data[1]) << 16;
+				break;
+			case 0x03: //start segment address
+			case 0x05: //start linear address
+				break;
+			default:
+				throw std::runtime_error(where + ": unknown record type");
+		}
+	}
+	throw std::runtime_error(path + ": no end of file record");
+}
+
+//! Works out the CRC of a page, the same way as the bootloader.
+static uint16_t pageCrc(const uint8_t *page)
+{
+	uint16_t crc = 0xFFFF;
+	for (std::size_t i = 0; i < BOOT_PAGE_SIZE; i++)
+		crc = updateCrcCcitt(crc, page[i]);
+	return crc;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//! Waits for a packet of a type, discarding anything else. @return false on timeout.
+static bool waitFor(PacketLink &link, uint8_t type, Packet &packet, int timeoutMs = REPLY_TIMEOUT_MS)
+{
+	const auto start = std::chrono::steady_clock::now();
+	while (true)
+	{
+		const int remaining = timeoutMs - (int)millisecondsSince(start);
+		if (remaining <= 0 || !link.poll(remaining, packet))
+			return false;
+		if (packet.type == type)
+			return true;
+	}
+}
+
+//! Asks for a BOOT_INFO, up to a number of times. @return false if there was no answer.
+static bool getInfo(PacketLink &link, int attempts, int timeoutMs, BootInfo &info)
+{
+	Packet packet;
+	for (int attempt = 0; attempt < attempts; attempt++)
+	{
+		link.send(BOOT_GET_INFO);
+		if (waitFor(link, BOOT_INFO, packet, timeoutMs))
+		{
+			info = BootInfo::decode(packet.data);
+			return true;
+		}
+	}
+	return false;
+}
+
+//! Reads the CRC of each page from 0 to count - 1 on the robot.
+static std::vector<uint16_t> readPageCrcs(PacketLink &link, std::size_t count)
+{
+	std::vector<uint16_t> crcs;
+	Packet packet;
+	int failures = 0;
+	while (crcs.size() < count)
+	{
+		const std::size_t asked = std::min(count - crcs.size(), MAX_PAGE_CRCS);
+		link.send(BOOT_GET_PAGE_CRCS, BootGetPageCrcs{(uint16_t)crcs.size(), (uint8_t)asked}.encode());
+		BootPageCrcs reply;
+		if (!waitFor(link, BOOT_PAGE_CRCS, packet) || (reply = BootPageCrcs::decode(packet.data)).firstPage != crcs.size()
+		    || reply.crcs.empty())
+		{
+			if (++failures == PAGE_ATTEMPTS)
+				throw std::runtime_error("no page CRCs from the bootloader");
+			continue;
+		}
+		for (std::size_t i = 0; i + 1 < reply.crcs.size(); i += 2)
+			crcs.push_back((reply.crcs[i] << 8) | reply.crcs[i + 1]);
+	}
+	return crcs;
+}
+
+/*! Finds the parts of a page that differ from what the robot has, as (offset, length) pairs of up to
+ *  ::MAX_PAGE_DATA bytes. With no base, the whole page is sent.
+ */
+static std::vector<std::pair<std::size_t, std::size_t>> changedRuns(const uint8_t *page, const uint8_t *base)
+{
+	std::vector<std::pair<std::size_t, std::size_t>> runs;
+	for (std::size_t i = 0; i < BOOT_PAGE_SIZE; i++)
+	{
+		if (base && page[i] == base[i])
+			continue;
+		if (!runs.empty())
+		{
+			auto &last = runs.back();
+			const std::size_t end = last.first + last.second;
+			if (i - end < MERGE_GAP && i + 1 - last.first <= MAX_PAGE_DATA)
+			{
+				last.second = i + 1 - last.first;
+				continue;
+			}
+		}
+		runs.emplace_back(i, 1);
+	}
+	return runs;
+}
+
+//! Counts what was done to the pages, for the summary.
+struct Summary
+{
+	unsigned unchanged = 0;
+	unsigned patched = 0;
+	unsigned whole = 0;
+	unsigned retries = 0;
+	std::size_t bytesSent = 0;
+};
+
+/*! Sends the changes to one page and writes it, trying again with the whole page if that doesn't work.
+ *  Throws std::runtime_error if the page can't be written.
+ */
+static void flashPage(PacketLink &link, uint16_t page, const uint8_t *data, const uint8_t *base, Summary &summary)
+{
+	const uint16_t crc = pageCrc(data);
+	Packet packet;
+	for (int attempt = 0; attempt < PAGE_ATTEMPTS; attempt++)
+	{
+		if (attempt > 0)
+			summary.retries++;
+		for (const auto &run : changedRuns(data, base))
+		{
+			const std::vector<uint8_t> bytes(data + run.first, data + run.first + run.second);
+			link.send(BOOT_PAGE_DATA, BootPageData{page, (uint8_t)run.first, bytes}.encode());
+			summary.bytesSent += bytes.size();
+		}
+		link.send(BOOT_PAGE_WRITE, BootPageWrite{page, crc}.encode());
+
+		BootPageWritten reply{};
+		while (waitFor(link, BOOT_PAGE_WRITTEN, packet) && (reply = BootPageWritten::decode(packet.data)).page != page)
+		{
+		}
+		if (packet.type == BOOT_PAGE_WRITTEN && reply.page == page)
+		{
+			if (reply.status == BOOT_OK)
+			{
+				if (base)
+					summary.patched++;
+				else
+					summary.whole++;
+				return;
+			}
+			if (reply.status == BOOT_BAD_PAGE)
+				throw std::runtime_error("page " + std::to_string(page) + " is outside the application section");
+		}
+		//the bootloader starts the page over from flash, which may not be the base any more if a write went wrong
+		base = nullptr;
+	}
+	throw std::runtime_error("couldn't write page " + std::to_string(page));
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned baud = 38400;
+	unsigned fast = 500000;
+
+	int arg = 1;
+	for (; arg < argc && std::strncmp(argv[arg], "--", 2) == 0; arg++)
+	{
+		const std::string option = argv[arg];
+		if (option == "--baud" && arg + 1 < argc)
+			baud = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--fast" && arg + 1 < argc)
+			fast = std::strtoul(argv[++arg], nullptr, 0);
+		else
+		{
+			printUsage();
+			return 2;
+		}
+	}
+	if (argc - arg != 2 && argc - arg != 3)
+	{
+		printUsage();
+		return 2;
+	}
+	const char *const device = argv[arg];
+	const char *const oldPath = (argc - arg == 3) ? argv[arg + 1] : nullptr;
+	const char *const newPath = argv[argc - 1];
+
+	try
+	{
+		const std::vector<uint8_t> image = readHexFile(newPath);
+		std::vector<uint8_t> oldImage = oldPath ? readHexFile(oldPath) : std::vector<uint8_t>();
+		oldImage.resize(std::max(oldImage.size(), image.size()), 0xFF);
+		const std::size_t pages = image.size() / BOOT_PAGE_SIZE;
+
+		const int fd = openSerialPort(device, baud);
+		auto link = std::make_unique<PacketLink>(fd);
+		unsigned linkBaud = baud;
+		BootInfo info;
+		//the Launcher doesn't know the bootloader's packets, so the robot is only in the bootloader if it answers
+		if (!getInfo(*link, 2, REPLY_TIMEOUT_MS / 4, info))
+		{
+			link->send(ENTER_BOOTLOADER);
+			//the bootloader starts with a new link, at its own rate
+			setSerialBaud(fd, BOOTLOADER_BAUD);
+			linkBaud = BOOTLOADER_BAUD;
+			link = std::make_unique<PacketLink>(fd);
+			if (!getInfo(*link, ENTER_TIMEOUT_MS / (REPLY_TIMEOUT_MS / 4), REPLY_TIMEOUT_MS / 4, info))
+				throw std::runtime_error("no answer from the bootloader (try pressing reset while this waits)");
+		}
+		if (info.version != BOOT_VERSION || info.pageSize != BOOT_PAGE_SIZE)
+			throw std::runtime_error("the bootloader is version " + std::to_string(info.version) + " with "
+			                         + std::to_string(info.pageSize) + " byte pages, which this tool doesn't know");
+		if (pages > info.appPages)
+			throw std::runtime_error("the image is " + std::to_string(pages) + " pages, but only "
+			                         + std::to_string(info.appPages) + " fit below the bootloader");
+
+		link->setBaudSetter(linkBaud, [fd](unsigned newBaud) { setSerialBaud(fd, newBaud); });
+		if (fast != 0 && fast != linkBaud && !link->requestBaud(fast, REPLY_TIMEOUT_MS))
+			std::fprintf(stderr, "bootflash: couldn't switch to %u baud, staying at %u\n", fast, link->baud());
+
+		const auto start = std::chrono::steady_clock::now();
+		const std::vector<uint16_t> robotCrcs = readPageCrcs(*link, pages);
+		Summary summary;
+		for (std::size_t page = 0; page < pages; page++)
+		{
+			const uint8_t *const data = &image[page * BOOT_PAGE_SIZE];
+			const uint8_t *const old = &oldImage[page * BOOT_PAGE_SIZE];
+			if (robotCrcs[page] == pageCrc(data))
+			{
+				summary.unchanged++;
+				continue;
+			}
+			flashPage(*link, (uint16_t)page, data, (oldPath && robotCrcs[page] == pageCrc(old)) ? old : nullptr, summary);
+			std::fprintf(stderr, "\rpage %zu of %zu", page + 1, pages);
+		}
+		link->send(BOOT_START_APP);
+		//give the last packet time to go out before the port is closed
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		close(fd);
+
+		std::fprintf(stderr, "\r");
+		std::printf("%zu pages: %u unchanged, %u patched, %u sent whole, %u retries. %zu bytes sent in %.1f s at %u baud\n",
+		            pages, summary.unchanged, summary.patched, summary.whole, summary.retries, summary.bytesSent,
+		            millisecondsSince(start) / 1000.0, link->baud());
+		return 0;
+	}
+	catch (const std::exception &e)
+	{
+		std::fprintf(stderr, "bootflash: %s\n", e.what());
+		return 1;
+	}
+}
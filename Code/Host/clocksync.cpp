@@ -0,0 +1,169 @@
+#include "clocksync.h"
+#include "protocol.h"
+#include <algorithm>
+#include <cmath>
+
+namespace robolink
+{
+
+//! An exchange this far off the estimate means the robot's clock jumped, so the estimate is started over.
+static constexpr int64_t CLOCK_JUMP_US = 1000000;
+//! The fitted line's slope is only trusted once the exchanges used cover this much time.
+static constexpr int64_t MIN_FIT_SPAN_US = 2000000;
+
+static int64_t sinceEpochUs(std::chrono::time_point<ClockSync::Clock> time)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
+ClockSync::ClockSync()
+	: epochUs(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count()
+	          - sinceEpochUs(Clock::now()))
+{
+}
+
+std::vector<uint8_t> ClockSync::request() const
+{
+	//only the low 32 bits fit, which is enough to find t1 again from t4, since a round trip is much shorter than 71 minutes
+	return TimeSync{(uint32_t)sinceEpochUs(Clock::now()), std::vector<uint8_t>(8, 0)}.encode();
+}
+
+bool ClockSync::handlePacket(const Packet &packet, Clock::time_point received)
+{
+	if (packet.type != TIME_SYNC_REPLY)
+		return false;
+	if (packet.data.size() != 12)
+		return true;
+	const TimeSyncReply reply = TimeSyncReply::decode(packet.data);
+
+	const int64_t t4 = sinceEpochUs(received);
+	const int64_t t1 = t4 - (uint32_t)((uint32_t)t4 - reply.originate);
+	int64_t t2 = unwrap(reply.receiveUs);
+	if (!history.empty() && std::llabs(t2 - (t1 + (int64_t)offsetAt(t1))) > CLOCK_JUMP_US)
+	{
+		history.clear();
+		restartCount++;
+	}
+	if (history.empty())
+		t2 = reply.receiveUs;
+	const int64_t t3 = t2 + (uint32_t)(reply.transmitUs - reply.receiveUs);
+
+	history.push_back({(t1 + t4) / 2, ((t2 - t1) + (t3 - t4)) / 2, (t4 - t1) - (t3 - t2)});
+	if (history.size() > historyLength)
+		history.pop_front();
+	latestRobotUs = t3;
+	exchangeCount++;
+	fit();
+	return true;
+}
+
+/*! Fits a line through the offsets of the better half of the exchanges, by round trip.
+ *  Long round trips mostly come from one direction waiting (such as behind another packet), which skews the offset.
+ */
+void ClockSync::fit()
+{
+	std::vector<Exchange> best(history.begin(), history.end());
+	std::sort(best.begin(), best.end(), [](const Exchange &a, const Exchange &b) { return a.roundTripUs < b.roundTripUs; });
+	best.resize((best.size() + 1) / 2);
+
+	//averaged relative to one of them, so the sums of squares keep their precision
+	const int64_t origin = best.front().pcUs;
+	double meanPc = 0.0, meanOffset = 0.0;
+	int64_t first = best.front().pcUs, last = first;
+	for (const Exchange &exchange : best)
+	{
+		meanPc += exchange.pcUs - origin;
+		meanOffset += exchange.offsetUs;
+		first = std::min(first, exchange.pcUs);
+		last = std::max(last, exchange.pcUs);
+	}
+	meanPc /= best.size();
+	meanOffset /= best.size();
+
+	centerUs = origin + (int64_t)meanPc;
+	centerOffsetUs = meanOffset;
+	if (last - first < MIN_FIT_SPAN_US)
+	{
+		//too close together to tell the drift from the noise
+		drift = 0.0;
+		return;
+	}
+	double covariance = 0.0, variance = 0.0;
+	for (const Exchange &exchange : best)
+	{
+		const double dx = (exchange.pcUs - origin) - meanPc;
+		covariance += dx * (exchange.offsetUs - meanOffset);
+		variance += dx * dx;
+	}
+	drift = covariance / variance;
+}
+
+double ClockSync::offsetAt(int64_t pcUs) const
+{
+	return centerOffsetUs + drift * (pcUs - centerUs);
+}
+
+double ClockSync::offsetUs() const
+{
+	return history.empty() ? 0.0 : offsetAt(history.back().pcUs);
+}
+
+int64_t ClockSync::bestRoundTripUs() const
+{
+	if (history.empty())
+		return 0;
+	return std::min_element(history.begin(), history.end(),
+	                        [](const Exchange &a, const Exchange &b) { return a.roundTripUs < b.roundTripUs; })->roundTripUs;
+}
+
+int64_t ClockSync::toTimeline(Clock::time_point time) const
+{
+	return epochUs + sinceEpochUs(time);
+}
+
+//! Counts the wraparounds of a robot time, taking the one closest to the latest exchange.
+int64_t ClockSync::unwrap(uint32_t robotUs) const
+{
+	return latestRobotUs + (int32_t)(robotUs - (uint32_t)latestRobotUs);
+}
+
+int64_t ClockSync::robotToTimeline(uint32_t robotUs) const
+{
+	const int64_t robot = unwrap(robotUs);
+	//the offset depends on the PC time being worked out, but changes so slowly that one refinement is plenty
+	double pcUs = robot - centerOffsetUs;
+	pcUs = robot - offsetAt((int64_t)pcUs);
+	return epochUs + std::llround(pcUs);
+}
+
+bool readLogTimestamp(const Packet &packet, uint32_t &robotUs)
+{
+	//the number of null terminated strings before the time, and where they start
+	std::size_t strings = 1, index = 0;
+	switch (packet.type)
+	{
+		case DEBUG_LOG:
+		case WARNING_LOG:
+		case CRITICAL_LOG:
+			break;
+		case SW_FAULT:
+			strings = 2;
+			index = 6;
+			break;
+		default:
+			return false;
+	}
+	for (; strings > 0; strings--)
+	{
+		const auto terminator = std::find(packet.data.begin() + std::min(index, packet.data.size()), packet.data.end(), 0);
+		if (terminator == packet.data.end())
+			return false;
+		index = terminator - packet.data.begin() + 1;
+	}
+	if (packet.data.size() != index + 4)
+		return false;
+	robotUs = ((uint32_t)packet.data[index] << 24) | (packet.data[index + 1] << 16) | (packet.data[index + 2] << 8) | packet.data[index + 3];
+	return true;
+}
+
+} // namespace robolink
@@ -0,0 +1,101 @@
+/*! @file
+    Puts the times of the robot's packets on the PC's clock, so the logs and telemetry of several robots, and video,
+    can be lined up on one microsecond timeline.
+
+    The clocks are compared with NTP-style exchanges of four timestamps: the PC sends a TIME_SYNC at its time t1,
+    the robot stamps when it received it (t2) and when it answered (t3) with getUptimeUs(), and the PC stamps when the
+    TIME_SYNC_REPLY arrived (t4). Then the robot's clock is ahead of the PC's by ((t2 - t1) + (t3 - t4)) / 2, give or
+    take half of the round trip (t4 - t1) - (t3 - t2), so only the exchanges with the shortest round trips are used.
+    A line fitted through their offsets over time gives the drift of the robot's crystal as well.
+ */
+
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include "packetlink.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace robolink
+{
+
+/*! Keeps an estimate of the offset and drift of a robot's clock from TIME_SYNC exchanges.
+ *  The common timeline is microseconds since the Unix epoch, as the PC's clock read at construction,
+ *  and measured with the monotonic clock after that, so adjustments to the PC's clock don't upset it.
+ */
+class ClockSync
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	//! The number of exchanges kept. At one every 250 ms, the fit covers the last 16 seconds.
+	static constexpr std::size_t historyLength = 64;
+
+	ClockSync();
+
+	//! The data section of a TIME_SYNC packet stamped now. Send it without the reliable channel, whose retransmissions would spoil it.
+	std::vector<uint8_t> request() const;
+	/*! Takes a TIME_SYNC_REPLY, received at a time.
+	 *  @return true if the packet was one, or false for any other packet.
+	 */
+	bool handlePacket(const Packet &packet, Clock::time_point received = Clock::now());
+
+	//! Checks if there has been an exchange yet. The conversions can't be used until there has.
+	bool synchronized() const { return !history.empty(); }
+
+	//! The current time on the common timeline.
+	int64_t nowUs() const { return toTimeline(Clock::now()); }
+	/*! Converts a getUptimeUs() time from the robot to the common timeline.
+	 *  It wraps around every 71.6 minutes, so it must be within 35 minutes of the latest exchange.
+	 */
+	int64_t robotToTimeline(uint32_t robotUs) const;
+	//! Converts a getUptimeMs() time from the robot, such as a TelemetrySample's, to the common timeline.
+	int64_t robotMsToTimeline(uint32_t robotMs) const { return robotToTimeline(robotMs * 1000u); }
+
+	//! How far the robot's clock was ahead of the PC's at the latest exchange, in microseconds.
+	double offsetUs() const;
+	//! How much faster the robot's clock runs than the PC's, in parts per million.
+	double driftPpm() const { return drift * 1e6; }
+	//! The shortest round trip of the exchanges kept, which bounds the error of the offset.
+	int64_t bestRoundTripUs() const;
+	unsigned exchanges() const { return exchangeCount; }
+	//! The number of times the estimate was started over, because the robot's clock jumped (such as when it reset).
+	unsigned restarts() const { return restartCount; }
+
+private:
+	struct Exchange
+	{
+		int64_t pcUs;       //!< The middle of the exchange on the PC's clock.
+		int64_t offsetUs;   //!< The robot's clock minus the PC's.
+		int64_t roundTripUs;
+	};
+
+	int64_t toTimeline(Clock::time_point time) const;
+	int64_t unwrap(uint32_t robotUs) const;
+	double offsetAt(int64_t pcUs) const;
+	void fit();
+
+	//! The common timeline's reading of the monotonic clock's zero.
+	const int64_t epochUs;
+	std::deque<Exchange> history;
+	//! The robot time of the latest exchange, with its wraparounds counted.
+	int64_t latestRobotUs = 0;
+	//! The fitted line: the offset at centerUs on the PC's clock, and its slope.
+	int64_t centerUs = 0;
+	double centerOffsetUs = 0.0;
+	double drift = 0.0;
+	unsigned exchangeCount = 0;
+	unsigned restartCount = 0;
+};
+
+/*! Reads the getUptimeUs() time at the end of a log packet (DEBUG_LOG, WARNING_LOG, CRITICAL_LOG or SW_FAULT),
+ *  which the robot adds while SET_LOG_TIMESTAMPS is on.
+ *  @return false if the packet isn't a log packet, or doesn't have a time.
+ */
+bool readLogTimestamp(const Packet &packet, uint32_t &robotUs);
+
+} // namespace robolink
+
+#endif
@@ -0,0 +1,12 @@
+/*! @file
+    Stands in for avr-libc's <avr/interrupt.h> on the PC. There are no interrupts there, so these do nothing.
+ */
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define sei()
+#define cli()
+
+#endif
@@ -0,0 +1,12 @@
+/*! @file
+    Stands in for avr-libc's <avr/io.h> when robot code is built for the PC (see firmware/hostfirmware.c).
+    Only what the robot code built there uses is defined.
+ */
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+#endif
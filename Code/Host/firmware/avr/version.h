@@ -0,0 +1,9 @@
+/*! @file
+    Stands in for avr-libc's <avr/version.h> on the PC.
+ */
+#ifndef HOST_AVR_VERSION_H
+#define HOST_AVR_VERSION_H
+
+#define __AVR_LIBC_VERSION_STRING__ "host"
+
+#endif
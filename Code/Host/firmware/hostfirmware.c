@@ -0,0 +1,234 @@
+/*! @file
+    Stands in for the robot's UARTs, clock, LED and debug logs on the PC. See hostfirmware.h.
+
+    Each UART is a pair of byte buffers: the tests feed the receive buffer and take from the transmit buffer, instead of
+    the interrupts moving bytes over the wire. The transmit buffer is the same size as on the robot, so the link's
+    queues fill up and wait the same way.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include "debug.h"
+#include "hostfirmware.h"
+#include "rtc.h"
+#include "uart.h"
+#include "utility.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+//! The size of each UART's receive buffer. Must be a power of 2.
+#define HOST_UART_RX_LENGTH 4096
+//! The size of each UART's transmit buffer. Must be a power of 2, and holds one byte less.
+#define HOST_UART_TX_LENGTH 256
+
+//! The bytes waiting in each direction of one UART.
+typedef struct
+{
+	u08 rx[HOST_UART_RX_LENGTH];
+	u16 rxHead, rxTail;
+	u08 tx[HOST_UART_TX_LENGTH];
+	u16 txHead, txTail;
+	u32 baud;
+	UartStats stats;
+} HostUart;
+
+static HostUart uarts[HOST_UART_PORTS];
+//! The boot baud rate of each UART, as UART0_BAUD and UART1_BAUD in the Launcher's Makefile.
+static const u32 bootBauds[HOST_UART_PORTS] = {38400, 57600};
+
+//The robot's clock.
+static bool clockStopped = FALSE;
+static u32 stoppedUs;
+static bool clockStarted = FALSE;
+static struct timespec clockStart;
+
+static HostUart *getUart(const int port)
+{
+	return (port >= 0 && port < HOST_UART_PORTS) ? &uarts[port] : NULL;
+}
+
+void hostUartReset(void)
+{
+	memset(uarts, 0, sizeof(uarts));
+	for (int port = 0; port < HOST_UART_PORTS; port++)
+		uarts[port].baud = bootBauds[port];
+}
+
+size_t hostUartFeed(int port, const uint8_t *data, size_t length)
+{
+	HostUart *const uart = getUart(port);
+	size_t fed = 0;
+	if (uart == NULL)
+		return 0;
+	while (fed < length && (u16)(uart->rxTail - uart->rxHead) < HOST_UART_RX_LENGTH)
+	{
+		uart->rx[uart->rxTail++ & (HOST_UART_RX_LENGTH - 1)] = data[fed++];
+		uart->stats.rxBytes++;
+	}
+	return fed;
+}
+
+size_t hostUartTake(int port, uint8_t *data, size_t maxLength)
+{
+	HostUart *const uart = getUart(port);
+	size_t taken = 0;
+	if (uart == NULL)
+		return 0;
+	while (taken < maxLength && uart->txTail != uart->txHead)
+		data[taken++] = uart->tx[uart->txTail++ & (HOST_UART_TX_LENGTH - 1)];
+	return taken;
+}
+
+uint32_t hostUartBaud(int port)
+{
+	HostUart *const uart = getUart(port);
+	return (uart == NULL) ? 0 : uart->baud;
+}
+
+//The XiphosLibrary/uart.h functions used by the robot code built on the PC.
+
+u08 uartWrite(const UartPort port, const u08 *data, const u08 length)
+{
+	const u08 free = uartTxFree(port);
+	HostUart *const uart = getUart(port);
+	const u08 written = (length < free) ? length : free;
+	if (uart == NULL)
+		return 0;
+	for (u08 i = 0; i < written; i++)
+		uart->tx[uart->txHead++ & (HOST_UART_TX_LENGTH - 1)] = data[i];
+	uart->stats.txBytes += written;
+	uart->stats.txDropped += length - written;
+	return written;
+}
+
+u08 uartRead(const UartPort port, u08 *data, const u08 maxLength)
+{
+	HostUart *const uart = getUart(port);
+	u08 count = 0;
+	if (uart == NULL)
+		return 0;
+	while (count < maxLength && uart->rxHead != uart->rxTail)
+		data[count++] = uart->rx[uart->rxHead++ & (HOST_UART_RX_LENGTH - 1)];
+	return count;
+}
+
+u08 uartTxPending(const UartPort port)
+{
+	HostUart *const uart = getUart(port);
+	return (uart == NULL) ? 0 : (u08)(uart->txHead - uart->txTail);
+}
+
+u08 uartTxFree(const UartPort port)
+{
+	return (getUart(port) == NULL) ? 0 : HOST_UART_TX_LENGTH - 1 - uartTxPending(port);
+}
+
+bool uartTxIdle(const UartPort port)
+{
+	return (uartTxPending(port) == 0);
+}
+
+void uartGetStats(const UartPort port, UartStats *stats)
+{
+	HostUart *const uart = getUart(port);
+	if (uart != NULL)
+		*stats = uart->stats;
+}
+
+bool uartSetBaud(const UartPort port, const u32 baud)
+{
+	HostUart *const uart = getUart(port);
+	if (uart == NULL || !uartBaudSupported(baud))
+		return FALSE;
+	uart->baud = baud;
+	return TRUE;
+}
+
+u32 uartGetBaud(const UartPort port)
+{
+	return hostUartBaud(port);
+}
+
+//! A pty or a pipe has no baud rate, so any rate the robot could use works.
+bool uartBaudSupported(const u32 baud)
+{
+	return (baud != 0 && baud <= F_CPU / 8);
+}
+
+//The Launcher's rtc.h functions.
+
+void hostClockSet(uint32_t us)
+{
+	clockStopped = TRUE;
+	stoppedUs = us;
+}
+
+u32 getUptimeUs()
+{
+	if (clockStopped)
+		return stoppedUs;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!clockStarted)
+	{
+		clockStarted = TRUE;
+		clockStart = now;
+	}
+	return (u32)((now.tv_sec - clockStart.tv_sec) * 1000000LL + (now.tv_nsec - clockStart.tv_nsec) / 1000);
+}
+
+u32 getUptimeMs()
+{
+	return getUptimeUs() / 1000;
+}
+
+u32 getMsCount()
+{
+	return getUptimeMs();
+}
+
+u16 getFastTicks()
+{
+	return (u16)(getUptimeUs() * FAST_TICKS_PER_US);
+}
+
+//! There is no LED on the PC; a software fault is printed instead.
+void ledOn()
+{
+}
+
+//The Launcher's debug.h functions. Debug logs are dropped, since the benchmarks log a bad CRC for every error they inject.
+
+void logDebug(const char *messageFormat, ...)
+{
+	(void)messageFormat;
+}
+
+static void printLog(const char *level, const char *messageFormat, va_list args)
+{
+	fprintf(stderr, "robot %s: ", level);
+	vfprintf(stderr, messageFormat, args);
+	fputc('\n', stderr);
+}
+
+void logWarning(const char *messageFormat, ...)
+{
+	va_list args;
+	va_start(args, messageFormat);
+	printLog("warning", messageFormat, args);
+	va_end(args);
+}
+
+void logCritical(const char *messageFormat, ...)
+{
+	va_list args;
+	va_start(args, messageFormat);
+	printLog("critical", messageFormat, args);
+	va_end(args);
+}
+
+void logSoftwareFault(const char *filename, u16 lineNumber, const char *message, u16 arg1, u16 arg2)
+{
+	fprintf(stderr, "robot software fault: %s:%u: %s (%u, %u)\n", filename, lineNumber, message, arg1, arg2);
+}
@@ -0,0 +1,110 @@
+/*! @file
+    Runs robot code on the PC, for the Host tests and benchmarks. The Launcher's packetprotocol.c, telemetry.c and
+    linkBench.c are built with the native C compiler against the stand-in AVR headers in this directory, and these
+    functions take the place of the UART, the clock and the debug logs (hostfirmware.c), and give C++ code a way into
+    the robot's packet links (hostlink.c), telemetry (hosttelemetry.c) and link benchmark (hostlinkbench.c).
+
+    Everything here runs in one thread: the robot's code has no interrupts on the PC, and nothing else may call into it
+    at the same time.
+ */
+
+#ifndef HOSTFIRMWARE_H
+#define HOSTFIRMWARE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! The number of UARTs the robot code can use, NUM_UART_PORTS in XiphosLibrary/uart.h.
+#define HOST_UART_PORTS 2
+
+//Values from Launcher/packetprotocol.h, which C++ code can't include since globals.h defines bool. Set in hostlink.c.
+extern const uint8_t hostPacketOverhead;   //!< PACKET_OVERHEAD, the length of a frame with no data.
+extern const uint8_t hostLinkControlFirst; //!< LINK_CONTROL_FIRST, the first packet type the links handle themselves.
+extern const uint8_t hostReliableMaxData;  //!< RELIABLE_MAX_DATA, the longest data section of a reliable packet.
+extern const uint16_t hostBaudProposeIntervalMs; //!< BAUD_PROPOSE_INTERVAL_MS, how often a baud rate proposal is repeated.
+extern const uint16_t hostBaudConfirmTimeoutMs;  //!< BAUD_CONFIRM_TIMEOUT_MS, how long the accepting end waits for a ping.
+extern const uint8_t hostBaudMaxFailures;        //!< BAUD_MAX_FAILURES, the proposals after which the proposer gives up.
+
+//! Empties both UARTs and sets them back to their boot baud rates.
+void hostUartReset(void);
+//! Adds bytes to a UART's receive buffer, as if they came over the wire. @return The number of bytes that fit.
+size_t hostUartFeed(int port, const uint8_t *data, size_t length);
+//! Takes the bytes the robot code has written to a UART, as if they went out over the wire. @return The number taken.
+size_t hostUartTake(int port, uint8_t *data, size_t maxLength);
+//! The baud rate the robot code has set on a UART.
+uint32_t hostUartBaud(int port);
+
+/*! Stops the robot's clock at a time in microseconds, for code that needs to control time. Until this is called, the
+ *  clock follows the PC's monotonic clock from the first time it is read.
+ */
+void hostClockSet(uint32_t us);
+
+//! Packets received by a robot link: the UART it is on, and the packet.
+typedef void (*HostPacketHandler)(int port, uint8_t packetType, const uint8_t *data, uint8_t dataLength);
+
+//! The packet link counters the tests and benchmarks look at, from the robot's PacketLinkStats.
+typedef struct
+{
+	uint32_t bytesReceived;
+	uint32_t bytesSent;
+	uint16_t packetsReceived;
+	uint16_t packetsSent;
+	uint16_t crcErrors;
+	uint16_t framingErrors;
+	uint16_t invalidHeaders;
+	uint16_t resyncs;
+	uint16_t droppedPackets;
+	uint16_t retransmissions;
+	uint16_t duplicates;
+} HostLinkStats;
+
+/*! Starts a robot packet link on a UART, replacing any link there, which accepts every packet type below the link
+ *  control packets with any dataLength, and passes them to handler.
+ *  @param cobs true for COBS framing, false for the 0xA5 0x5A start bytes.
+ */
+void hostLinkInit(int port, int cobs, HostPacketHandler handler);
+//! Runs packetLinkExec() on a link once.
+void hostLinkExec(int port);
+//! Queues a packet on a link with packetLinkSend(). @return false if it didn't fit in the queue.
+int hostLinkSend(int port, uint8_t packetType, const uint8_t *data, uint8_t dataLength);
+/*! Sends a packet on a link whose UART is otherwise idle, and takes the bytes that go out.
+ *  @return The length of the frame written to frame, which must have room for the longest frame, or 0 if the packet
+ *  couldn't be queued.
+ */
+size_t hostLinkEncode(int port, uint8_t packetType, const uint8_t *data, uint8_t dataLength, uint8_t *frame, size_t maxLength);
+//! Queues a packet on a link's reliable channel. @return false if the window is full.
+int hostLinkSendReliable(int port, uint8_t packetType, const uint8_t *data, uint8_t dataLength);
+//! Starts a baud rate change on a link with packetLinkProposeBaud().
+void hostLinkProposeBaud(int port, uint32_t baud);
+//! Checks if a link is in the middle of a baud rate change, as the proposer or the accepting end.
+int hostLinkBaudChanging(int port);
+void hostLinkStats(int port, HostLinkStats *stats);
+
+/*! Starts the Launcher's PC link on UART0 with the robot's link benchmark behind it: PING_REQUEST, BULK_SINK,
+ *  BULK_SOURCE and GET_LINK_REPORT are handled as on the robot, and every other packet is ignored.
+ */
+void hostLinkBenchInit(void);
+//! Runs the PC link and the BULK_SOURCE transfer once, as the Launcher's main loop does.
+void hostLinkBenchExec(void);
+
+//! Sets the sensor readings telemetry.c samples, in TelemetryChannel order.
+void hostTelemetrySetReadings(const uint16_t values[6]);
+/*! Called with each TELEMETRY_DATA packet telemetry.c sends.
+ *  @return false to have the send fail, as it does on the robot when the telemetry queue is full.
+ */
+typedef int (*HostTelemetrySink)(const uint8_t *data, uint8_t dataLength);
+void hostTelemetrySetSink(HostTelemetrySink sink);
+//Call telemetryStart(), telemetryStop() and telemetryExec(). Set the time with hostClockSet() first.
+void hostTelemetryStart(uint16_t periodMs);
+void hostTelemetryStop(void);
+void hostTelemetryExec(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
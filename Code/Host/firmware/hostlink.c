@@ -0,0 +1,110 @@
+/*! @file
+    Runs the Launcher's packet links (packetprotocol.c) on the PC, one on each UART of hostfirmware.c.
+    See hostfirmware.h.
+ */
+#include "hostfirmware.h"
+#include "packetprotocol.h"
+#include <stddef.h>
+
+const uint8_t hostPacketOverhead = PACKET_OVERHEAD;
+const uint8_t hostLinkControlFirst = LINK_CONTROL_FIRST;
+const uint8_t hostReliableMaxData = RELIABLE_MAX_DATA;
+const uint16_t hostBaudProposeIntervalMs = BAUD_PROPOSE_INTERVAL_MS;
+const uint16_t hostBaudConfirmTimeoutMs = BAUD_CONFIRM_TIMEOUT_MS;
+const uint8_t hostBaudMaxFailures = BAUD_MAX_FAILURES;
+
+//! The global link packetprotocol.c defines is left alone; these are the links on each port.
+static PacketLink links[HOST_UART_PORTS];
+static HostPacketHandler handlers[HOST_UART_PORTS];
+
+//An executor for each port, since an ExecCallback_t isn't told which link a packet came from.
+
+static void execPort0(const u08 packetType, const u08 sequence, const u08 * const data, const u08 dataLength)
+{
+	(void)sequence;
+	if (handlers[0] != NULL)
+		handlers[0](0, packetType, data, dataLength);
+}
+
+static void execPort1(const u08 packetType, const u08 sequence, const u08 * const data, const u08 dataLength)
+{
+	(void)sequence;
+	if (handlers[1] != NULL)
+		handlers[1](1, packetType, data, dataLength);
+}
+
+static const ExecCallback_t executors[HOST_UART_PORTS] = {execPort0, execPort1};
+
+static PacketLink *getLink(const int port)
+{
+	return (port >= 0 && port < HOST_UART_PORTS) ? &links[port] : NULL;
+}
+
+void hostLinkInit(int port, int cobs, HostPacketHandler handler)
+{
+	PacketLink *const link = getLink(port);
+	if (link == NULL)
+		return;
+	handlers[port] = handler;
+	packetLinkInit(link, (UartPort)port, cobs ? PACKET_FRAMING_COBS : PACKET_FRAMING_START_BYTES);
+	packetLinkConfig(link, NULL, executors[port], LINK_CONTROL_FIRST - 1);
+}
+
+void hostLinkExec(int port)
+{
+	PacketLink *const link = getLink(port);
+	if (link != NULL)
+		packetLinkExec(link);
+}
+
+int hostLinkSend(int port, uint8_t packetType, const uint8_t *data, uint8_t dataLength)
+{
+	PacketLink *const link = getLink(port);
+	return (link != NULL) && packetLinkSend(link, packetType, data, dataLength);
+}
+
+size_t hostLinkEncode(int port, uint8_t packetType, const uint8_t *data, uint8_t dataLength, uint8_t *frame, size_t maxLength)
+{
+	if (!hostLinkSend(port, packetType, data, dataLength))
+		return 0;
+	//the link pumps the whole frame into the empty transmit buffer, since a frame always fits
+	hostLinkExec(port);
+	return hostUartTake(port, frame, maxLength);
+}
+
+int hostLinkSendReliable(int port, uint8_t packetType, const uint8_t *data, uint8_t dataLength)
+{
+	PacketLink *const link = getLink(port);
+	return (link != NULL) && packetLinkSendReliable(link, packetType, data, dataLength);
+}
+
+void hostLinkProposeBaud(int port, uint32_t baud)
+{
+	PacketLink *const link = getLink(port);
+	if (link != NULL)
+		packetLinkProposeBaud(link, baud);
+}
+
+int hostLinkBaudChanging(int port)
+{
+	PacketLink *const link = getLink(port);
+	return (link != NULL) && link->baudChange.state != BAUD_IDLE;
+}
+
+void hostLinkStats(int port, HostLinkStats *stats)
+{
+	PacketLink *const link = getLink(port);
+	if (link == NULL)
+		return;
+	stats->bytesReceived = link->stats.bytesReceived;
+	stats->bytesSent = link->stats.bytesSent;
+	stats->packetsReceived = link->stats.packetsReceived;
+	stats->packetsSent = link->stats.packetsSent;
+	stats->crcErrors = link->stats.crcErrors;
+	stats->framingErrors = link->stats.framingErrors;
+	stats->invalidHeaders = link->stats.invalidHeaders;
+	stats->resyncs = link->stats.resyncs;
+	stats->droppedPackets = link->stats.droppedPackets;
+	stats->retransmissions = link->stats.retransmissions;
+	stats->duplicates = link->stats.duplicates;
+}
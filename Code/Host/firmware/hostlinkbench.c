@@ -0,0 +1,45 @@
+/*! @file
+    Runs the robot's end of the link benchmark (Launcher/linkBench.c) on the PC, on the Launcher's own PC link
+    (::pcLink on UART0), for linkbench --sim. See hostfirmware.h.
+ */
+#include "hostfirmware.h"
+#include "linkBench.h"
+#include "packetprotocol.h"
+#include "protocol.h"
+
+//! Handles the link benchmark's packets the way execLauncherPacket() does. The robot's other packets are ignored.
+static void execBenchPacket(const u08 packetType, const u08 sequence, const u08 * const data, const u08 dataLength)
+{
+	(void)sequence;
+	switch (packetType)
+	{
+		case PING_REQUEST:
+			sendPacket(PING_REPLY, PING_REQUEST_payload(data), PING_REQUEST_payloadLength(dataLength));
+			break;
+		case BULK_SINK:
+			linkBenchSink(BULK_SINK_payloadLength(dataLength));
+			break;
+		case BULK_SOURCE:
+			linkBenchSourceStart(BULK_SOURCE_count(data), BULK_SOURCE_patternLength(data));
+			break;
+		case GET_LINK_REPORT:
+			linkBenchReport();
+			break;
+		default:
+			break;
+	}
+}
+
+void hostLinkBenchInit(void)
+{
+	//as main.c sets the link up, with the same packet length checks
+	initPacketDriver();
+	configPacketProcessor(protocolUplinkLengthValid, execBenchPacket, LAST_UplinkPacketType - 1);
+	linkBenchSourceStart(0, 0);
+}
+
+void hostLinkBenchExec(void)
+{
+	execPacketDriver();
+	linkBenchExec();
+}
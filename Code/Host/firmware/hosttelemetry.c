@@ -0,0 +1,63 @@
+/*! @file
+    Runs the Launcher's telemetry.c on the PC, taking the packets it sends instead of queueing them on the PC link.
+    See hostfirmware.h.
+ */
+#include "debug.h"
+#include "hostfirmware.h"
+#include "launcherPackets.h"
+#include "main.h"
+#include "packetprotocol.h"
+#include "telemetry.h"
+#include <stddef.h>
+
+//What telemetry.c uses from main.c and packetprotocol.c.
+PacketLink pcLink;
+volatile u16 totalInnerEncoderTicks;
+volatile u16 totalWallEncoderTicks;
+volatile u16 innerEncoderReading;
+volatile u16 wallEncoderReading;
+volatile u16 batteryReading;
+volatile s16 error;
+
+static HostTelemetrySink telemetrySink;
+
+void hostTelemetrySetReadings(const uint16_t values[6])
+{
+	totalInnerEncoderTicks = values[TELEMETRY_INNER_TICKS];
+	totalWallEncoderTicks = values[TELEMETRY_WALL_TICKS];
+	innerEncoderReading = values[TELEMETRY_INNER_READING];
+	wallEncoderReading = values[TELEMETRY_WALL_READING];
+	batteryReading = values[TELEMETRY_BATTERY];
+	error = (s16)values[TELEMETRY_ERROR];
+}
+
+void hostTelemetrySetSink(HostTelemetrySink sink)
+{
+	telemetrySink = sink;
+}
+
+void hostTelemetryStart(uint16_t periodMs)
+{
+	telemetryStart(periodMs);
+}
+
+void hostTelemetryStop(void)
+{
+	telemetryStop();
+}
+
+void hostTelemetryExec(void)
+{
+	telemetryExec();
+}
+
+//! Passes the packets telemetry.c sends to the sink.
+bool packetLinkSendPriority(PacketLink *link, const PacketPriority priority, const u08 packetType, const u08 *const data, const u08 dataLength)
+{
+	if (link != &pcLink || priority != PACKET_PRIORITY_TELEMETRY || packetType != TELEMETRY_DATA)
+	{
+		SOFTWARE_FAULT(PSTR("unexpected telemetry send"), priority, packetType);
+		return FALSE;
+	}
+	return (telemetrySink != NULL) && telemetrySink(data, dataLength);
+}
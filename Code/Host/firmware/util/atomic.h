@@ -0,0 +1,12 @@
+/*! @file
+    Stands in for avr-libc's <util/atomic.h> on the PC. Robot code built there runs in one thread with no interrupts,
+    so an ATOMIC_BLOCK just runs its body once.
+ */
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 0
+#define ATOMIC_BLOCK(type) for (int atomicOnce = 1; atomicOnce; atomicOnce = 0)
+
+#endif
@@ -0,0 +1,265 @@
+/*! @file
+    Compares the two packet framings of the Launcher's parser (Launcher/packetprotocol.c, built for the PC) on noisy
+    captures: the 0xA5 0x5A start bytes, and COBS.
+
+    usage: framingbench [--packets n] [--max-size n] [--corrupt fraction] [--burst n] [--chunk n] [--rounds n] [--seed n]
+
+    The same --packets packets, with random types and 2 to --max-size byte payloads, are framed both ways by the robot's
+    own sender. The same --corrupt fraction of the packets is then corrupted in both captures, each with a burst of up to
+    --burst random bytes at a random place in its frame. Each capture is parsed clean and noisy:
+    - MB/s:      the parse rate, feeding --chunk bytes at a time, the best of --rounds.
+    - lost:      packets that weren't delivered, split into the corrupted ones (which can't be) and intact ones the
+                 parser threw away while it resynchronized. COBS loses the packet after a corrupted delimiter.
+    - bogus:     delivered packets that weren't sent, which got past the CRC.
+    - recovery:  for each corrupted packet followed by an intact one, the bytes from the end of the corrupted frame until
+                 the parser delivered a packet again, fed a byte at a time. The mean and maximum are shown, and the mean
+                 is also in milliseconds at 38400 baud. The clean rows measure from the same packets, which gives the
+                 length of the next frame: the least it can be.
+ */
+
+#include "firmware/hostfirmware.h"
+#include "protocol.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using robolink::MAX_PACKET_DATA;
+
+//! The length of the longest frame, which is the same with either framing.
+static const std::size_t MAX_FRAME_LENGTH = MAX_PACKET_DATA + hostPacketOverhead;
+//! Packet types are kept below the link control packets.
+static const unsigned MAX_PACKET_TYPE = hostLinkControlFirst - 1u;
+//! The UART the captures are parsed on.
+static const int PORT = 0;
+//! The link's baud rate the recovery times are given at, in bits per second with 10 bits per byte.
+static const double BAUD = 38400.0;
+
+static void printUsage()
+{
+	std::fprintf(stderr, "usage: framingbench [--packets n] [--max-size n] [--corrupt fraction] [--burst n] [--chunk n] [--rounds n] [--seed n]\n");
+}
+
+//! A packet as it was sent. The first two bytes of the data are its index.
+struct SentPacket
+{
+	uint8_t type;
+	std::vector<uint8_t> data;
+};
+
+//! The packets framed one way, and where each frame is in the capture.
+struct Capture
+{
+	std::vector<uint8_t> bytes;
+	std::vector<std::size_t> frameStarts;
+	std::vector<std::size_t> frameEnds;
+};
+
+static std::vector<SentPacket> packets;
+
+//What the parser has delivered in the current run.
+static std::vector<long> deliveredAt;
+static unsigned bogus;
+//! The number of bytes fed so far, for when each packet was delivered.
+static std::size_t fedBytes;
+
+//! The executor: matches each packet with the one sent with its index, and records when it came.
+static void receivePacket(int port, uint8_t packetType, const uint8_t *data, uint8_t dataLength)
+{
+	(void)port;
+	const std::size_t index = (dataLength >= 2) ? ((std::size_t)data[0] << 8 | data[1]) : packets.size();
+	if (index >= packets.size() || deliveredAt[index] >= 0 || packetType != packets[index].type
+	    || dataLength != packets[index].data.size() || !std::equal(data, data + dataLength, packets[index].data.begin()))
+	{
+		bogus++;
+		return;
+	}
+	deliveredAt[index] = (long)fedBytes;
+}
+
+static void generatePackets(unsigned count, unsigned maxSize, std::mt19937 &random)
+{
+	std::uniform_int_distribution<unsigned> types(0, MAX_PACKET_TYPE);
+	std::uniform_int_distribution<unsigned> sizes(2, maxSize);
+	std::uniform_int_distribution<unsigned> bytes(0, 0xFF);
+	for (unsigned i = 0; i < count; i++)
+	{
+		SentPacket packet{(uint8_t)types(random), std::vector<uint8_t>(sizes(random))};
+		for (uint8_t &byte : packet.data)
+			byte = (uint8_t)bytes(random);
+		packet.data[0] = (uint8_t)(i >> 8);
+		packet.data[1] = (uint8_t)i;
+		packets.push_back(std::move(packet));
+	}
+}
+
+//! Frames all the packets with the robot's sender.
+static Capture frame(bool cobs)
+{
+	Capture capture;
+	std::vector<uint8_t> bytes(MAX_FRAME_LENGTH);
+	hostUartReset();
+	hostLinkInit(PORT, cobs, nullptr);
+	for (const SentPacket &packet : packets)
+	{
+		const std::size_t length = hostLinkEncode(PORT, packet.type, packet.data.data(), (uint8_t)packet.data.size(), bytes.data(), bytes.size());
+		capture.frameStarts.push_back(capture.bytes.size());
+		capture.bytes.insert(capture.bytes.end(), bytes.begin(), bytes.begin() + length);
+		capture.frameEnds.push_back(capture.bytes.size());
+	}
+	return capture;
+}
+
+/*! Corrupts the chosen packets' frames in a capture. The positions and values come from a generator seeded the same
+ *  way for each framing, so both captures are hit in the same places relative to their frames.
+ */
+static Capture corrupt(const Capture &clean, const std::vector<std::size_t> &corrupted, unsigned burst, unsigned seed)
+{
+	Capture noisy = clean;
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<double> position(0.0, 1.0);
+	std::uniform_int_distribution<unsigned> flips(1, 0xFF);
+	for (std::size_t index : corrupted)
+	{
+		const std::size_t start = noisy.frameStarts[index];
+		const std::size_t length = noisy.frameEnds[index] - start;
+		const std::size_t offset = std::min(length - 1, (std::size_t)(position(random) * length));
+		for (std::size_t i = offset; i < std::min<std::size_t>(length, offset + burst); i++)
+			noisy.bytes[start + i] ^= (uint8_t)flips(random);
+	}
+	return noisy;
+}
+
+//! Feeds a capture to a new link a chunk at a time. @return The time taken in seconds.
+static double parse(const Capture &capture, bool cobs, std::size_t chunk)
+{
+	hostUartReset();
+	hostLinkInit(PORT, cobs, receivePacket);
+	deliveredAt.assign(packets.size(), -1);
+	bogus = 0;
+	fedBytes = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	while (fedBytes < capture.bytes.size())
+	{
+		fedBytes += hostUartFeed(PORT, &capture.bytes[fedBytes], std::min(chunk, capture.bytes.size() - fedBytes));
+		hostLinkExec(PORT);
+	}
+	//deliver anything still in the link's receive buffer
+	for (unsigned pass = 0; pass < MAX_FRAME_LENGTH; pass++)
+		hostLinkExec(PORT);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*! Parses a capture, and prints a row of results.
+ *  @param isCorrupted Whether each packet was corrupted in the noisy captures, even if this one is clean.
+ */
+static void measure(const char *name, const Capture &capture, bool cobs, const std::vector<bool> &isCorrupted, std::size_t chunk, unsigned rounds)
+{
+	double best = 0.0;
+	for (unsigned round = 0; round < rounds; round++)
+	{
+		const double seconds = parse(capture, cobs, chunk);
+		if (round == 0 || seconds < best)
+			best = seconds;
+	}
+
+	//the recovery is measured a byte at a time, so when each packet is delivered is known exactly
+	parse(capture, cobs, 1);
+	unsigned lostCorrupted = 0;
+	unsigned lostIntact = 0;
+	for (std::size_t i = 0; i < packets.size(); i++)
+	{
+		if (deliveredAt[i] < 0)
+			(isCorrupted[i] ? lostCorrupted : lostIntact)++;
+	}
+	double totalRecovery = 0.0;
+	std::size_t maxRecovery = 0;
+	unsigned recoveries = 0;
+	for (std::size_t i = 0; i + 1 < packets.size(); i++)
+	{
+		if (!isCorrupted[i] || isCorrupted[i + 1])
+			continue;
+		std::size_t next = i + 1;
+		while (next < packets.size() && deliveredAt[next] < 0)
+			next++;
+		const std::size_t recovery = ((next < packets.size()) ? (std::size_t)deliveredAt[next] : capture.bytes.size()) - capture.frameEnds[i];
+		totalRecovery += recovery;
+		maxRecovery = std::max(maxRecovery, recovery);
+		recoveries++;
+	}
+	const double meanRecovery = (recoveries > 0) ? totalRecovery / recoveries : 0.0;
+
+	std::printf("%-13s %9zu %8.2f %9u %9u %7u %9.1f %9zu %8.2f\n", name, capture.bytes.size(), capture.bytes.size() / best / 1e6,
+	            lostCorrupted, lostIntact, bogus, meanRecovery, maxRecovery, meanRecovery * 10.0 * 1000.0 / BAUD);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned count = 20000;
+	unsigned maxSize = 64;
+	double corruptFraction = 0.01;
+	unsigned burst = 1;
+	unsigned chunk = 32;
+	unsigned rounds = 5;
+	unsigned seed = 1;
+
+	for (int arg = 1; arg < argc; arg++)
+	{
+		const std::string option = argv[arg];
+		if (option == "--packets" && arg + 1 < argc)
+			count = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--max-size" && arg + 1 < argc)
+			maxSize = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--corrupt" && arg + 1 < argc)
+			corruptFraction = std::strtod(argv[++arg], nullptr);
+		else if (option == "--burst" && arg + 1 < argc)
+			burst = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--chunk" && arg + 1 < argc)
+			chunk = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--rounds" && arg + 1 < argc)
+			rounds = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--seed" && arg + 1 < argc)
+			seed = std::strtoul(argv[++arg], nullptr, 0);
+		else
+		{
+			printUsage();
+			return 2;
+		}
+	}
+	//the index in each payload is 16 bits
+	if (count == 0 || count > 0x10000 || maxSize < 2 || maxSize > MAX_PACKET_DATA || burst == 0 || chunk == 0 || rounds == 0)
+	{
+		printUsage();
+		return 2;
+	}
+
+	std::mt19937 random(seed);
+	generatePackets(count, maxSize, random);
+	std::bernoulli_distribution hit(corruptFraction);
+	std::vector<bool> isCorrupted(count);
+	std::vector<std::size_t> corrupted;
+	for (std::size_t i = 0; i < count; i++)
+	{
+		isCorrupted[i] = hit(random);
+		if (isCorrupted[i])
+			corrupted.push_back(i);
+	}
+
+	std::printf("%u packets of 2-%u bytes, %zu corrupted with bursts of up to %u bytes\n", count, maxSize, corrupted.size(), burst);
+	std::printf("%-13s %9s %8s %9s %9s %7s %19s %8s\n", "", "bytes", "MB/s", "lost", "lost", "bogus", "recovery bytes", "ms");
+	std::printf("%-13s %9s %8s %9s %9s %7s %9s %9s %8s\n", "", "", "", "corrupted", "intact", "", "mean", "max", "mean");
+	const unsigned noiseSeed = random();
+	for (bool cobs : {false, true})
+	{
+		const Capture clean = frame(cobs);
+		const Capture noisy = corrupt(clean, corrupted, burst, noiseSeed);
+		measure(cobs ? "COBS clean" : "A5/5A clean", clean, cobs, isCorrupted, chunk, rounds);
+		measure(cobs ? "COBS noisy" : "A5/5A noisy", noisy, cobs, isCorrupted, chunk, rounds);
+	}
+	return 0;
+}
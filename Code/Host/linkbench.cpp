@@ -0,0 +1,418 @@
+/*! @file
+    Measures the performance of the Launcher's PC link: the round trip time, the sustained throughput in each
+    direction, and the CRC and framing error rates, for a range of payload sizes and baud rates.
+
+    usage: linkbench [--baud rate] [--bauds rate,...] [--cobs] [--sizes n,...] [--pings n] [--seconds s] <device>
+           linkbench [--bauds rate,...] [--cobs] [--sizes n,...] [--pings n] [--seconds s] --sim
+
+    The link starts at --baud, the rate the robot boots at. Each of the --bauds is then tried in turn by asking the robot
+    to switch (see PacketLink::requestBaud()), and the link goes back to --baud at the end.
+    For each baud rate and each payload size (the data section length, up to MAX_PACKET_DATA):
+    - rtt:    PING_REQUESTs sent one at a time, each answered with a PING_REPLY. Prints the minimum, median, 90th and 99th
+              percentile and maximum round trip in ms, and the pings that got no matching reply.
+    - up:     BULK_SINK packets sent for --seconds. The robot's LINK_REPORT before and after tells how many arrived,
+              and how long the robot took to take them in.
+    - down:   a BULK_SOURCE transfer of about --seconds worth of BULK_DATA packets, checked for gaps and bad patterns.
+    - errors: CRC and COBS framing errors at both ends, headers the robot rejected, and bytes the robot's UART
+              discarded because its receive buffer was full. Each is counted over the whole row, and is also shown
+              per 1000 packets received at that end. Every one of them makes the receiver resynchronize.
+    Throughput is in payload bytes per second, and as a percentage of the raw baud rate (10 bits per byte).
+
+    --sim runs the robot's end without a robot: the Launcher's packetprotocol.c and linkBench.c, built for the PC (see
+    firmware/hostfirmware.h), in a thread on the other side of a pty, starting at the robot's boot rate. The device can
+    also be a pty connected to some other end of the link. A pty isn't limited by a baud rate, so only the round trip
+    times and the error counts mean anything there, and the throughput shows how fast the robot's code can go.
+ */
+
+#include "firmware/hostfirmware.h"
+#include "packetlink.h"
+#include "protocol.h"
+#include "serialport.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace robolink;
+
+//! How long to wait for a reply, or for the next BULK_DATA packet.
+static const int REPLY_TIMEOUT_MS = 1000;
+//! The UART the robot's end of the link is on with --sim.
+static const int SIM_PORT = 0;
+
+//The wire between the ends for --sim. A pty has no baud rate, so bytes only get through while both ends are set to the
+//same one, as on a real wire.
+static std::mutex simWire;
+//! The PC's rate, changed once the robot has taken everything the PC sent at the old one.
+static std::atomic<unsigned> simPcBaud{0};
+//! Bytes the robot has read from the pty but not yet fed to its UART. Guarded by simWire.
+static std::vector<uint8_t> simUnfed;
+
+static void printUsage()
+{
+	std::fprintf(stderr, "usage: linkbench [--baud rate] [--bauds rate,...] [--cobs] [--sizes n,...] [--pings n] [--seconds s] <device>\n"
+	                     "       linkbench [--bauds rate,...] [--cobs] [--sizes n,...] [--pings n] [--seconds s] --sim\n");
+}
+
+//! Parses a comma separated list of numbers.
+static std::vector<unsigned> parseList(const std::string &text)
+{
+	std::vector<unsigned> values;
+	std::istringstream stream(text);
+	std::string item;
+	while (std::getline(stream, item, ','))
+		values.push_back(std::strtoul(item.c_str(), nullptr, 0));
+	return values;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//! The value below which a fraction of the sorted samples fall.
+static double percentile(const std::vector<double> &sorted, double fraction)
+{
+	if (sorted.empty())
+		return 0.0;
+	const std::size_t index = (std::size_t)std::ceil(fraction * sorted.size());
+	return sorted[std::min(sorted.size(), std::max<std::size_t>(index, 1)) - 1];
+}
+
+//! Waits for a packet of a type, discarding anything else. @return false on timeout.
+static bool waitFor(PacketLink &link, uint8_t type, Packet &packet, int timeoutMs = REPLY_TIMEOUT_MS)
+{
+	const auto start = std::chrono::steady_clock::now();
+	while (true)
+	{
+		const int remaining = timeoutMs - (int)millisecondsSince(start);
+		if (remaining <= 0 || !link.poll(remaining, packet))
+			return false;
+		if (packet.type == type)
+			return true;
+	}
+}
+
+//! Asks the robot for its counters, trying a few times in case the request or the report is lost.
+static LinkReport readReport(PacketLink &link)
+{
+	Packet packet;
+	for (int attempt = 0; attempt < 3; attempt++)
+	{
+		link.send(GET_LINK_REPORT);
+		if (waitFor(link, LINK_REPORT, packet))
+			return LinkReport::decode(packet.data);
+	}
+	throw std::runtime_error("no LINK_REPORT from the robot");
+}
+
+//! The results for one payload size at one baud rate.
+struct Row
+{
+	std::vector<double> rtts;
+	unsigned pingsLost = 0;
+	double upRate = 0.0;
+	unsigned upLost = 0;
+	double downRate = 0.0;
+	unsigned downLost = 0;
+	unsigned downBad = 0;
+};
+
+//! Sends pings one at a time, and records the round trip of each one answered.
+static void measureRtt(PacketLink &link, std::size_t size, unsigned count, Row &row)
+{
+	std::vector<uint8_t> payload(size);
+	Packet packet;
+	for (unsigned i = 0; i < count; i++)
+	{
+		//number each ping, so a late echo of an earlier one isn't mistaken for this one's
+		for (std::size_t j = 0; j < size; j++)
+			payload[j] = (uint8_t)((j < 2) ? (i >> (8 * (1 - j))) : (i + j));
+
+		const auto start = std::chrono::steady_clock::now();
+		link.send(PING_REQUEST, payload);
+		bool answered = false;
+		while (!answered && waitFor(link, PING_REPLY, packet, REPLY_TIMEOUT_MS - (int)millisecondsSince(start)))
+			answered = (packet.data == payload);
+		if (answered)
+			row.rtts.push_back(millisecondsSince(start));
+		else
+			row.pingsLost++;
+	}
+	std::sort(row.rtts.begin(), row.rtts.end());
+}
+
+//! Sends BULK_SINK packets for a number of seconds, and works out from the robot's counters how many arrived and how fast.
+static void measureUp(PacketLink &link, std::size_t size, double seconds, Row &row)
+{
+	const LinkReport before = readReport(link);
+	const std::vector<uint8_t> payload(size, 0x55);
+	Packet packet;
+	unsigned sent = 0;
+	const auto start = std::chrono::steady_clock::now();
+	while (millisecondsSince(start) < seconds * 1000.0)
+	{
+		link.send(BULK_SINK, payload);
+		sent++;
+		//keep up with whatever the robot sends meanwhile
+		while (link.poll(0, packet))
+		{
+		}
+	}
+	const LinkReport after = readReport(link);
+
+	const unsigned arrived = after.sinkPackets - before.sinkPackets;
+	const uint32_t elapsedMs = after.uptimeMs - before.uptimeMs;
+	row.upLost = (sent > arrived) ? sent - arrived : 0;
+	row.upRate = (elapsedMs > 0) ? (after.sinkBytes - before.sinkBytes) * 1000.0 / elapsedMs : 0.0;
+}
+
+//! Asks for enough BULK_DATA packets to take about a number of seconds at the baud rate, and checks each one.
+static void measureDown(PacketLink &link, std::size_t size, double seconds, unsigned baud, Row &row)
+{
+	const std::size_t length = std::max<std::size_t>(size, 2);
+	const unsigned count = std::max(1u, std::min(0xFFFFu, (unsigned)(seconds * baud / 10 / (length + hostPacketOverhead))));
+	link.send(BULK_SOURCE, BulkSource{(uint16_t)count, (uint8_t)(length - 2)}.encode());
+
+	const auto start = std::chrono::steady_clock::now();
+	double lastMs = 0.0;
+	unsigned received = 0;
+	std::size_t bytes = 0;
+	Packet packet;
+	while (received < count && waitFor(link, BULK_DATA, packet))
+	{
+		lastMs = millisecondsSince(start);
+		received++;
+		bytes += packet.data.size();
+		const BulkData data = BulkData::decode(packet.data);
+		bool good = (packet.data.size() == length);
+		for (std::size_t i = 0; good && i < data.pattern.size(); i++)
+			good = (data.pattern[i] == (uint8_t)(data.index + i));
+		if (!good)
+			row.downBad++;
+	}
+	if (received < count)
+		link.send(BULK_SOURCE, BulkSource{0, 0}.encode());
+
+	row.downLost = count - received;
+	row.downRate = (lastMs > 0.0) ? bytes * 1000.0 / lastMs : 0.0;
+}
+
+//! Runs the robot's end of the link for --sim until stop is set: moves bytes between the pty and the UART, and runs the link.
+static void runRobot(int fd, const std::atomic<bool> &stop)
+{
+	std::vector<uint8_t> bytes(256);
+	while (!stop)
+	{
+		{
+			std::lock_guard<std::mutex> lock(simWire);
+			pollfd readable = {fd, POLLIN, 0};
+			if (simUnfed.empty() && poll(&readable, 1, 1) > 0)
+			{
+				const ssize_t length = read(fd, bytes.data(), bytes.size());
+				//bytes sent at another rate arrive as garbage, which the parser treats the same as nothing
+				if (length > 0 && simPcBaud == hostUartBaud(SIM_PORT))
+					simUnfed.assign(bytes.begin(), bytes.begin() + length);
+			}
+			//what doesn't fit in the receive buffer waits, as if flow control held the PC back
+			const std::size_t fed = hostUartFeed(SIM_PORT, simUnfed.data(), simUnfed.size());
+			simUnfed.erase(simUnfed.begin(), simUnfed.begin() + fed);
+		}
+
+		hostLinkBenchExec();
+		std::size_t length;
+		while ((length = hostUartTake(SIM_PORT, bytes.data(), bytes.size())) > 0)
+		{
+			if (simPcBaud == hostUartBaud(SIM_PORT) && write(fd, bytes.data(), length) != (ssize_t)length)
+				std::fprintf(stderr, "linkbench: couldn't write to the pty\n");
+		}
+	}
+}
+
+/*! Changes the PC's rate for --sim, once the robot has taken everything the PC sent at the old rate.
+ *  @param master The pty master the robot reads.
+ */
+static void setSimPcBaud(int fd, int master, unsigned baud)
+{
+	setSerialBaud(fd, baud);
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(simWire);
+			int unread = 0;
+			if (ioctl(master, FIONREAD, &unread) != 0 || (unread == 0 && simUnfed.empty()))
+			{
+				simPcBaud = baud;
+				return;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+//! Prints a count, and the count per 1000 of the packets it is out of.
+static void printErrors(const char *name, unsigned errors, unsigned packets)
+{
+	std::printf(" %s %u (%.1f)", name, errors, (packets > 0) ? errors * 1000.0 / packets : 0.0);
+}
+
+//! Runs every payload size at the link's current baud rate.
+static void runBaud(PacketLink &link, const std::vector<unsigned> &sizes, unsigned pings, double seconds)
+{
+	const unsigned baud = link.baud();
+	const double rawRate = baud / 10.0;
+	std::printf("%7s %4s | %-37s | %-18s | %-24s | errors (per 1000 packets)\n",
+	            "baud", "size", "rtt ms: min   med   p90   p99   max lost", "up B/s   eff lost", "down B/s   eff lost  bad");
+	for (unsigned size : sizes)
+	{
+		const LinkStats pcBefore = link.stats();
+		const LinkReport robotBefore = readReport(link);
+
+		Row row;
+		measureRtt(link, size, pings, row);
+		measureUp(link, size, seconds, row);
+		measureDown(link, size, seconds, baud, row);
+
+		const LinkStats pcAfter = link.stats();
+		const LinkReport robotAfter = readReport(link);
+
+		std::printf("%7u %4u | %11.2f %5.2f %5.2f %5.2f %5.2f %4u | %8.0f %4.0f%% %4u | %8.0f %4.0f%% %4u %4u |",
+		            baud, size, percentile(row.rtts, 0.0), percentile(row.rtts, 0.5), percentile(row.rtts, 0.9),
+		            percentile(row.rtts, 0.99), row.rtts.empty() ? 0.0 : row.rtts.back(), row.pingsLost,
+		            row.upRate, row.upRate * 100.0 / rawRate, row.upLost,
+		            row.downRate, row.downRate * 100.0 / rawRate, row.downLost, row.downBad);
+		const unsigned pcPackets = pcAfter.packetsReceived - pcBefore.packetsReceived;
+		printErrors("pc crc", pcAfter.crcErrors - pcBefore.crcErrors, pcPackets);
+		printErrors("framing", pcAfter.framingErrors - pcBefore.framingErrors, pcPackets);
+		const unsigned robotPackets = (uint16_t)(robotAfter.packetsReceived - robotBefore.packetsReceived);
+		printErrors("| robot crc", (uint16_t)(robotAfter.crcErrors - robotBefore.crcErrors), robotPackets);
+		printErrors("framing", (uint16_t)(robotAfter.framingErrors - robotBefore.framingErrors), robotPackets);
+		printErrors("headers", (uint16_t)(robotAfter.invalidHeaders - robotBefore.invalidHeaders), robotPackets);
+		std::printf(" overrun bytes %u\n", (uint16_t)(robotAfter.rxOverruns - robotBefore.rxOverruns));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned baud = 38400;
+	std::vector<unsigned> bauds;
+	bool cobs = false;
+	bool sim = false;
+	bool baudGiven = false;
+	std::vector<unsigned> sizes = {0, 16, 64, 128, MAX_PACKET_DATA};
+	unsigned pings = 100;
+	double seconds = 2.0;
+
+	int arg = 1;
+	for (; arg < argc && std::strncmp(argv[arg], "--", 2) == 0; arg++)
+	{
+		const std::string option = argv[arg];
+		if (option == "--cobs")
+			cobs = true;
+		else if (option == "--sim")
+			sim = true;
+		else if (option == "--baud" && arg + 1 < argc)
+		{
+			baud = std::strtoul(argv[++arg], nullptr, 0);
+			baudGiven = true;
+		}
+		else if (option == "--bauds" && arg + 1 < argc)
+			bauds = parseList(argv[++arg]);
+		else if (option == "--sizes" && arg + 1 < argc)
+			sizes = parseList(argv[++arg]);
+		else if (option == "--pings" && arg + 1 < argc)
+			pings = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--seconds" && arg + 1 < argc)
+			seconds = std::strtod(argv[++arg], nullptr);
+		else
+		{
+			printUsage();
+			return 2;
+		}
+	}
+	if (arg + (sim ? 0 : 1) != argc || (sim && baudGiven) || sizes.empty() || *std::max_element(sizes.begin(), sizes.end()) > MAX_PACKET_DATA)
+	{
+		printUsage();
+		return 2;
+	}
+
+	int master = -1;
+	std::string device = sim ? "" : argv[arg];
+	if (sim)
+	{
+		master = posix_openpt(O_RDWR | O_NOCTTY);
+		if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+		{
+			std::perror("linkbench: can't open a pty");
+			return 1;
+		}
+		device = ptsname(master);
+		hostUartReset();
+		hostLinkBenchInit();
+		baud = hostUartBaud(SIM_PORT);
+	}
+
+	std::atomic<bool> stop{false};
+	std::thread robot;
+	int status = 1;
+	try
+	{
+		const int fd = openSerialPort(device, baud);
+		PacketLink link(fd);
+		if (sim)
+		{
+			simPcBaud = baud;
+			link.setBaudSetter(baud, [fd, master](unsigned newBaud) { setSimPcBaud(fd, master, newBaud); });
+			robot = std::thread(runRobot, master, std::cref(stop));
+		}
+		else
+		{
+			link.setBaudSetter(baud, [fd](unsigned newBaud) { setSerialBaud(fd, newBaud); });
+		}
+		if (cobs && !link.requestFraming(Framing::Cobs, REPLY_TIMEOUT_MS))
+			throw std::runtime_error("robot didn't switch to COBS framing");
+
+		runBaud(link, sizes, pings, seconds);
+		bool ok = true;
+		for (unsigned newBaud : bauds)
+		{
+			if (newBaud == link.baud())
+				continue;
+			if (!link.requestBaud(newBaud, REPLY_TIMEOUT_MS))
+			{
+				std::fprintf(stderr, "couldn't switch to %u baud\n", newBaud);
+				ok = false;
+				continue;
+			}
+			runBaud(link, sizes, pings, seconds);
+		}
+		if (link.baud() != baud && !link.requestBaud(baud, REPLY_TIMEOUT_MS))
+			std::fprintf(stderr, "couldn't switch back to %u baud\n", baud);
+
+		close(fd);
+		status = ok ? 0 : 1;
+	}
+	catch (const std::exception &e)
+	{
+		std::fprintf(stderr, "linkbench: %s\n", e.what());
+	}
+	stop = true;
+	if (robot.joinable())
+		robot.join();
+	if (master >= 0)
+		close(master);
+	return status;
+}
@@ -0,0 +1,211 @@
+/*! @file
+    Tests the reliable channel end to end with packets being lost: the PC's PacketLink on one side of a pty, and the
+    Launcher's packetprotocol.c (built for the PC, see firmware/hostfirmware.h) on the other, in a thread that moves
+    bytes between the pty and its UART.
+
+    usage: linklosstest [--packets n] [--loss p] [--seed n]
+
+    Once the PC has turned the reliable channel on, it drops each packet it sends or receives with probability --loss
+    (see PacketLink::setLoss()), so both ends have to retransmit. Each end sends --packets numbered reliable packets, and
+    each must receive the other's exactly once and in order. Run by "make test".
+ */
+
+#include "firmware/hostfirmware.h"
+#include "packetlink.h"
+#include "serialport.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace robolink;
+
+//! The packet type of the numbered packets sent each way.
+static const uint8_t TEST_PACKET = 0x42;
+//! The UART the robot's end of the link is on.
+static const int PORT = 0;
+//! How long the whole exchange may take before the test fails.
+static const int TIMEOUT_MS = 60000;
+
+static void printUsage()
+{
+	std::fprintf(stderr, "usage: linklosstest [--packets n] [--loss p] [--seed n]\n");
+}
+
+//! The data of numbered packet i: its number, then a pattern of a length that varies with it.
+static std::vector<uint8_t> numberedData(unsigned i)
+{
+	std::vector<uint8_t> data(2 + i % (hostReliableMaxData - 1u));
+	data[0] = (uint8_t)(i >> 8);
+	data[1] = (uint8_t)i;
+	for (std::size_t j = 2; j < data.size(); j++)
+		data[j] = (uint8_t)(i + j);
+	return data;
+}
+
+/*! Checks that a packet is the next numbered packet expected.
+ *  @param next The number of the packet expected, incremented if it is that one.
+ *  @return false if the packet is anything else.
+ */
+static bool checkNext(const char *end, uint8_t type, const std::vector<uint8_t> &data, unsigned &next)
+{
+	if (type == TEST_PACKET && data == numberedData(next))
+	{
+		next++;
+		return true;
+	}
+	const unsigned number = (data.size() >= 2) ? (data[0] << 8 | data[1]) : 0;
+	std::fprintf(stderr, "linklosstest: the %s got packet %u (type 0x%02X, %zu bytes) when packet %u was next\n",
+	             end, number, type, data.size(), next);
+	return false;
+}
+
+//What the robot's end has received, only touched by its thread until it is joined.
+static unsigned robotNext = 0;
+static bool robotFailed = false;
+static std::atomic<unsigned> robotReceived{0};
+
+static void robotReceive(int port, uint8_t packetType, const uint8_t *data, uint8_t dataLength)
+{
+	(void)port;
+	if (!robotFailed)
+		robotFailed = !checkNext("robot", packetType, std::vector<uint8_t>(data, data + dataLength), robotNext);
+	robotReceived = robotNext;
+}
+
+/*! Runs the robot's end of the link until stop is set: moves bytes between the pty and the UART, runs the link, and
+ *  sends the numbered packets once sending is set, as fast as the reliable window allows.
+ */
+static void runRobot(int fd, unsigned count, const std::atomic<bool> &sending, const std::atomic<bool> &stop)
+{
+	unsigned sent = 0;
+	std::vector<uint8_t> bytes(256);
+	while (!stop)
+	{
+		pollfd readable = {fd, POLLIN, 0};
+		if (poll(&readable, 1, 1) > 0)
+		{
+			const ssize_t length = read(fd, bytes.data(), bytes.size());
+			for (ssize_t fed = 0; fed < length; )
+				fed += hostUartFeed(PORT, &bytes[fed], length - fed);
+		}
+
+		hostLinkExec(PORT);
+		if (sending && sent < count)
+		{
+			const std::vector<uint8_t> data = numberedData(sent);
+			if (hostLinkSendReliable(PORT, TEST_PACKET, data.data(), (uint8_t)data.size()))
+				sent++;
+		}
+
+		std::size_t length;
+		while ((length = hostUartTake(PORT, bytes.data(), bytes.size())) > 0)
+		{
+			if (write(fd, bytes.data(), length) != (ssize_t)length)
+				std::fprintf(stderr, "linklosstest: couldn't write to the pty\n");
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned count = 200;
+	double loss = 0.1;
+	unsigned seed = 1;
+
+	for (int arg = 1; arg < argc; arg++)
+	{
+		const std::string option = argv[arg];
+		if (option == "--packets" && arg + 1 < argc)
+			count = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--loss" && arg + 1 < argc)
+			loss = std::strtod(argv[++arg], nullptr);
+		else if (option == "--seed" && arg + 1 < argc)
+			seed = std::strtoul(argv[++arg], nullptr, 0);
+		else
+		{
+			printUsage();
+			return 2;
+		}
+	}
+	if (count == 0 || count > 0x10000 || loss < 0.0 || loss >= 1.0)
+	{
+		printUsage();
+		return 2;
+	}
+
+	const int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+	{
+		std::perror("linklosstest: can't open a pty");
+		return 1;
+	}
+
+	std::atomic<bool> sending{false};
+	std::atomic<bool> stop{false};
+	std::thread robot;
+	bool passed = false;
+	try
+	{
+		const int fd = openSerialPort(ptsname(master), 38400);
+		PacketLink link(fd);
+		hostUartReset();
+		hostLinkInit(PORT, false, robotReceive);
+		robot = std::thread(runRobot, master, count, std::cref(sending), std::cref(stop));
+
+		if (!link.requestReliable(true, 1000))
+			throw std::runtime_error("the robot didn't turn the reliable channel on");
+		link.setLoss(loss, seed);
+		sending = true;
+
+		unsigned sent = 0;
+		unsigned received = 0;
+		bool failed = false;
+		Packet packet;
+		const auto start = std::chrono::steady_clock::now();
+		while (!failed && (sent < count || received < count || robotReceived < count))
+		{
+			if (std::chrono::steady_clock::now() - start > std::chrono::milliseconds(TIMEOUT_MS))
+			{
+				std::fprintf(stderr, "linklosstest: timed out with %u of %u packets received by the PC, %u by the robot\n",
+				             received, count, robotReceived.load());
+				failed = true;
+				break;
+			}
+			if (sent < count && link.sendReliable(TEST_PACKET, numberedData(sent)))
+				sent++;
+			if (link.poll(10, packet))
+				failed = !checkNext("PC", packet.type, packet.data, received);
+		}
+		stop = true;
+		robot.join();
+
+		HostLinkStats robotStats;
+		hostLinkStats(PORT, &robotStats);
+		const LinkStats &stats = link.stats();
+		std::printf("%u packets each way, %u lost on purpose, %u and %u retransmitted by the PC and the robot, "
+		            "%u and %u duplicates discarded\n", count, stats.injectedLosses, stats.retransmissions,
+		            robotStats.retransmissions, stats.duplicates, robotStats.duplicates);
+		passed = !failed && !robotFailed;
+		close(fd);
+	}
+	catch (const std::exception &e)
+	{
+		std::fprintf(stderr, "linklosstest: %s\n", e.what());
+		stop = true;
+		if (robot.joinable())
+			robot.join();
+	}
+	close(master);
+
+	std::printf("linklosstest: %s\n", passed ? "passed" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,553 @@
+#include "packetlink.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace robolink
+{
+
+static constexpr uint8_t START_BYTE1 = 0xA5;
+static constexpr uint8_t START_BYTE2 = 0x5A;
+
+//Layout of the sequenceNum byte while the reliable channel is on, the same as in packetprotocol.h.
+static constexpr uint8_t RELIABLE_SEQ_FLAG = 0x80;
+static constexpr uint8_t RELIABLE_SEQ_SHIFT = 4;
+static constexpr uint8_t RELIABLE_ACK_FLAG = 0x08;
+static constexpr uint8_t RELIABLE_SEQ_MASK = 0x07;
+
+//! Same as _crc_ccitt_update() from avr-libc, which the robot uses.
+uint16_t updateCrcCcitt(uint16_t crc, uint8_t dataByte)
+{
+	dataByte ^= (uint8_t)crc;
+	dataByte ^= (uint8_t)(dataByte << 4);
+	return (((uint16_t)dataByte << 8) | (crc >> 8)) ^ (uint8_t)(dataByte >> 4) ^ ((uint16_t)dataByte << 3);
+}
+
+//! Decodes a COBS frame without its 0x00 delimiter. @return false if the frame is malformed.
+static bool decodeCobs(const uint8_t *frame, std::size_t length, std::vector<uint8_t> &decoded)
+{
+	decoded.clear();
+	std::size_t i = 0;
+	while (i < length)
+	{
+		const uint8_t code = frame[i++];
+		if (code == 0)
+			return false;
+		for (uint8_t j = 1; j < code; j++)
+		{
+			if (i >= length)
+				return false;
+			decoded.push_back(frame[i++]);
+		}
+		//every block except the last one and full blocks ends with a zero
+		if (code != 0xFF && i < length)
+			decoded.push_back(0);
+	}
+	return true;
+}
+
+//! COBS encodes a frame and appends the 0x00 delimiter.
+static std::vector<uint8_t> encodeCobs(const std::vector<uint8_t> &frame)
+{
+	std::vector<uint8_t> encoded(1);
+	std::size_t codeIndex = 0;
+	uint8_t code = 1;
+	for (uint8_t dataByte : frame)
+	{
+		if (dataByte != 0)
+		{
+			encoded.push_back(dataByte);
+			code++;
+		}
+		if (dataByte == 0 || code == 0xFF)
+		{
+			encoded[codeIndex] = code;
+			codeIndex = encoded.size();
+			encoded.push_back(0);
+			code = 1;
+		}
+	}
+	encoded[codeIndex] = code;
+	encoded.push_back(0);
+	return encoded;
+}
+
+PacketLink::PacketLink(int fd, Framing framing) :
+	fd(fd),
+	currentFraming(framing)
+{
+}
+
+void PacketLink::setLoss(double probability, unsigned seed)
+{
+	lossProbability = probability;
+	random.seed(seed);
+}
+
+uint8_t PacketLink::send(uint8_t type, const std::vector<uint8_t> &data)
+{
+	const uint8_t sequence = reliableEnabled ? reliableAck() : downSequence++;
+	transmit(type, sequence, data);
+	return sequence;
+}
+
+bool PacketLink::sendReliable(uint8_t type, const std::vector<uint8_t> &data)
+{
+	if (!reliableEnabled)
+	{
+		send(type, data);
+		return true;
+	}
+	if (data.size() > reliableMaxData)
+		throw std::invalid_argument("reliable packet too long");
+	if (outstanding() >= reliableWindowSize)
+		return false;
+
+	//keep a copy for retransmission
+	const uint8_t sequence = nextSequence;
+	window[sequence % reliableWindowSize] = ReliablePacket{type, data};
+	nextSequence = (sequence + 1) & RELIABLE_SEQ_MASK;
+	//the retransmit timer runs for the oldest unacknowledged packet
+	if (outstanding() == 1)
+		retransmitTime = Clock::now() + retransmitTimeout;
+
+	sendReliablePacket(sequence);
+	return true;
+}
+
+bool PacketLink::poll(int timeoutMs, Packet &packet)
+{
+	const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+	while (true)
+	{
+		service();
+		if (!delivered.empty())
+		{
+			packet = std::move(delivered.front());
+			delivered.pop_front();
+			return true;
+		}
+
+		const Clock::time_point now = Clock::now();
+		Clock::time_point wakeup = deadline;
+		if (reliableEnabled && outstanding() != 0)
+			wakeup = std::min(wakeup, retransmitTime);
+		const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(wakeup - now).count();
+		receiveBytes(std::max<long long>(wait, 0));
+		if (Clock::now() >= deadline && delivered.empty())
+		{
+			service();
+			return false;
+		}
+	}
+}
+
+bool PacketLink::requestFraming(Framing framing, int timeoutMs)
+{
+	controlReceived = false;
+	send(LINK_SET_FRAMING, {(uint8_t)framing});
+	return waitForControl(LINK_FRAMING_SET, timeoutMs) && currentFraming == framing;
+}
+
+bool PacketLink::requestReliable(bool enabled, int timeoutMs)
+{
+	controlReceived = false;
+	send(LINK_SET_RELIABLE, {(uint8_t)enabled});
+	return waitForControl(LINK_RELIABLE_SET, timeoutMs) && reliableEnabled == enabled;
+}
+
+void PacketLink::setBaudSetter(unsigned bootBaud, BaudSetter setter)
+{
+	this->bootBaud = bootBaud;
+	currentBaud = bootBaud;
+	baudSetter = std::move(setter);
+}
+
+bool PacketLink::requestBaud(unsigned baud, int timeoutMs)
+{
+	if (!baudSetter)
+		throw std::logic_error("baud rate changes aren't enabled");
+
+	controlReceived = false;
+	sendBaud(LINK_SET_BAUD, baud);
+	if (!waitForControl(LINK_BAUD_SET, timeoutMs) || lastBaudReply != baud)
+		return false;
+
+	//the robot switches once its acceptance has been sent, then waits for a ping at the new rate
+	changeBaud(baud);
+	for (int i = 0; i < baudPingAttempts; i++)
+	{
+		controlReceived = false;
+		send(LINK_PING);
+		if (waitForControl(LINK_PONG, baudPingIntervalMs))
+			return true;
+	}
+	changeBaud(bootBaud);
+	return false;
+}
+
+void PacketLink::sendBaud(uint8_t type, unsigned baud)
+{
+	send(type, {(uint8_t)(baud >> 24), (uint8_t)(baud >> 16), (uint8_t)(baud >> 8), (uint8_t)baud});
+}
+
+//! Switches the file descriptor to a baud rate. Anything garbled during the switch is dropped by the parser.
+void PacketLink::changeBaud(unsigned baud)
+{
+	baudSetter(baud);
+	currentBaud = baud;
+}
+
+//! Receives until a link control packet arrives, leaving any other packets for poll().
+bool PacketLink::waitForControl(uint8_t type, int timeoutMs)
+{
+	const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+	while (!(controlReceived && lastControl == type))
+	{
+		const Clock::time_point now = Clock::now();
+		if (now >= deadline)
+			return false;
+		service();
+		receiveBytes(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+	}
+	return true;
+}
+
+//! Builds a packet with the current framing and writes it to the file descriptor.
+void PacketLink::transmit(uint8_t type, uint8_t sequence, const std::vector<uint8_t> &data)
+{
+	if (data.size() > maxPacketData)
+	{
+		linkStats.droppedPackets++;
+		return;
+	}
+
+	std::vector<uint8_t> frame = {type, sequence, (uint8_t)data.size()};
+	frame.insert(frame.end(), data.begin(), data.end());
+	uint16_t crc = 0xFFFF;
+	for (uint8_t dataByte : frame)
+		crc = updateCrcCcitt(crc, dataByte);
+	frame.push_back((uint8_t)(crc >> 8));
+	frame.push_back((uint8_t)crc);
+
+	std::vector<uint8_t> bytes;
+	if (currentFraming == Framing::Cobs)
+	{
+		bytes = encodeCobs(frame);
+	}
+	else
+	{
+		bytes = {START_BYTE1, START_BYTE2};
+		bytes.insert(bytes.end(), frame.begin(), frame.end());
+	}
+
+	if (lossProbability > 0.0 && std::bernoulli_distribution(lossProbability)(random))
+	{
+		linkStats.injectedLosses++;
+		return;
+	}
+
+	std::size_t written = 0;
+	while (written < bytes.size())
+	{
+		const ssize_t count = write(fd, bytes.data() + written, bytes.size() - written);
+		if (count < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				pollfd descriptor = {fd, POLLOUT, 0};
+				::poll(&descriptor, 1, 100);
+				continue;
+			}
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error(std::string("write failed: ") + std::strerror(errno));
+		}
+		written += count;
+	}
+	linkStats.packetsSent++;
+}
+
+//! Gets the acknowledgement bits for an outgoing packet, which acknowledge everything received so far.
+uint8_t PacketLink::reliableAck()
+{
+	ackPending = false;
+	return RELIABLE_ACK_FLAG | expectedSequence;
+}
+
+void PacketLink::sendReliablePacket(uint8_t sequence)
+{
+	const ReliablePacket &packet = window[sequence % reliableWindowSize];
+	transmit(packet.type, RELIABLE_SEQ_FLAG | (sequence << RELIABLE_SEQ_SHIFT) | reliableAck(), packet.data);
+}
+
+void PacketLink::resetReliable(bool enabled)
+{
+	reliableEnabled = enabled;
+	nextSequence = 0;
+	oldestSequence = 0;
+	expectedSequence = 0;
+	ackPending = false;
+}
+
+//! Resends unacknowledged packets when the retransmit timer expires, and sends any acknowledgement that wasn't piggybacked.
+void PacketLink::service()
+{
+	const Clock::time_point now = Clock::now();
+	if (awaitingPing && now >= pingDeadline)
+	{
+		//the robot's ping never arrived at the new rate
+		awaitingPing = false;
+		changeBaud(bootBaud);
+	}
+
+	if (!reliableEnabled)
+		return;
+
+	if (outstanding() != 0 && now >= retransmitTime)
+	{
+		//go back N: resend everything that hasn't been acknowledged, in order
+		const unsigned count = outstanding();
+		for (unsigned i = 0; i < count; i++)
+		{
+			sendReliablePacket((oldestSequence + i) & RELIABLE_SEQ_MASK);
+			linkStats.retransmissions++;
+		}
+		retransmitTime = now + retransmitTimeout;
+	}
+	if (ackPending)
+		transmit(LINK_ACK, reliableAck(), {});
+}
+
+//! Waits up to timeoutMs for bytes and parses whatever arrived.
+void PacketLink::receiveBytes(int timeoutMs)
+{
+	pollfd descriptor = {fd, POLLIN, 0};
+	const int ready = ::poll(&descriptor, 1, timeoutMs);
+	if (ready < 0 && errno != EINTR)
+		throw std::runtime_error(std::string("poll failed: ") + std::strerror(errno));
+	if (ready <= 0)
+		return;
+
+	uint8_t bytes[4096];
+	const ssize_t count = read(fd, bytes, sizeof bytes);
+	if (count < 0)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return;
+		throw std::runtime_error(std::string("read failed: ") + std::strerror(errno));
+	}
+	receiveBuffer.insert(receiveBuffer.end(), bytes, bytes + count);
+
+	//a link control packet can switch the framing part way through the buffer
+	Framing framing;
+	do
+	{
+		framing = currentFraming;
+		if (framing == Framing::Cobs)
+			parseCobs();
+		else
+			parseStartBytes();
+	} while (framing != currentFraming);
+}
+
+void PacketLink::parseStartBytes()
+{
+	std::size_t i = 0;
+	while (currentFraming == Framing::StartBytes)
+	{
+		//hunt for the start bytes
+		while (i + 1 < receiveBuffer.size() && !(receiveBuffer[i] == START_BYTE1 && receiveBuffer[i + 1] == START_BYTE2))
+			i++;
+		if (i + 5 > receiveBuffer.size())
+			break;
+
+		const uint8_t dataLength = receiveBuffer[i + 4];
+		if (dataLength > maxPacketData)
+		{
+			linkStats.invalidHeaders++;
+			i++;
+			continue;
+		}
+		if (i + 7 + dataLength > receiveBuffer.size())
+			break;
+
+		uint16_t crc = 0xFFFF;
+		for (std::size_t j = i + 2; j < i + 5 + dataLength; j++)
+			crc = updateCrcCcitt(crc, receiveBuffer[j]);
+		const uint16_t receivedCrc = (receiveBuffer[i + 5 + dataLength] << 8) | receiveBuffer[i + 6 + dataLength];
+		if (crc != receivedCrc)
+		{
+			//out of sync or corrupted, so look for a start inside what was taken to be this packet
+			linkStats.crcErrors++;
+			i++;
+			continue;
+		}
+
+		Packet packet;
+		packet.type = receiveBuffer[i + 2];
+		packet.sequence = receiveBuffer[i + 3];
+		packet.data.assign(receiveBuffer.begin() + i + 5, receiveBuffer.begin() + i + 5 + dataLength);
+		i += 7 + dataLength;
+		handlePacket(std::move(packet));
+	}
+	receiveBuffer.erase(receiveBuffer.begin(), receiveBuffer.begin() + std::min(i, receiveBuffer.size()));
+}
+
+void PacketLink::parseCobs()
+{
+	std::vector<uint8_t> decoded;
+	std::size_t start = 0;
+	while (currentFraming == Framing::Cobs)
+	{
+		const auto delimiter = std::find(receiveBuffer.begin() + start, receiveBuffer.end(), 0);
+		if (delimiter == receiveBuffer.end())
+			break;
+		const std::size_t end = delimiter - receiveBuffer.begin();
+		const std::size_t length = end - start;
+		const uint8_t *frame = receiveBuffer.data() + start;
+		start = end + 1;
+
+		//back to back delimiters are harmless
+		if (length == 0)
+			continue;
+		if (!decodeCobs(frame, length, decoded) || decoded.size() < 5 || decoded.size() != decoded[2] + 5u)
+		{
+			linkStats.framingErrors++;
+			continue;
+		}
+
+		const std::size_t dataLength = decoded[2];
+		uint16_t crc = 0xFFFF;
+		for (std::size_t j = 0; j < 3 + dataLength; j++)
+			crc = updateCrcCcitt(crc, decoded[j]);
+		if (crc != ((decoded[3 + dataLength] << 8) | decoded[4 + dataLength]))
+		{
+			linkStats.crcErrors++;
+			continue;
+		}
+
+		Packet packet;
+		packet.type = decoded[0];
+		packet.sequence = decoded[1];
+		packet.data.assign(decoded.begin() + 3, decoded.begin() + 3 + dataLength);
+		handlePacket(std::move(packet));
+	}
+	receiveBuffer.erase(receiveBuffer.begin(), receiveBuffer.begin() + std::min(start, receiveBuffer.size()));
+}
+
+//! Runs a received packet through the reliable channel and link control, and queues it for poll().
+void PacketLink::handlePacket(Packet &&packet)
+{
+	if (lossProbability > 0.0 && std::bernoulli_distribution(lossProbability)(random))
+	{
+		linkStats.injectedLosses++;
+		return;
+	}
+	linkStats.packetsReceived++;
+
+	if (reliableEnabled)
+	{
+		if (packet.sequence & RELIABLE_ACK_FLAG)
+		{
+			//the acknowledgement is cumulative, so ignore stale ones
+			const uint8_t ack = packet.sequence & RELIABLE_SEQ_MASK;
+			const unsigned acked = (ack - oldestSequence) & RELIABLE_SEQ_MASK;
+			if (acked != 0 && acked <= outstanding())
+			{
+				oldestSequence = ack;
+				retransmitTime = Clock::now() + retransmitTimeout;
+			}
+		}
+		if (packet.sequence & RELIABLE_SEQ_FLAG)
+		{
+			//acknowledge every reliable packet, even duplicates, in case the previous acknowledgement was lost
+			ackPending = true;
+			const uint8_t sequence = (packet.sequence >> RELIABLE_SEQ_SHIFT) & RELIABLE_SEQ_MASK;
+			if (sequence != expectedSequence)
+			{
+				linkStats.duplicates++;
+				return;
+			}
+			expectedSequence = (sequence + 1) & RELIABLE_SEQ_MASK;
+		}
+	}
+
+	if (packet.type < LINK_SET_FRAMING)
+	{
+		delivered.push_back(std::move(packet));
+		return;
+	}
+
+	const uint8_t setting = packet.data.empty() ? 0 : packet.data[0];
+	switch (packet.type)
+	{
+		case LINK_SET_FRAMING:
+			if (setting <= (uint8_t)Framing::Cobs)
+			{
+				send(LINK_FRAMING_SET, {setting});
+				currentFraming = (Framing)setting;
+			}
+			break;
+		case LINK_FRAMING_SET:
+			if (setting <= (uint8_t)Framing::Cobs)
+				currentFraming = (Framing)setting;
+			break;
+		case LINK_SET_RELIABLE:
+			if (setting <= 1)
+			{
+				send(LINK_RELIABLE_SET, {setting});
+				resetReliable(setting);
+			}
+			break;
+		case LINK_RELIABLE_SET:
+			if (setting <= 1)
+				resetReliable(setting);
+			break;
+		case LINK_SET_BAUD:
+		case LINK_BAUD_SET:
+		{
+			if (packet.data.size() != 4)
+				break;
+			const unsigned baud = ((unsigned)packet.data[0] << 24) | (packet.data[1] << 16) | (packet.data[2] << 8) | packet.data[3];
+			if (packet.type == LINK_BAUD_SET)
+			{
+				lastBaudReply = baud;
+				break;
+			}
+			if (!baudSetter)
+			{
+				sendBaud(LINK_BAUD_SET, 0);
+				break;
+			}
+			//accept at the old rate, switch, and wait for the robot to ping at the new rate
+			sendBaud(LINK_BAUD_SET, baud);
+			try
+			{
+				changeBaud(baud);
+			}
+			catch (const std::exception &)
+			{
+				//the robot won't get a reply to its pings, and will fall back by itself
+				changeBaud(bootBaud);
+				break;
+			}
+			awaitingPing = true;
+			pingDeadline = Clock::now() + baudConfirmTimeout;
+			break;
+		}
+		case LINK_PING:
+			send(LINK_PONG);
+			awaitingPing = false;
+			break;
+		default:
+			break;
+	}
+	lastControl = packet.type;
+	controlReceived = true;
+}
+
+} // namespace robolink
@@ -0,0 +1,181 @@
+/*! @file
+    PC side of the packet protocol implemented by Launcher/packetprotocol.c.
+    Handles both framings, the link control packets, and the optional go-back-N reliable channel.
+ */
+
+#ifndef PACKETLINK_H
+#define PACKETLINK_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace robolink
+{
+
+//! Same values as PacketFraming in packetprotocol.h.
+enum class Framing : uint8_t
+{
+	StartBytes = 0,
+	Cobs = 1
+};
+
+//! A received packet.
+struct Packet
+{
+	uint8_t type;
+	uint8_t sequence;
+	std::vector<uint8_t> data;
+};
+
+//! The PC end's version of some of the counters in PacketLinkStats (packetprotocol.h), plus the packets dropped on purpose by setLoss().
+struct LinkStats
+{
+	unsigned packetsReceived = 0;
+	unsigned packetsSent = 0;
+	unsigned crcErrors = 0;
+	unsigned framingErrors = 0;
+	unsigned invalidHeaders = 0;
+	unsigned droppedPackets = 0;
+	unsigned retransmissions = 0;
+	unsigned duplicates = 0;
+	unsigned injectedLosses = 0;
+};
+
+/*! One end of a packet link over a file descriptor, such as a serial port or a pty.
+ *  Nothing happens in the background: packets are only received, acknowledged and retransmitted inside poll().
+ */
+class PacketLink
+{
+public:
+	static constexpr std::size_t maxPacketData = 200;
+	static constexpr unsigned reliableWindowSize = 4;
+	static constexpr std::size_t reliableMaxData = 32;
+	static constexpr std::chrono::milliseconds retransmitTimeout{100};
+	//Baud rate change timing, the same as in packetprotocol.h.
+	static constexpr int baudPingIntervalMs = 50;
+	static constexpr int baudPingAttempts = 5;
+	static constexpr std::chrono::milliseconds baudConfirmTimeout{2 * baudPingIntervalMs * baudPingAttempts};
+
+	//! Link control packet types, the same as LinkControlPacketType in packetprotocol.h.
+	enum : uint8_t
+	{
+		LINK_SET_FRAMING = 0xF0,
+		LINK_FRAMING_SET,
+		LINK_SET_RELIABLE,
+		LINK_RELIABLE_SET,
+		LINK_ACK,
+		LINK_SET_BAUD,
+		LINK_BAUD_SET,
+		LINK_PING,
+		LINK_PONG
+	};
+
+	//! Changes the baud rate of the file descriptor, after the bytes written so far have been sent. Throws on failure.
+	using BaudSetter = std::function<void(unsigned baud)>;
+
+	explicit PacketLink(int fd, Framing framing = Framing::StartBytes);
+
+	/*! Sends a packet immediately. While the reliable channel is on, it still carries an acknowledgement.
+	 *  @return The packet's sequenceNum byte, which the Remote System echoes in its replies.
+	 */
+	uint8_t send(uint8_t type, const std::vector<uint8_t> &data = {});
+	/*! Sends a packet on the reliable channel, or with send() if the reliable channel is off.
+	 *  @return false if reliableWindowSize packets are already waiting to be acknowledged.
+	 */
+	bool sendReliable(uint8_t type, const std::vector<uint8_t> &data = {});
+	//! Checks if every reliable packet has been acknowledged.
+	bool reliableIdle() const { return outstanding() == 0; }
+
+	/*! Waits up to timeoutMs for a packet, while servicing the reliable channel.
+	 *  Link control packets are handled here and not returned.
+	 *  @return true if a packet was received.
+	 */
+	bool poll(int timeoutMs, Packet &packet);
+
+	//! Asks the robot to switch framing, and waits for it to confirm. @return true if it confirmed.
+	bool requestFraming(Framing framing, int timeoutMs);
+	//! Asks the robot to turn the reliable channel on or off, and waits for it to confirm. @return true if it confirmed.
+	bool requestReliable(bool enabled, int timeoutMs);
+
+	/*! Allows baud rate changes, which are accepted automatically when the robot proposes them.
+	 *  @param bootBaud The rate the link is at now, which both ends fall back to if a change isn't confirmed.
+	 */
+	void setBaudSetter(unsigned bootBaud, BaudSetter setter);
+	/*! Asks the robot to change the baud rate, switches, and confirms the new rate with pings.
+	 *  @return true if the new rate works, or false if the robot refused it or both ends fell back to the boot rate.
+	 */
+	bool requestBaud(unsigned baud, int timeoutMs);
+	unsigned baud() const { return currentBaud; }
+
+	/*! Drops each outgoing and each received packet with a probability, to exercise the reliable channel
+	 *  on a perfect link such as a pty.
+	 */
+	void setLoss(double probability, unsigned seed);
+
+	//! For waiting until bytes arrive without holding up other users of the link.
+	int fileDescriptor() const { return fd; }
+	Framing framing() const { return currentFraming; }
+	bool reliable() const { return reliableEnabled; }
+	const LinkStats &stats() const { return linkStats; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct ReliablePacket
+	{
+		uint8_t type;
+		std::vector<uint8_t> data;
+	};
+
+	void transmit(uint8_t type, uint8_t sequence, const std::vector<uint8_t> &data);
+	void sendReliablePacket(uint8_t sequence);
+	uint8_t reliableAck();
+	unsigned outstanding() const { return (nextSequence - oldestSequence) & 0x07; }
+	void resetReliable(bool enabled);
+	void service();
+	void receiveBytes(int timeoutMs);
+	void parseStartBytes();
+	void parseCobs();
+	void handlePacket(Packet &&packet);
+	bool waitForControl(uint8_t type, int timeoutMs);
+	void sendBaud(uint8_t type, unsigned baud);
+	void changeBaud(unsigned baud);
+
+	int fd;
+	Framing currentFraming;
+	LinkStats linkStats;
+
+	std::vector<uint8_t> receiveBuffer;
+	std::deque<Packet> delivered;
+	uint8_t downSequence = 0;
+
+	bool reliableEnabled = false;
+	uint8_t nextSequence = 0;
+	uint8_t oldestSequence = 0;
+	uint8_t expectedSequence = 0;
+	bool ackPending = false;
+	Clock::time_point retransmitTime;
+	ReliablePacket window[reliableWindowSize];
+
+	BaudSetter baudSetter;
+	unsigned bootBaud = 0;
+	unsigned currentBaud = 0;
+	unsigned lastBaudReply = 0;
+	bool awaitingPing = false;
+	Clock::time_point pingDeadline;
+
+	double lossProbability = 0.0;
+	std::mt19937 random;
+	uint8_t lastControl = 0;
+	bool controlReceived = false;
+};
+
+uint16_t updateCrcCcitt(uint16_t crc, uint8_t dataByte);
+
+} // namespace robolink
+
+#endif
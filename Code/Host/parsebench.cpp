@@ -0,0 +1,217 @@
+/*! @file
+    Measures the Launcher's packet parser (Launcher/packetprotocol.c, built for the PC) with two links running at once,
+    one on each UART, as the PC link and the RoboClaw link do on the robot.
+
+    usage: parsebench [--cobs] [--packets n] [--max-size n] [--chunk n] [--rounds n] [--seed n]
+
+    Two streams of --packets packets each, with random types and payloads of up to --max-size bytes, are framed by the
+    robot's own sender. They are then fed to the two links in alternating chunks of 1 to --chunk bytes, the way bytes
+    trickle in from two UARTs between main loop passes, with packetLinkExec() run on each link after each chunk.
+    Each link must hand its executor exactly its own stream, in order; any other packet, and any parser error, fails.
+    For comparison, each stream is first parsed on its own.
+
+    Prints the parse rate in MB/s and the time per packet, the best of --rounds.
+ */
+
+#include "firmware/hostfirmware.h"
+#include "protocol.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using robolink::MAX_PACKET_DATA;
+
+//! The packetLinkExec() passes that may go by without a packet after the whole stream is fed, before giving up.
+static const unsigned MAX_IDLE_PASSES = 8;
+
+static void printUsage()
+{
+	std::fprintf(stderr, "usage: parsebench [--cobs] [--packets n] [--max-size n] [--chunk n] [--rounds n] [--seed n]\n");
+}
+
+//! A packet as the executor should see it.
+struct ExpectedPacket
+{
+	uint8_t type;
+	std::vector<uint8_t> data;
+};
+
+//! One link's stream, and what its executor has been given so far.
+struct Stream
+{
+	std::vector<ExpectedPacket> packets;
+	std::vector<uint8_t> bytes;
+	std::size_t fed = 0;
+	std::size_t received = 0;
+	unsigned mismatches = 0;
+};
+
+static Stream streams[HOST_UART_PORTS];
+
+//! The executor of both links: checks each packet against the next one of the link's stream.
+static void receivePacket(int port, uint8_t packetType, const uint8_t *data, uint8_t dataLength)
+{
+	Stream &stream = streams[port];
+	if (stream.received >= stream.packets.size())
+	{
+		stream.mismatches++;
+		return;
+	}
+	const ExpectedPacket &expected = stream.packets[stream.received++];
+	if (packetType != expected.type || dataLength != expected.data.size() || !std::equal(data, data + dataLength, expected.data.begin()))
+		stream.mismatches++;
+}
+
+//! Makes random packets, and frames them with the robot's sender on a port.
+static void generateStream(Stream &stream, int port, bool cobs, unsigned count, unsigned maxSize, std::mt19937 &random)
+{
+	hostUartReset();
+	hostLinkInit(port, cobs, nullptr);
+	//packet types are kept below the link control packets
+	std::uniform_int_distribution<unsigned> types(0, hostLinkControlFirst - 1);
+	std::uniform_int_distribution<unsigned> sizes(0, maxSize);
+	std::uniform_int_distribution<unsigned> bytes(0, 0xFF);
+	std::vector<uint8_t> frame(MAX_PACKET_DATA + hostPacketOverhead);
+	for (unsigned i = 0; i < count; i++)
+	{
+		ExpectedPacket packet{(uint8_t)types(random), std::vector<uint8_t>(sizes(random))};
+		for (uint8_t &byte : packet.data)
+			byte = (uint8_t)bytes(random);
+		const std::size_t length = hostLinkEncode(port, packet.type, packet.data.data(), (uint8_t)packet.data.size(), frame.data(), frame.size());
+		stream.bytes.insert(stream.bytes.end(), frame.begin(), frame.begin() + length);
+		stream.packets.push_back(std::move(packet));
+	}
+}
+
+/*! Feeds the streams of some ports to their links, a random sized chunk at a time and alternating between them.
+ *  @return The time taken in seconds, or a negative number if a link didn't get its stream back exactly.
+ */
+static double parseStreams(const std::vector<int> &ports, bool cobs, unsigned maxChunk, std::mt19937 &random)
+{
+	hostUartReset();
+	for (int port : ports)
+	{
+		hostLinkInit(port, cobs, receivePacket);
+		streams[port].fed = 0;
+		streams[port].received = 0;
+		streams[port].mismatches = 0;
+	}
+	//the chunk sizes are drawn up front, so drawing them isn't timed
+	std::uniform_int_distribution<unsigned> sizes(1, maxChunk);
+	std::vector<std::size_t> chunks(4096);
+	for (std::size_t &chunk : chunks)
+		chunk = sizes(random);
+
+	const auto start = std::chrono::steady_clock::now();
+	std::size_t next = 0;
+	//passes since everything was fed that dispatched nothing, to stop if a packet never comes
+	unsigned idlePasses = 0;
+	bool running = true;
+	while (running && idlePasses < MAX_IDLE_PASSES)
+	{
+		running = false;
+		bool fedAll = true;
+		bool dispatched = false;
+		for (int port : ports)
+		{
+			Stream &stream = streams[port];
+			const std::size_t chunk = std::min(chunks[next++ % chunks.size()], stream.bytes.size() - stream.fed);
+			stream.fed += hostUartFeed(port, &stream.bytes[stream.fed], chunk);
+			const std::size_t received = stream.received;
+			hostLinkExec(port);
+			dispatched |= (stream.received != received);
+			fedAll &= (stream.fed == stream.bytes.size());
+			running |= (stream.fed < stream.bytes.size()) || (stream.received < stream.packets.size());
+		}
+		idlePasses = (fedAll && !dispatched) ? idlePasses + 1 : 0;
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	for (int port : ports)
+	{
+		HostLinkStats stats;
+		hostLinkStats(port, &stats);
+		if (streams[port].received < streams[port].packets.size())
+			streams[port].mismatches += streams[port].packets.size() - streams[port].received;
+		if (streams[port].mismatches > 0 || stats.crcErrors > 0 || stats.framingErrors > 0 || stats.invalidHeaders > 0)
+		{
+			std::fprintf(stderr, "parsebench: link %d got %u wrong or missing packets, %u CRC errors, %u framing errors, %u invalid headers\n",
+			             port, streams[port].mismatches, stats.crcErrors, stats.framingErrors, stats.invalidHeaders);
+			return -1.0;
+		}
+	}
+	return seconds;
+}
+
+int main(int argc, char *argv[])
+{
+	bool cobs = false;
+	unsigned count = 20000;
+	unsigned maxSize = 64;
+	unsigned maxChunk = 32;
+	unsigned rounds = 5;
+	unsigned seed = 1;
+
+	for (int arg = 1; arg < argc; arg++)
+	{
+		const std::string option = argv[arg];
+		if (option == "--cobs")
+			cobs = true;
+		else if (option == "--packets" && arg + 1 < argc)
+			count = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--max-size" && arg + 1 < argc)
+			maxSize = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--chunk" && arg + 1 < argc)
+			maxChunk = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--rounds" && arg + 1 < argc)
+			rounds = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--seed" && arg + 1 < argc)
+			seed = std::strtoul(argv[++arg], nullptr, 0);
+		else
+		{
+			printUsage();
+			return 2;
+		}
+	}
+	if (count == 0 || maxSize > MAX_PACKET_DATA || maxChunk == 0 || rounds == 0)
+	{
+		printUsage();
+		return 2;
+	}
+
+	std::mt19937 random(seed);
+	for (int port = 0; port < HOST_UART_PORTS; port++)
+		generateStream(streams[port], port, cobs, count, maxSize, random);
+
+	std::printf("%s framing, %u packets of 0-%u bytes per stream, chunks of 1-%u bytes\n",
+	            cobs ? "COBS" : "A5/5A", count, maxSize, maxChunk);
+	std::printf("%-14s %10s %10s %12s\n", "", "bytes", "MB/s", "ns/packet");
+	const std::vector<std::vector<int>> runs = {{0}, {1}, {0, 1}};
+	const char *const names[] = {"link 0 alone", "link 1 alone", "interleaved"};
+	for (std::size_t run = 0; run < runs.size(); run++)
+	{
+		double best = 0.0;
+		for (unsigned round = 0; round < rounds; round++)
+		{
+			const double seconds = parseStreams(runs[run], cobs, maxChunk, random);
+			if (seconds < 0.0)
+				return 1;
+			if (round == 0 || seconds < best)
+				best = seconds;
+		}
+		std::size_t bytes = 0;
+		std::size_t packets = 0;
+		for (int port : runs[run])
+		{
+			bytes += streams[port].bytes.size();
+			packets += streams[port].packets.size();
+		}
+		std::printf("%-14s %10zu %10.2f %12.1f\n", names[run], bytes, bytes / best / 1e6, best * 1e9 / packets);
+	}
+	return 0;
+}
@@ -0,0 +1,1843 @@
+/*! @file
+    Generated by Protocol/packetgen.py from Protocol/packets.schema. Do not edit; edit the schema instead.
+
+    The packet types of the robot's PC link, and a struct for each packet with fields that encodes and
+    decodes its data section. All multi-byte fields are MSB first.
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace robolink
+{
+
+constexpr std::size_t MAX_PACKET_DATA = 200;
+constexpr unsigned LAUNCHER_UPLINK_FIRST = 0x40;
+//! The layout of STATS_DATA, sent as its first byte. Increase it whenever the fields change.
+constexpr unsigned STATS_VERSION = 0x02;
+constexpr unsigned BOOT_UPLINK_FIRST = 0x60;
+//! The version of the bootloader's packets, sent in BOOT_INFO. Increase it whenever they change.
+constexpr unsigned BOOT_VERSION = 0x01;
+//! The size of a flash page of the ATmega1281 in bytes, the unit the bootloader erases and writes.
+constexpr unsigned BOOT_PAGE_SIZE = 0x100;
+
+enum RemoteCommand : uint8_t
+{
+	//parameterless commands
+	CMD_GET_VERSION = 0,
+	CMD_LED_ON,
+	CMD_LED_OFF,
+	CMD_RELAY_ON,
+	CMD_RELAY_OFF,
+	CMD_LCD_ON,
+	CMD_LCD_OFF,
+	CMD_CLEAR_SCREEN,
+	CMD_LOWER_LINE,
+	CMD_GET_BUTTON1,
+	CMD_KNOB,
+	CMD_KNOB10,
+	CMD_SOFT_RESET,
+	CMD_STOP_SOUND,
+	//! Ends the remote session: stops the running script and the sensor stream.
+	CMD_EXIT_REMOTE,
+
+	//single-parameter commands
+	//! Blocks the whole main loop, stalling any running mode. Scripts use SCRIPT_WAIT_MS instead.
+	CMD_DELAY_MS,
+	CMD_DELAY_US,
+	CMD_PRINT_STRING,
+	CMD_DIGITAL_INPUT,
+	CMD_ANALOG,
+	CMD_ANALOG10,
+	CMD_SERVO_OFF,
+	CMD_GET_SERVO_RANGE,
+	CMD_PLAY_SOUND,
+
+	//two-parameter commands
+	CMD_SET_SERVO_RANGE_BY_INDEX,
+	CMD_SET_SERVO_RANGE,
+	CMD_SERVO,
+	CMD_SERVO2,
+	CMD_MOTOR,
+	CMD_LCD_CURSOR,
+
+	//variable-length commands
+	/*! A sequence of sub-commands, each encoded as: command, dataLength, data. They are all checked first,
+	 *  then executed back to back in one dispatch, and answered with a single RESP_BATCH.
+	 */
+	CMD_BATCH,
+
+	//script commands, see remoteScript.h
+	//! Stores script bytes at the offset. Answered with a RESP_VALUE of 1 if they were stored.
+	CMD_SCRIPT_LOAD,
+	//! Runs the loaded script. Answered with a RESP_SCRIPT_DONE when the script finishes.
+	CMD_SCRIPT_RUN,
+	CMD_SCRIPT_STOP,
+	//! Saves the loaded script in EEPROM.
+	CMD_SCRIPT_SAVE,
+	//! Loads the script saved in EEPROM.
+	CMD_SCRIPT_RESTORE,
+
+	//sensor stream
+	/*! Streams samples of the inputs in RESP_SAMPLES packets until another CMD_SUBSCRIBE replaces it.
+	 *  A period of 0 stops the stream. See sensorStream.c.
+	 */
+	CMD_SUBSCRIBE,
+	NUM_CMD
+};
+
+//! Remote System replies. Each one starts with the sequenceNum of the command packet it answers.
+enum RemoteResponse : uint8_t
+{
+	RESP_BOOTED_UP = 0x30,
+	//! The version string (not null terminated).
+	RESP_VERSION,
+	//! The value returned by the command (1 or 2 bytes).
+	RESP_VALUE,
+	/*! The number of sub-commands executed (0 if the batch was rejected),
+	 *  then the command and value of each sub-command that returns one, in order.
+	 */
+	RESP_BATCH,
+	//! The ScriptStatus, and the address the script finished at.
+	RESP_SCRIPT_DONE,
+	//! See sensorStream.c.
+	RESP_SAMPLES,
+	LAST_Response
+};
+
+enum UplinkPacketType : uint8_t
+{
+	GET_VERSIONS = LAUNCHER_UPLINK_FIRST,
+	PAUSE,
+	RESUME,
+	ABORT_TO_MENU,
+	GET_STATS,
+	//! The sample period in ms, or 0 to stop.
+	SET_TELEMETRY,
+	//! Answered with a TUNABLE_INFO. See tunables.h.
+	GET_TUNABLE_INFO,
+	//! Answered with a TUNABLE_VALUE.
+	GET_TUNABLE,
+	//! Stages a new value, applied at the next control period. Answered with a TUNABLE_VALUE.
+	SET_TUNABLE,
+
+	//link benchmark, see linkBench.c
+	//! Answered straight away with a PING_REPLY of the same payload. (Plain PING is the port G input register in avr/io.h.)
+	PING_REQUEST,
+	//! Counted in the LINK_REPORT, then discarded.
+	BULK_SINK,
+	/*! Sends count BULK_DATA packets of patternLength pattern bytes each, as fast as the link allows.
+	 *  Replaces any transfer in progress, so a count of 0 stops it.
+	 */
+	BULK_SOURCE,
+	//! Answered with a LINK_REPORT.
+	GET_LINK_REPORT,
+
+	//clock synchronization, see Host/clocksync.h
+	/*! Answered straight away with a TIME_SYNC_REPLY. The originate time is the PC's, and is only echoed back.
+	 *  The padding makes it as long as the reply, so both directions take equally long to send.
+	 */
+	TIME_SYNC,
+	//! Whether log packets end with the time they were logged at, see DEBUG_LOG. Off after reset.
+	SET_LOG_TIMESTAMPS,
+
+	//reflashing
+	/*! Resets into the bootloader, which stays until it gets a BOOT_START_APP instead of starting the Launcher again.
+	 *  Not answered: the PC talks to the bootloader from then on, at UART0_BAUD.
+	 */
+	ENTER_BOOTLOADER,
+
+	//tracing, see traceStream.c
+	/*! Starts the TraceMode (see traceStream.h) with an empty trace ring, or stops it. Bit n of the mask traces the
+	 *  TraceId or LauncherTraceId n; TRACE_TICK is always traced. Not answered.
+	 */
+	SET_TRACE,
+	//! Stops tracing, and sends what the trace ring holds as TRACE_DATA.
+	DUMP_TRACE,
+	LAST_UplinkPacketType
+};
+
+enum DownlinkPacketType : uint8_t
+{
+	BOOTED_UP = 128,
+	//! The null terminated version string.
+	VERSION_DATA,
+	/*! The STATS_VERSION, then:
+	 *  - the bytes lost because the UART0 receive buffer was full, and each drive motor's fault count and the time of its
+	 *  last fault (in ms).
+	 *  - the PacketLinkStats of the PC link (see packetprotocol.h), with the drops and the queue high-water marks of
+	 *  each PacketPriority in order.
+	 *  - then for each uplink packet type received since reset, lowest first and as many as fit: the type and a u16 count.
+	 *  All counters wrap around. Version 1 (before the version byte) was only the first 24 bytes after it.
+	 */
+	STATS_DATA,
+	//! See telemetry.c.
+	TELEMETRY_DATA,
+	/*! Null terminated. While SET_LOG_TIMESTAMPS is on, every log packet (this one, WARNING_LOG, CRITICAL_LOG and
+	 *  SW_FAULT) ends with 4 more bytes after the text: the u32 getUptimeUs() time it was logged at.
+	 */
+	DEBUG_LOG,
+	//! Null terminated, see DEBUG_LOG.
+	WARNING_LOG,
+	//! Null terminated, see DEBUG_LOG.
+	CRITICAL_LOG,
+	//! The null terminated file name, then the null terminated message, see DEBUG_LOG.
+	SW_FAULT,
+	//! The number of tunables, then the description from tunableDescribe(), or nothing else if there is no tunable with that id.
+	TUNABLE_INFO,
+	//! The TunableStatus, then the latest value (0 if the id is unknown).
+	TUNABLE_VALUE,
+	//! The payload of the PING_REQUEST it answers.
+	PING_REPLY,
+	//! The number of the packet within the BULK_SOURCE transfer, then pattern bytes: byte i is (index + i) & 0xFF.
+	BULK_DATA,
+	/*! The robot's uptime in ms, the BULK_SINK packets and bytes received, the BULK_DATA packets still to send,
+	 *  then the receive counters of the PC link: packets received, CRC errors, COBS framing errors, rejected headers,
+	 *  and the bytes lost because the UART0 receive buffer was full. All of them count up from reset and wrap around.
+	 */
+	LINK_REPORT,
+	/*! The originate time of the TIME_SYNC it answers, then the robot's getUptimeUs() time when that was received, and
+	 *  when this was sent. The two robot times wrap around every 71.6 minutes.
+	 */
+	TIME_SYNC_REPLY,
+	/*! The getUptimeUs() time and the trace clock when tracing started, the events lost before these, the flags
+	 *  (TRACE_DATA_END on the last packet of a dump), then 4 bytes for each event. See traceStream.c.
+	 */
+	TRACE_DATA,
+	LAST_DownlinkPacketType
+};
+
+/*! The packets of the bootloader (see Bootloader/bootloader.c), which knows nothing else except the link control packets.
+ *  Flash is written a page at a time: a page is assembled from its current contents and BOOT_PAGE_DATA changes,
+ *  then written with BOOT_PAGE_WRITE, so the PC only sends the bytes that differ from the running image.
+ */
+enum BootCommand : uint8_t
+{
+	//! Answered with a BOOT_INFO.
+	BOOT_GET_INFO = BOOT_UPLINK_FIRST,
+	/*! Answered with a BOOT_PAGE_CRCS for count pages from firstPage, or for as many of them as fit in the packet
+	 *  and are in the application section.
+	 */
+	BOOT_GET_PAGE_CRCS,
+	/*! Copies data into the page being assembled, from offset onwards. A BOOT_PAGE_DATA for a different page first
+	 *  starts that one from its current contents in flash. Not answered.
+	 */
+	BOOT_PAGE_DATA,
+	/*! Writes the page being assembled, if its CRC matches, then reads it back. Answered with a BOOT_PAGE_WRITTEN.
+	 *  A page whose CRC doesn't match is thrown away, so the next BOOT_PAGE_DATA starts it again from flash.
+	 */
+	BOOT_PAGE_WRITE,
+	//! Leaves the bootloader and starts the Launcher. Not answered.
+	BOOT_START_APP,
+	LAST_BootCommand
+};
+
+//! The bootloader's replies.
+enum BootReply : uint8_t
+{
+	/*! The BOOT_VERSION, the BOOT_PAGE_SIZE, and the number of pages in the application section,
+	 *  then 1 if the Launcher sent the robot here with ENTER_BOOTLOADER, or 0 if it came from a reset.
+	 */
+	BOOT_INFO = 0xD0,
+	//! The CRC of each page from firstPage on, as a u16. Worked out like a packet's CRC: CCITT, starting from 0xFFFF.
+	BOOT_PAGE_CRCS,
+	//! The BootStatus, see Bootloader/bootloader.h.
+	BOOT_PAGE_WRITTEN,
+	LAST_BootReply
+};
+
+namespace detail
+{
+
+template <typename T>
+T readField(const std::vector<uint8_t> &data, std::size_t offset)
+{
+	uint32_t value = 0;
+	for (std::size_t i = 0; i < sizeof(T); i++)
+		value = (value << 8) | data[offset + i];
+	return (T)value;
+}
+
+template <typename T>
+void writeField(std::vector<uint8_t> &data, T value)
+{
+	for (std::size_t i = sizeof(T); i-- > 0;)
+		data.push_back((uint8_t)((uint32_t)value >> (8 * i)));
+}
+
+inline void checkLength(const char *packet, std::size_t length, std::size_t min, std::size_t max)
+{
+	if (length < min || length > max)
+		throw std::runtime_error(std::string("bad ") + packet + " data length " + std::to_string(length));
+}
+
+} // namespace detail
+
+//! The data section of a CMD_DELAY_MS packet.
+struct CmdDelayMs
+{
+	static constexpr uint8_t type = CMD_DELAY_MS;
+
+	uint16_t ms;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->ms);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdDelayMs decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_DELAY_MS", data.size(), 2, 2);
+		CmdDelayMs packet;
+		packet.ms = detail::readField<uint16_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_DELAY_US packet.
+struct CmdDelayUs
+{
+	static constexpr uint8_t type = CMD_DELAY_US;
+
+	uint16_t us;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->us);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdDelayUs decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_DELAY_US", data.size(), 2, 2);
+		CmdDelayUs packet;
+		packet.us = detail::readField<uint16_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_PRINT_STRING packet.
+struct CmdPrintString
+{
+	static constexpr uint8_t type = CMD_PRINT_STRING;
+
+	std::string text; //!< 1 to 200 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		data.insert(data.end(), this->text.begin(), this->text.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length. Trailing null characters are removed from text.
+	static CmdPrintString decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_PRINT_STRING", data.size(), 1, 200);
+		CmdPrintString packet;
+		packet.text.assign(data.begin() + 0, data.end());
+		while (!packet.text.empty() && packet.text.back() == '\0')
+			packet.text.pop_back();
+		return packet;
+	}
+};
+
+//! The data section of a CMD_DIGITAL_INPUT packet.
+struct CmdDigitalInput
+{
+	static constexpr uint8_t type = CMD_DIGITAL_INPUT;
+
+	uint8_t pin;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->pin);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdDigitalInput decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_DIGITAL_INPUT", data.size(), 1, 1);
+		CmdDigitalInput packet;
+		packet.pin = detail::readField<uint8_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_ANALOG packet.
+struct CmdAnalog
+{
+	static constexpr uint8_t type = CMD_ANALOG;
+
+	uint8_t channel;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->channel);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdAnalog decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_ANALOG", data.size(), 1, 1);
+		CmdAnalog packet;
+		packet.channel = detail::readField<uint8_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_ANALOG10 packet.
+struct CmdAnalog10
+{
+	static constexpr uint8_t type = CMD_ANALOG10;
+
+	uint8_t channel;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->channel);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdAnalog10 decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_ANALOG10", data.size(), 1, 1);
+		CmdAnalog10 packet;
+		packet.channel = detail::readField<uint8_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_SERVO_OFF packet.
+struct CmdServoOff
+{
+	static constexpr uint8_t type = CMD_SERVO_OFF;
+
+	uint8_t servo;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->servo);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdServoOff decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_SERVO_OFF", data.size(), 1, 1);
+		CmdServoOff packet;
+		packet.servo = detail::readField<uint8_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_GET_SERVO_RANGE packet.
+struct CmdGetServoRange
+{
+	static constexpr uint8_t type = CMD_GET_SERVO_RANGE;
+
+	uint8_t servo;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->servo);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdGetServoRange decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_GET_SERVO_RANGE", data.size(), 1, 1);
+		CmdGetServoRange packet;
+		packet.servo = detail::readField<uint8_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_PLAY_SOUND packet.
+struct CmdPlaySound
+{
+	static constexpr uint8_t type = CMD_PLAY_SOUND;
+
+	uint8_t sound;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->sound);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdPlaySound decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_PLAY_SOUND", data.size(), 1, 1);
+		CmdPlaySound packet;
+		packet.sound = detail::readField<uint8_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_SET_SERVO_RANGE_BY_INDEX packet.
+struct CmdSetServoRangeByIndex
+{
+	static constexpr uint8_t type = CMD_SET_SERVO_RANGE_BY_INDEX;
+
+	uint8_t servo;
+	uint8_t index;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->servo);
+		detail::writeField(data, this->index);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdSetServoRangeByIndex decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_SET_SERVO_RANGE_BY_INDEX", data.size(), 2, 2);
+		CmdSetServoRangeByIndex packet;
+		packet.servo = detail::readField<uint8_t>(data, 0);
+		packet.index = detail::readField<uint8_t>(data, 1);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_SET_SERVO_RANGE packet.
+struct CmdSetServoRange
+{
+	static constexpr uint8_t type = CMD_SET_SERVO_RANGE;
+
+	uint8_t servo;
+	uint8_t range;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->servo);
+		detail::writeField(data, this->range);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdSetServoRange decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_SET_SERVO_RANGE", data.size(), 2, 2);
+		CmdSetServoRange packet;
+		packet.servo = detail::readField<uint8_t>(data, 0);
+		packet.range = detail::readField<uint8_t>(data, 1);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_SERVO packet.
+struct CmdServo
+{
+	static constexpr uint8_t type = CMD_SERVO;
+
+	uint8_t servo;
+	uint8_t position;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->servo);
+		detail::writeField(data, this->position);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdServo decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_SERVO", data.size(), 2, 2);
+		CmdServo packet;
+		packet.servo = detail::readField<uint8_t>(data, 0);
+		packet.position = detail::readField<uint8_t>(data, 1);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_SERVO2 packet.
+struct CmdServo2
+{
+	static constexpr uint8_t type = CMD_SERVO2;
+
+	uint8_t servo;
+	int8_t position;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->servo);
+		detail::writeField(data, this->position);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdServo2 decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_SERVO2", data.size(), 2, 2);
+		CmdServo2 packet;
+		packet.servo = detail::readField<uint8_t>(data, 0);
+		packet.position = detail::readField<int8_t>(data, 1);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_MOTOR packet.
+struct CmdMotor
+{
+	static constexpr uint8_t type = CMD_MOTOR;
+
+	uint8_t motor;
+	uint8_t speed;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->motor);
+		detail::writeField(data, this->speed);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdMotor decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_MOTOR", data.size(), 2, 2);
+		CmdMotor packet;
+		packet.motor = detail::readField<uint8_t>(data, 0);
+		packet.speed = detail::readField<uint8_t>(data, 1);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_LCD_CURSOR packet.
+struct CmdLcdCursor
+{
+	static constexpr uint8_t type = CMD_LCD_CURSOR;
+
+	uint8_t row;
+	uint8_t column;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->row);
+		detail::writeField(data, this->column);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdLcdCursor decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_LCD_CURSOR", data.size(), 2, 2);
+		CmdLcdCursor packet;
+		packet.row = detail::readField<uint8_t>(data, 0);
+		packet.column = detail::readField<uint8_t>(data, 1);
+		return packet;
+	}
+};
+
+//! The data section of a CMD_BATCH packet.
+struct CmdBatch
+{
+	static constexpr uint8_t type = CMD_BATCH;
+
+	std::vector<uint8_t> commands; //!< 2 to 200 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		data.insert(data.end(), this->commands.begin(), this->commands.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdBatch decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_BATCH", data.size(), 2, 200);
+		CmdBatch packet;
+		packet.commands.assign(data.begin() + 0, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a CMD_SCRIPT_LOAD packet.
+struct CmdScriptLoad
+{
+	static constexpr uint8_t type = CMD_SCRIPT_LOAD;
+
+	uint16_t offset;
+	std::vector<uint8_t> script; //!< 1 to 198 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->offset);
+		data.insert(data.end(), this->script.begin(), this->script.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdScriptLoad decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_SCRIPT_LOAD", data.size(), 3, 200);
+		CmdScriptLoad packet;
+		packet.offset = detail::readField<uint16_t>(data, 0);
+		packet.script.assign(data.begin() + 2, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a CMD_SUBSCRIBE packet.
+struct CmdSubscribe
+{
+	static constexpr uint8_t type = CMD_SUBSCRIBE;
+
+	uint16_t periodMs;
+	uint8_t analogMask;
+	uint16_t digitalMask;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->periodMs);
+		detail::writeField(data, this->analogMask);
+		detail::writeField(data, this->digitalMask);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static CmdSubscribe decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CMD_SUBSCRIBE", data.size(), 5, 5);
+		CmdSubscribe packet;
+		packet.periodMs = detail::readField<uint16_t>(data, 0);
+		packet.analogMask = detail::readField<uint8_t>(data, 2);
+		packet.digitalMask = detail::readField<uint16_t>(data, 3);
+		return packet;
+	}
+};
+
+//! The data section of a RESP_VERSION packet.
+struct RespVersion
+{
+	static constexpr uint8_t type = RESP_VERSION;
+
+	uint8_t request;
+	std::string version; //!< 1 to 199 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->request);
+		data.insert(data.end(), this->version.begin(), this->version.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length. Trailing null characters are removed from text.
+	static RespVersion decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("RESP_VERSION", data.size(), 2, 200);
+		RespVersion packet;
+		packet.request = detail::readField<uint8_t>(data, 0);
+		packet.version.assign(data.begin() + 1, data.end());
+		while (!packet.version.empty() && packet.version.back() == '\0')
+			packet.version.pop_back();
+		return packet;
+	}
+};
+
+//! The data section of a RESP_VALUE packet.
+struct RespValue
+{
+	static constexpr uint8_t type = RESP_VALUE;
+
+	uint8_t request;
+	uint8_t command;
+	std::vector<uint8_t> value; //!< 1 to 2 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->request);
+		detail::writeField(data, this->command);
+		data.insert(data.end(), this->value.begin(), this->value.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static RespValue decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("RESP_VALUE", data.size(), 3, 4);
+		RespValue packet;
+		packet.request = detail::readField<uint8_t>(data, 0);
+		packet.command = detail::readField<uint8_t>(data, 1);
+		packet.value.assign(data.begin() + 2, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a RESP_BATCH packet.
+struct RespBatch
+{
+	static constexpr uint8_t type = RESP_BATCH;
+
+	uint8_t request;
+	uint8_t count;
+	std::vector<uint8_t> values; //!< 0 to 198 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->request);
+		detail::writeField(data, this->count);
+		data.insert(data.end(), this->values.begin(), this->values.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static RespBatch decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("RESP_BATCH", data.size(), 2, 200);
+		RespBatch packet;
+		packet.request = detail::readField<uint8_t>(data, 0);
+		packet.count = detail::readField<uint8_t>(data, 1);
+		packet.values.assign(data.begin() + 2, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a RESP_SCRIPT_DONE packet.
+struct RespScriptDone
+{
+	static constexpr uint8_t type = RESP_SCRIPT_DONE;
+
+	uint8_t request;
+	uint8_t status;
+	uint16_t address;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->request);
+		detail::writeField(data, this->status);
+		detail::writeField(data, this->address);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static RespScriptDone decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("RESP_SCRIPT_DONE", data.size(), 4, 4);
+		RespScriptDone packet;
+		packet.request = detail::readField<uint8_t>(data, 0);
+		packet.status = detail::readField<uint8_t>(data, 1);
+		packet.address = detail::readField<uint16_t>(data, 2);
+		return packet;
+	}
+};
+
+//! The data section of a RESP_SAMPLES packet.
+struct RespSamples
+{
+	static constexpr uint8_t type = RESP_SAMPLES;
+
+	uint8_t request;
+	uint8_t frame;
+	uint8_t count;
+	std::vector<uint8_t> samples; //!< 0 to 197 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->request);
+		detail::writeField(data, this->frame);
+		detail::writeField(data, this->count);
+		data.insert(data.end(), this->samples.begin(), this->samples.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static RespSamples decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("RESP_SAMPLES", data.size(), 3, 200);
+		RespSamples packet;
+		packet.request = detail::readField<uint8_t>(data, 0);
+		packet.frame = detail::readField<uint8_t>(data, 1);
+		packet.count = detail::readField<uint8_t>(data, 2);
+		packet.samples.assign(data.begin() + 3, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a SET_TELEMETRY packet.
+struct SetTelemetry
+{
+	static constexpr uint8_t type = SET_TELEMETRY;
+
+	uint16_t periodMs;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->periodMs);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static SetTelemetry decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("SET_TELEMETRY", data.size(), 2, 2);
+		SetTelemetry packet;
+		packet.periodMs = detail::readField<uint16_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a GET_TUNABLE_INFO packet.
+struct GetTunableInfo
+{
+	static constexpr uint8_t type = GET_TUNABLE_INFO;
+
+	uint8_t id;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->id);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static GetTunableInfo decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("GET_TUNABLE_INFO", data.size(), 1, 1);
+		GetTunableInfo packet;
+		packet.id = detail::readField<uint8_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a GET_TUNABLE packet.
+struct GetTunable
+{
+	static constexpr uint8_t type = GET_TUNABLE;
+
+	uint8_t id;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->id);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static GetTunable decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("GET_TUNABLE", data.size(), 1, 1);
+		GetTunable packet;
+		packet.id = detail::readField<uint8_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a SET_TUNABLE packet.
+struct SetTunable
+{
+	static constexpr uint8_t type = SET_TUNABLE;
+
+	uint8_t id;
+	int16_t value;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->id);
+		detail::writeField(data, this->value);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static SetTunable decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("SET_TUNABLE", data.size(), 3, 3);
+		SetTunable packet;
+		packet.id = detail::readField<uint8_t>(data, 0);
+		packet.value = detail::readField<int16_t>(data, 1);
+		return packet;
+	}
+};
+
+//! The data section of a PING_REQUEST packet.
+struct PingRequest
+{
+	static constexpr uint8_t type = PING_REQUEST;
+
+	std::vector<uint8_t> payload; //!< 0 to 200 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		data.insert(data.end(), this->payload.begin(), this->payload.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static PingRequest decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("PING_REQUEST", data.size(), 0, 200);
+		PingRequest packet;
+		packet.payload.assign(data.begin() + 0, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a BULK_SINK packet.
+struct BulkSink
+{
+	static constexpr uint8_t type = BULK_SINK;
+
+	std::vector<uint8_t> payload; //!< 0 to 200 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		data.insert(data.end(), this->payload.begin(), this->payload.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static BulkSink decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("BULK_SINK", data.size(), 0, 200);
+		BulkSink packet;
+		packet.payload.assign(data.begin() + 0, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a BULK_SOURCE packet.
+struct BulkSource
+{
+	static constexpr uint8_t type = BULK_SOURCE;
+
+	uint16_t count;
+	uint8_t patternLength;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->count);
+		detail::writeField(data, this->patternLength);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static BulkSource decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("BULK_SOURCE", data.size(), 3, 3);
+		BulkSource packet;
+		packet.count = detail::readField<uint16_t>(data, 0);
+		packet.patternLength = detail::readField<uint8_t>(data, 2);
+		return packet;
+	}
+};
+
+//! The data section of a TIME_SYNC packet.
+struct TimeSync
+{
+	static constexpr uint8_t type = TIME_SYNC;
+
+	uint32_t originate;
+	std::vector<uint8_t> padding; //!< 8 to 8 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->originate);
+		data.insert(data.end(), this->padding.begin(), this->padding.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static TimeSync decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("TIME_SYNC", data.size(), 12, 12);
+		TimeSync packet;
+		packet.originate = detail::readField<uint32_t>(data, 0);
+		packet.padding.assign(data.begin() + 4, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a SET_LOG_TIMESTAMPS packet.
+struct SetLogTimestamps
+{
+	static constexpr uint8_t type = SET_LOG_TIMESTAMPS;
+
+	uint8_t enabled;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->enabled);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static SetLogTimestamps decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("SET_LOG_TIMESTAMPS", data.size(), 1, 1);
+		SetLogTimestamps packet;
+		packet.enabled = detail::readField<uint8_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a SET_TRACE packet.
+struct SetTrace
+{
+	static constexpr uint8_t type = SET_TRACE;
+
+	uint8_t mode;
+	uint32_t mask;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->mode);
+		detail::writeField(data, this->mask);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static SetTrace decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("SET_TRACE", data.size(), 5, 5);
+		SetTrace packet;
+		packet.mode = detail::readField<uint8_t>(data, 0);
+		packet.mask = detail::readField<uint32_t>(data, 1);
+		return packet;
+	}
+};
+
+//! The data section of a BOOTED_UP packet.
+struct BootedUp
+{
+	static constexpr uint8_t type = BOOTED_UP;
+
+	uint8_t resetCause;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->resetCause);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static BootedUp decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("BOOTED_UP", data.size(), 1, 1);
+		BootedUp packet;
+		packet.resetCause = detail::readField<uint8_t>(data, 0);
+		return packet;
+	}
+};
+
+//! The data section of a VERSION_DATA packet.
+struct VersionData
+{
+	static constexpr uint8_t type = VERSION_DATA;
+
+	std::string version; //!< 1 to 200 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		data.insert(data.end(), this->version.begin(), this->version.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length. Trailing null characters are removed from text.
+	static VersionData decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("VERSION_DATA", data.size(), 1, 200);
+		VersionData packet;
+		packet.version.assign(data.begin() + 0, data.end());
+		while (!packet.version.empty() && packet.version.back() == '\0')
+			packet.version.pop_back();
+		return packet;
+	}
+};
+
+//! The data section of a STATS_DATA packet.
+struct StatsData
+{
+	static constexpr uint8_t type = STATS_DATA;
+
+	uint8_t version;
+	uint16_t rxOverruns;
+	uint16_t motor0Faults;
+	uint32_t motor0FaultTime;
+	uint16_t motor1Faults;
+	uint32_t motor1FaultTime;
+	uint32_t bytesReceived;
+	uint32_t bytesSent;
+	uint16_t packetsReceived;
+	uint16_t packetsSent;
+	uint16_t crcErrors;
+	uint16_t framingErrors;
+	uint16_t invalidHeaders;
+	uint16_t validatorRejections;
+	uint16_t resyncs;
+	uint16_t droppedPackets;
+	uint16_t controlDrops;
+	uint16_t faultDrops;
+	uint16_t telemetryDrops;
+	uint16_t debugDrops;
+	uint16_t controlHighWater;
+	uint16_t faultHighWater;
+	uint16_t telemetryHighWater;
+	uint16_t debugHighWater;
+	uint16_t retransmissions;
+	uint16_t duplicates;
+	uint16_t maxParseUs;
+	std::vector<uint8_t> typeCounts; //!< 0 to 139 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->version);
+		detail::writeField(data, this->rxOverruns);
+		detail::writeField(data, this->motor0Faults);
+		detail::writeField(data, this->motor0FaultTime);
+		detail::writeField(data, this->motor1Faults);
+		detail::writeField(data, this->motor1FaultTime);
+		detail::writeField(data, this->bytesReceived);
+		detail::writeField(data, this->bytesSent);
+		detail::writeField(data, this->packetsReceived);
+		detail::writeField(data, this->packetsSent);
+		detail::writeField(data, this->crcErrors);
+		detail::writeField(data, this->framingErrors);
+		detail::writeField(data, this->invalidHeaders);
+		detail::writeField(data, this->validatorRejections);
+		detail::writeField(data, this->resyncs);
+		detail::writeField(data, this->droppedPackets);
+		detail::writeField(data, this->controlDrops);
+		detail::writeField(data, this->faultDrops);
+		detail::writeField(data, this->telemetryDrops);
+		detail::writeField(data, this->debugDrops);
+		detail::writeField(data, this->controlHighWater);
+		detail::writeField(data, this->faultHighWater);
+		detail::writeField(data, this->telemetryHighWater);
+		detail::writeField(data, this->debugHighWater);
+		detail::writeField(data, this->retransmissions);
+		detail::writeField(data, this->duplicates);
+		detail::writeField(data, this->maxParseUs);
+		data.insert(data.end(), this->typeCounts.begin(), this->typeCounts.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static StatsData decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("STATS_DATA", data.size(), 61, 200);
+		StatsData packet;
+		packet.version = detail::readField<uint8_t>(data, 0);
+		packet.rxOverruns = detail::readField<uint16_t>(data, 1);
+		packet.motor0Faults = detail::readField<uint16_t>(data, 3);
+		packet.motor0FaultTime = detail::readField<uint32_t>(data, 5);
+		packet.motor1Faults = detail::readField<uint16_t>(data, 9);
+		packet.motor1FaultTime = detail::readField<uint32_t>(data, 11);
+		packet.bytesReceived = detail::readField<uint32_t>(data, 15);
+		packet.bytesSent = detail::readField<uint32_t>(data, 19);
+		packet.packetsReceived = detail::readField<uint16_t>(data, 23);
+		packet.packetsSent = detail::readField<uint16_t>(data, 25);
+		packet.crcErrors = detail::readField<uint16_t>(data, 27);
+		packet.framingErrors = detail::readField<uint16_t>(data, 29);
+		packet.invalidHeaders = detail::readField<uint16_t>(data, 31);
+		packet.validatorRejections = detail::readField<uint16_t>(data, 33);
+		packet.resyncs = detail::readField<uint16_t>(data, 35);
+		packet.droppedPackets = detail::readField<uint16_t>(data, 37);
+		packet.controlDrops = detail::readField<uint16_t>(data, 39);
+		packet.faultDrops = detail::readField<uint16_t>(data, 41);
+		packet.telemetryDrops = detail::readField<uint16_t>(data, 43);
+		packet.debugDrops = detail::readField<uint16_t>(data, 45);
+		packet.controlHighWater = detail::readField<uint16_t>(data, 47);
+		packet.faultHighWater = detail::readField<uint16_t>(data, 49);
+		packet.telemetryHighWater = detail::readField<uint16_t>(data, 51);
+		packet.debugHighWater = detail::readField<uint16_t>(data, 53);
+		packet.retransmissions = detail::readField<uint16_t>(data, 55);
+		packet.duplicates = detail::readField<uint16_t>(data, 57);
+		packet.maxParseUs = detail::readField<uint16_t>(data, 59);
+		packet.typeCounts.assign(data.begin() + 61, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a TELEMETRY_DATA packet.
+struct TelemetryData
+{
+	static constexpr uint8_t type = TELEMETRY_DATA;
+
+	uint8_t flags;
+	uint8_t frame;
+	std::vector<uint8_t> samples; //!< 0 to 198 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->flags);
+		detail::writeField(data, this->frame);
+		data.insert(data.end(), this->samples.begin(), this->samples.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static TelemetryData decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("TELEMETRY_DATA", data.size(), 2, 200);
+		TelemetryData packet;
+		packet.flags = detail::readField<uint8_t>(data, 0);
+		packet.frame = detail::readField<uint8_t>(data, 1);
+		packet.samples.assign(data.begin() + 2, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a DEBUG_LOG packet.
+struct DebugLog
+{
+	static constexpr uint8_t type = DEBUG_LOG;
+
+	std::string message; //!< 1 to 200 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		data.insert(data.end(), this->message.begin(), this->message.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length. Trailing null characters are removed from text.
+	static DebugLog decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("DEBUG_LOG", data.size(), 1, 200);
+		DebugLog packet;
+		packet.message.assign(data.begin() + 0, data.end());
+		while (!packet.message.empty() && packet.message.back() == '\0')
+			packet.message.pop_back();
+		return packet;
+	}
+};
+
+//! The data section of a WARNING_LOG packet.
+struct WarningLog
+{
+	static constexpr uint8_t type = WARNING_LOG;
+
+	std::string message; //!< 1 to 200 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		data.insert(data.end(), this->message.begin(), this->message.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length. Trailing null characters are removed from text.
+	static WarningLog decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("WARNING_LOG", data.size(), 1, 200);
+		WarningLog packet;
+		packet.message.assign(data.begin() + 0, data.end());
+		while (!packet.message.empty() && packet.message.back() == '\0')
+			packet.message.pop_back();
+		return packet;
+	}
+};
+
+//! The data section of a CRITICAL_LOG packet.
+struct CriticalLog
+{
+	static constexpr uint8_t type = CRITICAL_LOG;
+
+	std::string message; //!< 1 to 200 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		data.insert(data.end(), this->message.begin(), this->message.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length. Trailing null characters are removed from text.
+	static CriticalLog decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("CRITICAL_LOG", data.size(), 1, 200);
+		CriticalLog packet;
+		packet.message.assign(data.begin() + 0, data.end());
+		while (!packet.message.empty() && packet.message.back() == '\0')
+			packet.message.pop_back();
+		return packet;
+	}
+};
+
+//! The data section of a SW_FAULT packet.
+struct SwFault
+{
+	static constexpr uint8_t type = SW_FAULT;
+
+	uint16_t line;
+	uint16_t arg1;
+	uint16_t arg2;
+	std::string text; //!< 2 to 194 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->line);
+		detail::writeField(data, this->arg1);
+		detail::writeField(data, this->arg2);
+		data.insert(data.end(), this->text.begin(), this->text.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length. Trailing null characters are removed from text.
+	static SwFault decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("SW_FAULT", data.size(), 8, 200);
+		SwFault packet;
+		packet.line = detail::readField<uint16_t>(data, 0);
+		packet.arg1 = detail::readField<uint16_t>(data, 2);
+		packet.arg2 = detail::readField<uint16_t>(data, 4);
+		packet.text.assign(data.begin() + 6, data.end());
+		while (!packet.text.empty() && packet.text.back() == '\0')
+			packet.text.pop_back();
+		return packet;
+	}
+};
+
+//! The data section of a TUNABLE_INFO packet.
+struct TunableInfo
+{
+	static constexpr uint8_t type = TUNABLE_INFO;
+
+	uint8_t id;
+	uint8_t count;
+	std::vector<uint8_t> description; //!< 0 to 198 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->id);
+		detail::writeField(data, this->count);
+		data.insert(data.end(), this->description.begin(), this->description.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static TunableInfo decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("TUNABLE_INFO", data.size(), 2, 200);
+		TunableInfo packet;
+		packet.id = detail::readField<uint8_t>(data, 0);
+		packet.count = detail::readField<uint8_t>(data, 1);
+		packet.description.assign(data.begin() + 2, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a TUNABLE_VALUE packet.
+struct TunableValue
+{
+	static constexpr uint8_t type = TUNABLE_VALUE;
+
+	uint8_t id;
+	uint8_t status;
+	int16_t value;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->id);
+		detail::writeField(data, this->status);
+		detail::writeField(data, this->value);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static TunableValue decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("TUNABLE_VALUE", data.size(), 4, 4);
+		TunableValue packet;
+		packet.id = detail::readField<uint8_t>(data, 0);
+		packet.status = detail::readField<uint8_t>(data, 1);
+		packet.value = detail::readField<int16_t>(data, 2);
+		return packet;
+	}
+};
+
+//! The data section of a PING_REPLY packet.
+struct PingReply
+{
+	static constexpr uint8_t type = PING_REPLY;
+
+	std::vector<uint8_t> payload; //!< 0 to 200 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		data.insert(data.end(), this->payload.begin(), this->payload.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static PingReply decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("PING_REPLY", data.size(), 0, 200);
+		PingReply packet;
+		packet.payload.assign(data.begin() + 0, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a BULK_DATA packet.
+struct BulkData
+{
+	static constexpr uint8_t type = BULK_DATA;
+
+	uint16_t index;
+	std::vector<uint8_t> pattern; //!< 0 to 198 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->index);
+		data.insert(data.end(), this->pattern.begin(), this->pattern.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static BulkData decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("BULK_DATA", data.size(), 2, 200);
+		BulkData packet;
+		packet.index = detail::readField<uint16_t>(data, 0);
+		packet.pattern.assign(data.begin() + 2, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a LINK_REPORT packet.
+struct LinkReport
+{
+	static constexpr uint8_t type = LINK_REPORT;
+
+	uint32_t uptimeMs;
+	uint32_t sinkPackets;
+	uint32_t sinkBytes;
+	uint16_t sourceLeft;
+	uint16_t packetsReceived;
+	uint16_t crcErrors;
+	uint16_t framingErrors;
+	uint16_t invalidHeaders;
+	uint16_t rxOverruns;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->uptimeMs);
+		detail::writeField(data, this->sinkPackets);
+		detail::writeField(data, this->sinkBytes);
+		detail::writeField(data, this->sourceLeft);
+		detail::writeField(data, this->packetsReceived);
+		detail::writeField(data, this->crcErrors);
+		detail::writeField(data, this->framingErrors);
+		detail::writeField(data, this->invalidHeaders);
+		detail::writeField(data, this->rxOverruns);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static LinkReport decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("LINK_REPORT", data.size(), 24, 24);
+		LinkReport packet;
+		packet.uptimeMs = detail::readField<uint32_t>(data, 0);
+		packet.sinkPackets = detail::readField<uint32_t>(data, 4);
+		packet.sinkBytes = detail::readField<uint32_t>(data, 8);
+		packet.sourceLeft = detail::readField<uint16_t>(data, 12);
+		packet.packetsReceived = detail::readField<uint16_t>(data, 14);
+		packet.crcErrors = detail::readField<uint16_t>(data, 16);
+		packet.framingErrors = detail::readField<uint16_t>(data, 18);
+		packet.invalidHeaders = detail::readField<uint16_t>(data, 20);
+		packet.rxOverruns = detail::readField<uint16_t>(data, 22);
+		return packet;
+	}
+};
+
+//! The data section of a TIME_SYNC_REPLY packet.
+struct TimeSyncReply
+{
+	static constexpr uint8_t type = TIME_SYNC_REPLY;
+
+	uint32_t originate;
+	uint32_t receiveUs;
+	uint32_t transmitUs;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->originate);
+		detail::writeField(data, this->receiveUs);
+		detail::writeField(data, this->transmitUs);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static TimeSyncReply decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("TIME_SYNC_REPLY", data.size(), 12, 12);
+		TimeSyncReply packet;
+		packet.originate = detail::readField<uint32_t>(data, 0);
+		packet.receiveUs = detail::readField<uint32_t>(data, 4);
+		packet.transmitUs = detail::readField<uint32_t>(data, 8);
+		return packet;
+	}
+};
+
+//! The data section of a TRACE_DATA packet.
+struct TraceData
+{
+	static constexpr uint8_t type = TRACE_DATA;
+
+	uint32_t startUs;
+	uint16_t startClock;
+	uint16_t lost;
+	uint8_t flags;
+	std::vector<uint8_t> events; //!< 0 to 191 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->startUs);
+		detail::writeField(data, this->startClock);
+		detail::writeField(data, this->lost);
+		detail::writeField(data, this->flags);
+		data.insert(data.end(), this->events.begin(), this->events.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static TraceData decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("TRACE_DATA", data.size(), 9, 200);
+		TraceData packet;
+		packet.startUs = detail::readField<uint32_t>(data, 0);
+		packet.startClock = detail::readField<uint16_t>(data, 4);
+		packet.lost = detail::readField<uint16_t>(data, 6);
+		packet.flags = detail::readField<uint8_t>(data, 8);
+		packet.events.assign(data.begin() + 9, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a BOOT_GET_PAGE_CRCS packet.
+struct BootGetPageCrcs
+{
+	static constexpr uint8_t type = BOOT_GET_PAGE_CRCS;
+
+	uint16_t firstPage;
+	uint8_t count;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->firstPage);
+		detail::writeField(data, this->count);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static BootGetPageCrcs decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("BOOT_GET_PAGE_CRCS", data.size(), 3, 3);
+		BootGetPageCrcs packet;
+		packet.firstPage = detail::readField<uint16_t>(data, 0);
+		packet.count = detail::readField<uint8_t>(data, 2);
+		return packet;
+	}
+};
+
+//! The data section of a BOOT_PAGE_DATA packet.
+struct BootPageData
+{
+	static constexpr uint8_t type = BOOT_PAGE_DATA;
+
+	uint16_t page;
+	uint8_t offset;
+	std::vector<uint8_t> data; //!< 1 to 128 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->page);
+		detail::writeField(data, this->offset);
+		data.insert(data.end(), this->data.begin(), this->data.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static BootPageData decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("BOOT_PAGE_DATA", data.size(), 4, 131);
+		BootPageData packet;
+		packet.page = detail::readField<uint16_t>(data, 0);
+		packet.offset = detail::readField<uint8_t>(data, 2);
+		packet.data.assign(data.begin() + 3, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a BOOT_PAGE_WRITE packet.
+struct BootPageWrite
+{
+	static constexpr uint8_t type = BOOT_PAGE_WRITE;
+
+	uint16_t page;
+	uint16_t crc;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->page);
+		detail::writeField(data, this->crc);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static BootPageWrite decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("BOOT_PAGE_WRITE", data.size(), 4, 4);
+		BootPageWrite packet;
+		packet.page = detail::readField<uint16_t>(data, 0);
+		packet.crc = detail::readField<uint16_t>(data, 2);
+		return packet;
+	}
+};
+
+//! The data section of a BOOT_INFO packet.
+struct BootInfo
+{
+	static constexpr uint8_t type = BOOT_INFO;
+
+	uint8_t version;
+	uint16_t pageSize;
+	uint16_t appPages;
+	uint8_t requested;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->version);
+		detail::writeField(data, this->pageSize);
+		detail::writeField(data, this->appPages);
+		detail::writeField(data, this->requested);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static BootInfo decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("BOOT_INFO", data.size(), 6, 6);
+		BootInfo packet;
+		packet.version = detail::readField<uint8_t>(data, 0);
+		packet.pageSize = detail::readField<uint16_t>(data, 1);
+		packet.appPages = detail::readField<uint16_t>(data, 3);
+		packet.requested = detail::readField<uint8_t>(data, 5);
+		return packet;
+	}
+};
+
+//! The data section of a BOOT_PAGE_CRCS packet.
+struct BootPageCrcs
+{
+	static constexpr uint8_t type = BOOT_PAGE_CRCS;
+
+	uint16_t firstPage;
+	std::vector<uint8_t> crcs; //!< 0 to 198 bytes.
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->firstPage);
+		data.insert(data.end(), this->crcs.begin(), this->crcs.end());
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static BootPageCrcs decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("BOOT_PAGE_CRCS", data.size(), 2, 200);
+		BootPageCrcs packet;
+		packet.firstPage = detail::readField<uint16_t>(data, 0);
+		packet.crcs.assign(data.begin() + 2, data.end());
+		return packet;
+	}
+};
+
+//! The data section of a BOOT_PAGE_WRITTEN packet.
+struct BootPageWritten
+{
+	static constexpr uint8_t type = BOOT_PAGE_WRITTEN;
+
+	uint16_t page;
+	uint8_t status;
+
+	std::vector<uint8_t> encode() const
+	{
+		std::vector<uint8_t> data;
+		detail::writeField(data, this->page);
+		detail::writeField(data, this->status);
+		return data;
+	}
+
+	//! @throw std::runtime_error if the data section has the wrong length.
+	static BootPageWritten decode(const std::vector<uint8_t> &data)
+	{
+		detail::checkLength("BOOT_PAGE_WRITTEN", data.size(), 3, 3);
+		BootPageWritten packet;
+		packet.page = detail::readField<uint16_t>(data, 0);
+		packet.status = detail::readField<uint8_t>(data, 2);
+		return packet;
+	}
+};
+
+} // namespace robolink
+
+#endif
@@ -0,0 +1,168 @@
+/*! @file
+    Measures how many Remote System queries per second the link can answer, first one at a time
+    and then with many outstanding at once.
+
+    usage: remotebench [--baud rate] [--window n] [--count n] [--channel n] [--stream secs] [--period ms] <device>
+
+    The Remote System commands are handled in every mode, so the robot can be benchmarked in the middle of a run.
+    Each query is a CMD_ANALOG10 of the channel.
+    With --stream, it also subscribes to every analog input and digital input for a number of seconds,
+    and compares the sample rate with the rate of one-at-a-time queries.
+ */
+
+#include "packetlink.h"
+#include "remoteclient.h"
+#include "sensorstream.h"
+#include "serialport.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using namespace robolink;
+
+static void printUsage()
+{
+	std::fprintf(stderr, "usage: remotebench [--baud rate] [--window n] [--count n] [--channel n] [--stream secs] [--period ms] <device>\n");
+}
+
+/*! Sends count queries, keeping up to window of them outstanding.
+ *  @return The queries answered per second, or 0 if any of them failed.
+ */
+static double runQueries(PacketLink &link, unsigned window, unsigned count, uint8_t channel)
+{
+	RemoteClient client(link, window);
+	std::deque<std::future<uint16_t>> replies;
+	unsigned failures = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < count; i++)
+	{
+		//collect the oldest reply before the window would block, so failures are noticed as they happen
+		if (replies.size() >= window)
+		{
+			try
+			{
+				replies.front().get();
+			}
+			catch (const std::exception &)
+			{
+				failures++;
+			}
+			replies.pop_front();
+		}
+		replies.push_back(client.analog10(channel));
+	}
+	for (auto &reply : replies)
+	{
+		try
+		{
+			reply.get();
+		}
+		catch (const std::exception &)
+		{
+			failures++;
+		}
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::printf("window %3u: %u queries in %.3f s, %.0f queries/s, %u failed\n",
+	            window, count, elapsed.count(), count / elapsed.count(), failures);
+	return failures == 0 ? count / elapsed.count() : 0.0;
+}
+
+/*! Streams every input for a number of seconds.
+ *  @return The samples received per second.
+ */
+static double runStream(PacketLink &link, unsigned seconds, uint16_t periodMs)
+{
+	RemoteClient client(link);
+	std::vector<SensorSample> samples;
+	const auto start = std::chrono::steady_clock::now();
+	SensorStreamStats stats;
+	{
+		SensorSubscription subscription(client, periodMs, 0xFF, 0x03FF);
+		const auto end = start + std::chrono::seconds(seconds);
+		while (std::chrono::steady_clock::now() < end)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			//drain the ring the way an application would, so it never overflows
+			subscription.read(samples);
+			samples.clear();
+		}
+		stats = subscription.stats();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::printf("stream %u ms: %lu samples of 8 analog and 10 digital inputs in %.3f s, %.0f samples/s, "
+	            "%lu packets, %lu lost, %lu overwritten\n",
+	            periodMs, stats.samples, elapsed.count(), stats.samples / elapsed.count(),
+	            stats.packets, stats.lostPackets, stats.overwritten);
+	return stats.samples / elapsed.count();
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned baud = 38400;
+	unsigned window = 8;
+	unsigned count = 200;
+	unsigned channel = 0;
+	unsigned streamSeconds = 0;
+	unsigned period = 1;
+
+	int arg = 1;
+	for (; arg < argc && std::strncmp(argv[arg], "--", 2) == 0; arg++)
+	{
+		const std::string option = argv[arg];
+		if (option == "--baud" && arg + 1 < argc)
+			baud = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--window" && arg + 1 < argc)
+			window = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--count" && arg + 1 < argc)
+			count = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--channel" && arg + 1 < argc)
+			channel = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--stream" && arg + 1 < argc)
+			streamSeconds = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--period" && arg + 1 < argc)
+			period = std::strtoul(argv[++arg], nullptr, 0);
+		else
+		{
+			printUsage();
+			return 2;
+		}
+	}
+	if (arg + 1 != argc || window == 0)
+	{
+		printUsage();
+		return 2;
+	}
+
+	try
+	{
+		const int fd = openSerialPort(argv[arg], baud);
+		PacketLink link(fd);
+		const double serial = runQueries(link, 1, count, channel);
+		const double pipelined = runQueries(link, window, count, channel);
+		if (serial > 0 && pipelined > 0)
+			std::printf("speedup: %.1fx\n", pipelined / serial);
+		if (streamSeconds > 0 && serial > 0)
+		{
+			//a polled sample of 8 analog inputs takes 8 queries
+			const double streamed = runStream(link, streamSeconds, period);
+			std::printf("streamed samples vs polled: %.1fx\n", streamed / (serial / 8));
+		}
+		close(fd);
+		return (serial > 0 && pipelined > 0) ? 0 : 1;
+	}
+	catch (const std::exception &e)
+	{
+		std::fprintf(stderr, "remotebench: %s\n", e.what());
+		return 1;
+	}
+}
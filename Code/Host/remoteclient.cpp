@@ -0,0 +1,331 @@
+#include "remoteclient.h"
+#include <algorithm>
+#include <poll.h>
+
+namespace robolink
+{
+
+static_assert(PacketLink::maxPacketData == MAX_PACKET_DATA, "the link and Protocol/packets.schema disagree on MAX_PACKET_DATA");
+
+//! How often the background thread checks for timed out queries and for being destroyed, when nothing arrives.
+static constexpr int IDLE_POLL_MS = 10;
+
+RemoteClient::RemoteClient(PacketLink &link, unsigned maxOutstanding, std::chrono::milliseconds timeout) :
+	link(link),
+	//sequence numbers are 8 bits, so keep well clear of reusing one that's still outstanding
+	maxOutstanding(std::max(1u, std::min(maxOutstanding, 128u))),
+	timeout(timeout)
+{
+	if (link.reliable())
+		throw std::invalid_argument("the Remote System client needs the reliable channel off");
+	thread = std::thread(&RemoteClient::run, this);
+}
+
+RemoteClient::~RemoteClient()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	thread.join();
+	//fail whatever is still outstanding, so nobody waits forever on a future
+	for (auto &entry : pending)
+		entry.second.complete(nullptr);
+}
+
+std::future<std::string> RemoteClient::version()
+{
+	return query<std::string>(CMD_GET_VERSION, {}, [](const std::vector<uint8_t> &value) {
+		return std::string(value.begin(), value.end());
+	});
+}
+
+//! Decodes a 1-byte value.
+static uint8_t decodeU8(const std::vector<uint8_t> &value)
+{
+	if (value.size() != 1)
+		throw std::runtime_error("expected a 1-byte reply");
+	return value[0];
+}
+
+//! Decodes a 2-byte value, MSB first.
+static uint16_t decodeU16(const std::vector<uint8_t> &value)
+{
+	if (value.size() != 2)
+		throw std::runtime_error("expected a 2-byte reply");
+	return (uint16_t)((value[0] << 8) | value[1]);
+}
+
+std::future<uint8_t> RemoteClient::button1()
+{
+	return query<uint8_t>(CMD_GET_BUTTON1, {}, decodeU8);
+}
+
+std::future<uint8_t> RemoteClient::digitalInput(uint8_t pin)
+{
+	return query<uint8_t>(CMD_DIGITAL_INPUT, {pin}, decodeU8);
+}
+
+std::future<uint8_t> RemoteClient::analog(uint8_t channel)
+{
+	return query<uint8_t>(CMD_ANALOG, {channel}, decodeU8);
+}
+
+std::future<uint16_t> RemoteClient::analog10(uint8_t channel)
+{
+	return query<uint16_t>(CMD_ANALOG10, {channel}, decodeU16);
+}
+
+std::future<uint8_t> RemoteClient::servoRange(uint8_t servo)
+{
+	return query<uint8_t>(CMD_GET_SERVO_RANGE, {servo}, decodeU8);
+}
+
+std::future<uint8_t> RemoteClient::setServoRange(uint8_t servo, uint8_t range)
+{
+	return query<uint8_t>(CMD_SET_SERVO_RANGE, {servo, range}, decodeU8);
+}
+
+RemoteBatch &RemoteBatch::add(uint8_t command, const std::vector<uint8_t> &commandData)
+{
+	if (data.size() + 2 + commandData.size() > PacketLink::maxPacketData)
+		throw std::length_error("batch too long");
+	data.push_back(command);
+	data.push_back((uint8_t)commandData.size());
+	data.insert(data.end(), commandData.begin(), commandData.end());
+	return *this;
+}
+
+//! Gets the number of bytes a command returns, the same as valueLength() in remoteControl.c.
+static std::size_t valueLength(uint8_t command)
+{
+	switch (command)
+	{
+		case CMD_ANALOG10:
+		case CMD_KNOB10:
+			return 2;
+		case CMD_SET_SERVO_RANGE_BY_INDEX:
+		case CMD_SET_SERVO_RANGE:
+		case CMD_GET_SERVO_RANGE:
+		case CMD_DIGITAL_INPUT:
+		case CMD_ANALOG:
+		case CMD_GET_BUTTON1:
+		case CMD_KNOB:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+std::future<BatchResult> RemoteClient::batch(const RemoteBatch &batch)
+{
+	return query<BatchResult>(CMD_BATCH, batch.bytes(), [](const std::vector<uint8_t> &reply) {
+		if (reply.empty() || reply[0] == 0)
+			throw std::runtime_error("batch rejected");
+		BatchResult result;
+		for (std::size_t i = 1; i < reply.size();)
+		{
+			const uint8_t command = reply[i];
+			const std::size_t length = valueLength(command);
+			if (length == 0 || i + 1 + length > reply.size())
+				throw std::runtime_error("malformed batch reply");
+			uint16_t value = reply[i + 1];
+			if (length == 2)
+				value = (uint16_t)((value << 8) | reply[i + 2]);
+			result.values.emplace_back(command, value);
+			i += 1 + length;
+		}
+		return result;
+	});
+}
+
+RemoteScript &RemoteScript::append(std::initializer_list<uint8_t> bytes)
+{
+	if (data.size() + bytes.size() > maxLength)
+		throw std::length_error("script too long");
+	data.insert(data.end(), bytes);
+	return *this;
+}
+
+RemoteScript &RemoteScript::command(uint8_t command, const std::vector<uint8_t> &commandData)
+{
+	if (data.size() + 3 + commandData.size() > maxLength)
+		throw std::length_error("script too long");
+	append({OpCommand, command, (uint8_t)commandData.size()});
+	data.insert(data.end(), commandData.begin(), commandData.end());
+	return *this;
+}
+
+RemoteScript &RemoteScript::waitMs(uint16_t ms)
+{
+	return append({OpWaitMs, (uint8_t)(ms >> 8), (uint8_t)ms});
+}
+
+RemoteScript &RemoteScript::waitUntil(Condition condition, uint8_t input, uint16_t threshold, uint16_t timeoutMs)
+{
+	return append({OpWaitUntil, condition, input, (uint8_t)(threshold >> 8), (uint8_t)threshold, (uint8_t)(timeoutMs >> 8), (uint8_t)timeoutMs});
+}
+
+RemoteScript &RemoteScript::jump(uint16_t address)
+{
+	return append({OpJump, (uint8_t)(address >> 8), (uint8_t)address});
+}
+
+RemoteScript &RemoteScript::jumpIf(Condition condition, uint8_t input, uint16_t threshold, uint16_t address)
+{
+	return append({OpJumpIf, condition, input, (uint8_t)(threshold >> 8), (uint8_t)threshold, (uint8_t)(address >> 8), (uint8_t)address});
+}
+
+RemoteScript &RemoteScript::setCounter(uint16_t count)
+{
+	return append({OpSetCounter, (uint8_t)(count >> 8), (uint8_t)count});
+}
+
+RemoteScript &RemoteScript::loop(uint16_t address)
+{
+	return append({OpLoop, (uint8_t)(address >> 8), (uint8_t)address});
+}
+
+RemoteScript &RemoteScript::end()
+{
+	return append({OpEnd});
+}
+
+void RemoteScript::setJumpTarget(uint16_t jumpAddress, uint16_t target)
+{
+	//the target is the last 2 bytes of every jump instruction
+	std::size_t offset;
+	switch (data.at(jumpAddress))
+	{
+		case OpJump:
+		case OpLoop:
+			offset = 1;
+			break;
+		case OpJumpIf:
+			offset = 5;
+			break;
+		default:
+			throw std::invalid_argument("not a jump instruction");
+	}
+	data.at(jumpAddress + offset) = (uint8_t)(target >> 8);
+	data.at(jumpAddress + offset + 1) = (uint8_t)target;
+}
+
+bool RemoteClient::loadScript(const RemoteScript &script)
+{
+	//small enough pieces that each fits in the robot's UART receive buffer
+	static constexpr std::size_t chunkLength = 64;
+	const std::vector<uint8_t> &bytes = script.bytes();
+	std::vector<std::future<uint8_t>> replies;
+	for (std::size_t offset = 0; offset < bytes.size(); offset += chunkLength)
+	{
+		std::vector<uint8_t> data = {(uint8_t)(offset >> 8), (uint8_t)offset};
+		data.insert(data.end(), bytes.begin() + offset, bytes.begin() + std::min(offset + chunkLength, bytes.size()));
+		replies.push_back(query<uint8_t>(CMD_SCRIPT_LOAD, data, decodeU8));
+	}
+	bool loaded = true;
+	for (auto &reply : replies)
+		loaded &= (reply.get() != 0);
+	return loaded;
+}
+
+std::future<ScriptResult> RemoteClient::runScript(std::chrono::milliseconds scriptTimeout)
+{
+	return query<ScriptResult>(CMD_SCRIPT_RUN, {}, [](const std::vector<uint8_t> &reply) {
+		if (reply.size() != 3)
+			throw std::runtime_error("malformed script reply");
+		return ScriptResult{(ScriptResult::Status)reply[0], (uint16_t)((reply[1] << 8) | reply[2])};
+	}, scriptTimeout);
+}
+
+uint8_t RemoteClient::command(uint8_t type, const std::vector<uint8_t> &data)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return link.send(type, data);
+}
+
+void RemoteClient::setPacketHandler(std::function<void(const Packet &)> handler)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	packetHandler = std::move(handler);
+}
+
+void RemoteClient::submit(uint8_t command, const std::vector<uint8_t> &data, Completion complete, std::chrono::milliseconds replyTimeout)
+{
+	if (replyTimeout == std::chrono::milliseconds::zero())
+		replyTimeout = timeout;
+	std::unique_lock<std::mutex> lock(mutex);
+	windowOpen.wait(lock, [this] { return pending.size() < maxOutstanding; });
+	const uint8_t sequence = link.send(command, data);
+	pending[sequence] = Pending{command, Clock::now() + replyTimeout, std::move(complete)};
+}
+
+//! Receives replies and times out queries until the client is destroyed.
+void RemoteClient::run()
+{
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stopping)
+				return;
+			Packet packet;
+			while (link.poll(0, packet))
+				handleReply(packet);
+			expire();
+		}
+		//wait for more bytes without the lock, so queries can be sent in the meantime
+		pollfd descriptor = {link.fileDescriptor(), POLLIN, 0};
+		::poll(&descriptor, 1, IDLE_POLL_MS);
+	}
+}
+
+//! Completes the query a reply answers. Other packets, such as logs, go to the packet handler.
+void RemoteClient::handleReply(const Packet &packet)
+{
+	std::size_t headerLength;
+	if (packet.type == RESP_VERSION || packet.type == RESP_BATCH || packet.type == RESP_SCRIPT_DONE)
+		headerLength = 1;
+	else if (packet.type == RESP_VALUE)
+		headerLength = 2;
+	else
+	{
+		if (packetHandler)
+			packetHandler(packet);
+		return;
+	}
+	if (packet.data.size() < headerLength)
+		return;
+
+	const auto entry = pending.find(packet.data[0]);
+	if (entry == pending.end() || (packet.type == RESP_VALUE && packet.data[1] != entry->second.command))
+	{
+		unmatched++;
+		return;
+	}
+	const std::vector<uint8_t> value(packet.data.begin() + headerLength, packet.data.end());
+	entry->second.complete(&value);
+	pending.erase(entry);
+	windowOpen.notify_all();
+}
+
+//! Fails the queries whose replies haven't arrived in time.
+void RemoteClient::expire()
+{
+	const Clock::time_point now = Clock::now();
+	for (auto entry = pending.begin(); entry != pending.end();)
+	{
+		if (now >= entry->second.deadline)
+		{
+			entry->second.complete(nullptr);
+			entry = pending.erase(entry);
+			windowOpen.notify_all();
+		}
+		else
+		{
+			++entry;
+		}
+	}
+}
+
+} // namespace robolink
@@ -0,0 +1,232 @@
+/*! @file
+    PC side of the Remote System (Launcher/remoteControl.c), with pipelined queries.
+    Every reply echoes the sequenceNum of the command it answers, so many queries can be outstanding at once
+    instead of waiting a full round trip for each one.
+ */
+
+#ifndef REMOTECLIENT_H
+#define REMOTECLIENT_H
+
+#include "packetlink.h"
+#include "protocol.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace robolink
+{
+
+//! Builds the data section of a CMD_BATCH: sub-commands that the robot executes back to back in one dispatch.
+class RemoteBatch
+{
+public:
+	//! Adds a sub-command. CMD_GET_VERSION, CMD_SOFT_RESET, CMD_EXIT_REMOTE, the delays and CMD_BATCH aren't allowed.
+	RemoteBatch &add(uint8_t command, const std::vector<uint8_t> &data = {});
+	RemoteBatch &servo(uint8_t servo, uint8_t position) { return add(CMD_SERVO, {servo, position}); }
+	RemoteBatch &motor(uint8_t motor, uint8_t speed) { return add(CMD_MOTOR, {motor, speed}); }
+	RemoteBatch &analog10(uint8_t channel) { return add(CMD_ANALOG10, {channel}); }
+	RemoteBatch &digitalInput(uint8_t pin) { return add(CMD_DIGITAL_INPUT, {pin}); }
+
+	const std::vector<uint8_t> &bytes() const { return data; }
+
+private:
+	std::vector<uint8_t> data;
+};
+
+//! The reply to a CMD_BATCH.
+struct BatchResult
+{
+	//! The command and value of each sub-command that returns one, in order.
+	std::vector<std::pair<uint8_t, uint16_t>> values;
+};
+
+/*! Assembles a script for the robot's script engine (Launcher/remoteScript.h).
+ *  Each instruction method returns the script, and here() gives the address of the next instruction, for jumps.
+ */
+class RemoteScript
+{
+public:
+	static constexpr std::size_t maxLength = 256;
+
+	//! Same values as ScriptCondition in remoteScript.h.
+	enum Condition : uint8_t
+	{
+		DigitalHigh,
+		DigitalLow,
+		AnalogAbove,
+		AnalogBelow
+	};
+
+	uint16_t here() const { return (uint16_t)data.size(); }
+
+	//! Executes a Remote System command. The same commands as in a RemoteBatch are allowed.
+	RemoteScript &command(uint8_t command, const std::vector<uint8_t> &commandData = {});
+	RemoteScript &waitMs(uint16_t ms);
+	//! Waits for a condition. The script stops with StatusTimeout if it isn't true within timeoutMs (0 waits forever).
+	RemoteScript &waitUntil(Condition condition, uint8_t input, uint16_t threshold, uint16_t timeoutMs);
+	RemoteScript &jump(uint16_t address);
+	RemoteScript &jumpIf(Condition condition, uint8_t input, uint16_t threshold, uint16_t address);
+	RemoteScript &setCounter(uint16_t count);
+	//! Decrements the counter, and jumps to address if it isn't 0 yet.
+	RemoteScript &loop(uint16_t address);
+	RemoteScript &end();
+	//! Changes where the jump instruction at jumpAddress goes, for jumps forward to an address not known yet.
+	void setJumpTarget(uint16_t jumpAddress, uint16_t target);
+
+	const std::vector<uint8_t> &bytes() const { return data; }
+
+private:
+	//! Same values as ScriptOpcode in remoteScript.h.
+	enum Opcode : uint8_t
+	{
+		OpEnd,
+		OpCommand,
+		OpWaitMs,
+		OpWaitUntil,
+		OpJump,
+		OpJumpIf,
+		OpSetCounter,
+		OpLoop
+	};
+
+	RemoteScript &append(std::initializer_list<uint8_t> bytes);
+
+	std::vector<uint8_t> data;
+};
+
+//! How a script finished, from the RESP_SCRIPT_DONE packet.
+struct ScriptResult
+{
+	//! Same values as ScriptStatus in remoteScript.h.
+	enum Status : uint8_t
+	{
+		StatusDone,
+		StatusStopped,
+		StatusTimeout,
+		StatusInvalid
+	};
+
+	Status status;
+	//! The address the script finished at.
+	uint16_t address;
+};
+
+/*! Sends Remote System commands over a PacketLink and matches the replies to them.
+ *  A background thread owns the link's poll() loop, so the returned futures complete on their own.
+ *  The reliable channel must be off, since its sequenceNum bytes aren't unique per packet.
+ */
+class RemoteClient
+{
+public:
+	/*! @param maxOutstanding The most queries waiting for replies at once. Queries beyond that block until a reply arrives.
+	 *  Keep it small enough that the requests fit in the robot's UART receive buffer.
+	 *  @param timeout How long to wait for each reply before failing its future with std::runtime_error.
+	 */
+	explicit RemoteClient(PacketLink &link, unsigned maxOutstanding = 8,
+	                      std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+	~RemoteClient();
+	RemoteClient(const RemoteClient &) = delete;
+	RemoteClient &operator=(const RemoteClient &) = delete;
+
+	std::future<std::string> version();
+	std::future<uint8_t> button1();
+	std::future<uint8_t> digitalInput(uint8_t pin);
+	std::future<uint8_t> analog(uint8_t channel);
+	std::future<uint16_t> analog10(uint8_t channel);
+	std::future<uint8_t> servoRange(uint8_t servo);
+	std::future<uint8_t> setServoRange(uint8_t servo, uint8_t range);
+	//! Executes a batch. The future fails with std::runtime_error if the robot rejected it.
+	std::future<BatchResult> batch(const RemoteBatch &batch);
+
+	//! Uploads a script into the robot's SRAM, replacing the loaded one. @return false if the robot refused any part.
+	bool loadScript(const RemoteScript &script);
+	/*! Runs the loaded script. The future completes when the script finishes, or fails if it doesn't within timeout.
+	 *  Other queries can be made while the script runs.
+	 */
+	std::future<ScriptResult> runScript(std::chrono::milliseconds timeout);
+	void stopScript() { command(CMD_SCRIPT_STOP); }
+	//! Saves the loaded script in the robot's EEPROM.
+	void saveScript() { command(CMD_SCRIPT_SAVE); }
+	//! Replaces the loaded script with the one saved in EEPROM.
+	void restoreScript() { command(CMD_SCRIPT_RESTORE); }
+
+	//! Sends a command that doesn't reply, in order with the queries. @return The command's sequenceNum.
+	uint8_t command(uint8_t type, const std::vector<uint8_t> &data = {});
+
+	/*! Sets the function called (from the background thread) with each packet that isn't a reply to a query,
+	 *  such as RESP_SAMPLES and logs.
+	 */
+	void setPacketHandler(std::function<void(const Packet &)> handler);
+
+	//! The number of replies that didn't match an outstanding query, such as late replies to timed out queries.
+	unsigned unmatchedReplies() const { return unmatched; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+	//! Completes a query with the reply's value bytes, or with nullptr if it timed out.
+	using Completion = std::function<void(const std::vector<uint8_t> *value)>;
+
+	struct Pending
+	{
+		uint8_t command;
+		Clock::time_point deadline;
+		Completion complete;
+	};
+
+	/*! Sends a query, and calls decode with the reply's value bytes to fulfill the returned future.
+	 *  @param replyTimeout How long to wait for the reply, or zero for the client's timeout.
+	 */
+	template <typename T, typename Decode>
+	std::future<T> query(uint8_t command, const std::vector<uint8_t> &data, Decode decode,
+	                     std::chrono::milliseconds replyTimeout = std::chrono::milliseconds::zero())
+	{
+		auto promise = std::make_shared<std::promise<T>>();
+		std::future<T> future = promise->get_future();
+		submit(command, data, [promise, decode, command](const std::vector<uint8_t> *value) {
+			try
+			{
+				if (value == nullptr)
+					throw std::runtime_error("no reply to command " + std::to_string(command));
+				promise->set_value(decode(*value));
+			}
+			catch (...)
+			{
+				promise->set_exception(std::current_exception());
+			}
+		}, replyTimeout);
+		return future;
+	}
+
+	void submit(uint8_t command, const std::vector<uint8_t> &data, Completion complete, std::chrono::milliseconds replyTimeout);
+	void run();
+	void handleReply(const Packet &packet);
+	void expire();
+
+	PacketLink &link;
+	const unsigned maxOutstanding;
+	const std::chrono::milliseconds timeout;
+
+	//! Guards the link and pending. Not held while waiting for bytes, so queries can be sent while waiting for replies.
+	std::mutex mutex;
+	std::condition_variable windowOpen;
+	std::map<uint8_t, Pending> pending;
+	std::function<void(const Packet &)> packetHandler;
+	unsigned unmatched = 0;
+	bool stopping = false;
+	std::thread thread;
+};
+
+} // namespace robolink
+
+#endif
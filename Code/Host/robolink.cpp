@@ -0,0 +1,462 @@
+/*! @file
+    Command line tool for talking to the Launcher robot over its packet link.
+
+    Usage: robolink [options] <device> <command>...
+    Options:
+      --baud <rate>  Baud rate of the serial port (default 38400, matching UART0_BAUD in Launcher/Makefile).
+      --cobs         Switch the link to COBS framing before running the commands.
+      --fast <rate>  Ask the robot to switch to a faster baud rate before running the commands.
+                     Rates the robot proposes by itself (PC_LINK_FAST_BAUD) are accepted either way.
+      --reliable     Turn on the reliable channel, and send commands on it.
+      --loss <p>     Drop each sent and received packet with probability p, to exercise the reliable channel.
+      --seed <n>     Seed for --loss.
+    Commands:
+      version          Prints the firmware version string.
+      stats            Prints the robot's link and motor counters (STATS_DATA).
+      pause, resume    Pauses or resumes the competition clock.
+      abort            Aborts to the main menu.
+      monitor <secs>   Prints every packet received for a number of seconds.
+      telemetry <period_ms> <secs>
+                       Streams telemetry samples for a number of seconds, printed as CSV.
+      sync <secs>      Synchronizes with the robot's clock (see clocksync.h) for a number of seconds, and prints every
+                       packet received with its time in microseconds since the Unix epoch: logs at the time the robot
+                       logged them, telemetry samples at the time they were taken, and other packets when they arrived.
+                       Prints the offset and drift of the robot's clock at the end.
+      tunables         Lists the tunable parameters (Launcher/tunables.h) with their ranges and values.
+      get <name>       Prints the value of a tunable parameter.
+      set <name> <value>
+                       Changes a tunable parameter. The robot applies it at the start of its next control period.
+
+    The device can be a pty, which makes it possible to run against another instance of the link
+    (for example through socat) and check the reliable channel with --loss, without a robot.
+ */
+
+#include "clocksync.h"
+#include "packetlink.h"
+#include "protocol.h"
+#include "serialport.h"
+#include "telemetry.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+using namespace robolink;
+
+//! A tunable parameter, from a TUNABLE_INFO packet.
+struct Tunable
+{
+	uint8_t id;
+	//! Same values as TunableType in Launcher/tunables.h: 0 for an integer, 1 for fixed point with 8 fraction bits.
+	uint8_t type;
+	int16_t min, max, defaultValue, value;
+	std::string name;
+
+	//! Converts a raw value to the number it stands for.
+	double toNumber(int16_t raw) const { return (type == 1) ? raw / 256.0 : raw; }
+	//! Converts a number to the nearest raw value.
+	int16_t toRaw(double number) const { return (int16_t)std::lround((type == 1) ? number * 256.0 : number); }
+};
+
+//! How long to wait for a reply or a link control confirmation.
+static const int REPLY_TIMEOUT_MS = 1000;
+
+static void printUsage()
+{
+	std::fprintf(stderr, "usage: robolink [--baud rate] [--fast rate] [--cobs] [--reliable] [--loss p] [--seed n] <device> <command>...\n"
+	                     "commands: version, stats, pause, resume, abort, monitor <seconds>, telemetry <period_ms> <seconds>, sync <seconds>,\n"
+	                     "          tunables, get <name>, set <name> <value>\n");
+}
+
+//! Prints a received packet in a readable form.
+static void printPacket(const Packet &packet)
+{
+	switch (packet.type)
+	{
+		case VERSION_DATA:
+		case DEBUG_LOG:
+		case WARNING_LOG:
+		case CRITICAL_LOG:
+		{
+			static const char *const names[] = {"version", "", "", "debug", "warning", "critical"};
+			const std::string text(packet.data.begin(), packet.data.end());
+			std::printf("%s: %s\n", names[packet.type - VERSION_DATA], text.c_str());
+			break;
+		}
+		default:
+			std::printf("packet %3u seq %3u len %3zu:", packet.type, packet.sequence, packet.data.size());
+			for (uint8_t dataByte : packet.data)
+				std::printf(" %02X", dataByte);
+			std::printf("\n");
+			break;
+	}
+}
+
+//! Prints a time on the common timeline of ClockSync, as seconds since the Unix epoch.
+static void printTimelineTime(int64_t us)
+{
+	std::printf("%lld.%06lld ", (long long)(us / 1000000), (long long)(us % 1000000));
+}
+
+/*! Prints a packet with its time on the common timeline. Once the clocks are synchronized, logs are printed at the
+ *  time the robot logged them and telemetry samples at the time they were taken. Anything else is printed when it arrived.
+ */
+static void printTimedPacket(const ClockSync &clock, TelemetryDecoder &decoder, const Packet &packet)
+{
+	if (packet.type == TELEMETRY_DATA && clock.synchronized())
+	{
+		std::vector<TelemetrySample> samples;
+		decoder.decode(packet.data, samples);
+		for (const TelemetrySample &sample : samples)
+		{
+			printTimelineTime(clock.robotMsToTimeline(sample.timeMs));
+			std::printf("telemetry %u ms: %u,%u,%u,%u,%u,%d\n", sample.timeMs, sample.values[0], sample.values[1],
+			            sample.values[2], sample.values[3], sample.values[4], (int16_t)sample.values[5]);
+		}
+		return;
+	}
+	uint32_t robotUs;
+	printTimelineTime((clock.synchronized() && readLogTimestamp(packet, robotUs)) ? clock.robotToTimeline(robotUs) : clock.nowUs());
+	printPacket(packet);
+}
+
+//! Waits for a packet of a type, printing it. @return false on timeout.
+static bool waitForReply(PacketLink &link, uint8_t type)
+{
+	Packet packet;
+	while (link.poll(REPLY_TIMEOUT_MS, packet))
+	{
+		printPacket(packet);
+		if (packet.type == type)
+			return true;
+	}
+	std::fprintf(stderr, "no reply to command\n");
+	return false;
+}
+
+//! Sends a command, on the reliable channel if it is on. Waits for room in the window if necessary.
+static void sendCommand(PacketLink &link, uint8_t type, const std::vector<uint8_t> &data = {})
+{
+	Packet packet;
+	while (!link.sendReliable(type, data))
+	{
+		if (link.poll(10, packet))
+			printPacket(packet);
+	}
+}
+
+//! Waits for a packet of a type without printing it, printing any other packets. @return false on timeout.
+static bool receiveReply(PacketLink &link, uint8_t type, Packet &reply)
+{
+	while (link.poll(REPLY_TIMEOUT_MS, reply))
+	{
+		if (reply.type == type)
+			return true;
+		printPacket(reply);
+	}
+	std::fprintf(stderr, "no reply to command\n");
+	return false;
+}
+
+static int16_t parseInt16(const std::vector<uint8_t> &data, std::size_t offset)
+{
+	return (int16_t)((data[offset] << 8) | data[offset + 1]);
+}
+
+//! Asks the robot to describe each of its tunable parameters, one at a time.
+static std::vector<Tunable> readTunables(PacketLink &link)
+{
+	std::vector<Tunable> tunables;
+	unsigned count = 1;
+	for (unsigned id = 0; id < count; id++)
+	{
+		sendCommand(link, GET_TUNABLE_INFO, GetTunableInfo{(uint8_t)id}.encode());
+		Packet reply;
+		if (!receiveReply(link, TUNABLE_INFO, reply))
+			throw std::runtime_error("couldn't read the tunables");
+		const TunableInfo info = TunableInfo::decode(reply.data);
+		if (info.id != id || info.description.size() < 9)
+			throw std::runtime_error("bad TUNABLE_INFO packet");
+		count = info.count;
+		//the description is laid out by tunableDescribe() in Launcher/tunables.c
+		Tunable tunable;
+		tunable.id = info.id;
+		tunable.type = info.description[0];
+		tunable.min = parseInt16(info.description, 1);
+		tunable.max = parseInt16(info.description, 3);
+		tunable.defaultValue = parseInt16(info.description, 5);
+		tunable.value = parseInt16(info.description, 7);
+		tunable.name.assign(info.description.begin() + 9, info.description.end());
+		tunables.push_back(tunable);
+	}
+	return tunables;
+}
+
+static const Tunable &findTunable(const std::vector<Tunable> &tunables, const std::string &name)
+{
+	for (const Tunable &tunable : tunables)
+	{
+		if (tunable.name == name)
+			return tunable;
+	}
+	throw std::runtime_error("no tunable named " + name);
+}
+
+//! Prints a TUNABLE_VALUE reply. @return false if the robot refused the request.
+static bool printTunableValue(const Tunable &tunable, const Packet &reply)
+{
+	static const char *const statuses[] = {"ok", "unknown tunable", "out of range"};
+	const TunableValue value = TunableValue::decode(reply.data);
+	if (value.status != 0)
+	{
+		std::fprintf(stderr, "%s: %s\n", tunable.name.c_str(), (value.status < 3) ? statuses[value.status] : "error");
+		return false;
+	}
+	std::printf("%s = %g\n", tunable.name.c_str(), tunable.toNumber(value.value));
+	return true;
+}
+
+//! Prints a STATS_DATA reply, one counter per line. Packets from firmware with another layout are printed raw.
+static void printStats(const Packet &reply)
+{
+	if (reply.data.empty() || reply.data[0] != STATS_VERSION)
+	{
+		std::fprintf(stderr, "STATS_DATA isn't version %u, so it can't be decoded\n", STATS_VERSION);
+		printPacket(reply);
+		return;
+	}
+	const StatsData stats = StatsData::decode(reply.data);
+	std::printf("uart rx overruns     %u\n", stats.rxOverruns);
+	std::printf("motor faults         %u (last at %u ms), %u (last at %u ms)\n",
+	            stats.motor0Faults, stats.motor0FaultTime, stats.motor1Faults, stats.motor1FaultTime);
+	std::printf("bytes                %u received, %u sent\n", stats.bytesReceived, stats.bytesSent);
+	std::printf("packets              %u received, %u sent\n", stats.packetsReceived, stats.packetsSent);
+	std::printf("receive errors       %u crc, %u framing, %u bad headers (%u rejected by the validator), %u resyncs\n",
+	            stats.crcErrors, stats.framingErrors, stats.invalidHeaders, stats.validatorRejections, stats.resyncs);
+	std::printf("dropped packets      %u (control %u, fault %u, telemetry %u, debug %u)\n", stats.droppedPackets,
+	            stats.controlDrops, stats.faultDrops, stats.telemetryDrops, stats.debugDrops);
+	std::printf("queue high water     control %u, fault %u, telemetry %u, debug %u bytes\n",
+	            stats.controlHighWater, stats.faultHighWater, stats.telemetryHighWater, stats.debugHighWater);
+	std::printf("reliable channel     %u retransmissions, %u duplicates\n", stats.retransmissions, stats.duplicates);
+	std::printf("longest parse        %u us\n", stats.maxParseUs);
+	std::printf("packets by type     ");
+	for (std::size_t i = 0; i + 2 < stats.typeCounts.size(); i += 3)
+		std::printf(" 0x%02X:%u", stats.typeCounts[i], (stats.typeCounts[i + 1] << 8) | stats.typeCounts[i + 2]);
+	std::printf("\n");
+}
+
+//! Keeps the link running until every reliable packet has been acknowledged. @return false on timeout.
+static bool flushReliable(PacketLink &link)
+{
+	Packet packet;
+	for (int i = 0; i < 10 && !link.reliableIdle(); i++)
+	{
+		if (link.poll(REPLY_TIMEOUT_MS / 10, packet))
+			printPacket(packet);
+	}
+	return link.reliableIdle();
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned baud = 38400;
+	unsigned fastBaud = 0;
+	bool cobs = false;
+	bool reliable = false;
+	double loss = 0.0;
+	unsigned seed = 1;
+
+	int arg = 1;
+	for (; arg < argc && std::strncmp(argv[arg], "--", 2) == 0; arg++)
+	{
+		const std::string option = argv[arg];
+		if (option == "--cobs")
+			cobs = true;
+		else if (option == "--reliable")
+			reliable = true;
+		else if (option == "--baud" && arg + 1 < argc)
+			baud = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--fast" && arg + 1 < argc)
+			fastBaud = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--loss" && arg + 1 < argc)
+			loss = std::strtod(argv[++arg], nullptr);
+		else if (option == "--seed" && arg + 1 < argc)
+			seed = std::strtoul(argv[++arg], nullptr, 0);
+		else
+		{
+			printUsage();
+			return 2;
+		}
+	}
+	if (arg + 1 >= argc)
+	{
+		printUsage();
+		return 2;
+	}
+
+	try
+	{
+		const int fd = openSerialPort(argv[arg++], baud);
+		PacketLink link(fd);
+		link.setBaudSetter(baud, [fd](unsigned newBaud) { setSerialBaud(fd, newBaud); });
+
+		if (fastBaud != 0 && !link.requestBaud(fastBaud, REPLY_TIMEOUT_MS))
+			throw std::runtime_error("couldn't switch to " + std::to_string(fastBaud) + " baud");
+
+		if (cobs && !link.requestFraming(Framing::Cobs, REPLY_TIMEOUT_MS))
+			throw std::runtime_error("robot didn't switch to COBS framing");
+		if (reliable && !link.requestReliable(true, REPLY_TIMEOUT_MS))
+			throw std::runtime_error("robot didn't turn on the reliable channel");
+		//inject losses only after the link is set up, since the setup packets aren't retransmitted
+		link.setLoss(loss, seed);
+
+		bool ok = true;
+		for (; arg < argc; arg++)
+		{
+			const std::string command = argv[arg];
+			if (command == "version")
+			{
+				sendCommand(link, GET_VERSIONS);
+				ok &= waitForReply(link, VERSION_DATA);
+			}
+			else if (command == "stats")
+			{
+				sendCommand(link, GET_STATS);
+				Packet reply;
+				ok &= receiveReply(link, STATS_DATA, reply);
+				if (ok)
+					printStats(reply);
+			}
+			else if (command == "pause")
+				sendCommand(link, PAUSE);
+			else if (command == "resume")
+				sendCommand(link, RESUME);
+			else if (command == "abort")
+				sendCommand(link, ABORT_TO_MENU);
+			else if (command == "monitor" && arg + 1 < argc)
+			{
+				const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(std::atoi(argv[++arg]));
+				Packet packet;
+				while (true)
+				{
+					const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(end - std::chrono::steady_clock::now()).count();
+					if (remaining <= 0)
+						break;
+					if (link.poll(remaining, packet))
+						printPacket(packet);
+				}
+			}
+			else if (command == "tunables")
+			{
+				for (const Tunable &tunable : readTunables(link))
+				{
+					std::printf("%-26s %8g  range %g to %g, default %g\n", tunable.name.c_str(), tunable.toNumber(tunable.value),
+					            tunable.toNumber(tunable.min), tunable.toNumber(tunable.max), tunable.toNumber(tunable.defaultValue));
+				}
+			}
+			else if (command == "get" && arg + 1 < argc)
+			{
+				const Tunable tunable = findTunable(readTunables(link), argv[++arg]);
+				sendCommand(link, GET_TUNABLE, GetTunable{tunable.id}.encode());
+				Packet reply;
+				ok &= receiveReply(link, TUNABLE_VALUE, reply) && printTunableValue(tunable, reply);
+			}
+			else if (command == "set" && arg + 2 < argc)
+			{
+				const Tunable tunable = findTunable(readTunables(link), argv[++arg]);
+				const int16_t raw = tunable.toRaw(std::strtod(argv[++arg], nullptr));
+				sendCommand(link, SET_TUNABLE, SetTunable{tunable.id, raw}.encode());
+				Packet reply;
+				ok &= receiveReply(link, TUNABLE_VALUE, reply) && printTunableValue(tunable, reply);
+			}
+			else if (command == "telemetry" && arg + 2 < argc)
+			{
+				const unsigned period = std::strtoul(argv[++arg], nullptr, 0);
+				const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(std::atoi(argv[++arg]));
+				sendCommand(link, SET_TELEMETRY, SetTelemetry{(uint16_t)period}.encode());
+
+				TelemetryDecoder decoder;
+				std::vector<TelemetrySample> samples;
+				std::printf("time_ms,inner_ticks,wall_ticks,inner_reading,wall_reading,battery,error\n");
+				Packet packet;
+				while (true)
+				{
+					const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(end - std::chrono::steady_clock::now()).count();
+					if (remaining <= 0)
+						break;
+					if (!link.poll(remaining, packet))
+						continue;
+					if (packet.type != TELEMETRY_DATA)
+					{
+						printPacket(packet);
+						continue;
+					}
+					samples.clear();
+					decoder.decode(packet.data, samples);
+					for (const TelemetrySample &sample : samples)
+					{
+						std::printf("%u,%u,%u,%u,%u,%u,%d\n", sample.timeMs, sample.values[0], sample.values[1], sample.values[2],
+						            sample.values[3], sample.values[4], (int16_t)sample.values[5]);
+					}
+				}
+				sendCommand(link, SET_TELEMETRY, SetTelemetry{0}.encode());
+				std::fprintf(stderr, "telemetry frames lost %u skipped %u\n", decoder.lostFrames(), decoder.skippedFrames());
+			}
+			else if (command == "sync" && arg + 1 < argc)
+			{
+				const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(std::atoi(argv[++arg]));
+				ClockSync clock;
+				TelemetryDecoder decoder;
+				sendCommand(link, SET_LOG_TIMESTAMPS, SetLogTimestamps{1}.encode());
+				auto nextRequest = std::chrono::steady_clock::now();
+				Packet packet;
+				while (true)
+				{
+					const auto now = std::chrono::steady_clock::now();
+					if (now >= end)
+						break;
+					if (now >= nextRequest)
+					{
+						link.send(TIME_SYNC, clock.request());
+						//a quick burst first, so there is an estimate straight away
+						nextRequest = now + std::chrono::milliseconds((clock.exchanges() < 8) ? 20 : 250);
+					}
+					const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(std::min(end, nextRequest) - now).count();
+					if (link.poll(wait, packet) && !clock.handlePacket(packet))
+						printTimedPacket(clock, decoder, packet);
+				}
+				sendCommand(link, SET_LOG_TIMESTAMPS, SetLogTimestamps{0}.encode());
+				std::fprintf(stderr, "clock offset %+.1f us, drift %+.2f ppm, best round trip %lld us, %u exchanges, %u restarts\n",
+				             clock.offsetUs(), clock.driftPpm(), (long long)clock.bestRoundTripUs(), clock.exchanges(), clock.restarts());
+				ok &= clock.synchronized();
+			}
+			else
+			{
+				printUsage();
+				return 2;
+			}
+		}
+
+		if (!flushReliable(link))
+		{
+			std::fprintf(stderr, "some commands were never acknowledged\n");
+			ok = false;
+		}
+
+		const LinkStats &stats = link.stats();
+		std::fprintf(stderr, "baud %u sent %u received %u crc errors %u framing errors %u retransmissions %u duplicates %u injected losses %u\n",
+		             link.baud(), stats.packetsSent, stats.packetsReceived, stats.crcErrors, stats.framingErrors,
+		             stats.retransmissions, stats.duplicates, stats.injectedLosses);
+		close(fd);
+		return ok ? 0 : 1;
+	}
+	catch (const std::exception &e)
+	{
+		std::fprintf(stderr, "robolink: %s\n", e.what());
+		return 1;
+	}
+}
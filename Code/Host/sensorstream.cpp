@@ -0,0 +1,132 @@
+#include "sensorstream.h"
+#include <algorithm>
+
+namespace robolink
+{
+
+//! The length of the sequence, frame number and sample count bytes of a RESP_SAMPLES packet.
+static constexpr std::size_t HEADER_LENGTH = 3;
+
+SensorSubscription::SensorSubscription(RemoteClient &client, uint16_t periodMs, uint8_t analogMask, uint16_t digitalMask,
+                                       std::size_t ringCapacity) :
+	client(client),
+	analogMask(analogMask),
+	digitalMask(digitalMask),
+	ring(std::max<std::size_t>(ringCapacity, 1))
+{
+	unsigned analogCount = 0;
+	for (unsigned i = 0; i < 8; i++)
+		analogCount += (analogMask >> i) & 1;
+	sampleLength = 2 + (analogCount * 10 + 7) / 8 + (digitalMask != 0 ? 2 : 0);
+
+	//install the handler first, so the first packet can't be missed. It ignores packets until the sequence is known.
+	//mutex isn't held while calling the client, since the client calls handlePacket() with its own lock held
+	client.setPacketHandler([this](const Packet &packet) { handlePacket(packet); });
+	const uint8_t subscribeSequence = client.command(CMD_SUBSCRIBE, {(uint8_t)(periodMs >> 8), (uint8_t)periodMs, analogMask,
+	                                                                 (uint8_t)(digitalMask >> 8), (uint8_t)digitalMask});
+	std::lock_guard<std::mutex> lock(mutex);
+	sequence = subscribeSequence;
+	started = true;
+}
+
+SensorSubscription::~SensorSubscription()
+{
+	client.command(CMD_SUBSCRIBE, {0, 0, 0, 0, 0});
+	client.setPacketHandler(nullptr);
+}
+
+std::size_t SensorSubscription::read(std::vector<SensorSample> &samples, std::size_t maxSamples)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	const std::size_t taken = std::min(count, maxSamples);
+	for (std::size_t i = 0; i < taken; i++)
+	{
+		samples.push_back(ring[head]);
+		head = (head + 1) % ring.size();
+	}
+	count -= taken;
+	return taken;
+}
+
+std::size_t SensorSubscription::available() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return count;
+}
+
+SensorStreamStats SensorSubscription::stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return streamStats;
+}
+
+//! Decodes a RESP_SAMPLES packet of this subscription into the ring. Called from the client's background thread.
+void SensorSubscription::handlePacket(const Packet &packet)
+{
+	if (packet.type != RESP_SAMPLES || packet.data.size() < HEADER_LENGTH)
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	//packets from an earlier stream can still be on their way
+	if (!started || packet.data[0] != sequence)
+		return;
+
+	const uint8_t frame = packet.data[1];
+	const std::size_t samples = packet.data[2];
+	if (packet.data.size() != HEADER_LENGTH + samples * sampleLength)
+	{
+		streamStats.malformed++;
+		return;
+	}
+	if (streamStats.packets > 0 && frame != nextFrame)
+		streamStats.lostPackets += (uint8_t)(frame - nextFrame);
+	nextFrame = frame + 1;
+	streamStats.packets++;
+
+	const uint8_t *next = &packet.data[HEADER_LENGTH];
+	for (std::size_t i = 0; i < samples; i++)
+	{
+		SensorSample sample{};
+		const uint16_t time = (uint16_t)((next[0] << 8) | next[1]);
+		if (streamStats.samples > 0)
+			timeMs += (uint16_t)(time - lastTime);
+		lastTime = time;
+		sample.timeMs = timeMs;
+
+		//unpack the 10-bit readings, MSB first
+		const uint8_t *analogBytes = next + 2;
+		unsigned bitOffset = 0;
+		for (unsigned input = 0; input < 8; input++)
+		{
+			if (!(analogMask & (1 << input)))
+				continue;
+			uint16_t reading = 0;
+			for (unsigned bit = 0; bit < 10; bit++, bitOffset++)
+				reading = (uint16_t)((reading << 1) | ((analogBytes[bitOffset / 8] >> (7 - bitOffset % 8)) & 1));
+			sample.analog[input] = reading;
+		}
+		if (digitalMask != 0)
+		{
+			const uint8_t *digitalBytes = next + sampleLength - 2;
+			sample.digital = (uint16_t)((digitalBytes[0] << 8) | digitalBytes[1]);
+		}
+
+		push(sample);
+		streamStats.samples++;
+		next += sampleLength;
+	}
+}
+
+void SensorSubscription::push(const SensorSample &sample)
+{
+	if (count == ring.size())
+	{
+		//overwrite the oldest sample
+		head = (head + 1) % ring.size();
+		count--;
+		streamStats.overwritten++;
+	}
+	ring[(head + count) % ring.size()] = sample;
+	count++;
+}
+
+} // namespace robolink
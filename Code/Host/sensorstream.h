@@ -0,0 +1,82 @@
+/*! @file
+    PC side of the Remote System's sensor stream (Launcher/sensorStream.c): subscribes to a set of inputs,
+    decodes the RESP_SAMPLES packets, and buffers the samples in a ring until they are read.
+ */
+
+#ifndef SENSORSTREAM_H
+#define SENSORSTREAM_H
+
+#include "remoteclient.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace robolink
+{
+
+//! One sample of the subscribed inputs.
+struct SensorSample
+{
+	//! Robot time in milliseconds, unwrapped from the 16 bits sent, counted from the first sample.
+	uint64_t timeMs;
+	//! 10-bit readings, indexed by analog input. Inputs that aren't subscribed are 0.
+	std::array<uint16_t, 8> analog;
+	//! digitalInputs() masked to the subscribed digital inputs.
+	uint16_t digital;
+};
+
+//! Counters kept by a SensorSubscription.
+struct SensorStreamStats
+{
+	unsigned long samples = 0;       //!< Samples decoded.
+	unsigned long packets = 0;       //!< RESP_SAMPLES packets decoded.
+	unsigned long lostPackets = 0;   //!< Gaps in the frame numbers.
+	unsigned long overwritten = 0;   //!< Samples dropped because the ring was full.
+	unsigned long malformed = 0;     //!< Packets whose length didn't match their sample count.
+};
+
+/*! Streams samples from the robot while it exists. Samples are kept in a ring of a fixed capacity;
+ *  when it is full, the oldest samples are overwritten.
+ */
+class SensorSubscription
+{
+public:
+	SensorSubscription(RemoteClient &client, uint16_t periodMs, uint8_t analogMask, uint16_t digitalMask,
+	                   std::size_t ringCapacity = 4096);
+	//! Stops the stream.
+	~SensorSubscription();
+	SensorSubscription(const SensorSubscription &) = delete;
+	SensorSubscription &operator=(const SensorSubscription &) = delete;
+
+	//! Moves up to maxSamples of the oldest samples out of the ring. @return The number of samples appended to samples.
+	std::size_t read(std::vector<SensorSample> &samples, std::size_t maxSamples = SIZE_MAX);
+	std::size_t available() const;
+	SensorStreamStats stats() const;
+
+private:
+	void handlePacket(const Packet &packet);
+	void push(const SensorSample &sample);
+
+	RemoteClient &client;
+	const uint8_t analogMask;
+	const uint16_t digitalMask;
+	std::size_t sampleLength;
+	uint8_t sequence;
+
+	mutable std::mutex mutex;
+	std::vector<SensorSample> ring;
+	std::size_t head = 0;
+	std::size_t count = 0;
+	SensorStreamStats streamStats;
+
+	bool started = false;
+	uint8_t nextFrame = 0;
+	uint16_t lastTime = 0;
+	uint64_t timeMs = 0;
+};
+
+} // namespace robolink
+
+#endif
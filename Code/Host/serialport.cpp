@@ -0,0 +1,121 @@
+#include "serialport.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#ifdef __linux__
+	#include <asm/ioctls.h>
+#endif
+
+namespace robolink
+{
+
+#ifdef __linux__
+//The kernel's termios2, which can't be included alongside <termios.h>. It allows any baud rate with BOTHER.
+struct termios2
+{
+	tcflag_t c_iflag;
+	tcflag_t c_oflag;
+	tcflag_t c_cflag;
+	tcflag_t c_lflag;
+	cc_t c_line;
+	cc_t c_cc[19];
+	speed_t c_ispeed;
+	speed_t c_ospeed;
+};
+#ifndef BOTHER
+	#define BOTHER 0010000
+#endif
+#endif
+
+//! Converts a baud rate to a termios speed constant. @return B0 if there is no constant for the rate.
+static speed_t baudToSpeed(unsigned baud)
+{
+	switch (baud)
+	{
+		case 9600:    return B9600;
+		case 19200:   return B19200;
+		case 38400:   return B38400;
+		case 57600:   return B57600;
+		case 115200:  return B115200;
+		case 230400:  return B230400;
+#ifdef B500000
+		case 500000:  return B500000;
+#endif
+#ifdef B1000000
+		case 1000000: return B1000000;
+#endif
+		default:      return B0;
+	}
+}
+
+//! Throws a std::runtime_error for the last failed system call.
+[[noreturn]] static void throwError(const std::string &what)
+{
+	throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+int openSerialPort(const std::string &path, unsigned baud)
+{
+	int fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0)
+		throwError("can't open " + path);
+
+	try
+	{
+		termios options;
+		if (tcgetattr(fd, &options) != 0)
+			throwError("can't configure " + path);
+		cfmakeraw(&options);
+		options.c_cflag |= CLOCAL | CREAD;
+		options.c_cflag &= ~CSTOPB;
+		if (tcsetattr(fd, TCSANOW, &options) != 0)
+			throwError("can't configure " + path);
+		setSerialBaud(fd, baud);
+	}
+	catch (...)
+	{
+		close(fd);
+		throw;
+	}
+	tcflush(fd, TCIOFLUSH);
+	return fd;
+}
+
+void setSerialBaud(int fd, unsigned baud)
+{
+	//switch only after the last bytes at the old rate have gone out
+	tcdrain(fd);
+
+	const speed_t speed = baudToSpeed(baud);
+	if (speed != B0)
+	{
+		termios options;
+		if (tcgetattr(fd, &options) != 0)
+			throwError("can't get serial settings");
+		cfsetispeed(&options, speed);
+		cfsetospeed(&options, speed);
+		if (tcsetattr(fd, TCSANOW, &options) != 0)
+			throwError("can't set baud rate " + std::to_string(baud));
+		return;
+	}
+
+#ifdef __linux__
+	termios2 options;
+	if (ioctl(fd, TCGETS2, &options) != 0)
+		throwError("can't get serial settings");
+	options.c_cflag &= ~CBAUD;
+	options.c_cflag |= BOTHER;
+	options.c_ispeed = baud;
+	options.c_ospeed = baud;
+	if (ioctl(fd, TCSETS2, &options) != 0)
+		throwError("can't set baud rate " + std::to_string(baud));
+#else
+	throw std::runtime_error("unsupported baud rate " + std::to_string(baud));
+#endif
+}
+
+} // namespace robolink
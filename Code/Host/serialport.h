@@ -0,0 +1,26 @@
+/*! @file
+    Opens serial ports (or ptys) in raw mode for the packet link.
+ */
+
+#ifndef SERIALPORT_H
+#define SERIALPORT_H
+
+#include <string>
+
+namespace robolink
+{
+
+/*! Opens a serial port in raw 8N1 mode at a baud rate, and returns its file descriptor.
+ *  Throws std::runtime_error if the port can't be opened or the baud rate isn't supported.
+ */
+int openSerialPort(const std::string &path, unsigned baud);
+
+/*! Changes the baud rate of an open serial port, after waiting for everything written so far to be sent.
+ *  Rates without a termios constant (such as 250000) use a custom rate on Linux.
+ *  Throws std::runtime_error if the rate can't be set.
+ */
+void setSerialBaud(int fd, unsigned baud);
+
+} // namespace robolink
+
+#endif
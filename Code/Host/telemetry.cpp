@@ -0,0 +1,101 @@
+#include "telemetry.h"
+
+namespace robolink
+{
+
+static constexpr uint8_t TELEMETRY_KEYFRAME = 0x80;
+static constexpr uint8_t TELEMETRY_SAMPLE_COUNT_MASK = 0x7F;
+
+//! Reads a varint. @return false if it runs past the end of the data.
+static bool readVarint(const std::vector<uint8_t> &data, std::size_t &index, uint32_t &value)
+{
+	value = 0;
+	for (unsigned shift = 0; shift < 35; shift += 7)
+	{
+		if (index >= data.size())
+			return false;
+		const uint8_t dataByte = data[index++];
+		value |= (uint32_t)(dataByte & 0x7F) << shift;
+		if (!(dataByte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+bool TelemetryDecoder::decode(const std::vector<uint8_t> &data, std::vector<TelemetrySample> &samples)
+{
+	if (data.size() < 2)
+		return false;
+
+	const bool keyframe = data[0] & TELEMETRY_KEYFRAME;
+	const unsigned count = data[0] & TELEMETRY_SAMPLE_COUNT_MASK;
+	const uint8_t frame = data[1];
+
+	if (synchronized && frame != nextFrame)
+	{
+		lost += (uint8_t)(frame - nextFrame);
+		synchronized = false;
+	}
+	nextFrame = frame + 1;
+	if (!synchronized && !keyframe)
+	{
+		skipped++;
+		return false;
+	}
+
+	std::vector<TelemetrySample> decoded;
+	TelemetrySample sample = last;
+	std::size_t index = 2;
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (i == 0 && keyframe)
+		{
+			if (index + 4 + 2 * numTelemetryChannels > data.size())
+				break;
+			sample.timeMs = ((uint32_t)data[index] << 24) | (data[index + 1] << 16) | (data[index + 2] << 8) | data[index + 3];
+			index += 4;
+			for (uint16_t &value : sample.values)
+			{
+				value = (data[index] << 8) | data[index + 1];
+				index += 2;
+			}
+		}
+		else
+		{
+			uint32_t elapsed;
+			if (!readVarint(data, index, elapsed))
+				break;
+			sample.timeMs += elapsed;
+			bool complete = true;
+			for (uint16_t &value : sample.values)
+			{
+				uint32_t zigzag;
+				if (!readVarint(data, index, zigzag))
+				{
+					complete = false;
+					break;
+				}
+				//undo the zigzag, and apply the change with 16-bit wraparound
+				const int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+				value = (uint16_t)(value + delta);
+			}
+			if (!complete)
+				break;
+		}
+		decoded.push_back(sample);
+	}
+
+	if (decoded.size() != count || index != data.size())
+	{
+		//a malformed packet leaves the deltas that follow it undecodable
+		synchronized = false;
+		skipped++;
+		return false;
+	}
+	synchronized = true;
+	last = sample;
+	samples.insert(samples.end(), decoded.begin(), decoded.end());
+	return true;
+}
+
+} // namespace robolink
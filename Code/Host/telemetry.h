@@ -0,0 +1,51 @@
+/*! @file
+    Decodes the TELEMETRY_DATA packets sent by Launcher/telemetry.c.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "packetlink.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace robolink
+{
+
+//! The number of values in each sample, the same as NUM_TELEMETRY_CHANNELS in telemetry.h.
+static constexpr std::size_t numTelemetryChannels = 6;
+
+//! One decoded telemetry sample.
+struct TelemetrySample
+{
+	uint32_t timeMs;
+	//! In TelemetryChannel order: inner ticks, wall ticks, inner reading, wall reading, battery, encoder error.
+	std::array<uint16_t, numTelemetryChannels> values;
+};
+
+/*! Decodes a stream of TELEMETRY_DATA packets. Deltas can only be decoded from the sample before them,
+ *  so after a lost packet, packets are skipped until the next keyframe.
+ */
+class TelemetryDecoder
+{
+public:
+	/*! Decodes the samples of a TELEMETRY_DATA packet and appends them to samples.
+	 *  @return false if the packet was skipped, because it is malformed or follows a lost packet.
+	 */
+	bool decode(const std::vector<uint8_t> &data, std::vector<TelemetrySample> &samples);
+
+	unsigned lostFrames() const { return lost; }
+	unsigned skippedFrames() const { return skipped; }
+
+private:
+	bool synchronized = false;
+	uint8_t nextFrame = 0;
+	TelemetrySample last = {};
+	unsigned lost = 0;
+	unsigned skipped = 0;
+};
+
+} // namespace robolink
+
+#endif
@@ -0,0 +1,199 @@
+/*! @file
+    Tests the telemetry encoding end to end: the Launcher's telemetry.c (built for the PC, see firmware/hostfirmware.h)
+    samples readings that change in small steps and large jumps, and TelemetryDecoder must give back exactly the same
+    samples, in order. This is checked with every packet delivered, with packets lost on the link (after which the
+    decoder waits for the next keyframe), and with sends that fail because the robot's queue is full (after which the
+    robot starts the next packet with a keyframe).
+
+    usage: telemetrytest [--seconds s] [--period ms] [--seed n]
+
+    Run by "make test".
+ */
+
+#include "firmware/hostfirmware.h"
+#include "telemetry.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace robolink;
+
+//! The getUptimeMs() time telemetry starts at.
+static const uint32_t START_MS = 1000;
+//! The TELEMETRY_DATA flag of a packet that starts with a keyframe, TELEMETRY_KEYFRAME in Launcher/telemetry.h.
+static const uint8_t TELEMETRY_KEYFRAME = 0x80;
+//! Masks the sample count out of the first byte of a TELEMETRY_DATA packet, TELEMETRY_SAMPLE_COUNT_MASK in Launcher/telemetry.h.
+static const uint8_t TELEMETRY_SAMPLE_COUNT_MASK = 0x7F;
+
+static void printUsage()
+{
+	std::fprintf(stderr, "usage: telemetrytest [--seconds s] [--period ms] [--seed n]\n");
+}
+
+//! A packet telemetry.c sent, or tried to.
+struct SentPacket
+{
+	std::vector<uint8_t> data;
+	bool queued;
+};
+
+static std::vector<SentPacket> sentPackets;
+//! The numbers of the sends (counting from 0) to fail, as if the queue were full.
+static std::set<unsigned> queueDrops;
+
+static int takePacket(const uint8_t *data, uint8_t dataLength)
+{
+	const bool queued = (queueDrops.count(sentPackets.size()) == 0);
+	sentPackets.push_back({std::vector<uint8_t>(data, data + dataLength), queued});
+	return queued;
+}
+
+/*! Runs telemetry for a number of milliseconds, with the main loop calling telemetryExec() every millisecond.
+ *  @param readings Filled with the readings at each millisecond from START_MS.
+ */
+static void runTelemetry(unsigned milliseconds, unsigned periodMs, std::mt19937 &random, std::vector<TelemetrySample> &readings)
+{
+	std::uniform_int_distribution<int> steps(-3, 3);
+	std::uniform_int_distribution<unsigned> values(0, 0xFFFF);
+	std::bernoulli_distribution jump(0.02);
+	TelemetrySample reading = {};
+	for (uint16_t &value : reading.values)
+		value = (uint16_t)values(random);
+
+	sentPackets.clear();
+	hostTelemetrySetSink(takePacket);
+	hostClockSet(START_MS * 1000);
+	hostTelemetryStart((uint16_t)periodMs);
+	for (unsigned ms = 0; ms < milliseconds; ms++)
+	{
+		reading.timeMs = START_MS + ms;
+		for (uint16_t &value : reading.values)
+			value = jump(random) ? (uint16_t)values(random) : (uint16_t)(value + steps(random));
+		readings.push_back(reading);
+		hostTelemetrySetReadings(reading.values.data());
+		hostClockSet(reading.timeMs * 1000);
+		hostTelemetryExec();
+	}
+	hostTelemetryStop();
+}
+
+/*! Runs telemetry and decodes what it sends, less the packets lost on the link, and checks that the decoder gives
+ *  back exactly the samples of the packets it could decode. @return true if it did.
+ */
+static bool runCase(const char *name, const std::set<unsigned> &linkDrops, const std::set<unsigned> &failedSends,
+                    unsigned milliseconds, unsigned periodMs, std::mt19937 &random)
+{
+	std::vector<TelemetrySample> readings;
+	queueDrops = failedSends;
+	runTelemetry(milliseconds, periodMs, random, readings);
+
+	//the samples are taken every periodMs from the start, and go into the packets in order
+	TelemetryDecoder decoder;
+	std::vector<TelemetrySample> decoded;
+	std::vector<TelemetrySample> expected;
+	std::size_t nextSample = 0;
+	bool synchronized = false;
+	unsigned expectedLost = 0;
+	unsigned expectedSkipped = 0;
+	for (std::size_t i = 0; i < sentPackets.size(); i++)
+	{
+		const std::vector<uint8_t> &data = sentPackets[i].data;
+		const std::size_t count = data[0] & TELEMETRY_SAMPLE_COUNT_MASK;
+		const bool arrives = sentPackets[i].queued && linkDrops.count(i) == 0;
+		if (!arrives)
+		{
+			expectedLost++;
+			synchronized = false;
+		}
+		else if (!synchronized && !(data[0] & TELEMETRY_KEYFRAME))
+			expectedSkipped++;
+		else
+		{
+			synchronized = true;
+			for (std::size_t sample = nextSample; sample < nextSample + count; sample++)
+				expected.push_back(readings[sample * periodMs]);
+		}
+		nextSample += count;
+		if (arrives)
+			decoder.decode(data, decoded);
+	}
+
+	bool passed = (nextSample == (milliseconds + periodMs - 1) / periodMs);
+	if (!passed)
+		std::fprintf(stderr, "telemetrytest: %s: %zu samples were sent instead of one every %u ms\n", name, nextSample, periodMs);
+	if (decoded.size() != expected.size())
+	{
+		std::fprintf(stderr, "telemetrytest: %s: %zu samples decoded instead of %zu\n", name, decoded.size(), expected.size());
+		passed = false;
+	}
+	for (std::size_t i = 0; passed && i < decoded.size(); i++)
+	{
+		if (decoded[i].timeMs != expected[i].timeMs)
+		{
+			std::fprintf(stderr, "telemetrytest: %s: sample %zu decoded at %u ms instead of %u ms\n",
+			             name, i, decoded[i].timeMs, expected[i].timeMs);
+			passed = false;
+		}
+		else if (decoded[i].values != expected[i].values)
+		{
+			std::fprintf(stderr, "telemetrytest: %s: the sample at %u ms decoded with the wrong values\n", name, decoded[i].timeMs);
+			passed = false;
+		}
+	}
+	if (decoder.lostFrames() != expectedLost || decoder.skippedFrames() != expectedSkipped)
+	{
+		std::fprintf(stderr, "telemetrytest: %s: the decoder counted %u lost and %u skipped packets instead of %u and %u\n",
+		             name, decoder.lostFrames(), decoder.skippedFrames(), expectedLost, expectedSkipped);
+		passed = false;
+	}
+	//after a failed send the robot starts the next packet with a keyframe, so nothing has to be skipped
+	if (linkDrops.empty() && expectedSkipped > 0)
+	{
+		std::fprintf(stderr, "telemetrytest: %s: %u packets had to be skipped\n", name, expectedSkipped);
+		passed = false;
+	}
+
+	std::printf("%-18s %5zu packets, %5zu samples decoded, %u lost and %u skipped packets\n",
+	            name, sentPackets.size(), decoded.size(), decoder.lostFrames(), decoder.skippedFrames());
+	return passed;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned seconds = 10;
+	unsigned periodMs = 2;
+	unsigned seed = 1;
+
+	for (int arg = 1; arg < argc; arg++)
+	{
+		const std::string option = argv[arg];
+		if (option == "--seconds" && arg + 1 < argc)
+			seconds = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--period" && arg + 1 < argc)
+			periodMs = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--seed" && arg + 1 < argc)
+			seed = std::strtoul(argv[++arg], nullptr, 0);
+		else
+		{
+			printUsage();
+			return 2;
+		}
+	}
+	if (seconds == 0 || periodMs == 0 || periodMs > 0xFFFF)
+	{
+		printUsage();
+		return 2;
+	}
+
+	std::mt19937 random(seed);
+	const unsigned milliseconds = seconds * 1000;
+	bool passed = runCase("every packet", {}, {}, milliseconds, periodMs, random);
+	passed &= runCase("lost on the link", {3, 14, 15, 40}, {}, milliseconds, periodMs, random);
+	passed &= runCase("queue full", {}, {5, 22, 23}, milliseconds, periodMs, random);
+
+	std::printf("telemetrytest: %s\n", passed ? "passed" : "FAILED");
+	return passed ? 0 : 1;
+}
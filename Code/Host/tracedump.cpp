@@ -0,0 +1,309 @@
+/*! @file
+    Records the Launcher's interrupts and main loop tasks (see Launcher/traceStream.c) and writes them out as a Chrome
+    trace, which chrome://tracing or ui.perfetto.dev show as a timeline.
+
+    usage: tracedump [--baud rate] [--mask m] [--record] [--seconds s] <device> <out.json>
+
+    By default the robot streams events as they happen for --seconds. With --record it only keeps the latest events in
+    its trace ring, which are dumped at the end: the cost on the robot is lower, but only the last few events are seen.
+    --mask chooses what is traced, a bit for each id in names below (all of them by default). The tick interrupt is
+    always traced, since the clock's wraparounds can only be counted from events at least every 32 ms.
+
+    Interrupts go on one track and main loop tasks on another. Events the robot had to drop are marked on the timeline,
+    and any interrupt or task that was running when they were dropped is left out. A summary of how often each one ran
+    and how long it took is printed at the end.
+
+    The device can be a pty connected to another end of the link, to try the tool without a robot.
+ */
+
+#include "packetlink.h"
+#include "protocol.h"
+#include "serialport.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace robolink;
+
+//The TraceMode values and TRACE_DATA flags, as in Launcher/traceStream.h.
+static constexpr uint8_t TRACE_MODE_OFF = 0;
+static constexpr uint8_t TRACE_MODE_RECORD = 1;
+static constexpr uint8_t TRACE_MODE_STREAM = 2;
+static constexpr uint8_t TRACE_DATA_END = 0x01;
+//! Set in an event's code at the end of an interrupt or task, TRACE_EXIT in XiphosLibrary/trace.h.
+static constexpr uint8_t TRACE_EXIT = 0x80;
+//! The ids below this are interrupts, TRACE_FIRST_TASK in XiphosLibrary/trace.h.
+static constexpr unsigned TRACE_FIRST_TASK = 16;
+//! The bytes of each event in a TRACE_DATA packet.
+static constexpr std::size_t TRACE_EVENT_LENGTH = 4;
+//! The trace clock's ticks per microsecond, FAST_TICKS_PER_US in Launcher/rtc.h.
+static constexpr double TICKS_PER_US = 2.0;
+
+//! How long to wait for a reply, or for the rest of a dump.
+static const int REPLY_TIMEOUT_MS = 1000;
+
+//! The names of the TraceIds in XiphosLibrary/trace.h and the LauncherTraceIds in Launcher/traceStream.h.
+static const std::array<const char *, 32> names = {
+	"ADC", "tick", "servos", "uart0 rx", "uart0 udre", "uart1 rx", "uart1 udre", "motor0 fault",
+	"motor1 fault", "motor pwm", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+	"main loop", "tunables", "program", "packets", "remote", "telemetry", "link bench", "trace stream",
+	"drive comp", "pid", "roboclaw", "feeder", "lcd clock", nullptr, nullptr, nullptr,
+};
+
+//The Chrome trace thread ids of the two tracks.
+static const int INTERRUPT_TRACK = 1;
+static const int TASK_TRACK = 2;
+
+static void printUsage()
+{
+	std::fprintf(stderr, "usage: tracedump [--baud rate] [--mask m] [--record] [--seconds s] <device> <out.json>\n");
+}
+
+static std::string idName(unsigned id)
+{
+	return (id < names.size() && names[id]) ? names[id] : "id " + std::to_string(id);
+}
+
+//! How often one id ran, and for how long.
+struct Summary
+{
+	unsigned count = 0;
+	double totalUs = 0.0;
+	double maxUs = 0.0;
+};
+
+/*! Turns the events of TRACE_DATA packets into Chrome trace events.
+ *  Times are the robot's getUptimeUs(), worked out from the trace clock and when tracing started.
+ */
+class Timeline
+{
+public:
+	//! Adds the events of a TRACE_DATA packet.
+	void add(const TraceData &packet)
+	{
+		if (!started || packet.startUs != startUs || packet.startClock != startClock)
+		{
+			//tracing was started again, so the clock is counted from a new start
+			started = true;
+			startUs = packet.startUs;
+			startClock = packet.startClock;
+			wrapBase = 0;
+			lastClock = startClock;
+			pending.fill(std::nullopt);
+		}
+		if (packet.events.size() % TRACE_EVENT_LENGTH != 0)
+			std::fprintf(stderr, "tracedump: ignoring the partial event at the end of a TRACE_DATA\n");
+
+		if (packet.lost > 0)
+		{
+			//the lost events came before the ones in this packet
+			const double time = (packet.events.size() >= TRACE_EVENT_LENGTH) ? eventTime(packet.events.data()) : lastUs;
+			addEvent("{\"name\":\"lost " + std::to_string(packet.lost) + " events\",\"ph\":\"i\",\"s\":\"p\",\"pid\":1,\"tid\":"
+			         + std::to_string(INTERRUPT_TRACK) + ",\"ts\":" + formatUs(time) + "}");
+			lostEvents += packet.lost;
+			pending.fill(std::nullopt);
+		}
+
+		for (std::size_t i = 0; i + TRACE_EVENT_LENGTH <= packet.events.size(); i += TRACE_EVENT_LENGTH)
+		{
+			const uint8_t code = packet.events[i];
+			const unsigned id = code & ~TRACE_EXIT;
+			const double time = eventTime(&packet.events[i]);
+			if (id >= pending.size())
+				continue;
+			if (!firstUs)
+				firstUs = time;
+			lastUs = time;
+			events++;
+
+			if (!(code & TRACE_EXIT))
+			{
+				pending[id] = time;
+				continue;
+			}
+			//an exit without its start began before tracing did, or while events were being lost
+			if (!pending[id])
+				continue;
+			const double duration = time - *pending[id];
+			addEvent("{\"name\":\"" + idName(id) + "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+			         + std::to_string(id < TRACE_FIRST_TASK ? INTERRUPT_TRACK : TASK_TRACK)
+			         + ",\"ts\":" + formatUs(*pending[id]) + ",\"dur\":" + formatUs(duration) + "}");
+			Summary &summary = summaries[id];
+			summary.count++;
+			summary.totalUs += duration;
+			summary.maxUs = std::max(summary.maxUs, duration);
+			pending[id] = std::nullopt;
+		}
+	}
+
+	//! Writes the Chrome trace JSON file.
+	void write(const std::string &path) const
+	{
+		FILE *file = std::fopen(path.c_str(), "w");
+		if (!file)
+			throw std::runtime_error("can't write " + path);
+		std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+		std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Launcher\"}},\n");
+		std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"interrupts\"}},\n", INTERRUPT_TRACK);
+		std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"main loop\"}}", TASK_TRACK);
+		for (const std::string &event : traceEvents)
+			std::fprintf(file, ",\n%s", event.c_str());
+		std::fprintf(file, "\n]}\n");
+		if (std::fclose(file) != 0)
+			throw std::runtime_error("can't write " + path);
+	}
+
+	//! Prints how often each id ran, how long it took, and its share of the traced time.
+	void printSummary() const
+	{
+		const double spanUs = firstUs ? lastUs - *firstUs : 0.0;
+		std::printf("%u events over %.1f ms, %u lost\n", events, spanUs / 1000.0, lostEvents);
+		std::printf("%-14s %8s %12s %10s %10s %7s\n", "", "count", "total us", "mean us", "max us", "time");
+		for (std::size_t id = 0; id < summaries.size(); id++)
+		{
+			const Summary &summary = summaries[id];
+			if (summary.count == 0)
+				continue;
+			std::printf("%-14s %8u %12.1f %10.1f %10.1f %6.2f%%\n", idName(id).c_str(), summary.count, summary.totalUs,
+			            summary.totalUs / summary.count, summary.maxUs, (spanUs > 0.0) ? summary.totalUs * 100.0 / spanUs : 0.0);
+		}
+	}
+
+private:
+	/*! Works out the time of an event in microseconds. The wraparound count and the clock make a 24-bit count, which
+	 *  is unwrapped in turn by noticing when it goes backwards.
+	 */
+	double eventTime(const uint8_t *event)
+	{
+		const uint32_t clock = ((uint32_t)event[1] << 16) | ((uint32_t)event[2] << 8) | event[3];
+		if (clock < lastClock)
+			wrapBase += 1 << 24;
+		lastClock = clock;
+		return startUs + (wrapBase + clock - startClock) / TICKS_PER_US;
+	}
+
+	static std::string formatUs(double us)
+	{
+		char text[32];
+		std::snprintf(text, sizeof(text), "%.1f", us);
+		return text;
+	}
+
+	void addEvent(std::string event)
+	{
+		traceEvents.push_back(std::move(event));
+	}
+
+	bool started = false;
+	uint32_t startUs = 0;
+	uint16_t startClock = 0;
+	uint64_t wrapBase = 0;
+	uint32_t lastClock = 0;
+	//! The start time of each id that is running.
+	std::array<std::optional<double>, 32> pending;
+	std::array<Summary, 32> summaries;
+	std::optional<double> firstUs;
+	double lastUs = 0.0;
+	unsigned events = 0;
+	unsigned lostEvents = 0;
+	std::vector<std::string> traceEvents;
+};
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//! Takes packets for a number of milliseconds, adding any TRACE_DATA to the timeline. @return true if a dump ended.
+static bool collect(PacketLink &link, Timeline &timeline, double ms)
+{
+	const auto start = std::chrono::steady_clock::now();
+	Packet packet;
+	while (true)
+	{
+		const int remaining = (int)(ms - millisecondsSince(start));
+		if (remaining <= 0 || !link.poll(remaining, packet))
+			return false;
+		if (packet.type != TRACE_DATA)
+			continue;
+		const TraceData data = TraceData::decode(packet.data);
+		timeline.add(data);
+		if (data.flags & TRACE_DATA_END)
+			return true;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned baud = 38400;
+	uint32_t mask = 0xFFFFFFFF;
+	bool record = false;
+	double seconds = 5.0;
+
+	int arg = 1;
+	for (; arg < argc && std::strncmp(argv[arg], "--", 2) == 0; arg++)
+	{
+		const std::string option = argv[arg];
+		if (option == "--record")
+			record = true;
+		else if (option == "--baud" && arg + 1 < argc)
+			baud = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--mask" && arg + 1 < argc)
+			mask = std::strtoul(argv[++arg], nullptr, 0);
+		else if (option == "--seconds" && arg + 1 < argc)
+			seconds = std::strtod(argv[++arg], nullptr);
+		else
+		{
+			printUsage();
+			return 2;
+		}
+	}
+	if (arg + 2 != argc)
+	{
+		printUsage();
+		return 2;
+	}
+	const std::string outPath = argv[arg + 1];
+
+	try
+	{
+		const int fd = openSerialPort(argv[arg], baud);
+		PacketLink link(fd);
+		link.setBaudSetter(baud, [fd](unsigned newBaud) { setSerialBaud(fd, newBaud); });
+
+		Timeline timeline;
+		link.send(SET_TRACE, SetTrace{record ? TRACE_MODE_RECORD : TRACE_MODE_STREAM, mask}.encode());
+		collect(link, timeline, seconds * 1000.0);
+		if (record)
+		{
+			link.send(DUMP_TRACE);
+			if (!collect(link, timeline, REPLY_TIMEOUT_MS))
+				std::fprintf(stderr, "tracedump: the end of the dump never came\n");
+		}
+		else
+		{
+			link.send(SET_TRACE, SetTrace{TRACE_MODE_OFF, 0}.encode());
+			//take what was already on its way
+			collect(link, timeline, 100);
+		}
+		close(fd);
+
+		timeline.write(outPath);
+		timeline.printSummary();
+		return 0;
+	}
+	catch (const std::exception &e)
+	{
+		std::fprintf(stderr, "tracedump: %s\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,108 @@
+/*! @file
+    Runs the ADC in the background, converting a set of analog inputs one after another with the ADC interrupt.
+    The latest 10-bit reading of each input in the scan is kept in adcReadings, so reading a sensor never waits
+    for a conversion. Each input in the scan is read every 104 us times the number of inputs in the scan.
+    The ADC interrupt itself is in main.c, since it also runs the wheel encoder logic; it calls adcScanNext()
+    after every conversion.
+ */
+#include "adcScan.h"
+#include "utility.h"
+#include <avr/io.h>
+#include <util/atomic.h>
+
+//! The latest 10-bit reading of each analog input in the scan, updated by the ADC interrupt.
+volatile u16 adcReadings[NUM_ANALOG_INPUTS];
+
+//! The time one conversion takes, in microseconds (13 ADC clocks at 125 kHz, see ADC.c).
+#define ADC_CONVERSION_US 104
+
+//! One bit per analog input, set for the inputs in the scan.
+static volatile u08 scanMask;
+
+/*! Starts converting a set of analog inputs in the background. Enables the ADC interrupt.
+    @param channelMask One bit per analog input. Must not be 0.
+ */
+void adcScanStart(const u08 channelMask)
+{
+	scanMask = channelMask;
+	u08 first = 0;
+	while (!(channelMask & _BV(first)))
+		first++;
+
+	//enable the ADC interrupt
+	ADCSRA |= _BV(ADIE);
+	//set ADC right shifting (for 10-bit ADC reading), and select the first input to read
+	ADMUX = _BV(REFS0) | first;
+	ADCSRA |= _BV(ADSC);
+}
+
+//! Adds analog inputs to the scan. They are first read within one pass through the scan.
+void adcScanAdd(const u08 channelMask)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		scanMask |= channelMask;
+	}
+}
+
+//! Removes analog inputs from the scan. The inputs passed to adcScanStart() should stay in the scan.
+void adcScanRemove(const u08 channelMask)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		//never leave the scan empty
+		if ((scanMask & ~channelMask) != 0)
+			scanMask &= ~channelMask;
+	}
+}
+
+/*! Stores a conversion result and picks the next input in the scan. Called from the ADC interrupt.
+    @param channel The input that was just converted.
+    @return The next input to convert.
+ */
+u08 adcScanNext(const u08 channel, const u16 reading)
+{
+	adcReadings[channel] = reading;
+	u08 next = channel;
+	do
+	{
+		next = (next + 1) & (NUM_ANALOG_INPUTS - 1);
+	} while (!(scanMask & _BV(next)) && next != channel);
+	return next;
+}
+
+//! Gets the inputs in the scan, one bit per analog input.
+u08 adcScanChannels()
+{
+	return scanMask;
+}
+
+//! Gets the latest reading of an analog input in the scan.
+u16 adcScanRead(const u08 channel)
+{
+	u16 reading;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		reading = adcReadings[channel & (NUM_ANALOG_INPUTS - 1)];
+	}
+	return reading;
+}
+
+/*! Gets the latest reading of any analog input, adding it to the scan first if it isn't in it yet. This replaces
+    analog10() while the scan is running, since a conversion started outside the scan would upset it.
+    An input added here stays in the scan, and its first reading is waited for.
+    @return The 10-bit reading, or 0xBAD if an invalid input number was passed, like analog10().
+ */
+u16 adcScanReadAny(const u08 channel)
+{
+	if (channel >= NUM_ANALOG_INPUTS)
+		return 0x0BAD;
+
+	if (!(scanMask & _BV(channel)))
+	{
+		adcScanAdd(_BV(channel));
+		//the conversion in progress, then up to a whole pass through the scan before the new input is converted
+		delayUs(ADC_CONVERSION_US * (NUM_ANALOG_INPUTS + 1));
+	}
+	return adcScanRead(channel);
+}
@@ -0,0 +1,19 @@
+#ifndef ADCSCAN_H
+#define ADCSCAN_H
+
+#include "globals.h"
+
+//! The number of single-ended analog inputs.
+#define NUM_ANALOG_INPUTS 8
+
+extern volatile u16 adcReadings[NUM_ANALOG_INPUTS];
+
+void adcScanStart(const u08 channelMask);
+void adcScanAdd(const u08 channelMask);
+void adcScanRemove(const u08 channelMask);
+u08 adcScanNext(const u08 channel, const u16 reading);
+u16 adcScanRead(const u08 channel);
+u16 adcScanReadAny(const u08 channel);
+u08 adcScanChannels();
+
+#endif
@@ -8,7 +8,6 @@
 #include "motors.h"
 #include "packetprotocol.h"
 #include "rtc.h"
-#include "serial.h"
 #include "servos.h"
 #include "util.h"
 #include "utility.h"
@@ -78,7 +77,7 @@ void compLeftExec()
 				else
 				{
 					stop();
-					delayMs(2000);
+					waitMs(2000);
 					resetEncoders();
 				}
 			}
@@ -108,7 +107,7 @@ void compLeftExec()
 				stop();
 				clearScreen();
 				printString_P(PSTR("Waiting 4 reload"));
-				delayMs(10000);
+				waitMs(10000);
 
 				compCollectFwd();
 				startTimeSecs = secCount;
@@ -121,7 +120,7 @@ void compLeftExec()
 			break;
 
 		case COMP_DONE:
-			buttonWait();
+			//the run is over. Idle instead of blocking in buttonWait(), so the PC can still inspect the robot.
 			break;
 	}
 } // End competition
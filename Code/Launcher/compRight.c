@@ -8,7 +8,6 @@
 #include "motors.h"
 #include "packetprotocol.h"
 #include "rtc.h"
-#include "serial.h"
 #include "servos.h"
 #include "util.h"
 #include "utility.h"
@@ -73,7 +72,7 @@ void compRightExec()
 			//drive until either side wall switches hit
 			if (PRESSED(dRearSide) || PRESSED(dFrontSide))
 			{
-				delayMs(500);
+				waitMs(500);
 				//pidStop = TRUE;
 				compTurnLeft();
 				startTimeSecs = secCount;
@@ -119,7 +118,7 @@ void compRightExec()
 				else
 				{
 					stop();
-					delayMs(2000);
+					waitMs(2000);
 
 					resetEncoders();
 				}
@@ -170,7 +169,7 @@ void compRightExec()
 			break;
 
 		case COMP_DONE:
-			buttonWait();
+			//the run is over. Idle instead of blocking in buttonWait(), so the PC can still inspect the robot.
 			break;
 	}
 } // End competition
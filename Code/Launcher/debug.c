@@ -1,13 +1,22 @@
 #include "debug.h"
 #include "launcherPackets.h"
 #include "packetprotocol.h"
-#include "serial.h"
+#include "protocol.h"
+#include "rtc.h"
+#include <avr/pgmspace.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+//! The length of the time added to the end of each log packet while timestamps are on.
+#define LOG_TIMESTAMP_LENGTH 4
+
+//! Whether log packets end with the time they were logged at. Set with ::SET_LOG_TIMESTAMPS.
+static bool logTimestamps = FALSE;
+
 //Local prototypes
-static void sendLog(const DownlinkPacketType packetType, const char *messageFormat, const va_list args);
+static u08 addTimestamp(u08 *buffer, const u32 time);
+static void sendLog(const DownlinkPacketType packetType, const PacketPriority priority, const char *messageFormat, const va_list args);
 
 //! Configures the UART to send logs to.
 void debugInit()
@@ -15,12 +24,33 @@ void debugInit()
 
 }
 
+//! Turns the timestamps at the end of log packets on or off, see ::DEBUG_LOG.
+void debugSetTimestamps(const bool enabled)
+{
+	logTimestamps = enabled;
+}
+
+/*! Adds the time at the end of a log packet, if timestamps are on.
+ *  @param buffer Where the time goes, with room for ::LOG_TIMESTAMP_LENGTH bytes.
+ *  @return The number of bytes added.
+ */
+static u08 addTimestamp(u08 *buffer, const u32 time)
+{
+	if (!logTimestamps)
+		return 0;
+	buffer[0] = (u08)(time >> 24);
+	buffer[1] = (u08)(time >> 16);
+	buffer[2] = (u08)(time >> 8);
+	buffer[3] = (u08)time;
+	return LOG_TIMESTAMP_LENGTH;
+}
+
 //! Logs information that is merely for debugging.
 void logDebug(const char *messageFormat, ...)
 {
 	va_list args;
 	va_start(args, messageFormat);
-	sendLog(DEBUG_LOG, messageFormat, args);
+	sendLog(DEBUG_LOG, PACKET_PRIORITY_DEBUG, messageFormat, args);
 	va_end(args);
 }
 
@@ -29,7 +59,7 @@ void logWarning(const char *messageFormat, ...)
 {
 	va_list args;
 	va_start(args, messageFormat);
-	sendLog(WARNING_LOG, messageFormat, args);
+	sendLog(WARNING_LOG, PACKET_PRIORITY_FAULT, messageFormat, args);
 	va_end(args);
 }
 
@@ -38,29 +68,39 @@ void logCritical(const char *messageFormat, ...)
 {
 	va_list args;
 	va_start(args, messageFormat);
-	sendLog(CRITICAL_LOG, messageFormat, args);
+	sendLog(CRITICAL_LOG, PACKET_PRIORITY_FAULT, messageFormat, args);
 	va_end(args);
 }
 
 /*! Transmits a log message as a packet over a UART.
- *  @param
+ *  @param priority The ::PacketPriority to queue the packet at, so long debug logs never delay more important packets.
  */
-static void sendLog(const DownlinkPacketType packetType, const char *messageFormat, const va_list args)
+static void sendLog(const DownlinkPacketType packetType, const PacketPriority priority, const char *messageFormat, const va_list args)
 {
+	//taken before formatting, which can take a while
+	const u32 time = getUptimeUs();
 	u08 buffer[MAX_PACKET_DATA];
+	const u08 maxLength = logTimestamps ? sizeof buffer - LOG_TIMESTAMP_LENGTH : sizeof buffer;
 	//returns the number of characters printed or that should have printed (not counting null)
-	int numChars = vsnprintf((char *)buffer, sizeof buffer, messageFormat, args);
-	sendPacket(packetType, buffer, numChars + 1);
+	int numChars = vsnprintf((char *)buffer, maxLength, messageFormat, args);
+	//a message that didn't fit was truncated, and is still null terminated
+	if (numChars > maxLength - 1)
+		numChars = maxLength - 1;
+	u08 length = numChars + 1;
+	length += addTimestamp(&buffer[length], time);
+	sendPacketPriority(priority, packetType, buffer, length);
 }
 
 /*! Logs a software fault - indicates a software bug. Typically used via the SOFTWARE_FAULT macro.
- *  @param filename The name of the source file where the bug is.
+ *  @param filename The name of the source file where the bug is, in program space.
  *  @param lineNumber The line number in the source file where the bug is.
- *  @param message The error message to print out.
+ *  @param message The error message to print out, in program space (use PSTR()).
  */
 void logSoftwareFault(const char *filename, u16 lineNumber, const char *message, u16 arg1, u16 arg2)
 {
+	const u32 time = getUptimeUs();
 	u08 buffer[MAX_PACKET_DATA];
+	const u08 maxLength = logTimestamps ? sizeof buffer - LOG_TIMESTAMP_LENGTH : sizeof buffer;
 	buffer[0] = (u08)(lineNumber >> 8);
 	buffer[1] = (u08)lineNumber;
 	buffer[2] = (u08)(arg1 >> 8);
@@ -71,20 +111,21 @@ void logSoftwareFault(const char *filename, u16 lineNumber, const char *message,
 	u08 index = 6;
 	u08 i;
 	//copy up to 20 filename characters into buffer
-	for (i = 0; (i < 20) && (filename[i] != 0); i++)
+	for (i = 0; (i < 20) && (pgm_read_byte(&filename[i]) != 0); i++)
 	{
-		buffer[index++] = filename[i];
+		buffer[index++] = pgm_read_byte(&filename[i]);
 	}
 	//null terminate the filename
 	buffer[index++] = '\0';
 
 	//copy message characters into buffer up to max allowed
-	for (i = 0; (index < MAX_PACKET_DATA - 1) && (message[i] != 0); i++)
+	for (i = 0; (index < maxLength - 1) && (pgm_read_byte(&message[i]) != 0); i++)
 	{
-		buffer[index++] = filename[i];
+		buffer[index++] = pgm_read_byte(&message[i]);
 	}
 	//null terminate the message
 	buffer[index++] = '\0';
+	index += addTimestamp(&buffer[index], time);
 
-	sendPacket(SW_FAULT, buffer, index);
+	sendPacketPriority(PACKET_PRIORITY_FAULT, SW_FAULT, buffer, index);
 }
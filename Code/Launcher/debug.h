@@ -4,14 +4,29 @@
 #include "globals.h"
 #include <avr/pgmspace.h>
 
+/*! Set to 0 with -D in the DEFINES of the project Makefile to compile out every log call along with its strings,
+ *  for a program without debug.c that has no room for them, such as the bootloader.
+ */
+#ifndef DEBUG_LOGS
+	#define DEBUG_LOGS 1
+#endif
+
+#if DEBUG_LOGS
 //Prototypes
 void debugInit();
+void debugSetTimestamps(const bool enabled);
 void logDebug(const char *messageFormat, ...);
 void logWarning(const char *messageFormat, ...);
 void logCritical(const char *messageFormat, ...);
 void logSoftwareFault(const char *filename, u16 lineNumber, const char *message, u16 arg1, u16 arg2);
 
-//! Macro to log/print a software fault. It stores its strings in flash instead of SRAM to save memory.
+//! Macro to log/print a software fault. It stores its strings in flash instead of SRAM to save memory, so msg must be a PSTR().
 #define SOFTWARE_FAULT(msg, arg1, arg2) logSoftwareFault(PSTR(__FILE__), __LINE__, (msg), (arg1), (arg2))
+#else
+#define logDebug(...) do {} while (0)
+#define logWarning(...) do {} while (0)
+#define logCritical(...) do {} while (0)
+#define SOFTWARE_FAULT(msg, arg1, arg2) do {} while (0)
+#endif
 
 #endif
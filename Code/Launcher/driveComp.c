@@ -0,0 +1,113 @@
+/*! @file
+    Compensates drive motor commands for the motor deadband and the motor battery voltage,
+    so a given drive speed gives about the same wheel speed throughout a match.
+ */
+#include "driveComp.h"
+
+#include "main.h"
+#include "motors.h"
+
+#include <util/atomic.h>
+
+//! Converts a motor battery voltage (in milliVolts) to the ADC reading expected from the battery voltage divider.
+#define MOTOR_BATTERY_MV_TO_READING(mv) ((u16)((u32)(mv) * RESISTOR_BATTERY_LOWER / (RESISTOR_BATTERY_LOWER + RESISTOR_BATTERY_UPPER) \
+                                         * NUM_ADC10_VALUES / (AREF_VOLTAGE * 1000)))
+
+//! The battery reading the drive speeds were tuned at. Commands are scaled by this reading divided by the present reading.
+#define NOMINAL_READING MOTOR_BATTERY_MV_TO_READING(MOTOR_BATTERY_VOLTAGE_NOMINAL)
+//! Below this reading the motor battery is assumed to be disconnected (e.g. running from USB power), so no scaling is applied.
+#define MIN_VALID_READING MOTOR_BATTERY_MV_TO_READING(MOTOR_BATTERY_VOLTAGE_CUTOFF / 2)
+
+//! Battery scale factors are in Q8 fixed point (256 = 1.0).
+#define SCALE_ONE 256
+//! The smallest battery scale factor, applied with a fully charged pack.
+#define SCALE_MIN (SCALE_ONE * 3 / 4)
+//! The largest battery scale factor, which limits how hard a nearly flat pack is pushed.
+#define SCALE_MAX (SCALE_ONE * 3 / 2)
+
+//! The battery reading filter keeps 4 extra bits of resolution.
+#define FILTER_SHIFT 4
+//! The filter moves 1/2^FILTER_GAIN_SHIFT of the way to each new reading, smoothing out sag from motor current spikes.
+#define FILTER_GAIN_SHIFT 4
+
+/*! The smallest duty cycle that turns each drive motor, as a percentage of full duty cycle, indexed by
+    ::DriveMotor and then by direction (forward, reverse).
+    These are initial estimates, not measurements. Calibrate them on the ground with the robot fully loaded, by raising
+    the duty cycle from 0 until each wheel just keeps turning, before relying on slow speeds.
+ */
+static const u08 deadbandPercent[2][2] =
+{
+	{ 9, 10 }, //DRIVE_INNER_MOTOR
+	{ 8,  9 }  //DRIVE_WALL_MOTOR
+};
+
+//! The filtered battery reading, left shifted by ::FILTER_SHIFT, or 0 before the first valid reading.
+static u16 filteredReading = 0;
+//! The current battery scale factor in Q8 fixed point.
+static u16 batteryScale = SCALE_ONE;
+
+/*! Updates the battery scale factor from the latest battery reading.
+    Should be called regularly from the main loop.
+ */
+void driveCompExec()
+{
+	u16 reading;
+	ATOMIC_BLOCK(ATOMIC_FORCEON)
+	{
+		reading = batteryReading;
+	}
+
+	if (reading < MIN_VALID_READING)
+	{
+		//no motor battery, so drive without scaling and restart the filter when the battery returns
+		filteredReading = 0;
+		batteryScale = SCALE_ONE;
+		return;
+	}
+
+	if (filteredReading == 0)
+	{
+		filteredReading = reading << FILTER_SHIFT;
+	}
+	else
+	{
+		filteredReading += ((s16)((reading << FILTER_SHIFT) - filteredReading)) >> FILTER_GAIN_SHIFT;
+	}
+
+	u32 scale = ((u32)NOMINAL_READING << (8 + FILTER_SHIFT)) / filteredReading;
+	if (scale < SCALE_MIN)
+		scale = SCALE_MIN;
+	else if (scale > SCALE_MAX)
+		scale = SCALE_MAX;
+	batteryScale = (u16)scale;
+}
+
+/*! Compensates a drive motor speed for the motor deadband and the battery voltage.
+    The nonzero speed range is mapped onto the duty cycles above the deadband, then scaled by nominal / present battery voltage.
+    @param motor The drive motor the speed is for.
+    @param motorSpeed The requested speed, from -MOTOR_SPEED_MAX to MOTOR_SPEED_MAX. 0 still means glide to a stop.
+    @return The speed to pass to motor0() or motor1().
+ */
+s16 compensateDriveSpeed(const DriveMotor motor, const s16 motorSpeed)
+{
+	if (motorSpeed == 0)
+		return 0;
+
+	const bool reverse = (motorSpeed < 0);
+	u32 magnitude = reverse ? -motorSpeed : motorSpeed;
+	const u16 deadband = (u16)((u32)MOTOR_SPEED_MAX * deadbandPercent[motor][reverse] / 100);
+
+	//map 1..MOTOR_SPEED_MAX onto deadband..MOTOR_SPEED_MAX, then apply the battery scale factor
+	magnitude = deadband + magnitude * (MOTOR_SPEED_MAX - deadband) / MOTOR_SPEED_MAX;
+	magnitude = (magnitude * batteryScale) >> 8;
+	if (magnitude > MOTOR_SPEED_MAX)
+		magnitude = MOTOR_SPEED_MAX;
+
+	return reverse ? -(s16)magnitude : (s16)magnitude;
+}
+
+//! Gets the current battery scale factor in Q8 fixed point (256 = no scaling), for display and debugging.
+u16 getDriveBatteryScale()
+{
+	return batteryScale;
+}
@@ -0,0 +1,17 @@
+#ifndef DRIVECOMP_H
+#define DRIVECOMP_H
+
+#include "globals.h"
+
+//! Indexes the drive compensation tables by motor channel.
+typedef enum
+{
+	DRIVE_INNER_MOTOR = 0, //!< The inside drive motor, on motor0.
+	DRIVE_WALL_MOTOR  = 1  //!< The wall drive motor, on motor1.
+} DriveMotor;
+
+void driveCompExec();
+s16 compensateDriveSpeed(const DriveMotor motor, const s16 motorSpeed);
+u16 getDriveBatteryScale();
+
+#endif
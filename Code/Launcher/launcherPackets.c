@@ -1,36 +1,59 @@
+#include "../Bootloader/bootloader.h"
 #include "debug.h"
 #include "launcherPackets.h"
 #include "LCD.h"
+#include "linkBench.h"
 #include "main.h"
+#include "motors.h"
 #include "packetprotocol.h"
+#include "remoteControl.h"
+#include "rtc.h"
+#include "telemetry.h"
+#include "traceStream.h"
+#include "tunables.h"
+#include "uart.h"
 #include <avr/version.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
 #include <stddef.h>
 
 //! The version string returned by the ::GET_VERSIONS command. Should be stored in program space.
 #define VERSION_STRING (LAUNCHER_FIRMWARE_VERSION "|" __TIMESTAMP__ "|" __AVR_LIBC_VERSION_STRING__ "|" __AVR_LIBC_DATE_STRING__)
 
+//! The number of uplink packet types: the Remote System's Commands, then the Launcher's own packets.
+#define NUM_UPLINK_TYPES (NUM_CMD + LAST_UplinkPacketType - LAUNCHER_UPLINK_FIRST)
+//! How many packets of each uplink type have been received, indexed by uplinkIndex(). Reported in STATS_DATA.
+static u16 packetCounts[NUM_UPLINK_TYPES];
+
 //Local Prototypes
+static u08 uplinkIndex(const u08 packetType);
+static u08 uplinkType(const u08 index);
 static void sendVersionData();
 static void sendStats();
+static void sendTunableInfo(const u08 id);
+static void sendTunableValue(const u08 id, const TunableStatus status);
+static void sendTimeSyncReply(const u32 originate, const u32 receiveUs);
+static void enterBootloader();
 
+//! Checks the dataLength of a packet from the PC: either a Launcher packet or a Remote System command.
 bool validateLauncherPacket(const u08 packetType, const u08 dataLength)
 {
-	switch (packetType)
-	{
-		case GET_VERSIONS:
-		case PAUSE:
-		case RESUME:
-		case ABORT_TO_MENU:
-		case GET_STATS:
-			return (dataLength == 0);
-		default:
-			SOFTWARE_FAULT("invalid packetType", packetType, dataLength);
-			return FALSE;
-	}
+	//one table, generated from Protocol/packets.schema, covers both
+	return protocolUplinkLengthValid(packetType, dataLength);
 }
 
-void execLauncherPacket(const u08 packetType, const u08 * const data, const u08 dataLength)
+//! Handles a packet from the PC. Remote System commands are passed on to the Remote System, whatever the mode.
+void execLauncherPacket(const u08 packetType, const u08 sequence, const u08 * const data, const u08 dataLength)
 {
+	//the validator has already rejected the types in between the two ranges
+	packetCounts[uplinkIndex(packetType)]++;
+
+	if (packetType < NUM_CMD)
+	{
+		remoteSystemExecutor(packetType, sequence, data, dataLength);
+		return;
+	}
+
 	switch (packetType)
 	{
 		case GET_VERSIONS:
@@ -48,18 +71,58 @@ void execLauncherPacket(const u08 packetType, const u08 * const data, const u08
 		case GET_STATS:
 			sendStats();
 			break;
+		case SET_TELEMETRY:
+			telemetryStart(SET_TELEMETRY_periodMs(data));
+			break;
+		case GET_TUNABLE_INFO:
+			sendTunableInfo(GET_TUNABLE_INFO_id(data));
+			break;
+		case GET_TUNABLE:
+			sendTunableValue(GET_TUNABLE_id(data), (GET_TUNABLE_id(data) < NUM_TUNABLES) ? TUNABLE_OK : TUNABLE_UNKNOWN);
+			break;
+		case SET_TUNABLE:
+			sendTunableValue(SET_TUNABLE_id(data), tunableSet(SET_TUNABLE_id(data), SET_TUNABLE_value(data)));
+			break;
+		case PING_REQUEST:
+			sendPacket(PING_REPLY, PING_REQUEST_payload(data), PING_REQUEST_payloadLength(dataLength));
+			break;
+		case BULK_SINK:
+			linkBenchSink(BULK_SINK_payloadLength(dataLength));
+			break;
+		case BULK_SOURCE:
+			linkBenchSourceStart(BULK_SOURCE_count(data), BULK_SOURCE_patternLength(data));
+			break;
+		case GET_LINK_REPORT:
+			linkBenchReport();
+			break;
+		case TIME_SYNC:
+			sendTimeSyncReply(TIME_SYNC_originate(data), getUptimeUs());
+			break;
+		case SET_LOG_TIMESTAMPS:
+			debugSetTimestamps(SET_LOG_TIMESTAMPS_enabled(data) != 0);
+			break;
+		case ENTER_BOOTLOADER:
+			enterBootloader();
+			break;
+		case SET_TRACE:
+			traceStreamSet(SET_TRACE_mode(data), SET_TRACE_mask(data));
+			break;
+		case DUMP_TRACE:
+			traceStreamDump();
+			break;
 		default:
 			lowerLine();
 			printString("Unknown Pkt: ");
 			printHex_u08(packetType);
-			SOFTWARE_FAULT("Unknown Pkt", packetType, dataLength);
+			SOFTWARE_FAULT(PSTR("Unknown Pkt"), packetType, dataLength);
 			break;
 	}
 }
 
 void sendBootNotification(u08 resetCause)
 {
-	sendPacket(BOOTED_UP, &resetCause, 1);
+	u08 data[1];
+	sendPacket(BOOTED_UP, data, BOOTED_UP_encode(data, resetCause));
 }
 
 static void sendVersionData()
@@ -72,12 +135,91 @@ static void sendVersionData()
 	sendPacket(VERSION_DATA, (u08 *)buffer, sizeof(buffer));
 }
 
+//! Maps the two ranges of uplink packet types onto one range of indexes, from 0 to ::NUM_UPLINK_TYPES - 1.
+static u08 uplinkIndex(const u08 packetType)
+{
+	return (packetType < NUM_CMD) ? packetType : NUM_CMD + packetType - LAUNCHER_UPLINK_FIRST;
+}
+
+//! The opposite of uplinkIndex().
+static u08 uplinkType(const u08 index)
+{
+	return (index < NUM_CMD) ? index : index - NUM_CMD + LAUNCHER_UPLINK_FIRST;
+}
+
 static void sendStats()
 {
-	//assemble the data section of the STATS_DATA packet
-	u08 statsData[2];
-	statsData[0] = (u08)(bufferOverfilledCounter >> 8);
-	statsData[1] = (u08)bufferOverfilledCounter;
+	//the layout of the STATS_DATA packet is in Protocol/packets.schema
+	UartStats uartStats;
+	uartGetStats(UART_PORT0, &uartStats);
+	u32 faultTimes[2];
+	ATOMIC_BLOCK(ATOMIC_FORCEON)
+	{
+		faultTimes[0] = motorFaultTimes[0];
+		faultTimes[1] = motorFaultTimes[1];
+	}
+	const PacketLinkStats *const stats = &pcLink.stats;
+
+	u08 statsData[MAX_PACKET_DATA];
+	u08 length = STATS_DATA_encode(statsData, STATS_VERSION, uartStats.rxOverruns,
+		getMotorFaultCount(0), faultTimes[0], getMotorFaultCount(1), faultTimes[1],
+		stats->bytesReceived, stats->bytesSent, stats->packetsReceived, stats->packetsSent,
+		stats->crcErrors, stats->framingErrors, stats->invalidHeaders, stats->validatorRejections, stats->resyncs,
+		stats->droppedPackets, stats->queueDrops[PACKET_PRIORITY_CONTROL], stats->queueDrops[PACKET_PRIORITY_FAULT],
+		stats->queueDrops[PACKET_PRIORITY_TELEMETRY], stats->queueDrops[PACKET_PRIORITY_DEBUG],
+		stats->queueHighWater[PACKET_PRIORITY_CONTROL], stats->queueHighWater[PACKET_PRIORITY_FAULT],
+		stats->queueHighWater[PACKET_PRIORITY_TELEMETRY], stats->queueHighWater[PACKET_PRIORITY_DEBUG],
+		stats->retransmissions, stats->duplicates, stats->maxParseUs);
+
+	//then the count of each packet type received so far, for as many as fit
+	for (u08 i = 0; i < NUM_UPLINK_TYPES && length + 3 <= MAX_PACKET_DATA; i++)
+	{
+		if (packetCounts[i] == 0)
+			continue;
+		statsData[length++] = uplinkType(i);
+		statsData[length++] = (u08)(packetCounts[i] >> 8);
+		statsData[length++] = (u08)packetCounts[i];
+	}
+	sendPacket(STATS_DATA, statsData, length);
+}
+
+static void sendTunableInfo(const u08 id)
+{
+	u08 infoData[2 + 9 + TUNABLE_NAME_LENGTH];
+	u08 length = TUNABLE_INFO_encode(infoData, id, NUM_TUNABLES);
+	length += tunableDescribe(id, &infoData[length]);
+	sendPacket(TUNABLE_INFO, infoData, length);
+}
+
+static void sendTunableValue(const u08 id, const TunableStatus status)
+{
+	s16 value = 0;
+	tunableGet(id, &value);
+	u08 valueData[4];
+	sendPacket(TUNABLE_VALUE, valueData, TUNABLE_VALUE_encode(valueData, id, status, value));
+}
 
-	sendPacket(STATS_DATA, statsData, sizeof(statsData));
+/*! Answers a TIME_SYNC with the robot's side of the exchange. The PC works out the offset between the clocks from it.
+ *  @param receiveUs When the TIME_SYNC was received. It is only taken when the packet is handled, so the PC keeps the
+ *  exchanges with the shortest round trips, which had the least waiting.
+ */
+static void sendTimeSyncReply(const u32 originate, const u32 receiveUs)
+{
+	u08 syncData[12];
+	//stamped as late as possible, just before queueing at the highest priority
+	sendPacket(TIME_SYNC_REPLY, syncData, TIME_SYNC_REPLY_encode(syncData, originate, receiveUs, getUptimeUs()));
+}
+
+/*! Resets into the bootloader (see Bootloader/bootloader.c), leaving a request for it to stay instead of starting the
+ *  Launcher again. Doesn't return.
+ */
+static void enterBootloader()
+{
+	cli();
+	//the top of the stack isn't needed any more, since this never returns
+	*(volatile u16 *)BOOT_REQUEST_ADDRESS = BOOT_REQUEST_MAGIC;
+	wdt_enable(WDTO_15MS);
+	while (TRUE)
+	{
+	}
 }
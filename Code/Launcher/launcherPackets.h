@@ -2,39 +2,16 @@
 #define LAUNCHERPACKETS_H
 
 #include "globals.h"
+#include "protocol.h"
 
-/*! Defines the valid PC to robot packets.
-    Avoid defining a packetType that is the same as ::START_BYTE1.
+/*! The valid PC to robot packets (::UplinkPacketType) and robot to PC packets (::DownlinkPacketType) are defined in
+    Protocol/packets.schema, and generated into protocol.h. The Launcher's packet types start at ::LAUNCHER_UPLINK_FIRST;
+    the types below it are the Remote System's Commands (see remoteControl.h), which are accepted in every mode alongside these.
  */
-typedef enum
-{
-	GET_VERSIONS,
-	PAUSE,
-	RESUME,
-	ABORT_TO_MENU,
-	GET_STATS,
-	LAST_UplinkPacketType
-} UplinkPacketType;
-
-/*! Defines the valid robot to PC packets.
-    Avoid defining a packetType that is the same as ::START_BYTE1.
- */
-typedef enum
-{
-	BOOTED_UP = 128,
-	VERSION_DATA,
-	STATS_DATA,
-	TELEMETRY_DATA,
-	DEBUG_LOG,
-	WARNING_LOG,
-	CRITICAL_LOG,
-	SW_FAULT,
-	LAST_DownlinkPacketType
-} DownlinkPacketType;
 
 //Prototypes
 bool validateLauncherPacket(const u08 packetType, const u08 dataLength);
-void execLauncherPacket(const u08 packetType, const u08 * const data, const u08 dataLength);
+void execLauncherPacket(const u08 packetType, const u08 sequence, const u08 * const data, const u08 dataLength);
 void sendBootNotification(u08 resetCause);
 
 #endif
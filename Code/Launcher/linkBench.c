@@ -0,0 +1,72 @@
+/*! @file
+    The robot's end of the link benchmark (Host/linkbench.cpp), which measures the round trip time, the throughput in
+    each direction, and the error rates of the PC link.
+
+    - PING_REQUEST is answered with a PING_REPLY straight away, by the packet executor.
+    - BULK_SINK packets are only counted, so the PC can send as fast as the link goes.
+    - BULK_SOURCE starts a transfer of BULK_DATA packets to the PC. They are sent at ::PACKET_PRIORITY_DEBUG, and only
+      when the queue has room for a whole packet, so the transfer runs as fast as the UART drains it without any being
+      dropped, and never holds up replies, faults or telemetry.
+    - GET_LINK_REPORT is answered with the counters, so the PC can compare what it sent with what arrived.
+ */
+#include "linkBench.h"
+#include "packetprotocol.h"
+#include "protocol.h"
+#include "rtc.h"
+#include "uart.h"
+
+static u32 sinkPackets;
+static u32 sinkBytes;
+
+//The BULK_SOURCE transfer in progress.
+static u16 sourceLeft;
+static u16 sourceIndex;
+static u08 sourceLength;
+
+//! Counts a BULK_SINK packet.
+void linkBenchSink(const u08 payloadLength)
+{
+	sinkPackets++;
+	sinkBytes += payloadLength;
+}
+
+/*! Starts sending BULK_DATA packets, replacing any transfer in progress.
+    @param count The number of packets to send, or 0 to stop.
+    @param patternLength The number of pattern bytes after the index in each packet. Limited to what fits in a packet.
+ */
+void linkBenchSourceStart(const u16 count, const u08 patternLength)
+{
+	sourceLeft = count;
+	sourceIndex = 0;
+	sourceLength = (patternLength > MAX_PACKET_DATA - 2) ? MAX_PACKET_DATA : patternLength + 2;
+}
+
+//! Queues as many BULK_DATA packets as there is room for. Call often.
+void linkBenchExec()
+{
+	u08 data[MAX_PACKET_DATA];
+	while (sourceLeft > 0 && packetLinkHasRoom(&pcLink, PACKET_PRIORITY_DEBUG, sourceLength))
+	{
+		const u08 offset = BULK_DATA_encode(data, sourceIndex);
+		for (u08 i = offset; i < sourceLength; i++)
+		{
+			data[i] = (u08)(sourceIndex + (i - offset));
+		}
+		sendPacketPriority(PACKET_PRIORITY_DEBUG, BULK_DATA, data, sourceLength);
+		sourceIndex++;
+		sourceLeft--;
+	}
+}
+
+//! Sends a LINK_REPORT.
+void linkBenchReport()
+{
+	UartStats uartStats;
+	uartGetStats(UART_PORT0, &uartStats);
+	const PacketLinkStats *const stats = &pcLink.stats;
+
+	u08 reportData[24];
+	const u08 length = LINK_REPORT_encode(reportData, getUptimeMs(), sinkPackets, sinkBytes, sourceLeft,
+		stats->packetsReceived, stats->crcErrors, stats->framingErrors, stats->invalidHeaders, uartStats.rxOverruns);
+	sendPacket(LINK_REPORT, reportData, length);
+}
@@ -0,0 +1,11 @@
+#ifndef LINKBENCH_H
+#define LINKBENCH_H
+
+#include "globals.h"
+
+void linkBenchSink(const u08 payloadLength);
+void linkBenchSourceStart(const u16 count, const u08 patternLength);
+void linkBenchExec();
+void linkBenchReport();
+
+#endif
@@ -1,17 +1,23 @@
+#include "adcScan.h"
 #include "ADC.h"
 #include "compLeft.h"
 #include "compRight.h"
 #include "debug.h"
+#include "driveComp.h"
 #include "launcherPackets.h"
 #include "LCD.h"
+#include "linkBench.h"
 #include "main.h"
 #include "motors.h"
 #include "packetprotocol.h"
 #include "remoteControl.h"
+#include "roboclaw.h"
 #include "rtc.h"
-#include "serial.h"
 #include "servos.h"
+#include "telemetry.h"
 #include "testmode.h"
+#include "traceStream.h"
+#include "uart.h"
 #include "util.h"
 #include "utility.h"
 #include <avr/pgmspace.h>
@@ -32,9 +38,12 @@ volatile u16 batteryReading;
 volatile s16 error;
 volatile s16 totalError;
 volatile bool pause = FALSE;
+//! The time (from getMsCount()) of the most recent H-bridge fault on each drive motor, or 0 if none.
+volatile u32 motorFaultTimes[2];
 
 //Local prototypes
 static void mainMenu();
+static void motorFaultHandler(const u08 motorNum, const u16 faultCount);
 
 //! Initializes XiphosLibrary, pullups, and timers, prints version.
 int main()
@@ -43,19 +52,23 @@ int main()
 	initialize();
 
 	rtcInit();
+	tunablesInit();
 
-	//Enable ADC interrupt
-	ADCSRA |= _BV(ADIE);
-
-	//set ADC right shifting (for 10-bit ADC reading), and select first ADC pin to read
-	ADMUX = _BV(REFS0) | ANALOG_WHEEL_ENCODER_INNER;
+	//the PC link on UART0 carries logs and remote control commands
+	initPacketDriver();
+#if PC_LINK_FAST_BAUD != 0
+	packetLinkProposeBaud(&pcLink, PC_LINK_FAST_BAUD);
+#endif
+	//handle the PC's commands (such as SET_TELEMETRY) and the Remote System's commands in every mode
+	configPacketProcessor(validateLauncherPacket, execLauncherPacket, LAST_UplinkPacketType - 1);
 
 	//enable interrupts
 	sei();
 
-	//Initialize UART
-	uart0Init();
-	uart1Init();
+#if USE_ROBOCLAW_SERIAL == 1
+	//UART1 is used to send packet serial commands to the RoboClaw
+	roboclawInit();
+#endif
 
 	//configure digital pins 2-9 as inputs
 	DDRA = 0;
@@ -64,6 +77,17 @@ int main()
 	//enable pullup resistors for all 8 analog inputs
 	analogPullups(0xFF);
 
+	//timestamp drive motor faults so they can be reported in the STATS_DATA packet
+	setMotorFaultCallback(motorFaultHandler);
+
+	//configure the motion profiles used for the servo-driven mechanisms
+	setServoProfile(SERVO_SCRAPER, SCRAPER_VELOCITY, SCRAPER_ACCELERATION);
+	setServoProfile(SERVO_FEEDER, FEEDER_VELOCITY, FEEDER_ACCELERATION);
+#if USE_ROBOCLAW_SERIAL == 0
+	setServoProfile(SERVO_LEFT_LAUNCHER, LAUNCHER_VELOCITY, LAUNCHER_ACCELERATION);
+	setServoProfile(SERVO_RIGHT_LAUNCHER, LAUNCHER_VELOCITY, LAUNCHER_ACCELERATION);
+#endif
+
 	//read and save RobotID
 	if (!digitalInput(SWITCH_ROBOT_ID))
 		robotID = LEFT_ROBOT;
@@ -79,12 +103,17 @@ int main()
 		printString_P(PSTR("Right Robot"));
 	delayMs(1000);
 
-	//Start taking ADC readings
-	ADCSRA |= _BV(ADSC);
+	//Start taking ADC readings of the wheel encoders and battery in the background
+	adcScanStart(_BV(ANALOG_WHEEL_ENCODER_INNER) | _BV(ANALOG_WHEEL_ENCODER_WALL) | _BV(ANALOG_BATTERY_VOLTAGE));
 
 	//Make sure launcher is off
 	launcherSpeed(LAUNCHER_SPEED_STOPPED);
-	uart1Transmit(0);
+#if USE_ROBOCLAW_SERIAL == 1
+	roboclawExec();
+#else
+	//in simple serial mode, 0 stops both RoboClaw channels
+	uartPutChar(UART_PORT1, 0);
+#endif
 
 	mainMenu();
 }
@@ -187,10 +216,16 @@ static void mainMenu()
 	u32 priorSeconds = 255;
 	while (1)
 	{
-		pProgExec();
+		TRACE_TASK_BEGIN(TRACE_MAIN_LOOP);
+		//start each control period with the latest values from the PC
+		TRACE_TASK(TRACE_TUNABLES, tunablesApply());
+		TRACE_TASK(TRACE_PROGRAM, pProgExec());
 
-		launcherExec();
-		pidExec();
+		//keep the PC link running (and finish any baud rate change) in every mode
+		serviceExec();
+		TRACE_TASK(TRACE_DRIVE_COMP, driveCompExec());
+		TRACE_TASK(TRACE_PID, pidExec());
+		mechanismExec();
 
 		u32 msCount = getMsCount();
 		u08 seconds = msCount / 1000;
@@ -198,6 +233,7 @@ static void mainMenu()
 		// only print when the seconds have changed
 		if (seconds != priorSeconds)
 		{
+			TRACE_TASK_BEGIN(TRACE_LCD_CLOCK);
 			priorSeconds = seconds;
 			lcdCursor(0, 11);
 
@@ -209,7 +245,47 @@ static void mainMenu()
 			// print seconds (ones digit)
 			printChar(((seconds % 60) % 10) + '0');
 			printChar('s');
+			TRACE_TASK_END(TRACE_LCD_CLOCK);
 		}
+		TRACE_TASK_END(TRACE_MAIN_LOOP);
+	}
+}
+
+/*! Runs the PC link's background work: a bounded number of received packets, the Remote System's script and
+ *  sensor stream, telemetry, any link benchmark transfer, and sending trace events. Called from the main loop in
+ *  every mode, and while waiting in waitMs().
+ */
+void serviceExec()
+{
+	TRACE_TASK(TRACE_PACKETS, execPacketDriver());
+	TRACE_TASK(TRACE_REMOTE, remoteSystemService());
+	TRACE_TASK(TRACE_TELEMETRY, telemetryExec());
+	TRACE_TASK(TRACE_LINK_BENCH, linkBenchExec());
+	TRACE_TASK(TRACE_STREAM, traceStreamExec());
+}
+
+/*! Runs the launcher mechanisms that finish what a mode started: the RoboClaw link, which sends the launcher speed
+ *  and polls its status, and the feeder. Called from the main loop, and while waiting in waitMs().
+ */
+void mechanismExec()
+{
+#if USE_ROBOCLAW_SERIAL == 1
+	TRACE_TASK(TRACE_ROBOCLAW, roboclawExec());
+#endif
+	TRACE_TASK(TRACE_FEEDER, feederExec());
+}
+
+/*! Waits for a number of milliseconds, like delayMs(), but keeps servicing the PC link and the launcher mechanisms
+ *  meanwhile, so a launcher speed or feeder change made before waiting takes effect during the wait.
+ *  The drive motors are not controlled, so a mode that stopped the robot before waiting stays stopped.
+ */
+void waitMs(const u16 ms)
+{
+	const u32 start = getUptimeMs();
+	while (getUptimeMs() - start < ms)
+	{
+		serviceExec();
+		mechanismExec();
 	}
 }
 
@@ -225,8 +301,15 @@ void resumeCompetition()
 	pause = FALSE;
 }
 
+//! Records when a drive motor H-bridge faulted. Called from the motor fault interrupt.
+static void motorFaultHandler(const u08 motorNum, const u16 faultCount)
+{
+	motorFaultTimes[motorNum] = getMsCount();
+}
+
 ISR(ADC_vect)
 {
+	TRACE_ISR_ENTER(TRACE_ADC);
 	// lower 8 bits of result must be read first
 	const u08 lowByte = ADCL;
 	// combine the high and low byte to get a 16-bit result.
@@ -235,33 +318,27 @@ ISR(ADC_vect)
 	bool encoderUpdated = FALSE;
 
 	// determine which input was read
-	switch (ADMUX & 0x3F)
+	const u08 channel = ADMUX & (NUM_ANALOG_INPUTS - 1);
+	switch (channel)
 	{
 		case ANALOG_WHEEL_ENCODER_INNER:
 			innerEncoderReading = reading;
 			encoderUpdated = TRUE;
-			// set ADC right shifting (for 10-bit ADC reading), and select next ADC pin to read
-			ADMUX = _BV(REFS0) | ANALOG_WHEEL_ENCODER_WALL;
 			break;
 		case ANALOG_WHEEL_ENCODER_WALL:
 			wallEncoderReading = reading;
 			encoderUpdated = TRUE;
-			// set ADC right shifting (for 10-bit ADC reading), and select next ADC pin to read
-			ADMUX = _BV(REFS0) | ANALOG_BATTERY_VOLTAGE;
 			break;
 		case ANALOG_BATTERY_VOLTAGE:
 			batteryReading = reading;
-			// set ADC right shifting (for 10-bit ADC reading), and select next ADC pin to read
-			ADMUX = _BV(REFS0) | ANALOG_WHEEL_ENCODER_INNER;
 			break;
 		default:
-			// shouldn't ever reach this point. Just reset to a valid analog input.
-			// set ADC right shifting (for 10-bit ADC reading), and select next ADC pin to read
-			ADMUX = _BV(REFS0) | ANALOG_WHEEL_ENCODER_INNER;
+			// other inputs are only in the scan for the Remote System's sensor stream
 			break;
 	}
 
-	// Start the next reading
+	// set ADC right shifting (for 10-bit ADC reading), select the next input in the scan, and start the next reading
+	ADMUX = _BV(REFS0) | adcScanNext(channel, reading);
 	ADCSRA |= _BV(ADSC);
 
 	// for encoder readings, run the tick counting logic
@@ -296,4 +373,5 @@ ISR(ADC_vect)
 		error = (totalInnerEncoderTicks - totalWallEncoderTicks);
 		totalError += error;
 	}
+	TRACE_ISR_EXIT(TRACE_ADC);
 }
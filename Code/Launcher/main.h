@@ -2,6 +2,7 @@
 #define MAIN_H
 
 #include "globals.h"
+#include "tunables.h"
 
 /*! Version of the Launcher firmware, part of the response to a ::GET_VERSIONS command.
     Should be incremented when new features or breaking changes are added.
@@ -28,19 +29,46 @@
 #define LOGIC_BATTERY_VOLTAGE_CUTOFF 3000 * LOGIC_BATTERY_NUM_CELLS
 
 //! The number of Lithium polymer cells in the motor battery pack.
-#define LOGIC_BATTERY_NUM_CELLS 2
-//! The voltage (in milliVolts) at which to alert the user that the logic battery is low.
-#define LOGIC_BATTERY_VOLTAGE_WARN 3500 * LOGIC_BATTERY_NUM_CELLS
-//! The voltage (in milliVolts) at which to turn off servos and anything else possible on the logic battery.
-#define LOGIC_BATTERY_VOLTAGE_CUTOFF 3000 * LOGIC_BATTERY_NUM_CELLS
+#define MOTOR_BATTERY_NUM_CELLS 2
+//! The motor battery voltage (in milliVolts) that the drive speeds are tuned at. See driveComp.c.
+#define MOTOR_BATTERY_VOLTAGE_NOMINAL (3700 * MOTOR_BATTERY_NUM_CELLS)
+//! The voltage (in milliVolts) at which to alert the user that the motor battery is low.
+#define MOTOR_BATTERY_VOLTAGE_WARN (3500 * MOTOR_BATTERY_NUM_CELLS)
+//! The voltage (in milliVolts) at which to stop the motors to protect the motor battery.
+#define MOTOR_BATTERY_VOLTAGE_CUTOFF (3000 * MOTOR_BATTERY_NUM_CELLS)
+
+//! The ::PacketFraming the PC link uses after a reset. The PC can switch it at runtime with a LINK_SET_FRAMING packet.
+#define PC_LINK_FRAMING PACKET_FRAMING_START_BYTES
+/*! The baud rate the robot proposes for the PC link after booting at UART0_BAUD, or 0 to stay at UART0_BAUD.
+ *  250000, 500000 and 1000000 are exact at 16 MHz.
+ */
+#define PC_LINK_FAST_BAUD 500000UL
+
+//! Set to 1 to control the launcher wheels with RoboClaw packet serial commands on UART1, or 0 to drive them as RC servos.
+#define USE_ROBOCLAW_SERIAL 1
+//! The launcher wheel encoder speed (in quadrature pulses per second) for each launcherSpeed() step above ::LAUNCHER_SPEED_STOPPED.
+#define LAUNCHER_QPPS_PER_STEP 120
+//! The launcher wheel acceleration (in quadrature pulses per second squared), matching the ::LAUNCHER_VELOCITY servo ramp.
+#define LAUNCHER_QPPS_ACCELERATION ((u32)LAUNCHER_VELOCITY * LAUNCHER_QPPS_PER_STEP)
+//! How close (in percent) each launcher wheel must be to the requested speed before balls are fed into it.
+#define LAUNCHER_READY_TOLERANCE 5
 
 //! The number of seconds per competition round.
 #define COMPETITION_DURATION_SECS (3 * 60)
 
-//! The drive motor that is always on the inside of the course.
-#define innerMotor(speedAndDirection) motor0(127 + speedAndDirection)
-//! The drive motor that always runs along the wall.
-#define wallMotor(speedAndDirection) motor1(127 + speedAndDirection)
+//! Converts a drive speed (-127 to 127) to a motor speed (-MOTOR_SPEED_MAX to MOTOR_SPEED_MAX).
+#define DRIVE_TO_MOTOR_SPEED(speed) ((s16)((s32)(speed) * MOTOR_SPEED_MAX / 127))
+
+//! The inside drive motor, with a full resolution motor speed from -MOTOR_SPEED_MAX to MOTOR_SPEED_MAX,
+//! compensated for deadband and battery voltage (see driveComp.h).
+#define innerMotorFine(motorSpeed) motor0(compensateDriveSpeed(DRIVE_INNER_MOTOR, motorSpeed))
+//! The wall drive motor, with a full resolution motor speed from -MOTOR_SPEED_MAX to MOTOR_SPEED_MAX,
+//! compensated for deadband and battery voltage (see driveComp.h).
+#define wallMotorFine(motorSpeed) motor1(compensateDriveSpeed(DRIVE_WALL_MOTOR, motorSpeed))
+//! The drive motor that is always on the inside of the course, with a drive speed from -127 to 127.
+#define innerMotor(speed) innerMotorFine(DRIVE_TO_MOTOR_SPEED(speed))
+//! The drive motor that always runs along the wall, with a drive speed from -127 to 127.
+#define wallMotor(speed) wallMotorFine(DRIVE_TO_MOTOR_SPEED(speed))
 
 // Right robot switches
 #define REAR_SIDE_WALL_HIT  !digitalInput(SWITCH_SIDE_WALL_REAR)
@@ -68,17 +96,30 @@ enum servos
 
 enum servoPositions
 {
-	RSCRAPER_DOWN          = 3, //!< The final position to lower the right scraper arm to to collect balls.
-	RSCRAPER_MOSTLY_DOWN   = 10, //!< The initial position to lower the right scraper arm to to avoid whacking the trough.
-	RSCRAPER_UP            = 134, //!< The raised position for the right scraper arm.
-	LSCRAPER_DOWN          = 128, //!< The final position to lower the left scraper arm to to collect balls.
-	LSCRAPER_MOSTLY_DOWN   = 127, //!< The initial position to lower the left scraper arm to to avoid whacking the trough.
-	LSCRAPER_UP            = 6, //!< The raised position for the left scraper arm.
 	FEEDER_STOPPED         = 128,
 	FEEDER_RUNNING         = 180,
 	LAUNCHER_SPEED_STOPPED = 128, //!< The center servo setting that the RoboClaw interprets as stopped.
-	LAUNCHER_SPEED_NEAR    = 150, //!< The minimum speed to spin the launcher wheels at, when closest to the goal.
-	LAUNCHER_SPEED_FAR     = 165,  //!< The maximum speed to spin the launcher wheels at, when farthest away from the goal.
+};
+
+//Servo positions that can be tuned from the PC. Their defaults are in tunables.h.
+#define RSCRAPER_DOWN       tunable(RSCRAPER_DOWN)       //!< The final position to lower the right scraper arm to to collect balls.
+#define RSCRAPER_UP         tunable(RSCRAPER_UP)         //!< The raised position for the right scraper arm.
+#define LSCRAPER_DOWN       tunable(LSCRAPER_DOWN)       //!< The final position to lower the left scraper arm to to collect balls.
+#define LSCRAPER_UP         tunable(LSCRAPER_UP)         //!< The raised position for the left scraper arm.
+#define LAUNCHER_SPEED_NEAR tunable(LAUNCHER_SPEED_NEAR) //!< The minimum speed to spin the launcher wheels at, when closest to the goal.
+#define LAUNCHER_SPEED_FAR  tunable(LAUNCHER_SPEED_FAR)  //!< The maximum speed to spin the launcher wheels at, when farthest away from the goal.
+
+/*! Motion profile limits for the servo-driven mechanisms, passed to setServoProfile().
+    Velocities are in servo position units per second, accelerations in position units per second squared.
+ */
+enum servoProfiles
+{
+	SCRAPER_VELOCITY      = 400, //!< Fast enough to swing the scraper in well under a second.
+	SCRAPER_ACCELERATION  = 1200, //!< Decelerates over the last ~65 position units, so the scraper lands softly in the trough.
+	FEEDER_VELOCITY       = 200,
+	FEEDER_ACCELERATION   = 400,
+	LAUNCHER_VELOCITY     = 45, //!< Matches the old launcherExec() ramp of one step every ~22 ms.
+	LAUNCHER_ACCELERATION = 90 //!< Reaches LAUNCHER_VELOCITY in half a second, to avoid current spikes in the RoboClaw.
 };
 
 typedef enum
@@ -120,18 +161,15 @@ enum encoderThresholds
 	ENCODER_THRESHOLD_WALL_HIGH  = 400
 };
 
-//wall motor is stronger/faster
-enum motorSpeeds
-{
-	FAST_SPEED_INNER_WHEEL    = 50,
-	FAST_SPEED_WALL_WHEEL     = 50,
-	SLOW_SPEED_INNER_WHEEL    = 20,
-	SLOW_SPEED_WALL_WHEEL     = 20,
-	SLOW_SPEED_BK_INNER_WHEEL = 13,
-	SLOW_SPEED_BK_WALL_WHEEL  = 13,
-	TURN_SPEED_INNER_WHEEL    = 45,
-	TURN_SPEED_WALL_WHEEL     = 45
-};
+//Drive speeds, which can be tuned from the PC. Their defaults are in tunables.h. The wall motor is stronger/faster.
+#define FAST_SPEED_INNER_WHEEL    tunable(FAST_SPEED_INNER_WHEEL)
+#define FAST_SPEED_WALL_WHEEL     tunable(FAST_SPEED_WALL_WHEEL)
+#define SLOW_SPEED_INNER_WHEEL    tunable(SLOW_SPEED_INNER_WHEEL)
+#define SLOW_SPEED_WALL_WHEEL     tunable(SLOW_SPEED_WALL_WHEEL)
+#define SLOW_SPEED_BK_INNER_WHEEL tunable(SLOW_SPEED_BK_INNER_WHEEL)
+#define SLOW_SPEED_BK_WALL_WHEEL  tunable(SLOW_SPEED_BK_WALL_WHEEL)
+#define TURN_SPEED_INNER_WHEEL    tunable(TURN_SPEED_INNER_WHEEL)
+#define TURN_SPEED_WALL_WHEEL     tunable(TURN_SPEED_WALL_WHEEL)
 
 //RobotID values
 enum {
@@ -140,6 +178,9 @@ enum {
 };
 
 //Prototypes
+void serviceExec();
+void mechanismExec();
+void waitMs(const u16 ms);
 void pauseCompetition();
 void resumeCompetition();
 
@@ -158,5 +199,6 @@ extern volatile u16 batteryReading;
 extern volatile s16 error;
 extern volatile s16 totalError;
 extern volatile bool pause;
+extern volatile u32 motorFaultTimes[2];
 
 #endif
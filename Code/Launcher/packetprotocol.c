@@ -1,7 +1,22 @@
+/*! @file
+    Implements the packet protocol used to communicate with the PC (or another board) over a UART.
+    Packets are framed as: START_BYTE1, START_BYTE2, packetType, sequenceNum, dataLength, data section, 16-bit CRC-CCITT.
+    Alternatively, a link can use COBS framing, where packetType through the CRC are COBS encoded and followed by a 0x00 delimiter.
+    All of the protocol state is kept in a ::PacketLink, so independent links can run on several UARTs at the same time,
+    each with its own handlers. The original single-link functions operate on ::pcLink.
+
+    Outgoing packets are framed as soon as they are sent, and wait in the link's queue for their ::PacketPriority.
+    Whole frames are moved from the queues into the UART transmit buffer, highest priority first, whenever it has room.
+
+    COBS framing, the reliable channel and the priority queues can each be left out of a build (see ::PACKET_LINK_COBS,
+    ::PACKET_LINK_RELIABLE and ::PACKET_LINK_PRIORITIES in packetprotocol.h).
+ */
 #include "debug.h"
 #include "LCD.h"
 #include "main.h"
 #include "packetprotocol.h"
+#include "rtc.h"
+#include "uart.h"
 #include "utility.h"
 #include <avr/io.h>
 #include <avr/interrupt.h>
@@ -13,106 +28,306 @@
 #define START_BYTE1 0xA5
 #define START_BYTE2 0x5A
 
-//!Circular buffer, large enough to store the maximum packet size plus 1 byte.
-#define RX_BUFFER_LENGTH 255
-//!Plain buffer, large enough to store the maximum packet size. Only stores 1 packet at a time.
-#define TX_BUFFER_LENGTH 254
-//!Plain buffer, just large enough to store the maximum data section (not counting the optional dataLength).
-#define DATA_SECTION_LENGTH 20
-
-/*! Indexes that track the beginning and end of the circular ::receiveBuffer.
-    When they are equal, there is nothing in the buffer.
-    Length of data stored in the buffer is tail - head.
+/*! Plain buffer, large enough to store the maximum packet size. Only stores 1 packet at a time.
+    Has one spare byte at the start, so a COBS code byte can be written in front of the packetType.
+ */
+#define TX_BUFFER_LENGTH (MAX_PACKET_DATA + PACKET_OVERHEAD + 1)
 
+/*! The length of the part of a packet that gets COBS encoded: packetType, sequenceNum, dataLength, data, and CRC.
+    As long as this is under 254 bytes, a packet is a single COBS block between zeros, and encoding never adds bytes
+    beyond the leading code byte. That lets packets be encoded in place.
  */
-static volatile u08 head = 0, tail = 0;
-//! Circular buffer that stores data received from the PC.
-static volatile u08 receiveBuffer[RX_BUFFER_LENGTH];
-//! Plain buffer that stores data to be sent to the PC.
-u08 transmitBuffer[TX_BUFFER_LENGTH];
-//! Index in the ::transmitBuffer of the next byte to send.
-static volatile u08 transmitIndex;
-//! Length in bytes of the current packet in ::transmitBuffer.
-static u08 transmitLength;
-//! Sequence Number to include in the next outgoing packet.
-static u08 downSequenceNum = 0;
+#define COBS_MAX_FRAME_LENGTH (MAX_PACKET_DATA + 5)
+#if COBS_MAX_FRAME_LENGTH >= 254
+	#error "MAX_PACKET_DATA is too large for in-place COBS encoding"
+#endif
 
-static ValidateDataLengthCallback_t validator = NULL;
-static ExecCallback_t executor = NULL;
-static u08 maxPacketType = 0;
+#if PACKET_LINK_COBS
+	#define NUM_LINK_FRAMINGS NUM_PACKET_FRAMINGS
+#else
+	//! The framings compiled in: only ::PACKET_FRAMING_START_BYTES.
+	#define NUM_LINK_FRAMINGS PACKET_FRAMING_COBS
+#endif
 
-//Stats
+//! The link to the PC on UART0.
+PacketLink pcLink;
 
-//! Counter that tracks how many times a buffer overfill condition occurs, for development/testing purposes.
-volatile u16 bufferOverfilledCounter = 0;
+/*! Plain buffer that stores the packet being assembled by packetLinkSend(). It is shared by all links,
+    since a packet is copied into its priority queue as soon as it has been assembled.
+ */
+static u08 transmitBuffer[TX_BUFFER_LENGTH];
 
-static volatile u08 codeTracks[16];
+#if PACKET_LINK_PRIORITIES
+#if PACKET_QUEUE_CONTROL_LENGTH < TX_BUFFER_LENGTH || PACKET_QUEUE_FAULT_LENGTH < TX_BUFFER_LENGTH || PACKET_QUEUE_DEBUG_LENGTH < TX_BUFFER_LENGTH
+	#error "the control, fault and debug packet queues must hold the largest packet"
+#endif
+
+//! Where each priority's queue starts in PacketLink::queueBuffer.
+static const u16 queueOffsets[NUM_PACKET_PRIORITIES] =
+{
+	0,
+	PACKET_QUEUE_CONTROL_LENGTH,
+	PACKET_QUEUE_CONTROL_LENGTH + PACKET_QUEUE_FAULT_LENGTH,
+	PACKET_QUEUE_CONTROL_LENGTH + PACKET_QUEUE_FAULT_LENGTH + PACKET_QUEUE_TELEMETRY_LENGTH
+};
+//! Masks an offset into each priority's queue.
+static const u16 queueMasks[NUM_PACKET_PRIORITIES] =
+{
+	PACKET_QUEUE_CONTROL_LENGTH - 1,
+	PACKET_QUEUE_FAULT_LENGTH - 1,
+	PACKET_QUEUE_TELEMETRY_LENGTH - 1,
+	PACKET_QUEUE_DEBUG_LENGTH - 1
+};
+#endif
 
 //Local Prototypes
-static void processPacketBuffer();
+static void fillPacketBuffer(PacketLink *const link);
+static void processPacketBuffer(PacketLink *const link);
+#if PACKET_LINK_COBS
+static void processCobsBuffer(PacketLink *const link);
+static void decodeCobsByte(PacketLink *const link, const u08 decodedByte);
+#endif
+static void resetParser(PacketLink *const link);
+static bool validPacketType(PacketLink *const link, const u08 packetType);
+static bool validDataLength(PacketLink *const link, const u08 packetType, const u08 dataLength);
+static void dispatchPacket(PacketLink *const link);
+static void execLinkControl(PacketLink *const link);
+static bool transmitPacket(PacketLink *const link, const PacketPriority priority, const u08 packetType, const u08 sequence, const u08 *const data, const u08 dataLength);
+static bool enqueueFrame(PacketLink *const link, const PacketPriority priority, const u08 *const frame, const u08 length);
+#if PACKET_LINK_PRIORITIES
+static void pumpQueues(PacketLink *const link);
+#endif
+#if PACKET_LINK_RELIABLE
+static u08 reliableAck(PacketLink *const link);
+static void sendReliablePacket(PacketLink *const link, const u08 sequence);
+static bool receiveReliable(PacketLink *const link);
+static void updateReliable(PacketLink *const link);
+#endif
+static void sendBaud(PacketLink *const link, const u08 packetType, const u32 baud);
+static void updateBaudChange(PacketLink *const link);
+static void fallBackToBootBaud(PacketLink *const link);
+static void discardPartialPacket(PacketLink *const link);
 //static void resetPolyBot(const u08 * const data);
-static void codeTrack(const u08 num);
-//static void printCodeTracks();
+static void loseSync(PacketLink *const link);
+static void updateParseTime(PacketLink *const link, const u16 startTicks, const u32 startMs);
 static u16 updateCrcCcitt(const u16 crc, const u08 dataByte);
 
+enum PacketStates
+{
+	STATE_Start1,
+	STATE_Start2,
+	STATE_PacketType,
+	STATE_SequenceNum,
+	STATE_DataLength,
+	STATE_DataSection,
+	STATE_CrcMsb,
+	STATE_CrcLsb,
+	NUM_States
+};
 
-void configPacketProcessor(ValidateDataLengthCallback_t newValidator, ExecCallback_t newExecutor, u08 newMaxPacketType)
+
+/*! Initializes a link on a UART, with no handlers registered.
+    The UART must be enabled with USE_UARTn in the Makefile.
+    @param framing The ::PacketFraming the other end of the link starts with.
+ */
+void packetLinkInit(PacketLink *link, const UartPort port, const PacketFraming framing)
 {
-	validator = newValidator;
-	executor = newExecutor;
-	maxPacketType = newMaxPacketType;
+	memset(link, 0, sizeof(*link));
+	link->port = port;
+	link->framing = framing;
+	link->baudChange.bootBaud = uartGetBaud(port);
+	resetParser(link);
 }
 
-void initPacketDriver()
+/*! Switches the framing used by a link in both directions. Any partially received packet is discarded.
+    Normally the framing is changed by the other end sending a ::LINK_SET_FRAMING packet.
+ */
+void packetLinkSetFraming(PacketLink *link, const PacketFraming framing)
 {
-	//these bytes never change
-	transmitBuffer[0] = START_BYTE1;
-	transmitBuffer[1] = START_BYTE2;
+	if (framing >= NUM_LINK_FRAMINGS)
+	{
+		SOFTWARE_FAULT(PSTR("invalid framing"), framing, link->port);
+		return;
+	}
+	link->framing = framing;
+	discardPartialPacket(link);
+}
 
-	//initialize codeTracks
-	memset((char *)codeTracks, '-', sizeof codeTracks);
+/*! Registers the functions that handle the packets received on a link.
+    @param link The link to configure.
+    @param newValidator Called to validate the dataLength of each packetType, or NULL to accept any dataLength up to ::MAX_PACKET_DATA.
+    @param newExecutor Called with each packet received with a valid CRC.
+    @param newMaxPacketType The largest packetType that will be accepted.
+ */
+void packetLinkConfig(PacketLink *link, ValidateDataLengthCallback_t newValidator, ExecCallback_t newExecutor, u08 newMaxPacketType)
+{
+	link->validator = newValidator;
+	link->executor = newExecutor;
+	link->maxPacketType = newMaxPacketType;
 }
 
-void execPacketDriver()
+//! Processes the bytes received on a link, calling the link's executor for each complete packet.
+void packetLinkExec(PacketLink *link)
 {
-	//process the serial packet data in receiveBuffer, if any
-	processPacketBuffer();
-	codeTrack(0);
+	//move any bytes received by the UART into receiveBuffer
+	fillPacketBuffer(link);
+	//process the serial packet data in receiveBuffer, if any, up to PACKET_DISPATCH_LIMIT packets
+	link->dispatchesLeft = PACKET_DISPATCH_LIMIT;
+	const u16 startTicks = getFastTicks();
+	const u32 startMs = getUptimeMs();
+#if PACKET_LINK_COBS
+	if (link->framing == PACKET_FRAMING_COBS)
+		processCobsBuffer(link);
+	else
+#endif
+		processPacketBuffer(link);
+	updateParseTime(link, startTicks, startMs);
+#if PACKET_LINK_RELIABLE
+	if (link->reliable.enabled)
+		updateReliable(link);
+#endif
+	if (link->baudChange.state != BAUD_IDLE)
+		updateBaudChange(link);
+#if PACKET_LINK_PRIORITIES
+	pumpQueues(link);
+#endif
 }
 
-static void codeTrack(const u08 num)
+/*! Sends a packet on a link at ::PACKET_PRIORITY_CONTROL. See packetLinkSendPriority().
+    @return TRUE if the packet was queued for transmission.
+ */
+bool packetLinkSend(PacketLink *link, const u08 packetType, const u08 *const data, const u08 dataLength)
 {
-	codeTracks[num] = num;
+	return packetLinkSendPriority(link, PACKET_PRIORITY_CONTROL, packetType, data, dataLength);
 }
-/*
-static void printCodeTracks()
+
+/*! Sends a packet on a link, without waiting for previous packets to finish transmitting.
+    The packet waits in the queue for its priority until every higher priority packet has been passed to the UART.
+    If the queue doesn't have room for the whole packet, the packet is dropped and counted in the link's stats.
+    The sequence number still advances, so the receiver can detect the gap.
+    While the reliable channel is on, the packet is sent unreliably but still carries an acknowledgement.
+    @return TRUE if the packet was queued for transmission.
+ */
+bool packetLinkSendPriority(PacketLink *link, const PacketPriority priority, const u08 packetType, const u08 *const data, const u08 dataLength)
+{
+	u08 sequence;
+#if PACKET_LINK_RELIABLE
+	if (link->reliable.enabled)
+		sequence = reliableAck(link);
+	else
+#endif
+		sequence = link->downSequenceNum++;
+	return transmitPacket(link, priority, packetType, sequence, data, dataLength);
+}
+
+/*! Checks whether a packet would fit in the queue for a priority right now, so a sender that can wait
+    (such as a bulk transfer) can hold a packet back instead of having it dropped and counted.
+ */
+bool packetLinkHasRoom(PacketLink *link, const PacketPriority priority, const u08 dataLength)
+{
+	if (priority >= NUM_PACKET_PRIORITIES || dataLength > MAX_PACKET_DATA)
+		return FALSE;
+#if PACKET_LINK_PRIORITIES
+	const u16 used = link->queueTail[priority] - link->queueHead[priority];
+	return used + 1 + PACKET_OVERHEAD + dataLength <= queueMasks[priority] + 1;
+#else
+	return uartTxFree(link->port) >= PACKET_OVERHEAD + dataLength;
+#endif
+}
+
+
+#if PACKET_LINK_RELIABLE
+/*! Turns the reliable channel of a link on or off, discarding any unacknowledged packets.
+    Normally the reliable channel is switched by the other end sending a ::LINK_SET_RELIABLE packet.
+ */
+void packetLinkSetReliable(PacketLink *link, const bool enabled)
 {
-	lowerLine();
-	for (u08 i = 0; i < sizeof(codeTracks); i++)
+	memset(&link->reliable, 0, sizeof(link->reliable));
+	link->reliable.enabled = enabled;
+}
+
+/*! Sends a packet on a link's reliable channel. The packet is kept until the other end acknowledges it,
+    and is sent again every ::RELIABLE_RETRANSMIT_MS until then, by packetLinkExec().
+    If the reliable channel is off, the packet is sent with packetLinkSend() instead.
+    @return TRUE if the packet was accepted, or FALSE if ::RELIABLE_WINDOW_SIZE packets are already waiting to be acknowledged.
+ */
+bool packetLinkSendReliable(PacketLink *link, const u08 packetType, const u08 *const data, const u08 dataLength)
+{
+	ReliableChannel *const channel = &link->reliable;
+	if (!channel->enabled)
+		return packetLinkSend(link, packetType, data, dataLength);
+
+	if (dataLength > RELIABLE_MAX_DATA)
 	{
-		if (codeTracks[i] == '-')
-			printChar('-');
-		else
-			printHexDigit(codeTracks[i]);
+		SOFTWARE_FAULT(PSTR("reliable packet too long"), packetType, dataLength);
+		return FALSE;
 	}
-}*/
+	const u08 outstanding = (channel->nextSequence - channel->oldestSequence) & RELIABLE_SEQ_MASK;
+	if (outstanding >= RELIABLE_WINDOW_SIZE)
+		return FALSE;
 
-void sendPacket(const u08 packetType, const u08 *const data, const u08 dataLength)
+	//keep a copy for retransmission
+	const u08 sequence = channel->nextSequence;
+	ReliablePacket *const packet = &channel->window[sequence & (RELIABLE_WINDOW_SIZE - 1)];
+	packet->packetType = packetType;
+	packet->dataLength = dataLength;
+	memcpy(packet->data, data, dataLength);
+	channel->nextSequence = (sequence + 1) & RELIABLE_SEQ_MASK;
+
+	//the retransmit timer runs for the oldest unacknowledged packet
+	if (outstanding == 0)
+		channel->retransmitTime = getUptimeMs() + RELIABLE_RETRANSMIT_MS;
+
+	//if the UART transmit buffer is full, the retransmit timer will take care of it
+	sendReliablePacket(link, sequence);
+	return TRUE;
+}
+#endif
+
+/*! Starts changing the baud rate of a link. The proposal is repeated every ::BAUD_PROPOSE_INTERVAL_MS until the other end
+    answers it. If the new rate doesn't work, the link falls back to its boot baud rate and proposes again.
+    Each unanswered proposal and each failed change counts as a failure, and after ::BAUD_MAX_FAILURES the link gives up
+    and stays at its boot baud rate, so it doesn't keep proposing to something that never answers.
+    Progress is made by packetLinkExec().
+ */
+void packetLinkProposeBaud(PacketLink *link, const u32 baud)
+{
+	BaudChange *const change = &link->baudChange;
+	if (!uartBaudSupported(baud))
+	{
+		SOFTWARE_FAULT(PSTR("unsupported baud"), baud >> 16, baud);
+		return;
+	}
+	if (baud == uartGetBaud(link->port))
+		return;
+
+	change->baud = baud;
+	change->proposer = TRUE;
+	change->failures = 0;
+	change->state = BAUD_PROPOSED;
+	sendBaud(link, LINK_SET_BAUD, baud);
+	change->timeout = getUptimeMs() + BAUD_PROPOSE_INTERVAL_MS;
+}
+
+//! Builds a packet in transmitBuffer with the link's framing, and queues it at a priority.
+static bool transmitPacket(PacketLink *const link, const PacketPriority priority, const u08 packetType, const u08 sequence, const u08 *const data, const u08 dataLength)
 {
-	//We must wait until the previous packet is done transmitting before modifying any transmit variables.
-	//We simply loop until the Data Register Empty Interrupt Enable bit is cleared.
-	while (UCSR0B & (1<<UDRIE0));
+	if (dataLength > MAX_PACKET_DATA)
+	{
+		link->stats.droppedPackets++;
+		return FALSE;
+	}
 
-	//[0] and [1] are already filled with the start bytes, so start filling at [2]
+	//leave [0] and [1] for the start bytes or the COBS code byte, so start filling at [2]
 	transmitBuffer[2] = packetType;
-	transmitBuffer[3] = downSequenceNum;
+	transmitBuffer[3] = sequence;
 	transmitBuffer[4] = dataLength;
 
 	//CRC-CCITT initializes all bits to 1
 	u16 crc = 0xFFFF;
 	//calculate CRC-CCITT over packetType, sequenceNum, dataLength, and data bytes
 	crc = updateCrcCcitt(crc, packetType);
-	crc = updateCrcCcitt(crc, downSequenceNum);
+	crc = updateCrcCcitt(crc, sequence);
 	crc = updateCrcCcitt(crc, dataLength);
 
 	//copy data bytes into transmitBuffer and roll them into the CRC
@@ -126,202 +341,317 @@ void sendPacket(const u08 packetType, const u08 *const data, const u08 dataLengt
 	transmitBuffer[5 + dataLength] = (u08)(crc >> 8);
 	transmitBuffer[6 + dataLength] = (u08)crc;
 
-	//increment downSequenceNum
-	downSequenceNum++;
+	const u08 *packet;
+#if PACKET_LINK_COBS
+	if (link->framing == PACKET_FRAMING_COBS)
+	{
+		/* Encode in place. Each zero is replaced with the distance to the next zero (or the end of the frame),
+		   and the distance to the first zero goes in the code byte at [1]. */
+		u08 codeIndex = 1;
+		for (u08 i = 2; i < 7 + dataLength; i++)
+		{
+			if (transmitBuffer[i] == 0)
+			{
+				transmitBuffer[codeIndex] = i - codeIndex;
+				codeIndex = i;
+			}
+		}
+		transmitBuffer[codeIndex] = 7 + dataLength - codeIndex;
+		//frame delimiter
+		transmitBuffer[7 + dataLength] = 0;
+		packet = &transmitBuffer[1];
+	}
+	else
+#endif
+	{
+		transmitBuffer[0] = START_BYTE1;
+		transmitBuffer[1] = START_BYTE2;
+		packet = transmitBuffer;
+	}
 
-	//setup variables used by the ISR
-	transmitIndex = 0;
-	transmitLength = 7 + dataLength;
+	if (!enqueueFrame(link, priority, packet, PACKET_OVERHEAD + dataLength))
+		return FALSE;
+	link->stats.packetsSent++;
+#if PACKET_LINK_PRIORITIES
+	pumpQueues(link);
+#endif
+	return TRUE;
+}
+
+#if PACKET_LINK_PRIORITIES
+
+/*! Stores a frame, preceded by its length, in the queue for a priority.
+    @return FALSE if the frame was dropped because the queue doesn't have room for it.
+ */
+static bool enqueueFrame(PacketLink *const link, const PacketPriority priority, const u08 *const frame, const u08 length)
+{
+	if (priority >= NUM_PACKET_PRIORITIES)
+	{
+		SOFTWARE_FAULT(PSTR("invalid priority"), priority, length);
+		return FALSE;
+	}
+	const u16 mask = queueMasks[priority];
+	u08 *const queue = &link->queueBuffer[queueOffsets[priority]];
+	u16 tail = link->queueTail[priority];
 
-	codeTrack(2);
+	//head and tail run freely, so the number of bytes used is their difference
+	if ((u16)(tail - link->queueHead[priority]) + 1 + length > mask + 1)
+	{
+		link->stats.queueDrops[priority]++;
+		link->stats.droppedPackets++;
+		return FALSE;
+	}
 
-	//Enable the USART0_UDRE_vect interrupt by setting Data Register Empty Interrupt Enable bit to 1.
-	sbi(UCSR0B, UDRIE0);
+	queue[tail++ & mask] = length;
+	for (u08 i = 0; i < length; i++)
+	{
+		queue[tail++ & mask] = frame[i];
+	}
+	link->queueTail[priority] = tail;
+	const u16 used = tail - link->queueHead[priority];
+	if (used > link->stats.queueHighWater[priority])
+		link->stats.queueHighWater[priority] = used;
+	return TRUE;
 }
 
-/*! This interrupt is triggered when the USART's transmit buffer register is empty.
- *  Using this interrupt allows the ATmega CPU to do something else while it waits for each byte to transmit.
+/*! Moves whole frames from the queues into the UART transmit buffer, highest priority first, until the next frame
+    doesn't fit. A lower priority frame is never moved ahead of a waiting higher priority one, since it would
+    only delay it more. Telemetry and debug frames are held back while the UART has more than ::PACKET_BULK_TX_LIMIT
+    bytes to send, so the next control or fault frame doesn't have to wait long behind them.
+    While switching baud rate, only the control frames up to BaudChange::switchHead (such as the acceptance of the
+    change) still go out, and everything else waits for the new rate.
  */
-ISR(USART0_UDRE_vect)
+static void pumpQueues(PacketLink *const link)
 {
-	//Put the current byte into the data register and increment index to next byte.
-	UDR0 = transmitBuffer[transmitIndex++];
+	const bool switching = (link->baudChange.state == BAUD_SWITCHING);
+	for (u08 priority = 0; priority < NUM_PACKET_PRIORITIES; priority++)
+	{
+		if (switching && priority != PACKET_PRIORITY_CONTROL)
+			return;
 
-	//If there is no more data in the buffer to send, then disable this interrupt so it doesn't keep getting called.
-	if (transmitIndex >= transmitLength)
+		const u16 mask = queueMasks[priority];
+		const u08 *const queue = &link->queueBuffer[queueOffsets[priority]];
+		u16 head = link->queueHead[priority];
+
+		while (head != link->queueTail[priority])
+		{
+			if (switching && head == link->baudChange.switchHead)
+				return;
+			const u08 length = queue[head & mask];
+			if (uartTxFree(link->port) < length)
+				return;
+			if (priority >= PACKET_PRIORITY_TELEMETRY)
+			{
+				const u08 pending = uartTxPending(link->port);
+				if (pending > 0 && pending + length > PACKET_BULK_TX_LIMIT)
+					return;
+			}
+
+			//the frame may wrap around the end of the queue, so write it in up to 2 pieces
+			const u16 start = (head + 1) & mask;
+			const u08 firstPiece = (start + length > mask + 1) ? mask + 1 - start : length;
+			uartWrite(link->port, &queue[start], firstPiece);
+			if (firstPiece < length)
+				uartWrite(link->port, queue, length - firstPiece);
+			head += 1 + length;
+			link->queueHead[priority] = head;
+			link->stats.bytesSent += length;
+		}
+	}
+}
+#else
+/*! Writes a frame straight into the UART transmit buffer, since there are no queues to hold it.
+    @return FALSE if the frame was dropped because the UART doesn't have room for it, or because a baud rate change is
+    switching, when it would go out at the old rate.
+ */
+static bool enqueueFrame(PacketLink *const link, const PacketPriority priority, const u08 *const frame, const u08 length)
+{
+	if (priority >= NUM_PACKET_PRIORITIES)
 	{
-		//disable this interrupt by setting Data Register Empty Interrupt Enable bit to 0.
-		cbi(UCSR0B, UDRIE0);
+		SOFTWARE_FAULT(PSTR("invalid priority"), priority, length);
+		return FALSE;
 	}
-	codeTrack(3);
+	if (link->baudChange.state == BAUD_SWITCHING || !uartWriteAll(link->port, frame, length))
+	{
+		link->stats.queueDrops[priority]++;
+		link->stats.droppedPackets++;
+		return FALSE;
+	}
+	link->stats.bytesSent += length;
+	return TRUE;
 }
+#endif
 
-//! This interrupt is triggered when a character is received on UART0 from the computer.
-ISR(USART0_RX_vect)
+//! Registers the functions that handle the packets received from the PC. See packetLinkConfig().
+void configPacketProcessor(ValidateDataLengthCallback_t newValidator, ExecCallback_t newExecutor, u08 newMaxPacketType)
 {
-	//Read the received byte from the UART0 Data Received register and save into the circular receiveBuffer.
-	//Increment tail to the next buffer position.
-	receiveBuffer[tail++] = UDR0;
+	packetLinkConfig(&pcLink, newValidator, newExecutor, newMaxPacketType);
+}
 
-	//If tail now matches head (falsely indicating empty), then the buffer is overfilled.
-	//We discard the oldest byte of data to make room. Hopefully, this is never necessary.
-	if (tail == head)
-	{
-		head++;
+//! Initializes the link to the PC on UART0.
+void initPacketDriver()
+{
+	packetLinkInit(&pcLink, UART_PORT0, PC_LINK_FRAMING);
+}
 
-		//Log that a buffer overfilled condition occurred.
-		ledOn();
-		bufferOverfilledCounter++;
-	}
-	codeTrack(4);
+//! Processes the packets received from the PC.
+void execPacketDriver()
+{
+	packetLinkExec(&pcLink);
 }
 
-enum PacketStates
+//! Sends a packet to the PC. See packetLinkSend().
+void sendPacket(const u08 packetType, const u08 *const data, const u08 dataLength)
 {
-	STATE_Start1,
-	STATE_Start2,
-	STATE_PacketType,
-	STATE_SequenceNum,
-	STATE_DataLength,
-	STATE_DataSection,
-	STATE_CrcMsb,
-	STATE_CrcLsb,
-	NUM_States
-};
+	packetLinkSend(&pcLink, packetType, data, dataLength);
+}
+
+//! Sends a packet to the PC at a priority. See packetLinkSendPriority().
+void sendPacketPriority(const PacketPriority priority, const u08 packetType, const u08 *const data, const u08 dataLength)
+{
+	packetLinkSendPriority(&pcLink, priority, packetType, data, dataLength);
+}
 
+/*! Copies bytes from the link's UART receive buffer into its receiveBuffer, as far as there is room.
+    Bytes that don't fit stay in the UART receive buffer until the parser has freed up space.
+ */
+static void fillPacketBuffer(PacketLink *const link)
+{
+	//one slot is always left empty, since head == tail means the buffer is empty
+	u08 space = link->head - link->tail - 1;
+	//copy in up to two runs, since the free space may wrap around the end of receiveBuffer
+	while (space > 0)
+	{
+		const u16 toEnd = PACKET_RX_BUFFER_LENGTH - link->tail;
+		const u08 run = (toEnd < space) ? (u08)toEnd : space;
+		u08 count = uartRead(link->port, &link->receiveBuffer[link->tail], run);
+		if (count == 0)
+			break;
+		link->tail += count;
+		space -= count;
+		link->stats.bytesReceived += count;
+	}
+}
 
-//! Runs through a state machine with the received bytes.
-static void processPacketBuffer()
+//! Runs through a state machine with the received bytes of a link.
+static void processPacketBuffer(PacketLink *const link)
 {
-	static u08 processIndex = 0;
-	static u08 state = STATE_Start1, receiveByte;
-	static u08 packetType, sequence, dataLength, dataCounter;
-	static u16 computedCRC, receivedCRC;
-	static u08 dataBuffer[DATA_SECTION_LENGTH];
+	u08 receiveByte;
 
-	while (processIndex != tail)
+	//stop if a link control packet switched the framing, or enough packets were dispatched for now
+	while (link->processIndex != link->tail && link->framing == PACKET_FRAMING_START_BYTES && link->dispatchesLeft > 0)
 	{
-		receiveByte = receiveBuffer[processIndex++];
-		//If processIndex is now beyond the end of the buffer, wrap around to the beginning.
-		if (processIndex >= RX_BUFFER_LENGTH)
-		{
-			processIndex = 0;
-		}
+		//processIndex wraps around to the beginning of the buffer by itself
+		receiveByte = link->receiveBuffer[link->processIndex++];
 /*
 lcdCursor(0,0);
-printHexDigit(state);
+printHexDigit(link->state);
 printChar(' ');
 printHex_u08(receiveByte);
 printChar(' ');
 */
 
-		switch (state)
+		switch (link->state)
 		{
 			case STATE_Start1:
 				//we don't need to keep storing the byte in the buffer
-				head++;
+				link->head++;
 				if (receiveByte == START_BYTE1)
 				{
-					state = STATE_Start2;
+					link->state = STATE_Start2;
+				}
+				else
+				{
+					//not the start of a packet, so something was garbled or lost. state = STATE_Start1 (no change)
+					loseSync(link);
 				}
-				//else state = STATE_Start1 (no change)
 				break;
 			case STATE_Start2:
 				//we don't need to keep storing the byte in the buffer
-				head++;
+				link->head++;
 				if (receiveByte == START_BYTE2)
 				{
-					state = STATE_PacketType;
+					link->state = STATE_PacketType;
 				}
 				else if (receiveByte != START_BYTE1)
 				{
-					state = STATE_Start1;
+					loseSync(link);
+					link->state = STATE_Start1;
 				}
 				//else receiveByte is START_BYTE1, so stay in STATE_Start2.
 				break;
 			case STATE_PacketType:
 				//we don't need to keep storing the byte in the buffer
-				head++;
+				link->head++;
 				//Check if this is a valid packet type to receive
-				if (receiveByte <= maxPacketType)
-				{
-					packetType = receiveByte;
-					state = STATE_SequenceNum;
-				}
-				else if (receiveByte == START_BYTE1)
+				if (validPacketType(link, receiveByte))
 				{
-					state = STATE_Start2;
+					link->packetType = receiveByte;
+					link->state = STATE_SequenceNum;
 				}
 				else
 				{
-					state = STATE_Start1;
+					link->stats.invalidHeaders++;
+					loseSync(link);
+					if (receiveByte == START_BYTE1)
+						link->state = STATE_Start2;
+					else
+						link->state = STATE_Start1;
 				}
 				break;
 			case STATE_SequenceNum:
 				//we don't need to keep storing the byte in the buffer
-				head++;
+				link->head++;
 				//can't do any checking on sequence, so just store it
-				sequence = receiveByte;
-				state = STATE_DataLength;
+				link->sequence = receiveByte;
+				link->state = STATE_DataLength;
 				break;
 			case STATE_DataLength:
 				//we don't need to keep storing the byte in the buffer
-				head++;
-
-				//Call the registered validator function to validate the
-				//dataLength allowed by this specific packetType.
-				bool valid;
-				if (validator != NULL)
-				{
-					logDebug("call validator %d", packetType);
-					valid = validator(packetType, receiveByte);
-				}
-				else
-				{
-					logDebug("no validator");
-					valid = (receiveByte <= MAX_PACKET_DATA);
-				}
+				link->head++;
 
 				//if length was invalid, do parser recovery.
-				if (!valid)
+				if (!validDataLength(link, link->packetType, receiveByte))
 				{
+					link->stats.invalidHeaders++;
+					loseSync(link);
 					//check if the sequence number and data length have start bytes.
-					if (sequence == START_BYTE1 && receiveByte == START_BYTE2)
+					if (link->sequence == START_BYTE1 && receiveByte == START_BYTE2)
 					{
 						//looks like a start sequence, so go to STATE_PacketType
-						state = STATE_PacketType;
+						link->state = STATE_PacketType;
 					}
 					else if (receiveByte == START_BYTE1)
 					{
-						state = STATE_Start2;
+						link->state = STATE_Start2;
 					}
 					else
 					{
 						//reset packet parser to beginning
-						state = STATE_Start1;
+						link->state = STATE_Start1;
 					}
 				}
 				else
 				{
 					//data length is valid, so save it
-					dataLength = receiveByte;
+					link->dataLength = receiveByte;
 					//CRC-CCITT initializes all bits to 1
-					computedCRC = 0xFFFF;
+					link->computedCRC = 0xFFFF;
 					//calculate CRC-CCITT over packetType, sequenceNum, and dataLength
-					computedCRC = updateCrcCcitt(computedCRC, packetType);
-					computedCRC = updateCrcCcitt(computedCRC, sequence);
-					computedCRC = updateCrcCcitt(computedCRC, dataLength);
+					link->computedCRC = updateCrcCcitt(link->computedCRC, link->packetType);
+					link->computedCRC = updateCrcCcitt(link->computedCRC, link->sequence);
+					link->computedCRC = updateCrcCcitt(link->computedCRC, link->dataLength);
 
-					if (dataLength == 0)
+					if (link->dataLength == 0)
 					{
 						//skip STATE_DataSection because there is no data
-						state = STATE_CrcMsb;
+						link->state = STATE_CrcMsb;
 					}
 					else
 					{
 						//initialize dataCounter used to count down data bytes in Data section state
-						dataCounter = dataLength;
-						state = STATE_DataSection;
+						link->dataCounter = link->dataLength;
+						link->state = STATE_DataSection;
 					}
 				}
 				break;
@@ -329,101 +659,598 @@ printChar(' ');
 			case STATE_DataSection:
 				//keep the data bytes in the circular buffer (don't modify head here)
 				//add to CRC
-				computedCRC = updateCrcCcitt(computedCRC, receiveByte);
-				dataCounter--;
+				link->computedCRC = updateCrcCcitt(link->computedCRC, receiveByte);
+				link->dataCounter--;
 				//if all data has been received, advance to STATE_CrcMsb
-				if (dataCounter == 0)
+				if (link->dataCounter == 0)
 				{
-					state = STATE_CrcMsb;
+					link->state = STATE_CrcMsb;
 				}
 				break;
 			//MSB of 16-bit CRC-CCITT
 			case STATE_CrcMsb:
-				receivedCRC = ((u16)receiveByte) << 8;
-				state = STATE_CrcLsb;
+				link->receivedCRC = ((u16)receiveByte) << 8;
+				link->state = STATE_CrcLsb;
 				break;
 			//LSB of 16-bit CRC-CCITT
 			case STATE_CrcLsb:
-				receivedCRC |= receiveByte;
+				link->receivedCRC |= receiveByte;
 				//verify that the checksums match
-				if (receivedCRC == computedCRC)
+				if (link->receivedCRC == link->computedCRC)
 				{
-					codeTrack(5);
 					//CRC values matched, so copy the data section to another buffer to linearize it and free up space in receiveBuffer.
-					for (u08 i = 0; i < dataLength; i++)
+					for (u08 i = 0; i < link->dataLength; i++)
 					{
-						dataBuffer[i] = receiveBuffer[head++];
-						//If head is now beyond the end of the buffer, wrap around to the beginning.
-						if (head >= RX_BUFFER_LENGTH)
-						{
-							head = 0;
-						}
+						link->dataBuffer[i] = link->receiveBuffer[link->head++];
 					}
 					//Free up the space occupied by the two CRC bytes in the receiveBuffer.
-					head += 2;
-					//If head is now beyond the end of the buffer, wrap around to the beginning.
-					if (head >= RX_BUFFER_LENGTH)
-					{
-						head = head - RX_BUFFER_LENGTH;
-					}
-					//Call the registered exec function, if any
-					logDebug("Exec packet %d", packetType);
-					if (executor != NULL)
-					{
-						//TODO: start debug code
-						clearScreen();
-						/*printString("exec pkt ");
-						print_u08(packetType);
-						printChar(' ');
-						print_u08(dataLength);*/
-						//TODO: end debug code
-						executor(packetType, dataBuffer, dataLength);
-					}
+					link->head += 2;
+					//look for the next packet
+					link->state = STATE_Start1;
+					dispatchPacket(link);
 				}
 				else
 				{
 					//TODO: start debug code
+				#if USE_LCD == 1
 					clearScreen();
 					printString("BadCRC comp!=rcv");
 					lowerLine();
-					printHex_u16(computedCRC);
+					printHex_u16(link->computedCRC);
 					printChar(' ');
-					printHex_u16(receivedCRC);
+					printHex_u16(link->receivedCRC);
+				#endif
 					//TODO: end debug code
 
-					logDebug("Bad CRC %02X != %02X", computedCRC, receivedCRC);
-					codeTrack(6);
+					link->stats.crcErrors++;
+					loseSync(link);
+					logDebug("Bad CRC %02X != %02X", link->computedCRC, link->receivedCRC);
 					//CRC values don't match, packet is either corrupted or we are out of sync with a real packet boundary.
 					//Recover as rapidly as possible by searching for packet starts within the data we already received.
 
 					//check if the sequence number and data length have start bytes.
-					if (sequence == START_BYTE1 && dataLength == START_BYTE2)
+					if (link->sequence == START_BYTE1 && link->dataLength == START_BYTE2)
 					{
 						//looks like a start sequence, so go to Packet Type state
-						state = STATE_PacketType;
+						link->state = STATE_PacketType;
 					}
-					else if (dataLength == START_BYTE1)
+					else if (link->dataLength == START_BYTE1)
 					{
-						state = STATE_Start2;
+						link->state = STATE_Start2;
 					}
 					else
 					{
-						state = STATE_Start1;
+						link->state = STATE_Start1;
 					}
 					//Back up the parser to re-process what we originally thought were data and checksum in the receiveBuffer.
-					processIndex = head;
+					link->processIndex = link->head;
 				}
 				break;
 			default:
 				//Fell out of packet parser. This should be impossible.
 				ledOn();
-				SOFTWARE_FAULT("invalid parser state", state, processIndex);
-				state = STATE_Start1;
+				SOFTWARE_FAULT(PSTR("invalid parser state"), link->state, link->processIndex);
+				link->state = STATE_Start1;
 				break;
 		}
 	}
 }
 
+#if PACKET_LINK_COBS
+/*! Runs the COBS decoder with the received bytes of a link.
+    Bytes are decoded as they arrive, so nothing needs to be kept in receiveBuffer after it has been processed,
+    and a damaged frame is dropped at the next 0x00 delimiter without any rewinding.
+ */
+static void processCobsBuffer(PacketLink *const link)
+{
+	//stop if a link control packet switched the framing, or enough packets were dispatched for now
+	while (link->processIndex != link->tail && link->framing == PACKET_FRAMING_COBS && link->dispatchesLeft > 0)
+	{
+		const u08 receiveByte = link->receiveBuffer[link->processIndex++];
+		//the decoder keeps its own state, so the byte can be freed up right away
+		link->head = link->processIndex;
+
+		if (receiveByte == 0)
+		{
+			//end of frame. Back to back delimiters are harmless, so ignore empty frames.
+			if (link->cobsCode != 0 && !link->frameDropped)
+			{
+				//the frame is complete only if the last block and both CRC bytes arrived
+				if (link->cobsRemaining != 0 || link->frameLength < 3 || link->frameLength != link->dataLength + 5)
+				{
+					link->stats.framingErrors++;
+					loseSync(link);
+				}
+				else if (link->receivedCRC == link->computedCRC)
+				{
+					dispatchPacket(link);
+				}
+				else
+				{
+					link->stats.crcErrors++;
+					loseSync(link);
+				}
+			}
+			resetParser(link);
+		}
+		else if (link->cobsRemaining == 0)
+		{
+			//receiveByte is a code byte. Every code byte except the first one and those following a full block stands for a zero.
+			if (link->cobsCode != 0 && link->cobsCode != 0xFF)
+				decodeCobsByte(link, 0);
+			link->cobsCode = receiveByte;
+			link->cobsRemaining = receiveByte - 1;
+		}
+		else
+		{
+			decodeCobsByte(link, receiveByte);
+			link->cobsRemaining--;
+		}
+	}
+}
+
+//! Handles one decoded byte of a COBS frame, checking the header as soon as it arrives.
+static void decodeCobsByte(PacketLink *const link, const u08 decodedByte)
+{
+	if (link->frameDropped)
+		return;
+
+	const u08 index = link->frameLength++;
+	if (index == 0)
+	{
+		if (!validPacketType(link, decodedByte))
+		{
+			link->stats.invalidHeaders++;
+			loseSync(link);
+			link->frameDropped = TRUE;
+		}
+		link->packetType = decodedByte;
+	}
+	else if (index == 1)
+	{
+		link->sequence = decodedByte;
+	}
+	else if (index == 2)
+	{
+		if (!validDataLength(link, link->packetType, decodedByte))
+		{
+			link->stats.invalidHeaders++;
+			loseSync(link);
+			link->frameDropped = TRUE;
+		}
+		link->dataLength = decodedByte;
+		//CRC-CCITT initializes all bits to 1
+		link->computedCRC = 0xFFFF;
+		//calculate CRC-CCITT over packetType, sequenceNum, and dataLength
+		link->computedCRC = updateCrcCcitt(link->computedCRC, link->packetType);
+		link->computedCRC = updateCrcCcitt(link->computedCRC, link->sequence);
+		link->computedCRC = updateCrcCcitt(link->computedCRC, link->dataLength);
+	}
+	else if (index < link->dataLength + 3)
+	{
+		link->dataBuffer[index - 3] = decodedByte;
+		link->computedCRC = updateCrcCcitt(link->computedCRC, decodedByte);
+	}
+	else if (index == link->dataLength + 3)
+	{
+		link->receivedCRC = ((u16)decodedByte) << 8;
+	}
+	else if (index == link->dataLength + 4)
+	{
+		link->receivedCRC |= decodedByte;
+	}
+	else
+	{
+		//more bytes than the dataLength allows for
+		link->stats.framingErrors++;
+		loseSync(link);
+		link->frameDropped = TRUE;
+	}
+}
+#endif
+
+/*! Records the time spent parsing if it is the longest so far. The fast ticks wrap around every 32 ms, and
+    getUptimeMs() only changes every 8 ms, so anything that might be longer than 32 ms (such as a CMD_DELAY_MS in
+    the executor) is measured in milliseconds instead.
+ */
+static void updateParseTime(PacketLink *const link, const u16 startTicks, const u32 startMs)
+{
+	const u16 ticks = getFastTicks() - startTicks;
+	const u32 ms = getUptimeMs() - startMs;
+	u16 us;
+	if (ms < 24)
+		us = ticks / FAST_TICKS_PER_US;
+	else if (ms < 65)
+		us = (u16)(ms * 1000);
+	else
+		us = 0xFFFF;
+	if (us > link->stats.maxParseUs)
+		link->stats.maxParseUs = us;
+}
+
+//! Counts a loss of sync on a link, unless the parser is still looking for a packet after an earlier one.
+static void loseSync(PacketLink *const link)
+{
+	if (link->resyncing)
+		return;
+	link->resyncing = TRUE;
+	link->stats.resyncs++;
+}
+
+//! Puts the parsers of a link back into the state for the start of a packet.
+static void resetParser(PacketLink *const link)
+{
+	link->state = STATE_Start1;
+#if PACKET_LINK_COBS
+	link->cobsCode = 0;
+	link->cobsRemaining = 0;
+	link->frameLength = 0;
+	link->frameDropped = FALSE;
+#endif
+}
+
+//! Checks if a link accepts a packetType.
+static bool validPacketType(PacketLink *const link, const u08 packetType)
+{
+	return (packetType <= link->maxPacketType) || (packetType >= LINK_CONTROL_FIRST && packetType < LAST_LinkControlPacketType);
+}
+
+//! Checks if a dataLength is allowed for a packetType.
+static bool validDataLength(PacketLink *const link, const u08 packetType, const u08 dataLength)
+{
+	if (packetType >= LINK_CONTROL_FIRST)
+	{
+		switch (packetType)
+		{
+			case LINK_ACK:
+			case LINK_PING:
+			case LINK_PONG:
+				return (dataLength == 0);
+			case LINK_SET_BAUD:
+			case LINK_BAUD_SET:
+				return (dataLength == 4);
+			default:
+				//the rest hold a single setting
+				return (dataLength == 1);
+		}
+	}
+	//Call the registered validator function to validate the
+	//dataLength allowed by this specific packetType.
+	if (link->validator != NULL)
+	{
+		if (link->validator(packetType, dataLength))
+			return TRUE;
+		link->stats.validatorRejections++;
+		return FALSE;
+	}
+	return (dataLength <= MAX_PACKET_DATA);
+}
+
+//! Passes a received packet with a valid CRC to the link's executor, or handles it if it is a link control packet.
+static void dispatchPacket(PacketLink *const link)
+{
+	link->dispatchesLeft--;
+	link->stats.packetsReceived++;
+	link->resyncing = FALSE;
+#if PACKET_LINK_RELIABLE
+	//drop reliable packets that were already delivered, or that arrived after a lost one
+	if (link->reliable.enabled && !receiveReliable(link))
+		return;
+#endif
+	if (link->packetType >= LINK_CONTROL_FIRST)
+	{
+		execLinkControl(link);
+		return;
+	}
+	//Call the registered exec function, if any
+	if (link->executor != NULL)
+	{
+		link->executor(link->packetType, link->sequence, link->dataBuffer, link->dataLength);
+	}
+}
+
+//! Handles a link control packet.
+static void execLinkControl(PacketLink *const link)
+{
+	switch (link->packetType)
+	{
+		case LINK_SET_FRAMING:
+		{
+			const u08 framing = link->dataBuffer[0];
+			if (framing >= NUM_PACKET_FRAMINGS)
+			{
+				logWarning("unknown framing %d", framing);
+				break;
+			}
+			if (framing >= NUM_LINK_FRAMINGS)
+			{
+				//left out of this build, so answer with the framing that stays in use
+				packetLinkSend(link, LINK_FRAMING_SET, &link->framing, 1);
+				break;
+			}
+			//confirm in the old framing, so the other end can still read it, then switch
+			packetLinkSend(link, LINK_FRAMING_SET, &framing, 1);
+			packetLinkSetFraming(link, framing);
+			break;
+		}
+		case LINK_FRAMING_SET:
+			//the other end has confirmed a switch that this end asked for
+			if (link->dataBuffer[0] < NUM_LINK_FRAMINGS)
+				packetLinkSetFraming(link, link->dataBuffer[0]);
+			break;
+		case LINK_SET_RELIABLE:
+		{
+			const u08 enabled = link->dataBuffer[0];
+			if (enabled > 1)
+			{
+				logWarning("invalid reliable setting %d", enabled);
+				break;
+			}
+#if PACKET_LINK_RELIABLE
+			//confirm in the old mode, so the other end can still read it, then switch
+			packetLinkSend(link, LINK_RELIABLE_SET, &enabled, 1);
+			packetLinkSetReliable(link, enabled);
+#else
+			//left out of this build, so answer that it stays off
+			const u08 off = 0;
+			packetLinkSend(link, LINK_RELIABLE_SET, &off, 1);
+#endif
+			break;
+		}
+#if PACKET_LINK_RELIABLE
+		case LINK_RELIABLE_SET:
+			//the other end has confirmed a switch that this end asked for
+			if (link->dataBuffer[0] <= 1)
+				packetLinkSetReliable(link, link->dataBuffer[0]);
+			break;
+#endif
+		case LINK_ACK:
+			//the acknowledgement in the sequenceNum has already been handled by receiveReliable()
+			break;
+		case LINK_SET_BAUD:
+		{
+			BaudChange *const change = &link->baudChange;
+			const u32 baud = ((u32)link->dataBuffer[0] << 24) | ((u32)link->dataBuffer[1] << 16) | ((u16)link->dataBuffer[2] << 8) | link->dataBuffer[3];
+			if (!uartBaudSupported(baud))
+			{
+				sendBaud(link, LINK_BAUD_SET, 0);
+				break;
+			}
+			//accept at the old rate, then switch once the acceptance has been sent, and wait for the proposer to ping.
+			//The acceptance may still be queued behind a full UART, so it and the control frames before it are let
+			//through while switching.
+			sendBaud(link, LINK_BAUD_SET, baud);
+			change->baud = baud;
+			change->proposer = FALSE;
+#if PACKET_LINK_PRIORITIES
+			change->switchHead = link->queueTail[PACKET_PRIORITY_CONTROL];
+#endif
+			change->state = BAUD_SWITCHING;
+			break;
+		}
+		case LINK_BAUD_SET:
+		{
+			BaudChange *const change = &link->baudChange;
+			const u32 baud = ((u32)link->dataBuffer[0] << 24) | ((u32)link->dataBuffer[1] << 16) | ((u16)link->dataBuffer[2] << 8) | link->dataBuffer[3];
+			if (change->state != BAUD_PROPOSED)
+				break;
+			if (baud == change->baud)
+			{
+				//the other end switches as soon as it has sent this, so nothing more is sent at the old rate
+#if PACKET_LINK_PRIORITIES
+				change->switchHead = link->queueHead[PACKET_PRIORITY_CONTROL];
+#endif
+				change->state = BAUD_SWITCHING;
+			}
+			else
+			{
+				logWarning("baud %lu refused", change->baud);
+				change->state = BAUD_IDLE;
+			}
+			break;
+		}
+		case LINK_PING:
+			packetLinkSend(link, LINK_PONG, NULL, 0);
+			//a ping at the new rate confirms a change this end accepted
+			if (link->baudChange.state == BAUD_AWAITING_PING)
+				link->baudChange.state = BAUD_IDLE;
+			break;
+		case LINK_PONG:
+			//a reply at the new rate confirms a change this end proposed
+			if (link->baudChange.state == BAUD_CONFIRMING)
+				link->baudChange.state = BAUD_IDLE;
+			break;
+		default:
+			break;
+	}
+}
+
+#if PACKET_LINK_RELIABLE
+/*! Gets the acknowledgement bits to put in the sequenceNum of an outgoing packet.
+    Any packet sent on the link acknowledges everything received so far, so no separate ::LINK_ACK is needed.
+ */
+static u08 reliableAck(PacketLink *const link)
+{
+	link->reliable.ackPending = FALSE;
+	return RELIABLE_ACK_FLAG | link->reliable.expectedSequence;
+}
+
+//! Sends (or resends) the unacknowledged reliable packet with a sequence number.
+static void sendReliablePacket(PacketLink *const link, const u08 sequence)
+{
+	const ReliablePacket *const packet = &link->reliable.window[sequence & (RELIABLE_WINDOW_SIZE - 1)];
+	const u08 sequenceByte = RELIABLE_SEQ_FLAG | (sequence << RELIABLE_SEQ_SHIFT) | reliableAck(link);
+	transmitPacket(link, PACKET_PRIORITY_CONTROL, packet->packetType, sequenceByte, packet->data, packet->dataLength);
+}
+
+/*! Handles the sequenceNum of a packet received while the reliable channel is on.
+    @return TRUE if the packet should be delivered, or FALSE if it is a reliable packet that is a duplicate or out of order.
+ */
+static bool receiveReliable(PacketLink *const link)
+{
+	ReliableChannel *const channel = &link->reliable;
+	const u08 sequence = link->sequence;
+
+	if (sequence & RELIABLE_ACK_FLAG)
+	{
+		//the acknowledgement is cumulative: everything before the sequence number it holds has been received
+		const u08 ack = sequence & RELIABLE_SEQ_MASK;
+		const u08 outstanding = (channel->nextSequence - channel->oldestSequence) & RELIABLE_SEQ_MASK;
+		const u08 acked = (ack - channel->oldestSequence) & RELIABLE_SEQ_MASK;
+		//ignore stale acknowledgements
+		if (acked != 0 && acked <= outstanding)
+		{
+			channel->oldestSequence = ack;
+			channel->retransmitTime = getUptimeMs() + RELIABLE_RETRANSMIT_MS;
+		}
+	}
+
+	if (sequence & RELIABLE_SEQ_FLAG)
+	{
+		//acknowledge every reliable packet, even duplicates, in case the previous acknowledgement was lost
+		channel->ackPending = TRUE;
+		const u08 reliableSequence = (sequence >> RELIABLE_SEQ_SHIFT) & RELIABLE_SEQ_MASK;
+		if (reliableSequence != channel->expectedSequence)
+		{
+			link->stats.duplicates++;
+			return FALSE;
+		}
+		channel->expectedSequence = (reliableSequence + 1) & RELIABLE_SEQ_MASK;
+	}
+	return TRUE;
+}
+
+//! Resends unacknowledged packets when the retransmit timer expires, and sends any acknowledgement that wasn't piggybacked.
+static void updateReliable(PacketLink *const link)
+{
+	ReliableChannel *const channel = &link->reliable;
+	const u08 outstanding = (channel->nextSequence - channel->oldestSequence) & RELIABLE_SEQ_MASK;
+	const u32 now = getUptimeMs();
+
+	if (outstanding != 0 && (s32)(now - channel->retransmitTime) >= 0)
+	{
+		//go back N: resend everything that hasn't been acknowledged, in order
+		for (u08 i = 0; i < outstanding; i++)
+		{
+			sendReliablePacket(link, (channel->oldestSequence + i) & RELIABLE_SEQ_MASK);
+			link->stats.retransmissions++;
+		}
+		channel->retransmitTime = now + RELIABLE_RETRANSMIT_MS;
+	}
+
+	if (channel->ackPending)
+	{
+		transmitPacket(link, PACKET_PRIORITY_CONTROL, LINK_ACK, reliableAck(link), NULL, 0);
+	}
+}
+#endif
+
+//! Sends a ::LINK_SET_BAUD or ::LINK_BAUD_SET packet.
+static void sendBaud(PacketLink *const link, const u08 packetType, const u32 baud)
+{
+	const u08 data[4] = {(u08)(baud >> 24), (u08)(baud >> 16), (u08)(baud >> 8), (u08)baud};
+	packetLinkSend(link, packetType, data, sizeof(data));
+}
+
+//! Runs the timers of a baud rate change.
+static void updateBaudChange(PacketLink *const link)
+{
+	BaudChange *const change = &link->baudChange;
+	const u32 now = getUptimeMs();
+	const bool timedOut = ((s32)(now - change->timeout) >= 0);
+
+	switch (change->state)
+	{
+		case BAUD_PROPOSED:
+			if (!timedOut)
+				break;
+			//the last proposal was either not answered, or accepted and then failed
+			if (++change->failures >= BAUD_MAX_FAILURES)
+			{
+				logWarning("giving up on baud %lu", change->baud);
+				change->state = BAUD_IDLE;
+				break;
+			}
+			sendBaud(link, LINK_SET_BAUD, change->baud);
+			change->timeout = now + BAUD_PROPOSE_INTERVAL_MS;
+			break;
+		case BAUD_SWITCHING:
+			//switch only after everything due at the old rate has been sent, so the two ends switch at a packet boundary
+#if PACKET_LINK_PRIORITIES
+			if (link->queueHead[PACKET_PRIORITY_CONTROL] != change->switchHead)
+				break;
+#endif
+			if (!uartTxIdle(link->port))
+				break;
+			uartSetBaud(link->port, change->baud);
+			//anything partly received at the old rate is garbage now
+			discardPartialPacket(link);
+			if (change->proposer)
+			{
+				//leave BAUD_SWITCHING first, so the ping isn't held back (or dropped without queues)
+				change->state = BAUD_CONFIRMING;
+				packetLinkSend(link, LINK_PING, NULL, 0);
+				change->attempts = 1;
+				change->timeout = now + BAUD_PING_INTERVAL_MS;
+			}
+			else
+			{
+				change->state = BAUD_AWAITING_PING;
+				change->timeout = now + BAUD_CONFIRM_TIMEOUT_MS;
+			}
+			break;
+		case BAUD_CONFIRMING:
+			if (!timedOut)
+				break;
+			if (change->attempts < BAUD_PING_ATTEMPTS)
+			{
+				packetLinkSend(link, LINK_PING, NULL, 0);
+				change->attempts++;
+				change->timeout = now + BAUD_PING_INTERVAL_MS;
+			}
+			else
+			{
+				fallBackToBootBaud(link);
+			}
+			break;
+		case BAUD_AWAITING_PING:
+			if (timedOut)
+				fallBackToBootBaud(link);
+			break;
+		default:
+			change->state = BAUD_IDLE;
+			break;
+	}
+}
+
+//! Goes back to the boot baud rate after a baud rate change that wasn't confirmed, and proposes again if allowed.
+static void fallBackToBootBaud(PacketLink *const link)
+{
+	BaudChange *const change = &link->baudChange;
+	//whatever is still queued at the new rate won't be understood, so it doesn't matter if it gets garbled
+	uartSetBaud(link->port, change->bootBaud);
+	discardPartialPacket(link);
+
+	if (change->proposer)
+	{
+		//give the other end time to fall back too. The failure is counted when the wait is over, like an unanswered proposal.
+		change->state = BAUD_PROPOSED;
+		change->timeout = getUptimeMs() + BAUD_PROPOSE_INTERVAL_MS;
+	}
+	else
+	{
+		change->state = BAUD_IDLE;
+	}
+	logWarning("baud %lu failed, back to %lu", change->baud, change->bootBaud);
+}
+
+//! Drops whatever has been received of the current packet, but not the bytes the parser hasn't looked at yet.
+static void discardPartialPacket(PacketLink *const link)
+{
+	link->head = link->processIndex;
+	resetParser(link);
+}
+
 //! Updates a CRC CCITT to include another byte of data.
 static u16 updateCrcCcitt(const u16 crc, const u08 dataByte)
 {
@@ -433,7 +1260,6 @@ static u16 updateCrcCcitt(const u16 crc, const u08 dataByte)
 /*
 static void resetPolyBot(const u08 * const data)
 {
-codeTrack(9);
 	//Check for the reset string in the packet's data section as extra verification that a reset was really intended.
 	const char * const resetString = "RESET_POLYBOT";
 	u08 i;
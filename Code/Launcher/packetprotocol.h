@@ -2,14 +2,18 @@
 #define PACKETPROTOCOL_H
 
 #include "globals.h"
+#include "uart.h"
 
 //! Defines a function pointer type for a method that validates dataLength.
 typedef bool(*ValidateDataLengthCallback_t)(const u08 packetType, const u08 dataLength);
-//! Defines a function pointer type for a method that handles a received packet.
-typedef void(*ExecCallback_t)(const u08 packetType, const u08 * const data, const u08 dataLength);
+/*! Defines a function pointer type for a method that handles a received packet.
+ *  The sequence is the packet's sequenceNum byte, which replies can echo so the sender can match them to requests.
+ */
+typedef void(*ExecCallback_t)(const u08 packetType, const u08 sequence, const u08 * const data, const u08 dataLength);
 
 /*! The minimum number of bytes in a packet (a packet with no data section).
  *  Includes: start1, start2, packetType, sequenceNum, dataLength, and 2 CRC bytes.
+ *  A COBS framed packet has the same overhead: a code byte, the 5 header and CRC bytes, and the 0x00 delimiter.
  */
 #define PACKET_OVERHEAD 7
 
@@ -18,11 +22,296 @@ typedef void(*ExecCallback_t)(const u08 packetType, const u08 * const data, cons
  */
 #define MAX_PACKET_DATA 200
 
+/*! Parts of the packet protocol that a small program, such as the bootloader, can leave out to save flash and RAM.
+ *  Each is on by default, and can be turned off with -D in the DEFINES of the project Makefile.
+ */
+#ifndef PACKET_LINK_COBS
+	//! Set to 0 to leave out ::PACKET_FRAMING_COBS. A ::LINK_SET_FRAMING to it is then answered with the framing in use.
+	#define PACKET_LINK_COBS 1
+#endif
+#ifndef PACKET_LINK_RELIABLE
+	//! Set to 0 to leave out the reliable channel. A ::LINK_SET_RELIABLE is then answered with it still off.
+	#define PACKET_LINK_RELIABLE 1
+#endif
+#ifndef PACKET_LINK_PRIORITIES
+	/*! Set to 0 to leave out the queues of the ::PacketPriority levels. Each packet then goes straight into the UART
+	 *  transmit buffer, and is dropped if it doesn't fit, which suits a program that sends one reply at a time.
+	 */
+	#define PACKET_LINK_PRIORITIES 1
+#endif
+
+/*! The ways packets can be delimited on a link.
+ *  Both ends of a link must use the same framing. Links start with the framing given to packetLinkInit(),
+ *  and either end can switch it with a ::LINK_SET_FRAMING packet.
+ */
+typedef enum
+{
+	//! Packets start with 0xA5 0x5A. The parser hunts for the start bytes byte by byte, and rewinds after a bad CRC.
+	PACKET_FRAMING_START_BYTES,
+	/*! Packets are Consistent Overhead Byte Stuffing encoded and end with a 0x00 delimiter, which never appears
+	 *  inside a packet. A corrupted packet is dropped at the next delimiter, without affecting the packets after it.
+	 */
+	PACKET_FRAMING_COBS,
+	NUM_PACKET_FRAMINGS
+} PacketFraming;
+
+/*! Packet types at or above this value are reserved for controlling the link itself, in both directions.
+ *  They are handled by the packet protocol instead of being passed to the link's executor.
+ */
+#define LINK_CONTROL_FIRST 0xF0
+
+//! Defines the link control packets.
+typedef enum
+{
+	/*! Requests a change of framing. data[0] is the new ::PacketFraming. The receiver replies with
+	 *  ::LINK_FRAMING_SET in the old framing, then uses the new framing in both directions.
+	 */
+	LINK_SET_FRAMING = LINK_CONTROL_FIRST,
+	//! Confirms a framing change. data[0] is the ::PacketFraming used from the next packet onwards.
+	LINK_FRAMING_SET,
+	/*! Turns the reliable channel on (data[0] = 1) or off (data[0] = 0). The receiver replies with
+	 *  ::LINK_RELIABLE_SET in the old mode, then both ends start from reliable sequence number 0.
+	 */
+	LINK_SET_RELIABLE,
+	//! Confirms a reliable channel change. data[0] is 1 if the reliable channel is on from the next packet onwards.
+	LINK_RELIABLE_SET,
+	//! Carries only an acknowledgement in its sequenceNum, for when there is no other packet to piggyback it on. No data.
+	LINK_ACK,
+	/*! Proposes a new baud rate. data[0..3] is the baud rate, MSB first. The receiver replies with ::LINK_BAUD_SET
+	 *  at the old rate, then both ends switch and the proposer confirms the new rate with ::LINK_PING.
+	 */
+	LINK_SET_BAUD,
+	//! Accepts a proposed baud rate. data[0..3] is the baud rate, MSB first, or 0 if the proposal is refused.
+	LINK_BAUD_SET,
+	//! Asks the other end to reply with ::LINK_PONG. No data.
+	LINK_PING,
+	//! Replies to ::LINK_PING. No data.
+	LINK_PONG,
+	LAST_LinkControlPacketType
+} LinkControlPacketType;
+
+/*! The size of each link's circular receive buffer. Must be 256, so the u08 indexes wrap around by themselves,
+ *  and it is large enough to store the maximum packet size plus 1 byte.
+ */
+#define PACKET_RX_BUFFER_LENGTH 256
+
+/*! The most received packets that each packetLinkExec() call passes to the executor (or handles as link control).
+ *  The rest wait in receiveBuffer for the next call, so a burst from the PC can't stall the main loop.
+ */
+#define PACKET_DISPATCH_LIMIT 4
+
+/*! The number of reliable packets that can be sent without being acknowledged yet.
+ *  Must be a power of 2 and no more than half of the 3-bit reliable sequence number space.
+ */
+#define RELIABLE_WINDOW_SIZE 4
+
+/*! The maximum data length of a reliable packet. Reliable packets are meant for commands and settings, so they
+ *  are kept small to limit the RAM used to store unacknowledged packets for retransmission.
+ */
+#define RELIABLE_MAX_DATA 32
+
+//! The time (in milliseconds) to wait for an acknowledgement before sending all unacknowledged packets again.
+#define RELIABLE_RETRANSMIT_MS 100
+
+/*! Layout of the sequenceNum byte while the reliable channel is on. The sequence numbers are 3 bits wide.
+ *  Every packet carries a cumulative acknowledgement: the next reliable sequence number its sender expects.
+ */
+#define RELIABLE_SEQ_FLAG      0x80 //!< Set if the packet is reliable, and must be acknowledged and delivered exactly once, in order.
+#define RELIABLE_SEQ_SHIFT     4    //!< Position of the 3-bit sequence number of a reliable packet.
+#define RELIABLE_ACK_FLAG      0x08 //!< Set if the acknowledgement bits are valid.
+#define RELIABLE_SEQ_MASK      0x07 //!< Mask of a 3-bit sequence number or acknowledgement.
+
+//! A reliable packet waiting to be acknowledged.
+typedef struct
+{
+	u08 packetType;
+	u08 dataLength;
+	u08 data[RELIABLE_MAX_DATA];
+} ReliablePacket;
+
+/*! Go-back-N state for the optional reliable channel of a link.
+ *  Unreliable packets (such as telemetry) are still sent straight away while it is on; they only gain an acknowledgement.
+ */
+typedef struct
+{
+	bool enabled;
+	u08 nextSequence;     //!< Sequence number of the next new reliable packet.
+	u08 oldestSequence;   //!< Sequence number of the oldest unacknowledged reliable packet.
+	u08 expectedSequence; //!< Sequence number of the next reliable packet expected from the other end.
+	bool ackPending;      //!< Set when an acknowledgement needs to be sent to the other end.
+	u32 retransmitTime;   //!< Time (from getUptimeMs()) to resend the unacknowledged packets.
+	//! Unacknowledged packets, indexed by sequence number modulo ::RELIABLE_WINDOW_SIZE.
+	ReliablePacket window[RELIABLE_WINDOW_SIZE];
+} ReliableChannel;
+
+//! How often (in milliseconds) a baud rate proposal is repeated until the other end answers it.
+#define BAUD_PROPOSE_INTERVAL_MS 1000
+//! How often (in milliseconds) the proposer pings at the new baud rate until it gets a reply.
+#define BAUD_PING_INTERVAL_MS 50
+//! The number of pings at the new baud rate before falling back to the boot baud rate.
+#define BAUD_PING_ATTEMPTS 5
+//! How long (in milliseconds) the accepting end waits for a ping at the new baud rate before falling back.
+#define BAUD_CONFIRM_TIMEOUT_MS (2 * BAUD_PING_INTERVAL_MS * BAUD_PING_ATTEMPTS)
+//! The number of unanswered proposals and failed baud rate changes after which the proposer gives up and stays at the boot baud rate.
+#define BAUD_MAX_FAILURES 3
+
+//! The steps of a baud rate change.
+typedef enum
+{
+	BAUD_IDLE,          //!< No change in progress.
+	BAUD_PROPOSED,      //!< Waiting for the other end to accept a proposal.
+	BAUD_SWITCHING,     //!< Waiting for the last frames at the old rate to be sent, before switching.
+	BAUD_CONFIRMING,    //!< Switched as the proposer, pinging until the other end replies.
+	BAUD_AWAITING_PING  //!< Switched as the accepting end, waiting for the proposer to ping.
+} BaudChangeState;
+
+//! State of a baud rate change on a link.
+typedef struct
+{
+	u08 state;          //!< The current ::BaudChangeState.
+	bool proposer;      //!< Set if this end proposed the change.
+	u08 attempts;       //!< Pings sent at the new rate so far.
+	u08 failures;       //!< Unanswered proposals, and changes that have fallen back to the boot baud rate.
+	u32 baud;           //!< The baud rate being switched to.
+	u32 bootBaud;       //!< The baud rate to fall back to, from UARTn_BAUD.
+	u32 timeout;        //!< Time (from getUptimeMs()) of the next retry or fallback.
+	u16 switchHead;     //!< While switching, the ::PACKET_PRIORITY_CONTROL queue position that is still sent at the old rate.
+} BaudChange;
+
+/*! Outgoing traffic classes, highest priority first. Each has its own queue on each link, and a queued packet is only
+ *  passed to the UART once every higher priority queue is empty. A packet never waits behind lower priority packets,
+ *  except for what the UART is already sending, which ::PACKET_BULK_TX_LIMIT keeps short.
+ */
+typedef enum
+{
+	PACKET_PRIORITY_CONTROL,    //!< Link control, reliable packets, and replies to commands.
+	PACKET_PRIORITY_FAULT,      //!< Warnings, critical errors and software faults.
+	PACKET_PRIORITY_TELEMETRY,  //!< Periodic sensor data.
+	PACKET_PRIORITY_DEBUG,      //!< Debug logs.
+	NUM_PACKET_PRIORITIES
+} PacketPriority;
+
+/*! The size of each priority's queue, in bytes. Each must be a power of 2, and large enough for the largest packet
+ *  sent at that priority plus 1 length byte.
+ */
+#define PACKET_QUEUE_CONTROL_LENGTH   256
+#define PACKET_QUEUE_FAULT_LENGTH     256
+#define PACKET_QUEUE_TELEMETRY_LENGTH 128
+#define PACKET_QUEUE_DEBUG_LENGTH     256
+#define PACKET_QUEUE_TOTAL_LENGTH (PACKET_QUEUE_CONTROL_LENGTH + PACKET_QUEUE_FAULT_LENGTH + PACKET_QUEUE_TELEMETRY_LENGTH + PACKET_QUEUE_DEBUG_LENGTH)
+
+/*! The most bytes the UART transmit buffer may hold for a ::PACKET_PRIORITY_TELEMETRY or ::PACKET_PRIORITY_DEBUG frame
+ *  to be added to it, counting the frame. A larger frame is only added once the buffer is empty. A control or fault
+ *  frame then waits for at most this much, or one lower priority frame, instead of a full buffer (67 ms at 38400 baud).
+ */
+#define PACKET_BULK_TX_LIMIT 64
+
+/*! Counters kept for each link, for development/testing purposes. All counters wrap around.
+ *  They are only updated by packetLinkExec() and the send functions, never from an interrupt.
+ */
+typedef struct
+{
+	u32 bytesReceived;   //!< Bytes taken from the UART receive buffer.
+	u32 bytesSent;       //!< Bytes passed to the UART transmit buffer.
+	u16 packetsReceived; //!< Packets received with a valid CRC and passed to the executor.
+	u16 packetsSent;     //!< Packets queued for transmission.
+	u16 crcErrors;       //!< Packets discarded because their CRC didn't match.
+	u16 framingErrors;   //!< COBS frames discarded because they were truncated or longer than their dataLength.
+	u16 invalidHeaders;  //!< Packet headers rejected because of an unknown packetType or an invalid dataLength.
+	u16 validatorRejections; //!< Packet headers (included in invalidHeaders) whose dataLength the link's validator rejected.
+	//! Times the parser lost track of the packet boundaries and had to search for the next packet, after any of the errors above.
+	u16 resyncs;
+	u16 droppedPackets;  //!< Packets not sent because their priority's queue was full or the data was too long.
+	u16 queueDrops[NUM_PACKET_PRIORITIES]; //!< Packets (included in droppedPackets) not sent because each priority's queue was full.
+	u16 queueHighWater[NUM_PACKET_PRIORITIES]; //!< The most bytes each priority's queue has held.
+	u16 retransmissions; //!< Reliable packets sent again because they weren't acknowledged in time.
+	u16 duplicates;      //!< Reliable packets received again or out of order, and discarded.
+	//! The longest time (in microseconds, up to 65535) one packetLinkExec() call spent parsing, including the executor.
+	u16 maxParseUs;
+} PacketLinkStats;
+
+/*! The state of one packet protocol link on one UART.
+ *  Each link has its own receive buffer, parser state, sequence numbers, statistics and registered handlers,
+ *  so several links can run at the same time. Treat the members as private, except for stats.
+ */
+typedef struct
+{
+	UartPort port;  //!< The UART this link sends and receives on.
+	u08 framing;    //!< The ::PacketFraming currently used in both directions.
+
+	//! Circular buffer that stores data received from the UART, copied from the UART receive buffer by packetLinkExec().
+	u08 receiveBuffer[PACKET_RX_BUFFER_LENGTH];
+	/*! Indexes that track the beginning and end of the circular receiveBuffer.
+	 *  When they are equal, there is nothing in the buffer. Length of data stored in the buffer is tail - head.
+	 */
+	u08 head, tail;
+	//! Index in receiveBuffer of the next byte for the parser to process.
+	u08 processIndex;
+	//! The number of packets the current packetLinkExec() call may still dispatch. See ::PACKET_DISPATCH_LIMIT.
+	u08 dispatchesLeft;
+
+	//Parser state for the packet currently being received.
+	u08 state;
+	u08 packetType;
+	u08 sequence;
+	u08 dataLength;
+	u08 dataCounter;
+	u16 computedCRC;
+	u16 receivedCRC;
+#if PACKET_LINK_COBS
+	//COBS decoder state for the frame currently being received.
+	u08 cobsCode;       //!< The most recent COBS code byte in this frame, or 0 at the start of a frame.
+	u08 cobsRemaining;  //!< Bytes left in the current COBS block before the next code byte.
+	u08 frameLength;    //!< Number of decoded bytes in this frame so far.
+	bool frameDropped;  //!< Set when this frame has been rejected, so the rest of it is skipped.
+#endif
+	bool resyncing;     //!< Set from an error until the next valid packet, so each loss of sync is counted once.
+	//! Stores the data section of a received packet contiguously, for the executor.
+	u08 dataBuffer[MAX_PACKET_DATA];
+
+	//! Sequence Number to include in the next outgoing packet, while the reliable channel is off.
+	u08 downSequenceNum;
+#if PACKET_LINK_RELIABLE
+	ReliableChannel reliable;
+#endif
+	BaudChange baudChange;
+
+#if PACKET_LINK_PRIORITIES
+	/*! Storage for the outgoing queue of each ::PacketPriority, one after another. Each queue is a circular buffer
+	 *  of complete packets, each preceded by its length.
+	 */
+	u08 queueBuffer[PACKET_QUEUE_TOTAL_LENGTH];
+	u16 queueHead[NUM_PACKET_PRIORITIES]; //!< Counts the bytes taken out of each queue. Masked to find the oldest byte.
+	u16 queueTail[NUM_PACKET_PRIORITIES]; //!< Counts the bytes put into each queue. Masked to find where the next byte goes.
+#endif
+
+	ValidateDataLengthCallback_t validator;
+	ExecCallback_t executor;
+	u08 maxPacketType;
+
+	PacketLinkStats stats;
+} PacketLink;
+
+//! The link to the PC on UART0, used by the original single-link functions below.
+extern PacketLink pcLink;
+
+void packetLinkInit(PacketLink *link, const UartPort port, const PacketFraming framing);
+void packetLinkSetFraming(PacketLink *link, const PacketFraming framing);
+void packetLinkConfig(PacketLink *link, ValidateDataLengthCallback_t validate, ExecCallback_t exec, u08 maxPacketType);
+void packetLinkExec(PacketLink *link);
+bool packetLinkSend(PacketLink *link, const u08 packetType, const u08 *const data, const u08 dataLength);
+bool packetLinkSendPriority(PacketLink *link, const PacketPriority priority, const u08 packetType, const u08 *const data, const u08 dataLength);
+bool packetLinkHasRoom(PacketLink *link, const PacketPriority priority, const u08 dataLength);
+#if PACKET_LINK_RELIABLE
+void packetLinkSetReliable(PacketLink *link, const bool enabled);
+bool packetLinkSendReliable(PacketLink *link, const u08 packetType, const u08 *const data, const u08 dataLength);
+#endif
+void packetLinkProposeBaud(PacketLink *link, const u32 baud);
+
 void configPacketProcessor(ValidateDataLengthCallback_t validate, ExecCallback_t exec, u08 maxPacketType);
 void initPacketDriver();
 void execPacketDriver();
 void sendPacket(const u08 packetType, const u08 *const data, const u08 dataLength);
-
-extern volatile u16 bufferOverfilledCounter;
+void sendPacketPriority(const PacketPriority priority, const u08 packetType, const u08 *const data, const u08 dataLength);
 
 #endif
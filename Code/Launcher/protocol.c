@@ -0,0 +1,96 @@
+/*! @file
+    Generated by Protocol/packetgen.py from Protocol/packets.schema. Do not edit; edit the schema instead.
+
+    The allowed dataLength range of each uplink packet type.
+ */
+#include "packetprotocol.h"
+#include "protocol.h"
+#include <avr/pgmspace.h>
+
+#if MAX_PACKET_DATA != 200
+	#error "MAX_PACKET_DATA doesn't match Protocol/packets.schema"
+#endif
+
+//! The shortest and longest data section of a packet type.
+typedef struct
+{
+	u08 min;
+	u08 max;
+} LengthRange;
+
+static const LengthRange commandsLengths[] PROGMEM =
+{
+	{0, 0}, //CMD_GET_VERSION
+	{0, 0}, //CMD_LED_ON
+	{0, 0}, //CMD_LED_OFF
+	{0, 0}, //CMD_RELAY_ON
+	{0, 0}, //CMD_RELAY_OFF
+	{0, 0}, //CMD_LCD_ON
+	{0, 0}, //CMD_LCD_OFF
+	{0, 0}, //CMD_CLEAR_SCREEN
+	{0, 0}, //CMD_LOWER_LINE
+	{0, 0}, //CMD_GET_BUTTON1
+	{0, 0}, //CMD_KNOB
+	{0, 0}, //CMD_KNOB10
+	{0, 0}, //CMD_SOFT_RESET
+	{0, 0}, //CMD_STOP_SOUND
+	{0, 0}, //CMD_EXIT_REMOTE
+	{2, 2}, //CMD_DELAY_MS
+	{2, 2}, //CMD_DELAY_US
+	{1, 200}, //CMD_PRINT_STRING
+	{1, 1}, //CMD_DIGITAL_INPUT
+	{1, 1}, //CMD_ANALOG
+	{1, 1}, //CMD_ANALOG10
+	{1, 1}, //CMD_SERVO_OFF
+	{1, 1}, //CMD_GET_SERVO_RANGE
+	{1, 1}, //CMD_PLAY_SOUND
+	{2, 2}, //CMD_SET_SERVO_RANGE_BY_INDEX
+	{2, 2}, //CMD_SET_SERVO_RANGE
+	{2, 2}, //CMD_SERVO
+	{2, 2}, //CMD_SERVO2
+	{2, 2}, //CMD_MOTOR
+	{2, 2}, //CMD_LCD_CURSOR
+	{2, 200}, //CMD_BATCH
+	{3, 200}, //CMD_SCRIPT_LOAD
+	{0, 0}, //CMD_SCRIPT_RUN
+	{0, 0}, //CMD_SCRIPT_STOP
+	{0, 0}, //CMD_SCRIPT_SAVE
+	{0, 0}, //CMD_SCRIPT_RESTORE
+	{5, 5}, //CMD_SUBSCRIBE
+};
+
+static const LengthRange uplinkPacketTypeLengths[] PROGMEM =
+{
+	{0, 0}, //GET_VERSIONS
+	{0, 0}, //PAUSE
+	{0, 0}, //RESUME
+	{0, 0}, //ABORT_TO_MENU
+	{0, 0}, //GET_STATS
+	{2, 2}, //SET_TELEMETRY
+	{1, 1}, //GET_TUNABLE_INFO
+	{1, 1}, //GET_TUNABLE
+	{3, 3}, //SET_TUNABLE
+	{0, 200}, //PING_REQUEST
+	{0, 200}, //BULK_SINK
+	{3, 3}, //BULK_SOURCE
+	{0, 0}, //GET_LINK_REPORT
+	{12, 12}, //TIME_SYNC
+	{1, 1}, //SET_LOG_TIMESTAMPS
+	{0, 0}, //ENTER_BOOTLOADER
+	{5, 5}, //SET_TRACE
+	{0, 0}, //DUMP_TRACE
+};
+
+//! Checks if a packet type is one the PC can send, and if its dataLength is allowed.
+bool protocolUplinkLengthValid(const u08 packetType, const u08 dataLength)
+{
+	const LengthRange *range;
+	if (packetType < NUM_CMD)
+		range = &commandsLengths[packetType - CMD_GET_VERSION];
+	else if (packetType >= GET_VERSIONS && packetType < LAST_UplinkPacketType)
+		range = &uplinkPacketTypeLengths[packetType - GET_VERSIONS];
+	else
+		return FALSE;
+
+	return (dataLength >= pgm_read_byte(&range->min) && dataLength <= pgm_read_byte(&range->max));
+}
@@ -0,0 +1,567 @@
+/*! @file
+    Generated by Protocol/packetgen.py from Protocol/packets.schema. Do not edit; edit the schema instead.
+
+    The packet types of the PC link, with accessors for the fields of uplink packets and encoders for the
+    fixed fields of downlink packets. All multi-byte fields are MSB first.
+ */
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "globals.h"
+
+#define LAUNCHER_UPLINK_FIRST 0x40
+//! The layout of STATS_DATA, sent as its first byte. Increase it whenever the fields change.
+#define STATS_VERSION 0x02
+#define BOOT_UPLINK_FIRST 0x60
+//! The version of the bootloader's packets, sent in BOOT_INFO. Increase it whenever they change.
+#define BOOT_VERSION 0x01
+//! The size of a flash page of the ATmega1281 in bytes, the unit the bootloader erases and writes.
+#define BOOT_PAGE_SIZE 0x100
+
+typedef enum
+{
+	//parameterless commands
+	CMD_GET_VERSION = 0,
+	CMD_LED_ON,
+	CMD_LED_OFF,
+	CMD_RELAY_ON,
+	CMD_RELAY_OFF,
+	CMD_LCD_ON,
+	CMD_LCD_OFF,
+	CMD_CLEAR_SCREEN,
+	CMD_LOWER_LINE,
+	CMD_GET_BUTTON1,
+	CMD_KNOB,
+	CMD_KNOB10,
+	CMD_SOFT_RESET,
+	CMD_STOP_SOUND,
+	//! Ends the remote session: stops the running script and the sensor stream.
+	CMD_EXIT_REMOTE,
+
+	//single-parameter commands
+	//! Blocks the whole main loop, stalling any running mode. Scripts use SCRIPT_WAIT_MS instead.
+	CMD_DELAY_MS,
+	CMD_DELAY_US,
+	CMD_PRINT_STRING,
+	CMD_DIGITAL_INPUT,
+	CMD_ANALOG,
+	CMD_ANALOG10,
+	CMD_SERVO_OFF,
+	CMD_GET_SERVO_RANGE,
+	CMD_PLAY_SOUND,
+
+	//two-parameter commands
+	CMD_SET_SERVO_RANGE_BY_INDEX,
+	CMD_SET_SERVO_RANGE,
+	CMD_SERVO,
+	CMD_SERVO2,
+	CMD_MOTOR,
+	CMD_LCD_CURSOR,
+
+	//variable-length commands
+	/*! A sequence of sub-commands, each encoded as: command, dataLength, data. They are all checked first,
+	 *  then executed back to back in one dispatch, and answered with a single RESP_BATCH.
+	 */
+	CMD_BATCH,
+
+	//script commands, see remoteScript.h
+	//! Stores script bytes at the offset. Answered with a RESP_VALUE of 1 if they were stored.
+	CMD_SCRIPT_LOAD,
+	//! Runs the loaded script. Answered with a RESP_SCRIPT_DONE when the script finishes.
+	CMD_SCRIPT_RUN,
+	CMD_SCRIPT_STOP,
+	//! Saves the loaded script in EEPROM.
+	CMD_SCRIPT_SAVE,
+	//! Loads the script saved in EEPROM.
+	CMD_SCRIPT_RESTORE,
+
+	//sensor stream
+	/*! Streams samples of the inputs in RESP_SAMPLES packets until another CMD_SUBSCRIBE replaces it.
+	 *  A period of 0 stops the stream. See sensorStream.c.
+	 */
+	CMD_SUBSCRIBE,
+	NUM_CMD
+} Commands;
+
+//! Remote System replies. Each one starts with the sequenceNum of the command packet it answers.
+typedef enum
+{
+	RESP_BOOTED_UP = 0x30,
+	//! The version string (not null terminated).
+	RESP_VERSION,
+	//! The value returned by the command (1 or 2 bytes).
+	RESP_VALUE,
+	/*! The number of sub-commands executed (0 if the batch was rejected),
+	 *  then the command and value of each sub-command that returns one, in order.
+	 */
+	RESP_BATCH,
+	//! The ScriptStatus, and the address the script finished at.
+	RESP_SCRIPT_DONE,
+	//! See sensorStream.c.
+	RESP_SAMPLES,
+	LAST_Response
+} Responses;
+
+typedef enum
+{
+	GET_VERSIONS = LAUNCHER_UPLINK_FIRST,
+	PAUSE,
+	RESUME,
+	ABORT_TO_MENU,
+	GET_STATS,
+	//! The sample period in ms, or 0 to stop.
+	SET_TELEMETRY,
+	//! Answered with a TUNABLE_INFO. See tunables.h.
+	GET_TUNABLE_INFO,
+	//! Answered with a TUNABLE_VALUE.
+	GET_TUNABLE,
+	//! Stages a new value, applied at the next control period. Answered with a TUNABLE_VALUE.
+	SET_TUNABLE,
+
+	//link benchmark, see linkBench.c
+	//! Answered straight away with a PING_REPLY of the same payload. (Plain PING is the port G input register in avr/io.h.)
+	PING_REQUEST,
+	//! Counted in the LINK_REPORT, then discarded.
+	BULK_SINK,
+	/*! Sends count BULK_DATA packets of patternLength pattern bytes each, as fast as the link allows.
+	 *  Replaces any transfer in progress, so a count of 0 stops it.
+	 */
+	BULK_SOURCE,
+	//! Answered with a LINK_REPORT.
+	GET_LINK_REPORT,
+
+	//clock synchronization, see Host/clocksync.h
+	/*! Answered straight away with a TIME_SYNC_REPLY. The originate time is the PC's, and is only echoed back.
+	 *  The padding makes it as long as the reply, so both directions take equally long to send.
+	 */
+	TIME_SYNC,
+	//! Whether log packets end with the time they were logged at, see DEBUG_LOG. Off after reset.
+	SET_LOG_TIMESTAMPS,
+
+	//reflashing
+	/*! Resets into the bootloader, which stays until it gets a BOOT_START_APP instead of starting the Launcher again.
+	 *  Not answered: the PC talks to the bootloader from then on, at UART0_BAUD.
+	 */
+	ENTER_BOOTLOADER,
+
+	//tracing, see traceStream.c
+	/*! Starts the TraceMode (see traceStream.h) with an empty trace ring, or stops it. Bit n of the mask traces the
+	 *  TraceId or LauncherTraceId n; TRACE_TICK is always traced. Not answered.
+	 */
+	SET_TRACE,
+	//! Stops tracing, and sends what the trace ring holds as TRACE_DATA.
+	DUMP_TRACE,
+	LAST_UplinkPacketType
+} UplinkPacketType;
+
+typedef enum
+{
+	BOOTED_UP = 128,
+	//! The null terminated version string.
+	VERSION_DATA,
+	/*! The STATS_VERSION, then:
+	 *  - the bytes lost because the UART0 receive buffer was full, and each drive motor's fault count and the time of its
+	 *  last fault (in ms).
+	 *  - the PacketLinkStats of the PC link (see packetprotocol.h), with the drops and the queue high-water marks of
+	 *  each PacketPriority in order.
+	 *  - then for each uplink packet type received since reset, lowest first and as many as fit: the type and a u16 count.
+	 *  All counters wrap around. Version 1 (before the version byte) was only the first 24 bytes after it.
+	 */
+	STATS_DATA,
+	//! See telemetry.c.
+	TELEMETRY_DATA,
+	/*! Null terminated. While SET_LOG_TIMESTAMPS is on, every log packet (this one, WARNING_LOG, CRITICAL_LOG and
+	 *  SW_FAULT) ends with 4 more bytes after the text: the u32 getUptimeUs() time it was logged at.
+	 */
+	DEBUG_LOG,
+	//! Null terminated, see DEBUG_LOG.
+	WARNING_LOG,
+	//! Null terminated, see DEBUG_LOG.
+	CRITICAL_LOG,
+	//! The null terminated file name, then the null terminated message, see DEBUG_LOG.
+	SW_FAULT,
+	//! The number of tunables, then the description from tunableDescribe(), or nothing else if there is no tunable with that id.
+	TUNABLE_INFO,
+	//! The TunableStatus, then the latest value (0 if the id is unknown).
+	TUNABLE_VALUE,
+	//! The payload of the PING_REQUEST it answers.
+	PING_REPLY,
+	//! The number of the packet within the BULK_SOURCE transfer, then pattern bytes: byte i is (index + i) & 0xFF.
+	BULK_DATA,
+	/*! The robot's uptime in ms, the BULK_SINK packets and bytes received, the BULK_DATA packets still to send,
+	 *  then the receive counters of the PC link: packets received, CRC errors, COBS framing errors, rejected headers,
+	 *  and the bytes lost because the UART0 receive buffer was full. All of them count up from reset and wrap around.
+	 */
+	LINK_REPORT,
+	/*! The originate time of the TIME_SYNC it answers, then the robot's getUptimeUs() time when that was received, and
+	 *  when this was sent. The two robot times wrap around every 71.6 minutes.
+	 */
+	TIME_SYNC_REPLY,
+	/*! The getUptimeUs() time and the trace clock when tracing started, the events lost before these, the flags
+	 *  (TRACE_DATA_END on the last packet of a dump), then 4 bytes for each event. See traceStream.c.
+	 */
+	TRACE_DATA,
+	LAST_DownlinkPacketType
+} DownlinkPacketType;
+
+bool protocolUplinkLengthValid(const u08 packetType, const u08 dataLength);
+
+//CMD_DELAY_MS
+static inline u16 CMD_DELAY_MS_ms(const u08 *const data) { return (u16)(((u16)data[0] << 8) | data[1]); }
+
+//CMD_DELAY_US
+static inline u16 CMD_DELAY_US_us(const u08 *const data) { return (u16)(((u16)data[0] << 8) | data[1]); }
+
+//CMD_PRINT_STRING
+static inline const char *CMD_PRINT_STRING_text(const u08 *const data) { return (const char *)&data[0]; }
+static inline u08 CMD_PRINT_STRING_textLength(const u08 dataLength) { return dataLength; }
+
+//CMD_DIGITAL_INPUT
+static inline u08 CMD_DIGITAL_INPUT_pin(const u08 *const data) { return data[0]; }
+
+//CMD_ANALOG
+static inline u08 CMD_ANALOG_channel(const u08 *const data) { return data[0]; }
+
+//CMD_ANALOG10
+static inline u08 CMD_ANALOG10_channel(const u08 *const data) { return data[0]; }
+
+//CMD_SERVO_OFF
+static inline u08 CMD_SERVO_OFF_servo(const u08 *const data) { return data[0]; }
+
+//CMD_GET_SERVO_RANGE
+static inline u08 CMD_GET_SERVO_RANGE_servo(const u08 *const data) { return data[0]; }
+
+//CMD_PLAY_SOUND
+static inline u08 CMD_PLAY_SOUND_sound(const u08 *const data) { return data[0]; }
+
+//CMD_SET_SERVO_RANGE_BY_INDEX
+static inline u08 CMD_SET_SERVO_RANGE_BY_INDEX_servo(const u08 *const data) { return data[0]; }
+static inline u08 CMD_SET_SERVO_RANGE_BY_INDEX_index(const u08 *const data) { return data[1]; }
+
+//CMD_SET_SERVO_RANGE
+static inline u08 CMD_SET_SERVO_RANGE_servo(const u08 *const data) { return data[0]; }
+static inline u08 CMD_SET_SERVO_RANGE_range(const u08 *const data) { return data[1]; }
+
+//CMD_SERVO
+static inline u08 CMD_SERVO_servo(const u08 *const data) { return data[0]; }
+static inline u08 CMD_SERVO_position(const u08 *const data) { return data[1]; }
+
+//CMD_SERVO2
+static inline u08 CMD_SERVO2_servo(const u08 *const data) { return data[0]; }
+static inline s08 CMD_SERVO2_position(const u08 *const data) { return (s08)data[1]; }
+
+//CMD_MOTOR
+static inline u08 CMD_MOTOR_motor(const u08 *const data) { return data[0]; }
+static inline u08 CMD_MOTOR_speed(const u08 *const data) { return data[1]; }
+
+//CMD_LCD_CURSOR
+static inline u08 CMD_LCD_CURSOR_row(const u08 *const data) { return data[0]; }
+static inline u08 CMD_LCD_CURSOR_column(const u08 *const data) { return data[1]; }
+
+//CMD_BATCH
+static inline const u08 *CMD_BATCH_commands(const u08 *const data) { return (const u08 *)&data[0]; }
+static inline u08 CMD_BATCH_commandsLength(const u08 dataLength) { return dataLength; }
+
+//CMD_SCRIPT_LOAD
+static inline u16 CMD_SCRIPT_LOAD_offset(const u08 *const data) { return (u16)(((u16)data[0] << 8) | data[1]); }
+static inline const u08 *CMD_SCRIPT_LOAD_script(const u08 *const data) { return (const u08 *)&data[2]; }
+static inline u08 CMD_SCRIPT_LOAD_scriptLength(const u08 dataLength) { return dataLength - 2; }
+
+//CMD_SUBSCRIBE
+static inline u16 CMD_SUBSCRIBE_periodMs(const u08 *const data) { return (u16)(((u16)data[0] << 8) | data[1]); }
+static inline u08 CMD_SUBSCRIBE_analogMask(const u08 *const data) { return data[2]; }
+static inline u16 CMD_SUBSCRIBE_digitalMask(const u08 *const data) { return (u16)(((u16)data[3] << 8) | data[4]); }
+
+//RESP_VERSION
+/*! Writes the fixed fields of a RESP_VERSION into data. @return 1, the length written, where version goes. */
+static inline u08 RESP_VERSION_encode(u08 *const data, const u08 request)
+{
+	data[0] = request;
+	return 1;
+}
+
+//RESP_VALUE
+/*! Writes the fixed fields of a RESP_VALUE into data. @return 2, the length written, where value goes. */
+static inline u08 RESP_VALUE_encode(u08 *const data, const u08 request, const u08 command)
+{
+	data[0] = request;
+	data[1] = command;
+	return 2;
+}
+
+//RESP_BATCH
+/*! Writes the fixed fields of a RESP_BATCH into data. @return 2, the length written, where values goes. */
+static inline u08 RESP_BATCH_encode(u08 *const data, const u08 request, const u08 count)
+{
+	data[0] = request;
+	data[1] = count;
+	return 2;
+}
+
+//RESP_SCRIPT_DONE
+/*! Writes the fixed fields of a RESP_SCRIPT_DONE into data. @return 4, the length written. */
+static inline u08 RESP_SCRIPT_DONE_encode(u08 *const data, const u08 request, const u08 status, const u16 address)
+{
+	data[0] = request;
+	data[1] = status;
+	data[2] = (u08)(address >> 8);
+	data[3] = (u08)address;
+	return 4;
+}
+
+//RESP_SAMPLES
+/*! Writes the fixed fields of a RESP_SAMPLES into data. @return 3, the length written, where samples goes. */
+static inline u08 RESP_SAMPLES_encode(u08 *const data, const u08 request, const u08 frame, const u08 count)
+{
+	data[0] = request;
+	data[1] = frame;
+	data[2] = count;
+	return 3;
+}
+
+//SET_TELEMETRY
+static inline u16 SET_TELEMETRY_periodMs(const u08 *const data) { return (u16)(((u16)data[0] << 8) | data[1]); }
+
+//GET_TUNABLE_INFO
+static inline u08 GET_TUNABLE_INFO_id(const u08 *const data) { return data[0]; }
+
+//GET_TUNABLE
+static inline u08 GET_TUNABLE_id(const u08 *const data) { return data[0]; }
+
+//SET_TUNABLE
+static inline u08 SET_TUNABLE_id(const u08 *const data) { return data[0]; }
+static inline s16 SET_TUNABLE_value(const u08 *const data) { return (s16)(((u16)data[1] << 8) | data[2]); }
+
+//PING_REQUEST
+static inline const u08 *PING_REQUEST_payload(const u08 *const data) { return (const u08 *)&data[0]; }
+static inline u08 PING_REQUEST_payloadLength(const u08 dataLength) { return dataLength; }
+
+//BULK_SINK
+static inline const u08 *BULK_SINK_payload(const u08 *const data) { return (const u08 *)&data[0]; }
+static inline u08 BULK_SINK_payloadLength(const u08 dataLength) { return dataLength; }
+
+//BULK_SOURCE
+static inline u16 BULK_SOURCE_count(const u08 *const data) { return (u16)(((u16)data[0] << 8) | data[1]); }
+static inline u08 BULK_SOURCE_patternLength(const u08 *const data) { return data[2]; }
+
+//TIME_SYNC
+static inline u32 TIME_SYNC_originate(const u08 *const data) { return (u32)(((u32)data[0] << 24) | ((u32)data[1] << 16) | ((u32)data[2] << 8) | data[3]); }
+static inline const u08 *TIME_SYNC_padding(const u08 *const data) { return (const u08 *)&data[4]; }
+static inline u08 TIME_SYNC_paddingLength(const u08 dataLength) { return dataLength - 4; }
+
+//SET_LOG_TIMESTAMPS
+static inline u08 SET_LOG_TIMESTAMPS_enabled(const u08 *const data) { return data[0]; }
+
+//SET_TRACE
+static inline u08 SET_TRACE_mode(const u08 *const data) { return data[0]; }
+static inline u32 SET_TRACE_mask(const u08 *const data) { return (u32)(((u32)data[1] << 24) | ((u32)data[2] << 16) | ((u32)data[3] << 8) | data[4]); }
+
+//BOOTED_UP
+/*! Writes the fixed fields of a BOOTED_UP into data. @return 1, the length written. */
+static inline u08 BOOTED_UP_encode(u08 *const data, const u08 resetCause)
+{
+	data[0] = resetCause;
+	return 1;
+}
+
+//VERSION_DATA
+//version starts at data[0].
+
+//STATS_DATA
+/*! Writes the fixed fields of a STATS_DATA into data. @return 61, the length written, where typeCounts goes. */
+static inline u08 STATS_DATA_encode(u08 *const data, const u08 version, const u16 rxOverruns, const u16 motor0Faults, const u32 motor0FaultTime, const u16 motor1Faults, const u32 motor1FaultTime, const u32 bytesReceived, const u32 bytesSent, const u16 packetsReceived, const u16 packetsSent, const u16 crcErrors, const u16 framingErrors, const u16 invalidHeaders, const u16 validatorRejections, const u16 resyncs, const u16 droppedPackets, const u16 controlDrops, const u16 faultDrops, const u16 telemetryDrops, const u16 debugDrops, const u16 controlHighWater, const u16 faultHighWater, const u16 telemetryHighWater, const u16 debugHighWater, const u16 retransmissions, const u16 duplicates, const u16 maxParseUs)
+{
+	data[0] = version;
+	data[1] = (u08)(rxOverruns >> 8);
+	data[2] = (u08)rxOverruns;
+	data[3] = (u08)(motor0Faults >> 8);
+	data[4] = (u08)motor0Faults;
+	data[5] = (u08)(motor0FaultTime >> 24);
+	data[6] = (u08)(motor0FaultTime >> 16);
+	data[7] = (u08)(motor0FaultTime >> 8);
+	data[8] = (u08)motor0FaultTime;
+	data[9] = (u08)(motor1Faults >> 8);
+	data[10] = (u08)motor1Faults;
+	data[11] = (u08)(motor1FaultTime >> 24);
+	data[12] = (u08)(motor1FaultTime >> 16);
+	data[13] = (u08)(motor1FaultTime >> 8);
+	data[14] = (u08)motor1FaultTime;
+	data[15] = (u08)(bytesReceived >> 24);
+	data[16] = (u08)(bytesReceived >> 16);
+	data[17] = (u08)(bytesReceived >> 8);
+	data[18] = (u08)bytesReceived;
+	data[19] = (u08)(bytesSent >> 24);
+	data[20] = (u08)(bytesSent >> 16);
+	data[21] = (u08)(bytesSent >> 8);
+	data[22] = (u08)bytesSent;
+	data[23] = (u08)(packetsReceived >> 8);
+	data[24] = (u08)packetsReceived;
+	data[25] = (u08)(packetsSent >> 8);
+	data[26] = (u08)packetsSent;
+	data[27] = (u08)(crcErrors >> 8);
+	data[28] = (u08)crcErrors;
+	data[29] = (u08)(framingErrors >> 8);
+	data[30] = (u08)framingErrors;
+	data[31] = (u08)(invalidHeaders >> 8);
+	data[32] = (u08)invalidHeaders;
+	data[33] = (u08)(validatorRejections >> 8);
+	data[34] = (u08)validatorRejections;
+	data[35] = (u08)(resyncs >> 8);
+	data[36] = (u08)resyncs;
+	data[37] = (u08)(droppedPackets >> 8);
+	data[38] = (u08)droppedPackets;
+	data[39] = (u08)(controlDrops >> 8);
+	data[40] = (u08)controlDrops;
+	data[41] = (u08)(faultDrops >> 8);
+	data[42] = (u08)faultDrops;
+	data[43] = (u08)(telemetryDrops >> 8);
+	data[44] = (u08)telemetryDrops;
+	data[45] = (u08)(debugDrops >> 8);
+	data[46] = (u08)debugDrops;
+	data[47] = (u08)(controlHighWater >> 8);
+	data[48] = (u08)controlHighWater;
+	data[49] = (u08)(faultHighWater >> 8);
+	data[50] = (u08)faultHighWater;
+	data[51] = (u08)(telemetryHighWater >> 8);
+	data[52] = (u08)telemetryHighWater;
+	data[53] = (u08)(debugHighWater >> 8);
+	data[54] = (u08)debugHighWater;
+	data[55] = (u08)(retransmissions >> 8);
+	data[56] = (u08)retransmissions;
+	data[57] = (u08)(duplicates >> 8);
+	data[58] = (u08)duplicates;
+	data[59] = (u08)(maxParseUs >> 8);
+	data[60] = (u08)maxParseUs;
+	return 61;
+}
+
+//TELEMETRY_DATA
+/*! Writes the fixed fields of a TELEMETRY_DATA into data. @return 2, the length written, where samples goes. */
+static inline u08 TELEMETRY_DATA_encode(u08 *const data, const u08 flags, const u08 frame)
+{
+	data[0] = flags;
+	data[1] = frame;
+	return 2;
+}
+
+//DEBUG_LOG
+//message starts at data[0].
+
+//WARNING_LOG
+//message starts at data[0].
+
+//CRITICAL_LOG
+//message starts at data[0].
+
+//SW_FAULT
+/*! Writes the fixed fields of a SW_FAULT into data. @return 6, the length written, where text goes. */
+static inline u08 SW_FAULT_encode(u08 *const data, const u16 line, const u16 arg1, const u16 arg2)
+{
+	data[0] = (u08)(line >> 8);
+	data[1] = (u08)line;
+	data[2] = (u08)(arg1 >> 8);
+	data[3] = (u08)arg1;
+	data[4] = (u08)(arg2 >> 8);
+	data[5] = (u08)arg2;
+	return 6;
+}
+
+//TUNABLE_INFO
+/*! Writes the fixed fields of a TUNABLE_INFO into data. @return 2, the length written, where description goes. */
+static inline u08 TUNABLE_INFO_encode(u08 *const data, const u08 id, const u08 count)
+{
+	data[0] = id;
+	data[1] = count;
+	return 2;
+}
+
+//TUNABLE_VALUE
+/*! Writes the fixed fields of a TUNABLE_VALUE into data. @return 4, the length written. */
+static inline u08 TUNABLE_VALUE_encode(u08 *const data, const u08 id, const u08 status, const s16 value)
+{
+	data[0] = id;
+	data[1] = status;
+	data[2] = (u08)((u16)value >> 8);
+	data[3] = (u08)value;
+	return 4;
+}
+
+//PING_REPLY
+//payload starts at data[0].
+
+//BULK_DATA
+/*! Writes the fixed fields of a BULK_DATA into data. @return 2, the length written, where pattern goes. */
+static inline u08 BULK_DATA_encode(u08 *const data, const u16 index)
+{
+	data[0] = (u08)(index >> 8);
+	data[1] = (u08)index;
+	return 2;
+}
+
+//LINK_REPORT
+/*! Writes the fixed fields of a LINK_REPORT into data. @return 24, the length written. */
+static inline u08 LINK_REPORT_encode(u08 *const data, const u32 uptimeMs, const u32 sinkPackets, const u32 sinkBytes, const u16 sourceLeft, const u16 packetsReceived, const u16 crcErrors, const u16 framingErrors, const u16 invalidHeaders, const u16 rxOverruns)
+{
+	data[0] = (u08)(uptimeMs >> 24);
+	data[1] = (u08)(uptimeMs >> 16);
+	data[2] = (u08)(uptimeMs >> 8);
+	data[3] = (u08)uptimeMs;
+	data[4] = (u08)(sinkPackets >> 24);
+	data[5] = (u08)(sinkPackets >> 16);
+	data[6] = (u08)(sinkPackets >> 8);
+	data[7] = (u08)sinkPackets;
+	data[8] = (u08)(sinkBytes >> 24);
+	data[9] = (u08)(sinkBytes >> 16);
+	data[10] = (u08)(sinkBytes >> 8);
+	data[11] = (u08)sinkBytes;
+	data[12] = (u08)(sourceLeft >> 8);
+	data[13] = (u08)sourceLeft;
+	data[14] = (u08)(packetsReceived >> 8);
+	data[15] = (u08)packetsReceived;
+	data[16] = (u08)(crcErrors >> 8);
+	data[17] = (u08)crcErrors;
+	data[18] = (u08)(framingErrors >> 8);
+	data[19] = (u08)framingErrors;
+	data[20] = (u08)(invalidHeaders >> 8);
+	data[21] = (u08)invalidHeaders;
+	data[22] = (u08)(rxOverruns >> 8);
+	data[23] = (u08)rxOverruns;
+	return 24;
+}
+
+//TIME_SYNC_REPLY
+/*! Writes the fixed fields of a TIME_SYNC_REPLY into data. @return 12, the length written. */
+static inline u08 TIME_SYNC_REPLY_encode(u08 *const data, const u32 originate, const u32 receiveUs, const u32 transmitUs)
+{
+	data[0] = (u08)(originate >> 24);
+	data[1] = (u08)(originate >> 16);
+	data[2] = (u08)(originate >> 8);
+	data[3] = (u08)originate;
+	data[4] = (u08)(receiveUs >> 24);
+	data[5] = (u08)(receiveUs >> 16);
+	data[6] = (u08)(receiveUs >> 8);
+	data[7] = (u08)receiveUs;
+	data[8] = (u08)(transmitUs >> 24);
+	data[9] = (u08)(transmitUs >> 16);
+	data[10] = (u08)(transmitUs >> 8);
+	data[11] = (u08)transmitUs;
+	return 12;
+}
+
+//TRACE_DATA
+/*! Writes the fixed fields of a TRACE_DATA into data. @return 9, the length written, where events goes. */
+static inline u08 TRACE_DATA_encode(u08 *const data, const u32 startUs, const u16 startClock, const u16 lost, const u08 flags)
+{
+	data[0] = (u08)(startUs >> 24);
+	data[1] = (u08)(startUs >> 16);
+	data[2] = (u08)(startUs >> 8);
+	data[3] = (u08)startUs;
+	data[4] = (u08)(startClock >> 8);
+	data[5] = (u08)startClock;
+	data[6] = (u08)(lost >> 8);
+	data[7] = (u08)lost;
+	data[8] = flags;
+	return 9;
+}
+
+#endif
@@ -1,69 +1,232 @@
-#include "ADC.h"
+#include "adcScan.h"
 #include "debug.h"
 #include "LCD.h"
 #include "motors.h"
 #include "packetprotocol.h"
 #include "remoteControl.h"
-#include "serial.h"
+#include "remoteScript.h"
+#include "sensorStream.h"
 #include "servos.h"
+#include "uart.h"
 #include "utility.h"
+#include <string.h>
 
 volatile bool remoteExited = FALSE;
 volatile u08 ReceivedData[MAX_DATA];
 volatile u08 DataIndex = 0;
 
+//! What happens to the values returned by commands.
+typedef enum
+{
+	REPLY_SEND,    //!< Sent in a RESP_VALUE packet.
+	REPLY_BATCH,   //!< Collected into batchReply, while executing the sub-commands of a CMD_BATCH.
+	REPLY_DISCARD  //!< Dropped, while executing a command from a script.
+} ReplyMode;
+
+static ReplyMode replyMode = REPLY_SEND;
+static u08 batchReply[MAX_PACKET_DATA];
+static u08 batchReplyLength;
+//! The sequenceNum of the CMD_SCRIPT_RUN that started the running script.
+static u08 scriptSequence;
+
 //Prototypes
-inline u16 parse_u16(const u08 * const data);
-void sendVersion();
+void sendVersion(const u08 requestSequence);
+static void sendValue(const u08 requestSequence, const u08 command, const u08 value);
+static void sendValue16(const u08 requestSequence, const u08 command, const u16 value);
+static void sendReply(const u08 *const reply, const u08 length);
+static u08 valueLength(const u08 command);
+static bool batchable(const u08 command);
+static void execBatch(const u08 sequence, const u08 *const data, const u08 dataLength);
+static void scriptDone(const ScriptStatus status, const u16 address);
 ServoRange namedServoRangeByIndex(u08 number);
-bool remoteSystemValidator(const u08 packetType, const u08 dataLength);
-void remoteSystemExecutor(const u08 packetType, const u08 * const data, const u08 dataLength);
 
+//! Starts the Remote System menu option, which leaves the robot idle for the PC to control.
 void remoteSystemInit()
 {
-
+	printString_P(PSTR("Remote Control"));
+	lowerLine();
+	printString_P(PSTR("System v" REMOTE_SYSTEM_VERSION));
 }
 
-//! Runs the Remote System functionality until exited.
+/*! Does nothing: the Remote System commands are handled in every mode, by execLauncherPacket() and remoteSystemService().
+ *  The Remote System menu option just keeps the competition and test modes from driving the robot meanwhile.
+ */
 void remoteSystemExec()
 {
-	//configure packet processor for Remote System packets
-	configPacketProcessor(&remoteSystemValidator, &remoteSystemExecutor, NUM_CMD - 1);
-	printString_P(PSTR("Remote Control"));
-	lowerLine();
-	printString_P(PSTR("System v" REMOTE_SYSTEM_VERSION));
+}
+
+/*! Runs the Remote System's background work: the loaded script and the sensor stream.
+ *  Called from the main loop in every mode, so each call does a bounded amount of work.
+ *  A CMD_EXIT_REMOTE ends the session, stopping both.
+ */
+void remoteSystemService()
+{
+	scriptExec();
+	sensorStreamExec();
+	if (remoteExited)
+	{
+		remoteExited = FALSE;
+		scriptStop();
+		sensorStreamStop();
+	}
+}
+
+//! Checks if a command can be executed by remoteCommandExec(), as part of a batch or a script.
+bool remoteCommandValid(const u08 command, const u08 dataLength)
+{
+	return batchable(command) && remoteSystemValidator(command, dataLength);
+}
+
+//! Executes a command on behalf of a script, discarding any value it returns. See remoteCommandValid().
+void remoteCommandExec(const u08 command, const u08 * const data, const u08 dataLength)
+{
+	const ReplyMode previousMode = replyMode;
+	replyMode = REPLY_DISCARD;
+	remoteSystemExecutor(command, 0, data, dataLength);
+	replyMode = previousMode;
+}
+
+//! Reports a finished script to the PC.
+static void scriptDone(const ScriptStatus status, const u16 address)
+{
+	u08 data[4];
+	sendPacket(RESP_SCRIPT_DONE, data, RESP_SCRIPT_DONE_encode(data, scriptSequence, status, address));
+}
+
+/*! Transmits a ::RESP_VERSION packet containing a pipe-separated string of various version numbers.
+    @param requestSequence The sequenceNum of the CMD_GET_VERSION packet being answered.
+ */
+void sendVersion(const u08 requestSequence)
+{
+	static const char version[] = VERSION;
+	u08 data[1 + sizeof(version) - 1];
+	const u08 length = RESP_VERSION_encode(data, requestSequence);
+	memcpy(&data[length], version, sizeof(version) - 1);
+	sendPacket(RESP_VERSION, data, sizeof(data));
+}
 
-	//process received packets until exit, everything else is handled by interrupts
-	remoteExited = FALSE;
-	while (remoteExited == FALSE)
+/*! Transmits a 1-byte value in a ::RESP_VALUE packet.
+    @param requestSequence The sequenceNum of the command packet being answered.
+    @param command The command being answered.
+ */
+static void sendValue(const u08 requestSequence, const u08 command, const u08 value)
+{
+	u08 data[3];
+	const u08 length = RESP_VALUE_encode(data, requestSequence, command);
+	data[length] = value;
+	sendReply(data, sizeof(data));
+}
+
+//! Transmits a 2-byte value in a ::RESP_VALUE packet, MSB first.
+static void sendValue16(const u08 requestSequence, const u08 command, const u16 value)
+{
+	u08 data[4];
+	const u08 length = RESP_VALUE_encode(data, requestSequence, command);
+	data[length] = (u08)(value >> 8);
+	data[length + 1] = (u08)value;
+	sendReply(data, sizeof(data));
+}
+
+/*! Sends the data section of a ::RESP_VALUE packet, or handles it according to replyMode.
+ */
+static void sendReply(const u08 *const reply, const u08 length)
+{
+	switch (replyMode)
 	{
-		execPacketDriver();
+		case REPLY_SEND:
+			sendPacket(RESP_VALUE, reply, length);
+			break;
+		case REPLY_BATCH:
+			//without the sequenceNum. execBatch() has already checked that every value fits
+			memcpy(&batchReply[batchReplyLength], &reply[1], length - 1);
+			batchReplyLength += length - 1;
+			break;
+		default:
+			break;
 	}
 }
 
-//! Parses a u16 value from a byte array.
-inline u16 parse_u16(const u08 * const data)
+//! Gets the number of bytes a command returns, or 0 if it doesn't return anything.
+static u08 valueLength(const u08 command)
 {
-	u16 output;
-	//load high byte
-	output = ((u16)data[0])<<8;
-	//load low byte
-	output |= data[1];
-	return output;
+	switch (command)
+	{
+		case CMD_ANALOG10:
+		case CMD_KNOB10:
+			return 2;
+		case CMD_SET_SERVO_RANGE_BY_INDEX:
+		case CMD_SET_SERVO_RANGE:
+		case CMD_GET_SERVO_RANGE:
+		case CMD_DIGITAL_INPUT:
+		case CMD_ANALOG:
+		case CMD_GET_BUTTON1:
+		case CMD_KNOB:
+			return 1;
+		default:
+			return 0;
+	}
 }
 
-//! Transmits a pipe-separated string containing various version numbers.
-void sendVersion()
+/*! Checks if a command is allowed in a CMD_BATCH or a script. Commands that block, reset, send their own packet,
+    or control batches and scripts are not.
+ */
+static bool batchable(const u08 command)
 {
-	char *version = VERSION;
+	switch (command)
+	{
+		case CMD_GET_VERSION:
+		case CMD_SOFT_RESET:
+		case CMD_EXIT_REMOTE:
+		case CMD_DELAY_MS:
+		case CMD_DELAY_US:
+		case CMD_BATCH:
+		case CMD_SCRIPT_LOAD:
+		case CMD_SCRIPT_RUN:
+		case CMD_SCRIPT_STOP:
+		case CMD_SCRIPT_SAVE:
+		case CMD_SCRIPT_RESTORE:
+		case CMD_SUBSCRIBE:
+			return FALSE;
+		default:
+			return (command < NUM_CMD);
+	}
+}
+
+/*! Executes the sub-commands of a CMD_BATCH back to back, and answers with a single ::RESP_BATCH.
+    The whole batch is checked first, so a malformed batch executes nothing.
+ */
+static void execBatch(const u08 sequence, const u08 *const data, const u08 dataLength)
+{
+	u08 count = 0;
+	//the sequenceNum and count come first
+	u08 replyLength = 2;
 	u08 i = 0;
-	//transmit the characters of the string until hitting a null terminator
-	while (version[i] != 0)
+	while (i < dataLength)
 	{
-		uart0Transmit(version[i++]);
+		const u08 command = data[i];
+		const u08 length = (i + 1 < dataLength) ? data[i + 1] : 0;
+		if (i + 2 > dataLength || length > dataLength - i - 2 || !batchable(command)
+			|| !remoteSystemValidator(command, length) || (valueLength(command) > 0 && replyLength + 1 + valueLength(command) > MAX_PACKET_DATA))
+		{
+			logWarning("bad batch entry %d", count);
+			u08 reject[2];
+			sendPacket(RESP_BATCH, reject, RESP_BATCH_encode(reject, sequence, 0));
+			return;
+		}
+		if (valueLength(command) > 0)
+			replyLength += 1 + valueLength(command);
+		i += 2 + length;
+		count++;
 	}
-	//Send a newline character to signal the end of the version string
-	uart0Transmit('\n');
+
+	batchReplyLength = RESP_BATCH_encode(batchReply, sequence, count);
+	replyMode = REPLY_BATCH;
+	for (i = 0; i < dataLength; i += 2 + data[i + 1])
+	{
+		remoteSystemExecutor(data[i], sequence, &data[i + 2], data[i + 1]);
+	}
+	replyMode = REPLY_SEND;
+	sendPacket(RESP_BATCH, batchReply, batchReplyLength);
 }
 
 //! Gets one of the predefined ServoRange values based on a generic index number.
@@ -87,67 +250,19 @@ ServoRange namedServoRangeByIndex(u08 number)
 	}
 }
 
-//! Validates the packetType and its dataLength.
+//! Validates the packetType and its dataLength, with the lengths in Protocol/packets.schema.
 bool remoteSystemValidator(const u08 packetType, const u08 dataLength)
 {
-	switch(packetType)
-	{
-		//parameterless commands
-		case CMD_GET_VERSION:
-		case CMD_LED_ON:
-		case CMD_LED_OFF:
-		case CMD_RELAY_ON:
-		case CMD_RELAY_OFF:
-		case CMD_LCD_ON:
-		case CMD_LCD_OFF:
-		case CMD_CLEAR_SCREEN:
-		case CMD_LOWER_LINE:
-		case CMD_GET_BUTTON1:
-		case CMD_KNOB:
-		case CMD_KNOB10:
-		case CMD_SOFT_RESET:
-		case CMD_STOP_SOUND:
-		case CMD_EXIT_REMOTE:
-			return (dataLength == 0);
-
-		//single-parameter commands
-		case CMD_DELAY_MS:
-		case CMD_DELAY_US:
-			return (dataLength == 2);
-		case CMD_PRINT_STRING:
-			return (dataLength > 0 && dataLength <= MAX_PACKET_DATA);
-		case CMD_DIGITAL_INPUT:
-		case CMD_ANALOG:
-		case CMD_ANALOG10:
-		case CMD_SERVO_OFF:
-		case CMD_GET_SERVO_RANGE:
-		case CMD_PLAY_SOUND:
-			return (dataLength == 1);
-
-		//two-parameter commands
-		case CMD_SET_SERVO_RANGE_BY_INDEX:
-		case CMD_SET_SERVO_RANGE:
-		case CMD_SERVO:
-		case CMD_SERVO2:
-		case CMD_MOTOR:
-		case CMD_LCD_CURSOR:
-			return (dataLength == 2);
-		default:
-			SOFTWARE_FAULT("invalid packetType", packetType, dataLength);
-			return FALSE;
-	}
+	return (packetType < NUM_CMD) && protocolUplinkLengthValid(packetType, dataLength);
 }
 
-//! Executes a packet of the specified type.
-void remoteSystemExecutor(const u08 packetType, const u08 * const data, const u08 dataLength)
+void remoteSystemExecutor(const u08 packetType, const u08 sequence, const u08 * const data, const u08 dataLength)
 {
-	u16 u16temp;
-
 	switch (packetType)
 	{
 		//parameterless functions
 		case CMD_GET_VERSION:
-			sendVersion();
+			sendVersion(sequence);
 			break;
 		case CMD_LED_ON:
 			ledOn();
@@ -186,17 +301,17 @@ void remoteSystemExecutor(const u08 packetType, const u08 * const data, const u0
 
 		//single-parameter functions
 		case CMD_DELAY_MS:
-			delayMs(parse_u16(data));
+			delayMs(CMD_DELAY_MS_ms(data));
 			break;
 		case CMD_DELAY_US:
-			delayUs(parse_u16(data));
+			delayUs(CMD_DELAY_US_us(data));
 			break;
 		case CMD_PRINT_STRING:
 			//print up to dataLength characters
-			printStringN((char *)data, dataLength);
+			printStringN(CMD_PRINT_STRING_text(data), CMD_PRINT_STRING_textLength(dataLength));
 			break;
 		case CMD_SERVO_OFF:
-			servoOff(data[0]);
+			servoOff(CMD_SERVO_OFF_servo(data));
 			//TODO remove this debug code
 			if (data[0] == 0)
 			{
@@ -216,7 +331,7 @@ void remoteSystemExecutor(const u08 packetType, const u08 * const data, const u0
 
 		//two-parameter functions
 		case CMD_SERVO:
-			servo(data[0], data[1]);
+			servo(CMD_SERVO_servo(data), CMD_SERVO_position(data));
 			//TODO remove this debug code
 			if (data[0] == 0)
 			{
@@ -231,7 +346,7 @@ void remoteSystemExecutor(const u08 packetType, const u08 * const data, const u0
 			break;
 
 		case CMD_SERVO2:
-			servo2(data[0], (s08)data[1]);
+			servo2(CMD_SERVO2_servo(data), CMD_SERVO2_position(data));
 			//TODO remove this debug code
 			if (data[0] == 0)
 			{
@@ -245,57 +360,85 @@ void remoteSystemExecutor(const u08 packetType, const u08 * const data, const u0
 			break;
 
 		case CMD_MOTOR:
-			switch (data[0])
+			switch (CMD_MOTOR_motor(data))
 			{
 				case 0:
 #if USE_MOTOR0 == 1
-					motor0(data[1]);
+					motor0(MOTOR_SPEED_FROM_U08(CMD_MOTOR_speed(data)));
 #endif
 					break;
 
 				case 1:
 #if USE_MOTOR1 == 1
-					motor1(data[1]);
+					motor1(MOTOR_SPEED_FROM_U08(CMD_MOTOR_speed(data)));
 #endif
 					break;
 			}
 			break;
 		case CMD_LCD_CURSOR:
-			lcdCursor(data[0], data[1]);
+			lcdCursor(CMD_LCD_CURSOR_row(data), CMD_LCD_CURSOR_column(data));
+			break;
+
+		//variable-length functions
+		case CMD_BATCH:
+			execBatch(sequence, CMD_BATCH_commands(data), CMD_BATCH_commandsLength(dataLength));
+			break;
+
+		//script functions
+		case CMD_SCRIPT_LOAD:
+			sendValue(sequence, packetType, scriptLoad(CMD_SCRIPT_LOAD_offset(data), CMD_SCRIPT_LOAD_script(data), CMD_SCRIPT_LOAD_scriptLength(dataLength)));
+			break;
+		case CMD_SCRIPT_RUN:
+			scriptStop();
+			scriptSequence = sequence;
+			scriptStart(scriptDone);
+			break;
+		case CMD_SCRIPT_STOP:
+			scriptStop();
+			break;
+		case CMD_SCRIPT_SAVE:
+			scriptSave();
+			break;
+		case CMD_SCRIPT_RESTORE:
+			scriptRestore();
+			break;
+
+		case CMD_SUBSCRIBE:
+			sensorStreamStart(sequence, CMD_SUBSCRIBE_periodMs(data), CMD_SUBSCRIBE_analogMask(data), CMD_SUBSCRIBE_digitalMask(data));
 			break;
 
 		//functions with return values
 		case CMD_SET_SERVO_RANGE_BY_INDEX:
-			uart0Transmit(setServoRange(data[0], namedServoRangeByIndex(data[1])));
+			sendValue(sequence, packetType, setServoRange(CMD_SET_SERVO_RANGE_BY_INDEX_servo(data), namedServoRangeByIndex(CMD_SET_SERVO_RANGE_BY_INDEX_index(data))));
 			break;
 		case CMD_SET_SERVO_RANGE:
-			uart0Transmit(setServoRange(data[0], data[1]));
+			sendValue(sequence, packetType, setServoRange(CMD_SET_SERVO_RANGE_servo(data), CMD_SET_SERVO_RANGE_range(data)));
 			break;
 		case CMD_GET_SERVO_RANGE:
-			uart0Transmit(getServoRange(data[0]));
+			sendValue(sequence, packetType, getServoRange(CMD_GET_SERVO_RANGE_servo(data)));
 			break;
 		case CMD_DIGITAL_INPUT:
-			uart0Transmit(digitalInput(data[0]));
+			sendValue(sequence, packetType, digitalInput(CMD_DIGITAL_INPUT_pin(data)));
 			break;
 		case CMD_ANALOG:
-			uart0Transmit(analog(data[0]));
+		{
+			//the top 8 bits, as analog() would read them, and its 0xBD for an invalid input
+			const u16 reading = adcScanReadAny(CMD_ANALOG_channel(data));
+			sendValue(sequence, packetType, (reading == 0x0BAD) ? 0xBD : (u08)(reading >> 2));
 			break;
+		}
 		case CMD_ANALOG10:
-			u16temp = analog10(data[0]);
-			uart0Transmit(u16temp >> 8);
-			uart0Transmit((u08)u16temp);
+			sendValue16(sequence, packetType, adcScanReadAny(CMD_ANALOG10_channel(data)));
 			break;
 		case CMD_GET_BUTTON1:
-			uart0Transmit(getButton1());
+			sendValue(sequence, packetType, getButton1());
 			break;
 		/*TODO
 		case CMD_KNOB:
-			uart0Transmit(knob());
+			sendValue(sequence, packetType, knob());
 			break;
 		case CMD_KNOB10:
-			u16temp = knob10();
-			uart0Transmit(u16temp >> 8);
-			uart0Transmit((u08)u16temp);
+			sendValue16(sequence, packetType, knob10());
 			break;*/
 		default:
 			// Command was not recognized
@@ -2,6 +2,7 @@
 #define REMOTECONTROL_H
 
 #include "globals.h"
+#include "protocol.h"
 #include <avr/version.h>
 
 //Baud rate and error tolerance are set in the init functions in serial.c
@@ -30,61 +31,17 @@
 //***The biggest command is PRINT_STRING with 1 command byte, 16 characters for the LCD line, and a null terminator
 #define MAX_DATA 18
 
-enum Commands
-{
-	//parameterless commands
-	CMD_GET_VERSION,
-	CMD_LED_ON,
-	CMD_LED_OFF,
-	CMD_RELAY_ON,
-	CMD_RELAY_OFF,
-	CMD_LCD_ON,
-	CMD_LCD_OFF,
-	CMD_CLEAR_SCREEN,
-	CMD_LOWER_LINE,
-	CMD_GET_BUTTON1,
-	CMD_KNOB,
-	CMD_KNOB10,
-	CMD_SOFT_RESET,
-	CMD_STOP_SOUND,
-	CMD_EXIT_REMOTE,
-	LAST_ParameterlessCommand,
-
-	//single-parameter commands
-	CMD_DELAY_MS = LAST_ParameterlessCommand,
-	CMD_DELAY_US,
-	CMD_PRINT_STRING,
-	CMD_DIGITAL_INPUT,
-	CMD_ANALOG,
-	CMD_ANALOG10,
-	CMD_SERVO_OFF,
-	CMD_GET_SERVO_RANGE,
-	CMD_PLAY_SOUND,
-	LAST_SingleParameterCommand,
-
-	//two-parameter commands
-	CMD_SET_SERVO_RANGE_BY_INDEX = LAST_SingleParameterCommand,
-	CMD_SET_SERVO_RANGE,
-	CMD_SERVO,
-	CMD_SERVO2,
-	CMD_MOTOR,
-	CMD_LCD_CURSOR,
-
-	NUM_CMD //!< The number of commands defined
-};
-
-
-//Packet responses - packet types that the microcontroller can send
-enum Responses
-{
-	RESP_BOOTED_UP = 0x30,
-	RESP_VERSION
-};
+//The Remote System's commands and responses are defined in Protocol/packets.schema, and generated into protocol.h.
 
 extern volatile bool remoteExited;
 
 //Prototypes
 void remoteSystemInit();
 void remoteSystemExec();
+void remoteSystemService();
+bool remoteSystemValidator(const u08 packetType, const u08 dataLength);
+void remoteSystemExecutor(const u08 packetType, const u08 sequence, const u08 * const data, const u08 dataLength);
+bool remoteCommandValid(const u08 command, const u08 dataLength);
+void remoteCommandExec(const u08 command, const u08 * const data, const u08 dataLength);
 
 #endif
@@ -0,0 +1,292 @@
+/*! @file
+    Runs Remote System command scripts on the robot, so timed sequences don't depend on the PC or USB latency.
+    A script is uploaded into SRAM in pieces, checked as a whole before it starts, and then run a few instructions
+    at a time by scriptExec() from the Remote System loop. Waits never block, so packets keep being processed
+    while a script runs. The script can also be saved in EEPROM, to survive a reset.
+ */
+#include "adcScan.h"
+#include "debug.h"
+#include "remoteControl.h"
+#include "remoteScript.h"
+#include "rtc.h"
+#include "utility.h"
+#include <avr/eeprom.h>
+#include <avr/io.h>
+#include <string.h>
+
+//! The length of a condition operand.
+#define CONDITION_LENGTH 4
+
+static u08 script[SCRIPT_MAX_LENGTH];
+//! The number of bytes loaded into script.
+static u16 scriptLength = 0;
+
+static bool running = FALSE;
+//! The address of the instruction being executed.
+static u16 programCounter;
+static u16 loopCounter;
+//! Set while the current instruction is waiting, until waitEnd.
+static bool waiting;
+static u32 waitEnd;
+static ScriptDoneCallback_t onDone;
+
+static u16 EEMEM savedScriptLength;
+static u08 EEMEM savedScript[SCRIPT_MAX_LENGTH];
+
+//Local prototypes
+static u08 instructionLength(const u16 address);
+static bool validScript();
+static bool conditionTrue(const u08 *const condition);
+static bool step();
+static void finish(const ScriptStatus status);
+
+/*! Stores part of a script. Loading at offset 0 starts a new script, and the rest must follow in order.
+    @return FALSE if a script is running, or the data doesn't follow the part already loaded or doesn't fit.
+ */
+bool scriptLoad(const u16 offset, const u08 *const data, const u08 length)
+{
+	if (running || (offset != 0 && offset != scriptLength) || offset + length > SCRIPT_MAX_LENGTH)
+		return FALSE;
+	memcpy(&script[offset], data, length);
+	scriptLength = offset + length;
+	return TRUE;
+}
+
+/*! Starts running the loaded script from the beginning, stopping any script that is already running.
+    @param doneCallback Called when the script finishes, including when it is rejected.
+    @return FALSE if the script is malformed, in which case doneCallback has been called with ::SCRIPT_STATUS_INVALID.
+ */
+bool scriptStart(ScriptDoneCallback_t doneCallback)
+{
+	scriptStop();
+	onDone = doneCallback;
+	programCounter = 0;
+	if (!validScript())
+	{
+		finish(SCRIPT_STATUS_INVALID);
+		return FALSE;
+	}
+	loopCounter = 0;
+	waiting = FALSE;
+	running = TRUE;
+	return TRUE;
+}
+
+//! Stops the running script, if any.
+void scriptStop()
+{
+	if (running)
+		finish(SCRIPT_STATUS_STOPPED);
+}
+
+bool scriptRunning()
+{
+	return running;
+}
+
+//! Runs the script until it waits, or for up to ::SCRIPT_STEPS_PER_EXEC instructions.
+void scriptExec()
+{
+	for (u08 i = 0; running && i < SCRIPT_STEPS_PER_EXEC; i++)
+	{
+		if (!step())
+			break;
+	}
+}
+
+//! Copies the loaded script to EEPROM. Blocks for several milliseconds per changed byte.
+void scriptSave()
+{
+	eeprom_update_block(script, savedScript, scriptLength);
+	eeprom_update_block(&scriptLength, &savedScriptLength, sizeof(scriptLength));
+}
+
+//! Loads the script saved in EEPROM, replacing the loaded script. Does nothing while a script is running.
+void scriptRestore()
+{
+	if (running)
+		return;
+	u16 length;
+	eeprom_read_block(&length, &savedScriptLength, sizeof(length));
+	//erased EEPROM reads as 0xFFFF
+	if (length > SCRIPT_MAX_LENGTH)
+		length = 0;
+	eeprom_read_block(script, savedScript, length);
+	scriptLength = length;
+}
+
+//! Gets the length of the instruction at an address, or 0 if its opcode is unknown.
+static u08 instructionLength(const u16 address)
+{
+	switch (script[address])
+	{
+		case SCRIPT_END:
+			return 1;
+		case SCRIPT_COMMAND:
+			//the dataLength is checked against the end of the script by validScript()
+			return (address + 2 < scriptLength) ? 3 + script[address + 2] : 3;
+		case SCRIPT_WAIT_MS:
+		case SCRIPT_JUMP:
+		case SCRIPT_SET_COUNTER:
+		case SCRIPT_LOOP:
+			return 3;
+		case SCRIPT_WAIT_UNTIL:
+		case SCRIPT_JUMP_IF:
+			return 1 + CONDITION_LENGTH + 2;
+		default:
+			return 0;
+	}
+}
+
+/*! Checks the whole loaded script before it runs: every instruction must be complete, every command and condition
+    valid, and every jump must land on the start of an instruction.
+ */
+static bool validScript()
+{
+	//one bit per address, set where an instruction starts
+	u08 starts[SCRIPT_MAX_LENGTH / 8];
+	memset(starts, 0, sizeof(starts));
+
+	u16 address = 0;
+	while (address < scriptLength)
+	{
+		const u08 length = instructionLength(address);
+		if (length == 0 || address + length > scriptLength)
+			return FALSE;
+		const u08 *const operands = &script[address + 1];
+		if (script[address] == SCRIPT_COMMAND && !remoteCommandValid(operands[0], operands[1]))
+			return FALSE;
+		if ((script[address] == SCRIPT_WAIT_UNTIL || script[address] == SCRIPT_JUMP_IF) && operands[0] >= NUM_SCRIPT_CONDITIONS)
+			return FALSE;
+		starts[address >> 3] |= _BV(address & 7);
+		address += length;
+	}
+
+	for (address = 0; address < scriptLength; address += instructionLength(address))
+	{
+		u16 target;
+		switch (script[address])
+		{
+			case SCRIPT_JUMP:
+			case SCRIPT_LOOP:
+				target = ((u16)script[address + 1] << 8) | script[address + 2];
+				break;
+			case SCRIPT_JUMP_IF:
+				target = ((u16)script[address + 1 + CONDITION_LENGTH] << 8) | script[address + 2 + CONDITION_LENGTH];
+				break;
+			default:
+				continue;
+		}
+		if (target >= scriptLength || !(starts[target >> 3] & _BV(target & 7)))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+//! Evaluates a condition operand.
+static bool conditionTrue(const u08 *const condition)
+{
+	const u16 threshold = ((u16)condition[2] << 8) | condition[3];
+	switch (condition[0])
+	{
+		case SCRIPT_IF_DIGITAL_HIGH:
+			return digitalInput(condition[1]) != 0;
+		case SCRIPT_IF_DIGITAL_LOW:
+			return digitalInput(condition[1]) == 0;
+		case SCRIPT_IF_ANALOG_ABOVE:
+			return adcScanReadAny(condition[1]) > threshold;
+		case SCRIPT_IF_ANALOG_BELOW:
+			return adcScanReadAny(condition[1]) < threshold;
+		default:
+			return FALSE;
+	}
+}
+
+/*! Executes the instruction at programCounter, or checks on its wait.
+    @return FALSE if the script is waiting or has finished.
+ */
+static bool step()
+{
+	//running off the end is the same as SCRIPT_END
+	if (programCounter >= scriptLength)
+	{
+		finish(SCRIPT_STATUS_DONE);
+		return FALSE;
+	}
+	const u08 *const operands = &script[programCounter + 1];
+	const u16 operand16 = ((u16)operands[0] << 8) | operands[1];
+	const u32 now = getUptimeMs();
+
+	switch (script[programCounter])
+	{
+		case SCRIPT_END:
+			finish(SCRIPT_STATUS_DONE);
+			return FALSE;
+		case SCRIPT_COMMAND:
+			remoteCommandExec(operands[0], &operands[2], operands[1]);
+			break;
+		case SCRIPT_WAIT_MS:
+			if (!waiting)
+			{
+				waiting = TRUE;
+				waitEnd = now + operand16;
+			}
+			if ((s32)(now - waitEnd) < 0)
+				return FALSE;
+			waiting = FALSE;
+			break;
+		case SCRIPT_WAIT_UNTIL:
+		{
+			const u16 timeoutMs = ((u16)operands[CONDITION_LENGTH] << 8) | operands[CONDITION_LENGTH + 1];
+			if (!waiting)
+			{
+				waiting = TRUE;
+				waitEnd = now + timeoutMs;
+			}
+			if (!conditionTrue(operands))
+			{
+				if (timeoutMs != 0 && (s32)(now - waitEnd) >= 0)
+					finish(SCRIPT_STATUS_TIMEOUT);
+				return FALSE;
+			}
+			waiting = FALSE;
+			break;
+		}
+		case SCRIPT_JUMP:
+			programCounter = operand16;
+			return TRUE;
+		case SCRIPT_JUMP_IF:
+			if (conditionTrue(operands))
+			{
+				programCounter = ((u16)operands[CONDITION_LENGTH] << 8) | operands[CONDITION_LENGTH + 1];
+				return TRUE;
+			}
+			break;
+		case SCRIPT_SET_COUNTER:
+			loopCounter = operand16;
+			break;
+		case SCRIPT_LOOP:
+			if (loopCounter > 0 && --loopCounter > 0)
+			{
+				programCounter = operand16;
+				return TRUE;
+			}
+			break;
+		default:
+			//validScript() rejects unknown opcodes, so this is a bug
+			SOFTWARE_FAULT(PSTR("bad script opcode"), script[programCounter], programCounter);
+			finish(SCRIPT_STATUS_INVALID);
+			return FALSE;
+	}
+	programCounter += instructionLength(programCounter);
+	return TRUE;
+}
+
+//! Stops the script and reports how it finished.
+static void finish(const ScriptStatus status)
+{
+	running = FALSE;
+	waiting = FALSE;
+	if (onDone != NULL)
+		onDone(status, programCounter);
+}
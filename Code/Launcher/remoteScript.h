@@ -0,0 +1,56 @@
+#ifndef REMOTESCRIPT_H
+#define REMOTESCRIPT_H
+
+#include "globals.h"
+
+//! The largest script, in bytes. Addresses in scripts are offsets from its start.
+#define SCRIPT_MAX_LENGTH 256
+//! The most instructions run by each scriptExec() call, so a script without waits can't starve the packet parser.
+#define SCRIPT_STEPS_PER_EXEC 8
+
+/*! Script instructions. Each is an opcode byte followed by its operands; u16 operands are MSB first.
+ *  A condition is 4 bytes: a ::ScriptCondition, the input number, and a u16 threshold (ignored by digital conditions).
+ */
+typedef enum
+{
+	SCRIPT_END,          //!< Ends the script successfully.
+	SCRIPT_COMMAND,      //!< command, dataLength, data: executes a Remote System command, discarding any value it returns.
+	SCRIPT_WAIT_MS,      //!< u16 ms: waits, while packets keep being processed.
+	SCRIPT_WAIT_UNTIL,   //!< condition, u16 timeoutMs: waits until the condition is true. Stops the script if it times out (0 waits forever).
+	SCRIPT_JUMP,         //!< u16 address
+	SCRIPT_JUMP_IF,      //!< condition, u16 address: jumps if the condition is true.
+	SCRIPT_SET_COUNTER,  //!< u16 count: sets the loop counter.
+	SCRIPT_LOOP,         //!< u16 address: decrements the loop counter, and jumps if it isn't 0 yet.
+	NUM_SCRIPT_OPCODES
+} ScriptOpcode;
+
+//! The kinds of condition tested by ::SCRIPT_WAIT_UNTIL and ::SCRIPT_JUMP_IF.
+typedef enum
+{
+	SCRIPT_IF_DIGITAL_HIGH, //!< digitalInput(input) is 1.
+	SCRIPT_IF_DIGITAL_LOW,  //!< digitalInput(input) is 0.
+	SCRIPT_IF_ANALOG_ABOVE, //!< analog10(input) is above the threshold.
+	SCRIPT_IF_ANALOG_BELOW, //!< analog10(input) is below the threshold.
+	NUM_SCRIPT_CONDITIONS
+} ScriptCondition;
+
+//! How a script finished, reported in ::RESP_SCRIPT_DONE.
+typedef enum
+{
+	SCRIPT_STATUS_DONE,     //!< Reached ::SCRIPT_END.
+	SCRIPT_STATUS_STOPPED,  //!< Stopped by CMD_SCRIPT_STOP, leaving Remote System, or starting another script.
+	SCRIPT_STATUS_TIMEOUT,  //!< A ::SCRIPT_WAIT_UNTIL timed out.
+	SCRIPT_STATUS_INVALID   //!< Rejected before starting, because an instruction is malformed or runs past the end.
+} ScriptStatus;
+
+typedef void(*ScriptDoneCallback_t)(const ScriptStatus status, const u16 address);
+
+bool scriptLoad(const u16 offset, const u08 *const data, const u08 length);
+bool scriptStart(ScriptDoneCallback_t doneCallback);
+void scriptStop();
+bool scriptRunning();
+void scriptExec();
+void scriptSave();
+void scriptRestore();
+
+#endif
@@ -0,0 +1,242 @@
+/*! @file
+    Controls a RoboClaw motor controller using its packet serial protocol on UART1.
+    Packets are queued in the UART driver's transmit buffer and replies are collected from its receive buffer,
+    so roboclawExec() never waits on the serial port.
+    Only one command is outstanding at a time. Speed setpoints take priority, otherwise the encoder speeds of both
+    motor channels are polled alternately.
+ */
+#include "roboclaw.h"
+
+#include "rtc.h"
+#include "uart.h"
+
+#include <stddef.h>
+#include <util/crc16.h>
+
+//! The packet serial address the RoboClaw is configured for (set with its mode buttons).
+#define ROBOCLAW_ADDRESS 0x80
+//! The number of milliseconds to wait for a reply before giving up on a command.
+#define ROBOCLAW_TIMEOUT_MS 20
+//! The number of milliseconds between encoder speed readings of each motor channel.
+#define ROBOCLAW_POLL_MS 25
+
+//! The byte the RoboClaw sends to acknowledge a write command with a valid CRC.
+#define ROBOCLAW_ACK 0xFF
+
+//! The RoboClaw packet serial commands used by this driver.
+enum roboclawCommands
+{
+	ROBOCLAW_GETM1SPEED       = 18, //!< Reads the M1 encoder speed in quadrature pulses per second.
+	ROBOCLAW_GETM2SPEED       = 19, //!< Reads the M2 encoder speed in quadrature pulses per second.
+	ROBOCLAW_MIXEDSPEEDACCEL  = 40  //!< Sets the M1 and M2 speed setpoints with a shared acceleration.
+};
+
+//! The largest number of data bytes sent with a command.
+#define ROBOCLAW_MAX_DATA 12
+//! The number of bytes in a speed reply: a 4 byte speed, a direction byte, and a 2 byte CRC.
+#define SPEED_REPLY_LENGTH 7
+
+//! The reply to the outstanding command, collected by roboclawExec().
+static u08 rxBuffer[SPEED_REPLY_LENGTH];
+//! The number of reply bytes received so far.
+static u08 rxCount = 0;
+//! The number of reply bytes expected for the outstanding command.
+static u08 rxExpected = 0;
+
+//! The outstanding command, or 0 when the RoboClaw is idle.
+static u08 pendingCommand = 0;
+//! The time the outstanding command was queued, from getUptimeMs().
+static u32 requestTime;
+//! The time of the last encoder speed poll, from getUptimeMs().
+static u32 lastPollTime;
+//! The motor channel to poll next.
+static RoboclawMotor nextPoll = ROBOCLAW_M1;
+
+//! The most recently requested setpoint, sent when the RoboClaw is next idle.
+static u32 setpointAcceleration;
+static s32 setpointSpeeds[2];
+//! Whether the setpoint has changed since it was last acknowledged.
+static bool setpointChanged = FALSE;
+
+//! The most recent encoder speed of each motor channel in quadrature pulses per second.
+static s32 measuredSpeeds[2];
+//! Whether each measured speed was read after the current setpoint was sent.
+static bool measuredValid[2];
+
+//! The number of commands that timed out or had a bad reply.
+static u16 errorCount = 0;
+
+/*! Sends a packet serial command, appending the address and CRC, and prepares to receive its reply.
+    @param command The RoboClaw command number.
+    @param data The command's data bytes.
+    @param length The number of data bytes.
+    @param replyLength The number of reply bytes the command produces.
+ */
+static void sendCommand(const u08 command, const u08 *data, const u08 length, const u08 replyLength)
+{
+	u08 packet[2 + ROBOCLAW_MAX_DATA + 2];
+	u08 packetLength = 0;
+	u16 crc = 0;
+
+	packet[packetLength++] = ROBOCLAW_ADDRESS;
+	packet[packetLength++] = command;
+	for (u08 i = 0; i < length; i++)
+		packet[packetLength++] = data[i];
+	for (u08 i = 0; i < packetLength; i++)
+		crc = _crc_xmodem_update(crc, packet[i]);
+	packet[packetLength++] = crc >> 8;
+	packet[packetLength++] = crc;
+
+	//discard any stray bytes, so they aren't mistaken for the reply
+	u08 discard;
+	while (uartGetChar(UART_PORT1, &discard))
+		;
+
+	rxCount = 0;
+	rxExpected = replyLength;
+	pendingCommand = command;
+	requestTime = getUptimeMs();
+
+	//if the packet doesn't fit, the command simply times out and is retried
+	uartWriteAll(UART_PORT1, packet, packetLength);
+}
+
+//! Stores a big-endian 32-bit value at the given buffer location.
+static void putU32(u08 *buffer, const u32 value)
+{
+	buffer[0] = value >> 24;
+	buffer[1] = value >> 16;
+	buffer[2] = value >> 8;
+	buffer[3] = value;
+}
+
+/*! Checks the reply to a speed read and saves the speed.
+    The reply CRC covers the address and command that were sent, followed by the reply data.
+ */
+static bool processSpeedReply(const RoboclawMotor motor, const u08 command)
+{
+	u16 crc = _crc_xmodem_update(_crc_xmodem_update(0, ROBOCLAW_ADDRESS), command);
+	for (u08 i = 0; i < SPEED_REPLY_LENGTH - 2; i++)
+		crc = _crc_xmodem_update(crc, rxBuffer[i]);
+	if (crc != (((u16)rxBuffer[5] << 8) | rxBuffer[6]))
+		return FALSE;
+
+	s32 speed = (s32)(((u32)rxBuffer[0] << 24) | ((u32)rxBuffer[1] << 16) | ((u32)rxBuffer[2] << 8) | rxBuffer[3]);
+	//a nonzero direction byte means the motor is turning backwards
+	if (rxBuffer[4] != 0 && speed > 0)
+		speed = -speed;
+
+	measuredSpeeds[motor] = speed;
+	measuredValid[motor] = !setpointChanged;
+	return TRUE;
+}
+
+//! Handles a complete reply to the outstanding command.
+static void processReply()
+{
+	bool valid = FALSE;
+
+	switch (pendingCommand)
+	{
+		case ROBOCLAW_MIXEDSPEEDACCEL:
+			valid = (rxBuffer[0] == ROBOCLAW_ACK);
+			break;
+		case ROBOCLAW_GETM1SPEED:
+			valid = processSpeedReply(ROBOCLAW_M1, pendingCommand);
+			break;
+		case ROBOCLAW_GETM2SPEED:
+			valid = processSpeedReply(ROBOCLAW_M2, pendingCommand);
+			break;
+	}
+
+	if (!valid)
+	{
+		errorCount++;
+		//a rejected setpoint will be sent again
+		if (pendingCommand == ROBOCLAW_MIXEDSPEEDACCEL)
+			setpointChanged = TRUE;
+	}
+}
+
+//! Stops both motor channels. UART1 must be enabled with USE_UART1 and UART1_BAUD in the Makefile.
+void roboclawInit()
+{
+	roboclawSetSpeeds(0, 0, 0);
+}
+
+/*! Handles the reply to the outstanding command, and sends the next command once the RoboClaw is idle.
+    Should be called regularly from the main loop.
+ */
+void roboclawExec()
+{
+	if (pendingCommand != 0)
+	{
+		rxCount += uartRead(UART_PORT1, &rxBuffer[rxCount], rxExpected - rxCount);
+
+		if (rxCount >= rxExpected)
+		{
+			processReply();
+		}
+		else if (getUptimeMs() - requestTime > ROBOCLAW_TIMEOUT_MS)
+		{
+			errorCount++;
+			if (pendingCommand == ROBOCLAW_MIXEDSPEEDACCEL)
+				setpointChanged = TRUE;
+		}
+		else
+		{
+			//still waiting for the reply
+			return;
+		}
+		pendingCommand = 0;
+	}
+
+	if (setpointChanged)
+	{
+		u08 data[12];
+		putU32(&data[0], setpointAcceleration);
+		putU32(&data[4], (u32)setpointSpeeds[ROBOCLAW_M1]);
+		putU32(&data[8], (u32)setpointSpeeds[ROBOCLAW_M2]);
+		setpointChanged = FALSE;
+		sendCommand(ROBOCLAW_MIXEDSPEEDACCEL, data, sizeof(data), 1);
+	}
+	else if (getUptimeMs() - lastPollTime >= ROBOCLAW_POLL_MS / 2)
+	{
+		lastPollTime = getUptimeMs();
+		sendCommand(nextPoll == ROBOCLAW_M1 ? ROBOCLAW_GETM1SPEED : ROBOCLAW_GETM2SPEED, NULL, 0, SPEED_REPLY_LENGTH);
+		nextPoll = (nextPoll == ROBOCLAW_M1) ? ROBOCLAW_M2 : ROBOCLAW_M1;
+	}
+}
+
+/*! Sets new speed setpoints for both motor channels. The RoboClaw's speed PID holds each encoder at its setpoint.
+    The setpoint is sent by roboclawExec(), and the measured speeds are invalid until it has been sent and read back.
+    @param acceleration The acceleration to ramp both channels at, in quadrature pulses per second per second.
+    @param m1Speed The M1 speed in quadrature pulses per second. Negative values run backwards.
+    @param m2Speed The M2 speed in quadrature pulses per second. Negative values run backwards.
+ */
+void roboclawSetSpeeds(const u32 acceleration, const s32 m1Speed, const s32 m2Speed)
+{
+	setpointAcceleration = acceleration;
+	setpointSpeeds[ROBOCLAW_M1] = m1Speed;
+	setpointSpeeds[ROBOCLAW_M2] = m2Speed;
+	setpointChanged = TRUE;
+	measuredValid[ROBOCLAW_M1] = FALSE;
+	measuredValid[ROBOCLAW_M2] = FALSE;
+}
+
+/*! Gets the most recent encoder speed read from a motor channel.
+    @param motor The motor channel.
+    @param speed Set to the speed in quadrature pulses per second.
+    @return TRUE if the speed was read after the current setpoint was sent.
+ */
+bool roboclawGetSpeed(const RoboclawMotor motor, s32 *speed)
+{
+	*speed = measuredSpeeds[motor];
+	return measuredValid[motor];
+}
+
+//! Gets the number of commands that timed out or were rejected since startup.
+u16 roboclawGetErrorCount()
+{
+	return errorCount;
+}
@@ -0,0 +1,19 @@
+#ifndef ROBOCLAW_H
+#define ROBOCLAW_H
+
+#include "globals.h"
+
+//! Selects a RoboClaw motor channel.
+typedef enum
+{
+	ROBOCLAW_M1 = 0, //!< Motor channel 1, the left launcher wheel.
+	ROBOCLAW_M2 = 1  //!< Motor channel 2, the right launcher wheel.
+} RoboclawMotor;
+
+void roboclawInit();
+void roboclawExec();
+void roboclawSetSpeeds(const u32 acceleration, const s32 m1Speed, const s32 m2Speed);
+bool roboclawGetSpeed(const RoboclawMotor motor, s32 *speed);
+u16 roboclawGetErrorCount();
+
+#endif
@@ -3,9 +3,15 @@
 //Elapsed seconds
 extern volatile u08 secCount;
 
+//! The rate of getFastTicks(): timer5 counts at 16 MHz / 8.
+#define FAST_TICKS_PER_US 2
+
 //Prototypes
 void rtcInit();
 void rtcRestart();
 void rtcPause();
 void rtcResume();
 u32 getMsCount();
+u32 getUptimeMs();
+u16 getFastTicks();
+u32 getUptimeUs();
@@ -1,4 +1,5 @@
 #include "rtc.h"
+#include "trace.h"
 #include <util/atomic.h>
 
 //There is an external 32.768kHz watch crystal attached to the Xiphos board,
@@ -9,8 +10,14 @@
 //! The number of seconds that have elapsed since the RTC was started.
 volatile u08 secCount;
 volatile u16 tickCount;
+//! The number of 1/128th seconds since rtcInit(), which keeps counting while the RTC is stopped or paused.
+static volatile u32 uptimeTicks;
+//! Whether tickCount and secCount are currently counting.
+static volatile bool rtcRunning = FALSE;
 
-//! Initializes the RTC timer/counter, but does not start it.
+/*! Initializes and starts the RTC timer/counter. The uptime count starts immediately,
+ *  but the competition clock (secCount) does not run until rtcRestart() is called.
+ */
 void rtcInit()
 {
 	//Normal port operation, normal WGM.
@@ -21,58 +28,119 @@ void rtcInit()
 
 	//Enable interrupt for timer5 output compare unit A
 	TIMSK5 = _BV(OCIE5A);
+
+	//Set timer5 prescaler to /8
+	TCCR5B = _BV(CS51);
 }
 
-//! Resets the timer to zero seconds and starts running it again.
+/*! Resets the RTC to zero seconds and starts running it again.
+ *  Note: this is only accurate to within 1/128th of a second, because the timer keeps running for the uptime count.
+ */
 void rtcRestart()
 {
-	//Reset fractional seconds to 0.
-	TCNT5 = 0;
-
-	//Reset secCount and tickCount
-	secCount = 0;
-	tickCount = 0;
+	ATOMIC_BLOCK(ATOMIC_FORCEON)
+	{
+		//Reset secCount and tickCount
+		secCount = 0;
+		tickCount = 0;
+	}
 
-	//Apply clock source to timer5.
 	rtcResume();
 }
 
 /*! Freezes running the Real Time Clock.
- *  Note: this technique is not sub-second accurate, because the prescaler continues to run.
+ *  Note: this is only accurate to within 1/128th of a second, because the timer keeps running for the uptime count.
  */
 void rtcPause()
 {
-	//Stop timer5 by removing its clock source.
-	TCCR5B = 0;
+	rtcRunning = FALSE;
 }
 
 /*! Resumes running the Real Time Clock.
- *  Note: this technique is not sub-second accurate, because the prescaler continues to run.
+ *  Note: this is only accurate to within 1/128th of a second, because the timer keeps running for the uptime count.
  */
 void rtcResume()
 {
-	//Set timer5 prescaler to /8
-	TCCR5B = _BV(CS51);
+	rtcRunning = TRUE;
 }
 
 //! Fires when timer5 matches output compare value, which means that 1/128th of a second has elapsed.
 ISR(TIMER5_COMPA_vect)
 {
+	TRACE_ISR_ENTER(TRACE_TICK);
 	//Update the output compare value
 	OCR5A += 15625;
 
-	//Increment the elapsed 1/128th seconds count
-	tickCount++;
-	//update secCount
-	secCount = tickCount >> 7;
+	uptimeTicks++;
+
+	if (rtcRunning)
+	{
+		//Increment the elapsed 1/128th seconds count
+		tickCount++;
+		//update secCount
+		secCount = tickCount >> 7;
+	}
+	TRACE_ISR_EXIT(TRACE_TICK);
 }
 
 u32 getMsCount()
 {
 	u32 temp;
-	ATOMIC_BLOCK(ATOMIC_FORCEON)
+	//restore the interrupt state, so this can also be used to timestamp events from an ISR
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
 		temp = tickCount;
 	}
-	return (u32)(temp * 1000.0 / 128);
+	//1000 / 128 = 125 / 16, which avoids floating point math
+	return (temp * 125) >> 4;
+}
+
+/*! Gets the number of milliseconds since rtcInit(), with a resolution of 1/128th of a second.
+ *  Unlike getMsCount(), this keeps counting while the RTC is paused, so it can be used for timeouts.
+ */
+u32 getUptimeMs()
+{
+	u32 temp;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		temp = uptimeTicks;
+	}
+	return (temp * 125) >> 4;
+}
+
+/*! Gets the free-running count of timer5, which runs at ::FAST_TICKS_PER_US ticks per microsecond and wraps around
+ *  every 32.768 ms. For timing short stretches of code: subtract two readings as u16.
+ */
+u16 getFastTicks()
+{
+	u16 temp;
+	//reading a 16-bit timer register uses the shared TEMP register, so an interrupt mustn't read one in between
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		temp = TCNT5;
+	}
+	return temp;
+}
+
+/*! Gets the number of microseconds since rtcInit(), from the uptime count and timer5. It wraps around every 71.6
+ *  minutes, so compare readings as a difference. Used to timestamp packets for the PC's clock synchronization.
+ */
+u32 getUptimeUs()
+{
+	u32 ticks;
+	u16 sinceTick;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ticks = uptimeTicks;
+		//the last tick happened when timer5 matched the previous compare value, 15625 counts before OCR5A
+		sinceTick = TCNT5 - (OCR5A - 15625);
+		//a compare match whose interrupt hasn't run yet has already started the next tick
+		if (TIFR5 & _BV(OCF5A))
+		{
+			ticks++;
+			sinceTick = TCNT5 - OCR5A;
+		}
+	}
+	//each tick is 15625 counts of half a microsecond, so 7812.5 us: the half is added separately, so only the result wraps
+	return ticks * 7812 + (ticks + sinceTick) / 2;
 }
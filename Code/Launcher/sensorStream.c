@@ -0,0 +1,165 @@
+/*! @file
+    Streams samples of a set of analog and digital inputs to the PC for the Remote System's CMD_SUBSCRIBE,
+    so the PC doesn't have to poll one value per round trip.
+
+    The analog inputs are read from the background ADC scan (see adcScan.c), so taking a sample never waits for a
+    conversion. Samples are batched, several to a ::RESP_SAMPLES packet, whose data section is:
+    - the sequenceNum of the CMD_SUBSCRIBE that started the stream.
+    - frame number: increments with each packet, so the PC can tell when one was lost.
+    - the number of samples.
+    - the samples.
+
+    Each sample is the time (the low 16 bits of getUptimeMs(), MSB first), then the 10-bit reading of each subscribed
+    analog input in order, packed MSB first with no gaps and zero padded to a whole byte, then the digital inputs
+    (digitalInputs() masked to the subscribed ones, u16 MSB first) if any are subscribed.
+ */
+#include "adcScan.h"
+#include "packetprotocol.h"
+#include "remoteControl.h"
+#include "rtc.h"
+#include "sensorStream.h"
+#include "utility.h"
+#include <avr/io.h>
+
+//! The length of the sequence, frame number and sample count bytes.
+#define SENSOR_STREAM_HEADER_LENGTH 3
+
+//! The sample period in milliseconds, or 0 if the stream is off.
+static u16 periodMs = 0;
+static u32 nextSampleTime;
+static u08 subscribedAnalog;
+static u16 subscribedDigital;
+//! The analog inputs the stream added to the ADC scan, to be removed again when it stops.
+static u08 addedAnalog;
+static u08 sampleLength;
+
+//The packet being assembled.
+static u08 packet[SENSOR_STREAM_MAX_DATA];
+static u08 packetLength;
+static u08 sampleCount;
+static u32 firstSampleTime;
+static u08 frameNumber;
+
+//Local prototypes
+static void addSample(const u32 time);
+static void flushSamples();
+
+/*! Starts streaming samples, replacing any stream that is already running.
+    @param sequence The sequenceNum of the CMD_SUBSCRIBE, echoed in every ::RESP_SAMPLES packet.
+    @param newPeriodMs The time between samples in milliseconds, or 0 to stop.
+    @param analogMask One bit per analog input to sample.
+    @param digitalMask One bit per digital input to sample, as in digitalInputs().
+ */
+void sensorStreamStart(const u08 sequence, const u16 newPeriodMs, const u08 analogMask, const u16 digitalMask)
+{
+	sensorStreamStop();
+	if (newPeriodMs == 0 || (analogMask == 0 && digitalMask == 0))
+		return;
+
+	addedAnalog = analogMask & ~adcScanChannels();
+	adcScanAdd(addedAnalog);
+
+	subscribedAnalog = analogMask;
+	subscribedDigital = digitalMask;
+	u08 analogCount = 0;
+	for (u08 i = 0; i < NUM_ANALOG_INPUTS; i++)
+	{
+		if (analogMask & _BV(i))
+			analogCount++;
+	}
+	sampleLength = 2 + (analogCount * 10 + 7) / 8 + (digitalMask != 0 ? 2 : 0);
+
+	packet[0] = sequence;
+	frameNumber = 0;
+	sampleCount = 0;
+	periodMs = newPeriodMs;
+	//give the scan time to read the added inputs before the first sample
+	nextSampleTime = getUptimeMs() + periodMs;
+}
+
+//! Sends any samples that are waiting, and stops the stream.
+void sensorStreamStop()
+{
+	if (periodMs == 0)
+		return;
+	flushSamples();
+	adcScanRemove(addedAnalog);
+	periodMs = 0;
+}
+
+//! Takes a sample when one is due, and sends the packet when it is full or has been waiting too long.
+void sensorStreamExec()
+{
+	if (periodMs == 0)
+		return;
+
+	const u32 now = getUptimeMs();
+	if ((s32)(now - nextSampleTime) >= 0)
+	{
+		addSample(now);
+		nextSampleTime += periodMs;
+		//if the main loop fell behind, skip the missed samples instead of taking them all at once
+		if ((s32)(now - nextSampleTime) >= 0)
+			nextSampleTime = now + periodMs;
+	}
+
+	if (sampleCount > 0 && now - firstSampleTime >= SENSOR_STREAM_MAX_LATENCY_MS)
+		flushSamples();
+}
+
+//! Adds a sample to the packet being assembled, sending the packet first if the sample doesn't fit.
+static void addSample(const u32 time)
+{
+	if (sampleCount > 0 && packetLength + sampleLength > SENSOR_STREAM_MAX_DATA)
+		flushSamples();
+	if (sampleCount == 0)
+	{
+		packetLength = SENSOR_STREAM_HEADER_LENGTH;
+		firstSampleTime = time;
+	}
+
+	u08 *next = &packet[packetLength];
+	*next++ = (u08)(time >> 8);
+	*next++ = (u08)time;
+
+	//pack the 10-bit readings MSB first, keeping the bits not written yet in bits
+	u32 bits = 0;
+	u08 bitCount = 0;
+	for (u08 i = 0; i < NUM_ANALOG_INPUTS; i++)
+	{
+		if (!(subscribedAnalog & _BV(i)))
+			continue;
+		const u16 reading = adcScanRead(i) & 0x3FF;
+		//bitCount is under 8 here, so the reading fits alongside the pending bits
+		bits = (bits << 10) | reading;
+		bitCount += 10;
+		while (bitCount >= 8)
+		{
+			bitCount -= 8;
+			*next++ = (u08)(bits >> bitCount);
+		}
+	}
+	if (bitCount > 0)
+		*next++ = (u08)(bits << (8 - bitCount));
+
+	if (subscribedDigital != 0)
+	{
+		const u16 digital = digitalInputs() & subscribedDigital;
+		*next++ = (u08)(digital >> 8);
+		*next++ = (u08)digital;
+	}
+
+	packetLength += sampleLength;
+	sampleCount++;
+}
+
+//! Sends the packet being assembled, if it has any samples.
+static void flushSamples()
+{
+	if (sampleCount == 0)
+		return;
+	packet[1] = frameNumber++;
+	packet[2] = sampleCount;
+	sendPacketPriority(PACKET_PRIORITY_TELEMETRY, RESP_SAMPLES, packet, packetLength);
+	sampleCount = 0;
+}
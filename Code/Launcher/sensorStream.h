@@ -0,0 +1,15 @@
+#ifndef SENSORSTREAM_H
+#define SENSORSTREAM_H
+
+#include "globals.h"
+
+//! The largest data section of a ::RESP_SAMPLES packet. Kept well below ::MAX_PACKET_DATA to limit latency.
+#define SENSOR_STREAM_MAX_DATA 96
+//! The longest time (in milliseconds) a sample is held back waiting for the packet to fill up.
+#define SENSOR_STREAM_MAX_LATENCY_MS 50
+
+void sensorStreamStart(const u08 sequence, const u16 periodMs, const u08 analogMask, const u16 digitalMask);
+void sensorStreamStop();
+void sensorStreamExec();
+
+#endif
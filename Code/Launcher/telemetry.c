@@ -0,0 +1,222 @@
+/*! @file
+    Streams sensor samples to the PC in compact TELEMETRY_DATA packets.
+
+    Samples are batched, several to a packet. The data section of a TELEMETRY_DATA packet is:
+    - flags and sample count: ::TELEMETRY_KEYFRAME if the first sample is a keyframe, OR'd with the number of samples.
+    - frame number: increments with each TELEMETRY_DATA packet, so the PC can tell when one was lost.
+    - the samples.
+
+    A keyframe sample holds the full values: the time (u32, from getUptimeMs()) and then each ::TelemetryChannel (u16),
+    all MSB first. Every other sample holds only the differences from the sample before it (which may be in the previous
+    packet): the elapsed time as a varint, then the change in each channel as a zigzag varint. Varints store 7 bits per
+    byte, least significant first, with bit 7 set in every byte but the last. Zigzag maps small signed changes to small
+    unsigned numbers (0, -1, 1, -2... become 0, 1, 2, 3...), so a slowly changing channel usually takes a single byte.
+    Channel differences wrap around at 16 bits.
+
+    Every ::TELEMETRY_KEYFRAME_INTERVAL packets, and after any packet that couldn't be sent, a packet starts with a keyframe,
+    so the PC can resynchronize after a lost packet.
+ */
+#include "launcherPackets.h"
+#include "main.h"
+#include "packetprotocol.h"
+#include "rtc.h"
+#include "telemetry.h"
+#include <string.h>
+#include <util/atomic.h>
+
+//! The largest data section of a TELEMETRY_DATA packet. Kept well below ::MAX_PACKET_DATA to limit latency and UART buffer use.
+#define TELEMETRY_MAX_DATA 96
+//! The number of TELEMETRY_DATA packets from one keyframe to the next.
+#define TELEMETRY_KEYFRAME_INTERVAL 10
+//! The longest time (in milliseconds) a sample is held back waiting for the packet to fill up.
+#define TELEMETRY_MAX_LATENCY_MS 100
+//! The length of the flags/sample count and frame number bytes.
+#define TELEMETRY_HEADER_LENGTH 2
+//! The longest encoded sample: a 5-byte time varint and a 3-byte varint for each channel.
+#define TELEMETRY_MAX_SAMPLE_LENGTH (5 + 3 * NUM_TELEMETRY_CHANNELS)
+
+//! The sample period in milliseconds, or 0 if telemetry is off.
+static u16 periodMs = 0;
+static u32 nextSampleTime;
+
+//The packet being assembled.
+static u08 packet[TELEMETRY_MAX_DATA];
+static u08 packetLength;
+static u08 sampleCount;
+static bool keyframe;
+//! The time of the first sample in the packet being assembled.
+static u32 firstSampleTime;
+static u08 frameNumber;
+static u08 framesSinceKeyframe;
+
+//The sample the next delta is taken from.
+static u32 lastTime;
+static u16 lastValues[NUM_TELEMETRY_CHANNELS];
+
+//Local prototypes
+static void readSample(u16 *values);
+static void addSample(const u32 time, const u16 *values);
+static u08 encodeKeyframe(u08 *sample, const u32 time, const u16 *values);
+static u08 encodeDelta(u08 *sample, const u32 time, const u16 *values);
+static u08 encodeVarint(u08 *buffer, u32 value);
+static void flushTelemetry();
+
+/*! Starts sending telemetry samples, or changes the sample period if telemetry is already on.
+    @param newPeriodMs The time between samples in milliseconds, or 0 to stop.
+ */
+void telemetryStart(const u16 newPeriodMs)
+{
+	if (newPeriodMs == 0)
+	{
+		telemetryStop();
+		return;
+	}
+	if (periodMs == 0)
+	{
+		//the PC needs a keyframe to start decoding
+		framesSinceKeyframe = 0;
+		nextSampleTime = getUptimeMs();
+	}
+	periodMs = newPeriodMs;
+}
+
+//! Sends any samples that are waiting, and stops sending telemetry.
+void telemetryStop()
+{
+	flushTelemetry();
+	periodMs = 0;
+}
+
+//! Takes a sample when one is due, and sends the packet when it is full or has been waiting too long.
+void telemetryExec()
+{
+	if (periodMs == 0)
+		return;
+
+	const u32 now = getUptimeMs();
+	if ((s32)(now - nextSampleTime) >= 0)
+	{
+		u16 values[NUM_TELEMETRY_CHANNELS];
+		readSample(values);
+		addSample(now, values);
+
+		nextSampleTime += periodMs;
+		//if the main loop fell behind, skip the missed samples instead of taking them all at once
+		if ((s32)(now - nextSampleTime) >= 0)
+			nextSampleTime = now + periodMs;
+	}
+
+	if (sampleCount > 0 && now - firstSampleTime >= TELEMETRY_MAX_LATENCY_MS)
+		flushTelemetry();
+}
+
+//! Reads the current value of every ::TelemetryChannel.
+static void readSample(u16 *values)
+{
+	//the readings are updated by the ADC interrupt
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		values[TELEMETRY_INNER_TICKS] = totalInnerEncoderTicks;
+		values[TELEMETRY_WALL_TICKS] = totalWallEncoderTicks;
+		values[TELEMETRY_INNER_READING] = innerEncoderReading;
+		values[TELEMETRY_WALL_READING] = wallEncoderReading;
+		values[TELEMETRY_BATTERY] = batteryReading;
+		values[TELEMETRY_ERROR] = (u16)error;
+	}
+}
+
+//! Adds a sample to the packet being assembled, sending the packet first if the sample doesn't fit.
+static void addSample(const u32 time, const u16 *values)
+{
+	u08 sample[TELEMETRY_MAX_SAMPLE_LENGTH];
+	u08 length = 0;
+
+	if (sampleCount > 0)
+	{
+		length = encodeDelta(sample, time, values);
+		if (packetLength + length > TELEMETRY_MAX_DATA || sampleCount >= TELEMETRY_SAMPLE_COUNT_MASK)
+			flushTelemetry();
+	}
+	if (sampleCount == 0)
+	{
+		//start a new packet, leaving room for the header
+		keyframe = (framesSinceKeyframe == 0);
+		packetLength = TELEMETRY_HEADER_LENGTH;
+		firstSampleTime = time;
+		if (keyframe)
+			length = encodeKeyframe(sample, time, values);
+		else
+			length = encodeDelta(sample, time, values);
+	}
+
+	memcpy(&packet[packetLength], sample, length);
+	packetLength += length;
+	sampleCount++;
+
+	lastTime = time;
+	memcpy(lastValues, values, sizeof(lastValues));
+}
+
+//! Encodes the full values of a sample. @return The number of bytes written to sample.
+static u08 encodeKeyframe(u08 *sample, const u32 time, const u16 *values)
+{
+	u08 *next = sample;
+	*next++ = (u08)(time >> 24);
+	*next++ = (u08)(time >> 16);
+	*next++ = (u08)(time >> 8);
+	*next++ = (u08)time;
+	for (u08 i = 0; i < NUM_TELEMETRY_CHANNELS; i++)
+	{
+		*next++ = (u08)(values[i] >> 8);
+		*next++ = (u08)values[i];
+	}
+	return next - sample;
+}
+
+//! Encodes the differences between a sample and the previous one. @return The number of bytes written to sample.
+static u08 encodeDelta(u08 *sample, const u32 time, const u16 *values)
+{
+	u08 length = encodeVarint(sample, time - lastTime);
+	for (u08 i = 0; i < NUM_TELEMETRY_CHANNELS; i++)
+	{
+		const s16 delta = (s16)(values[i] - lastValues[i]);
+		//zigzag: move the sign to bit 0
+		const u16 zigzag = ((u16)delta << 1) ^ (u16)(delta >> 15);
+		length += encodeVarint(&sample[length], zigzag);
+	}
+	return length;
+}
+
+//! Writes a value as a varint. @return The number of bytes written.
+static u08 encodeVarint(u08 *buffer, u32 value)
+{
+	u08 length = 0;
+	while (value >= 0x80)
+	{
+		buffer[length++] = (u08)value | 0x80;
+		value >>= 7;
+	}
+	buffer[length++] = (u08)value;
+	return length;
+}
+
+//! Sends the packet being assembled, if it has any samples.
+static void flushTelemetry()
+{
+	if (sampleCount == 0)
+		return;
+
+	packet[0] = (keyframe ? TELEMETRY_KEYFRAME : 0) | sampleCount;
+	packet[1] = frameNumber++;
+	if (packetLinkSendPriority(&pcLink, PACKET_PRIORITY_TELEMETRY, TELEMETRY_DATA, packet, packetLength))
+	{
+		if (++framesSinceKeyframe >= TELEMETRY_KEYFRAME_INTERVAL)
+			framesSinceKeyframe = 0;
+	}
+	else
+	{
+		//the PC can't decode the deltas that follow a lost packet, so resynchronize it right away
+		framesSinceKeyframe = 0;
+	}
+	sampleCount = 0;
+}
@@ -0,0 +1,27 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "globals.h"
+
+//! The values recorded in each telemetry sample, in the order they are encoded.
+typedef enum
+{
+	TELEMETRY_INNER_TICKS,   //!< totalInnerEncoderTicks
+	TELEMETRY_WALL_TICKS,    //!< totalWallEncoderTicks
+	TELEMETRY_INNER_READING, //!< innerEncoderReading
+	TELEMETRY_WALL_READING,  //!< wallEncoderReading
+	TELEMETRY_BATTERY,       //!< batteryReading
+	TELEMETRY_ERROR,         //!< error (between the two encoders)
+	NUM_TELEMETRY_CHANNELS
+} TelemetryChannel;
+
+//! Set in the first byte of a TELEMETRY_DATA packet whose first sample is a keyframe.
+#define TELEMETRY_KEYFRAME 0x80
+//! Masks the number of samples out of the first byte of a TELEMETRY_DATA packet.
+#define TELEMETRY_SAMPLE_COUNT_MASK 0x7F
+
+void telemetryStart(const u16 periodMs);
+void telemetryStop();
+void telemetryExec();
+
+#endif
@@ -6,7 +6,6 @@
 #include "LCD.h"
 #include "main.h"
 #include "motors.h"
-#include "serial.h"
 #include "servos.h"
 #include "util.h"
 #include "utility.h"
@@ -76,6 +75,10 @@ void testModeExec()
 		//loop to keep updating the values on the LCD
 		while (1)
 		{
+			//test mode doesn't return to the main loop, so keep the PC link running and apply tuning here
+			serviceExec();
+			tunablesApply();
+
 			switch (page)
 			{
 				case TEST_BatteryVoltage:
@@ -0,0 +1,137 @@
+/*! @file
+    Sends the events of the trace ring (see XiphosLibrary/trace.c) to the PC in TRACE_DATA packets, for Host/tracedump
+    to turn into a timeline.
+
+    In ::TRACE_MODE_STREAM the events are sent as they come, a packet at a time at debug priority, so tracing gives way
+    to everything else on the link. If the link can't keep up, the oldest events are overwritten, and the next packet
+    says how many were lost. In ::TRACE_MODE_RECORD the ring just keeps the latest events, until a DUMP_TRACE stops
+    recording and sends them, to see what led up to a problem without the cost of sending everything.
+
+    The data section of a TRACE_DATA packet is:
+    - the getUptimeUs() time and the trace clock (timer5, at ::FAST_TICKS_PER_US) when recording started.
+    - the number of events lost before the ones in this packet.
+    - flags: ::TRACE_DATA_END on the last packet of a dump.
+    - 4 bytes for each event: the ::TraceId or ::LauncherTraceId, OR'd with ::TRACE_EXIT at the end of one, the low
+      8 bits of the number of times the clock has wrapped around since recording started, and the clock (MSB first).
+ */
+#include "debug.h"
+#include "packetprotocol.h"
+#include "protocol.h"
+#include "rtc.h"
+#include "traceStream.h"
+#include <util/atomic.h>
+
+#if USE_TRACE != 1
+	#error "traceStream.c needs USE_TRACE = 1 in the Makefile"
+#endif
+
+//! The bytes in a TRACE_DATA packet before the events.
+#define TRACE_HEADER_LENGTH 9
+//! The bytes of each event in a TRACE_DATA packet.
+#define TRACE_EVENT_LENGTH 4
+//! The most events in one TRACE_DATA packet.
+#define TRACE_PACKET_EVENTS ((MAX_PACKET_DATA - TRACE_HEADER_LENGTH) / TRACE_EVENT_LENGTH)
+//! The longest time (in milliseconds) streamed events are held back waiting for a packet to fill up.
+#define TRACE_MAX_LATENCY_MS 50
+//! The number of events taken out of the ring at once, to keep the stack small.
+#define TRACE_TAKE_CHUNK 8
+
+//! The current ::TraceMode.
+static u08 traceMode = TRACE_MODE_OFF;
+//! Set from a DUMP_TRACE until the last of the events have been sent.
+static bool dumping = FALSE;
+//When recording started, for the PC to place the events.
+static u32 startUs;
+static u16 startClock;
+//! The time (from getUptimeMs()) the last TRACE_DATA packet was sent while streaming.
+static u32 lastSendTime;
+
+//Local prototypes
+static void sendTraceData(const bool dump);
+
+/*! Starts tracing in a ::TraceMode, with an empty trace ring, or stops it.
+ *  @param mask Bit n is set to trace the ::TraceId or ::LauncherTraceId n. ::TRACE_TICK is always traced, since the
+ *  PC can only count the wraparounds of the clock if there is an event at least every 32 ms.
+ */
+void traceStreamSet(const u08 mode, const u32 mask)
+{
+	if (mode >= NUM_TRACE_MODES)
+	{
+		logWarning("unknown trace mode %d", mode);
+		return;
+	}
+
+	dumping = FALSE;
+	traceMode = mode;
+	if (mode == TRACE_MODE_OFF)
+	{
+		traceStop();
+		return;
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		startUs = getUptimeUs();
+		startClock = traceStart(mask | _BV(TRACE_TICK));
+	}
+	lastSendTime = getUptimeMs();
+}
+
+//! Stops tracing, and starts sending the events that the trace ring holds.
+void traceStreamDump()
+{
+	traceStop();
+	traceMode = TRACE_MODE_OFF;
+	dumping = TRUE;
+}
+
+//! Sends a TRACE_DATA packet when one is due, and there is room for it.
+void traceStreamExec()
+{
+	if (dumping)
+	{
+		sendTraceData(TRUE);
+		return;
+	}
+	if (traceMode != TRACE_MODE_STREAM)
+		return;
+
+	const u08 count = traceCount();
+	if (count >= TRACE_PACKET_EVENTS || (count > 0 && getUptimeMs() - lastSendTime >= TRACE_MAX_LATENCY_MS))
+		sendTraceData(FALSE);
+}
+
+/*! Sends the oldest events in a TRACE_DATA packet, if it can be queued straight away.
+ *  Otherwise they stay in the trace ring for the next try.
+ */
+static void sendTraceData(const bool dump)
+{
+	const u08 waiting = traceCount();
+	const u08 count = (waiting < TRACE_PACKET_EVENTS) ? waiting : TRACE_PACKET_EVENTS;
+	if (!packetLinkHasRoom(&pcLink, PACKET_PRIORITY_DEBUG, TRACE_HEADER_LENGTH + count * TRACE_EVENT_LENGTH))
+		return;
+
+	//nothing is recorded during a dump, so this is its last packet if it takes everything
+	const bool end = dump && (count == waiting);
+	u08 traceData[MAX_PACKET_DATA];
+	u08 length = TRACE_DATA_encode(traceData, startUs, startClock, traceTakeLost(), end ? TRACE_DATA_END : 0);
+	for (u08 taken = 0; taken < count; )
+	{
+		TraceEvent events[TRACE_TAKE_CHUNK];
+		const u08 chunk = traceTake(events, (count - taken < TRACE_TAKE_CHUNK) ? count - taken : TRACE_TAKE_CHUNK);
+		if (chunk == 0)
+			break;
+		for (u08 i = 0; i < chunk; i++)
+		{
+			traceData[length++] = events[i].code;
+			traceData[length++] = events[i].wraps;
+			traceData[length++] = (u08)(events[i].clock >> 8);
+			traceData[length++] = (u08)events[i].clock;
+		}
+		taken += chunk;
+	}
+	packetLinkSendPriority(&pcLink, PACKET_PRIORITY_DEBUG, TRACE_DATA, traceData, length);
+
+	lastSendTime = getUptimeMs();
+	if (end)
+		dumping = FALSE;
+}
@@ -0,0 +1,42 @@
+#ifndef TRACESTREAM_H
+#define TRACESTREAM_H
+
+#include "globals.h"
+#include "trace.h"
+
+//! The Launcher's main loop tasks that are traced, after the interrupts in ::TraceId (see XiphosLibrary/trace.h).
+typedef enum
+{
+	TRACE_MAIN_LOOP = TRACE_FIRST_TASK, //!< A whole pass of the main loop in mainMenu().
+	TRACE_TUNABLES,     //!< tunablesApply()
+	TRACE_PROGRAM,      //!< The chosen program's exec function.
+	TRACE_PACKETS,      //!< execPacketDriver()
+	TRACE_REMOTE,       //!< remoteSystemService()
+	TRACE_TELEMETRY,    //!< telemetryExec()
+	TRACE_LINK_BENCH,   //!< linkBenchExec()
+	TRACE_STREAM,       //!< traceStreamExec()
+	TRACE_DRIVE_COMP,   //!< driveCompExec()
+	TRACE_PID,          //!< pidExec()
+	TRACE_ROBOCLAW,     //!< roboclawExec()
+	TRACE_FEEDER,       //!< feederExec()
+	TRACE_LCD_CLOCK,    //!< Printing the time on the LCD.
+	LAST_LauncherTraceId
+} LauncherTraceId;
+
+//! The ways of tracing, set by a SET_TRACE packet.
+typedef enum
+{
+	TRACE_MODE_OFF,     //!< Not recording.
+	TRACE_MODE_RECORD,  //!< Recording into the trace ring, which keeps the latest events until a DUMP_TRACE.
+	TRACE_MODE_STREAM,  //!< Recording, and sending the events to the PC as they come.
+	NUM_TRACE_MODES
+} TraceMode;
+
+//! Set in the flags of the last TRACE_DATA packet of a DUMP_TRACE.
+#define TRACE_DATA_END 0x01
+
+void traceStreamSet(const u08 mode, const u32 mask);
+void traceStreamDump();
+void traceStreamExec();
+
+#endif
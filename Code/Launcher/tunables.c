@@ -0,0 +1,125 @@
+/*! @file
+    Parameters that can be changed from the PC while the robot runs, so gains and speeds can be tuned during
+    practice runs without reflashing.
+
+    The tunables are declared once, in the ::TUNABLES list in tunables.h. It is expanded here into a descriptor
+    table in program space (name, type, range and default of each one), and into the ::TunableId enum.
+    The PC changes values with SET_TUNABLE packets. A change is only staged when it arrives, since packets are
+    also handled while a mode waits in the middle of a step (see waitMs()). tunablesApply() copies the staged
+    values into ::tunableValues at the start of each pass through the main loop, so the control code sees
+    every change at once, and never in the middle of a step.
+ */
+#include "tunables.h"
+#include <avr/pgmspace.h>
+#include <string.h>
+
+//! Describes one tunable. Stored in program space.
+typedef struct
+{
+	PGM_P name;
+	u08 type;
+	s16 min;
+	s16 max;
+	s16 defaultValue;
+} TunableDescriptor;
+
+//The names, one program space string each.
+#define TUNABLE_NAME(id, type, min, max, def) static const char name_##id[] PROGMEM = #id;
+TUNABLES(TUNABLE_NAME)
+#undef TUNABLE_NAME
+
+#define TUNABLE_DESCRIPTOR(id, type, min, max, def) {name_##id, type, min, max, def},
+static const TunableDescriptor descriptors[NUM_TUNABLES] PROGMEM =
+{
+	TUNABLES(TUNABLE_DESCRIPTOR)
+};
+#undef TUNABLE_DESCRIPTOR
+
+s16 tunableValues[NUM_TUNABLES];
+//! The values requested by the PC, copied into tunableValues by tunablesApply().
+static s16 stagedValues[NUM_TUNABLES];
+static bool changesStaged;
+
+//Local prototypes
+static void readDescriptor(const u08 id, TunableDescriptor *descriptor);
+
+//! Sets every tunable to its default.
+void tunablesInit()
+{
+	for (u08 id = 0; id < NUM_TUNABLES; id++)
+	{
+		TunableDescriptor descriptor;
+		readDescriptor(id, &descriptor);
+		tunableValues[id] = descriptor.defaultValue;
+		stagedValues[id] = descriptor.defaultValue;
+	}
+	changesStaged = FALSE;
+}
+
+/*! Puts the changes requested since the last call into effect, all at once.
+    Call only between control steps, where no control code is part-way through using the values.
+ */
+void tunablesApply()
+{
+	if (!changesStaged)
+		return;
+	memcpy(tunableValues, stagedValues, sizeof(tunableValues));
+	changesStaged = FALSE;
+}
+
+//! Stages a new value for a tunable, to be applied by tunablesApply(). The value must be within the tunable's range.
+TunableStatus tunableSet(const u08 id, const s16 value)
+{
+	if (id >= NUM_TUNABLES)
+		return TUNABLE_UNKNOWN;
+
+	TunableDescriptor descriptor;
+	readDescriptor(id, &descriptor);
+	if (value < descriptor.min || value > descriptor.max)
+		return TUNABLE_OUT_OF_RANGE;
+
+	stagedValues[id] = value;
+	changesStaged = TRUE;
+	return TUNABLE_OK;
+}
+
+//! Gets the latest value of a tunable, including a change that hasn't been applied yet.
+TunableStatus tunableGet(const u08 id, s16 *value)
+{
+	if (id >= NUM_TUNABLES)
+		return TUNABLE_UNKNOWN;
+	*value = stagedValues[id];
+	return TUNABLE_OK;
+}
+
+/*! Writes the description of a tunable, as sent in a TUNABLE_INFO packet after the id and count:
+    the ::TunableType, then the u16 min, max, default and latest value (MSB first), then the name (not null terminated).
+    @param buffer Must have room for 9 + ::TUNABLE_NAME_LENGTH bytes.
+    @return The number of bytes written, or 0 if there is no tunable with that id.
+ */
+u08 tunableDescribe(const u08 id, u08 *buffer)
+{
+	if (id >= NUM_TUNABLES)
+		return 0;
+
+	TunableDescriptor descriptor;
+	readDescriptor(id, &descriptor);
+	const s16 values[4] = {descriptor.min, descriptor.max, descriptor.defaultValue, stagedValues[id]};
+
+	u08 *next = buffer;
+	*next++ = descriptor.type;
+	for (u08 i = 0; i < 4; i++)
+	{
+		*next++ = (u08)((u16)values[i] >> 8);
+		*next++ = (u08)values[i];
+	}
+	const u08 nameLength = strlen_P(descriptor.name);
+	memcpy_P(next, descriptor.name, nameLength);
+	return (next - buffer) + nameLength;
+}
+
+//! Copies a tunable's descriptor out of program space.
+static void readDescriptor(const u08 id, TunableDescriptor *descriptor)
+{
+	memcpy_P(descriptor, &descriptors[id], sizeof(TunableDescriptor));
+}
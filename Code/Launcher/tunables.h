@@ -0,0 +1,68 @@
+#ifndef TUNABLES_H
+#define TUNABLES_H
+
+#include "globals.h"
+
+/*! The parameters that can be changed at runtime from the PC, declared once here.
+ *  Each entry is X(id, type, min, max, default): the enum name after ::TUNE_, a ::TunableType, and the range and
+ *  default of its raw s16 value. The id (as a string) is also the name reported to the PC, so keep it to
+ *  ::TUNABLE_NAME_LENGTH characters. Add new entries at the end, so the numbers the PC has seen stay the same.
+ */
+#define TUNABLES(X) \
+	X(PID_KP,                    TUNABLE_Q8,  0,   1024, 38)  /* 0.15: pidExec() correction per tick of error */ \
+	X(FAST_SPEED_INNER_WHEEL,    TUNABLE_INT, 0,   127,  50)  \
+	X(FAST_SPEED_WALL_WHEEL,     TUNABLE_INT, 0,   127,  50)  \
+	X(SLOW_SPEED_INNER_WHEEL,    TUNABLE_INT, 0,   127,  20)  \
+	X(SLOW_SPEED_WALL_WHEEL,     TUNABLE_INT, 0,   127,  20)  \
+	X(SLOW_SPEED_BK_INNER_WHEEL, TUNABLE_INT, 0,   127,  13)  \
+	X(SLOW_SPEED_BK_WALL_WHEEL,  TUNABLE_INT, 0,   127,  13)  \
+	X(TURN_SPEED_INNER_WHEEL,    TUNABLE_INT, 0,   127,  45)  \
+	X(TURN_SPEED_WALL_WHEEL,     TUNABLE_INT, 0,   127,  45)  \
+	X(LAUNCHER_SPEED_NEAR,       TUNABLE_INT, 128, 255,  150) \
+	X(LAUNCHER_SPEED_FAR,        TUNABLE_INT, 128, 255,  165) \
+	X(RSCRAPER_DOWN,             TUNABLE_INT, 0,   255,  3)   \
+	X(RSCRAPER_UP,               TUNABLE_INT, 0,   255,  134) \
+	X(LSCRAPER_DOWN,             TUNABLE_INT, 0,   255,  128) \
+	X(LSCRAPER_UP,               TUNABLE_INT, 0,   255,  6)
+
+//! How the PC should interpret the raw s16 value of a tunable.
+typedef enum
+{
+	TUNABLE_INT, //!< A plain integer.
+	TUNABLE_Q8,  //!< Fixed point with 8 fraction bits: the raw value divided by 256.
+	NUM_TUNABLE_TYPES
+} TunableType;
+
+#define TUNABLE_ENUM(id, type, min, max, def) TUNE_##id,
+//! Identifies each tunable. The value is the number used in the tunable packets.
+typedef enum
+{
+	TUNABLES(TUNABLE_ENUM)
+	NUM_TUNABLES
+} TunableId;
+#undef TUNABLE_ENUM
+
+//! The longest tunable name, without a null terminator.
+#define TUNABLE_NAME_LENGTH 25
+
+//! How a change requested with SET_TUNABLE was handled, reported in TUNABLE_VALUE.
+typedef enum
+{
+	TUNABLE_OK,           //!< The value was accepted, and is applied at the start of the next control period.
+	TUNABLE_UNKNOWN,      //!< There is no tunable with that number.
+	TUNABLE_OUT_OF_RANGE  //!< The value is outside the tunable's range, so it was ignored.
+} TunableStatus;
+
+//! The values in effect. Only changed by tunablesApply(), so they stay the same for a whole control period.
+extern s16 tunableValues[NUM_TUNABLES];
+
+//! The value of a tunable, as a raw s16.
+#define tunable(id) (tunableValues[TUNE_##id])
+
+void tunablesInit();
+void tunablesApply();
+TunableStatus tunableSet(const u08 id, const s16 value);
+TunableStatus tunableGet(const u08 id, s16 *value);
+u08 tunableDescribe(const u08 id, u08 *buffer);
+
+#endif
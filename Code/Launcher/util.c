@@ -1,11 +1,12 @@
 #include "ADC.h"
 #include "debug.h"
+#include "driveComp.h"
 #include "launcherPackets.h"
 #include "LCD.h"
 #include "main.h"
 #include "motors.h"
+#include "roboclaw.h"
 #include "rtc.h"
-#include "serial.h"
 #include "servos.h"
 #include "util.h"
 #include "utility.h"
@@ -18,8 +19,17 @@ static s08 innerSpeed = 0;
 static int i, j;
 u08 pidStop = TRUE;
 
-static s16 curLauncherSpeed = 128;
-static s16 requestedLauncherSpeed = 128;
+//! Whether the feeder servo output is on, so feederExec() knows if it needs to ramp up from stopped.
+static bool feederRunning = FALSE;
+//! Whether feederOn() has been called, so feederExec() should feed balls whenever the launcher is ready.
+static bool feederRequested = FALSE;
+//! Whether the feeder servo is currently moving to (or at) ::FEEDER_RUNNING.
+static bool feederFeeding = FALSE;
+
+#if USE_ROBOCLAW_SERIAL == 1
+//! The launcher wheel speed last requested by launcherSpeed(), in quadrature pulses per second.
+static s32 launcherTargetSpeed = 0;
+#endif
 
 //digital input states
 u08 dBackLeft;
@@ -29,8 +39,6 @@ u08 dFrontSide;
 u08 dFront;
 u08 dSide = DIGITAL_FILTER_CYCLES;
 
-#define LAUNCHER_SPEED_STEP 1
-
 #define LIMIT(v, min, max) (((v) < (min)) ? (min) : (((v) > (max)) ? (max) : (v)))
 #define ABS(v) (((v) < 0) ? -(v) : (v))
 
@@ -50,28 +58,34 @@ void pidDrive(s08 w, s08 i)
 
 void pidExec()
 {
-	s08 wallMotorSpeed;
-	s08 innerMotorSpeed;
-	float Kp = 0.15;
+	s16 wallMotorSpeed;
+	s16 innerMotorSpeed;
+	//proportional gain, in 1/256ths
+	const s32 Kp = tunable(PID_KP);
 	//float Ki = 0.15;
+	//the drive speed limit, converted to full resolution motor speed
+	const s16 maxMotorSpeed = DRIVE_TO_MOTOR_SPEED(100);
 
 	//Do not drive on PID
 	if (pidStop)
 		 return;
 
+	//Compute the correction at full motor resolution, so small errors still adjust the motor speeds.
+	s16 correction = (s16)(Kp * error * MOTOR_SPEED_MAX / (127 * 256));
+
 	// If wall motor is counting ticks faster error will be negative, error is calculated in the interrupt.
 	if (wallSpeed > 0)
-		wallMotorSpeed  = (s08)(wallSpeed  + (Kp * error)); //+ (Ki * totalError));
+		wallMotorSpeed  = DRIVE_TO_MOTOR_SPEED(wallSpeed) + correction; //+ (Ki * totalError));
 	else
-		wallMotorSpeed  = (s08)(wallSpeed  - (Kp * error)); //+ (Ki * totalError));
+		wallMotorSpeed  = DRIVE_TO_MOTOR_SPEED(wallSpeed) - correction; //+ (Ki * totalError));
 
 	if (innerSpeed > 0)
-		innerMotorSpeed = (s08)(innerSpeed - (Kp * error)); //- (Ki * totalError));
+		innerMotorSpeed = DRIVE_TO_MOTOR_SPEED(innerSpeed) - correction; //- (Ki * totalError));
 	else
-		innerMotorSpeed = (s08)(innerSpeed + (Kp * error)); //- (Ki * totalError));
+		innerMotorSpeed = DRIVE_TO_MOTOR_SPEED(innerSpeed) + correction; //- (Ki * totalError));
 
-	wallMotor(LIMIT(wallMotorSpeed, -100, 100));
-	innerMotor(LIMIT(innerMotorSpeed, -100, 100));
+	wallMotorFine(LIMIT(wallMotorSpeed, -maxMotorSpeed, maxMotorSpeed));
+	innerMotorFine(LIMIT(innerMotorSpeed, -maxMotorSpeed, maxMotorSpeed));
 }
 
 void compCollectFwd()
@@ -95,7 +109,7 @@ void compCollectBack()
 
 	feederOff();
 	launcherSpeed(LAUNCHER_SPEED_STOPPED);
-	delayMs(500);
+	waitMs(500);
 
 	// Start driving backwards to get a refill
 	clearScreen();
@@ -111,6 +125,11 @@ void compEmptyHopper()
     printString_P(PSTR("Empty hopper"));
 }
 
+/*! Follows the wall forwards.
+    The offsets added to the SLOW_SPEED_* tunables below, and the tunables' defaults, were hand-tuned before
+    compensateDriveSpeed() lifted every nonzero command above the motor deadband. Small speeds now drive noticeably
+    faster, so they need re-tuning once the deadband in driveComp.c has been calibrated.
+ */
 void hugWallForwards()
 {
 	lowerLine();
@@ -140,6 +159,7 @@ void hugWallForwards()
 	}
 }
 
+//! Follows the wall backwards. The offsets need re-tuning, see hugWallForwards().
 void hugWallBackwards()
 {
 	lowerLine();
@@ -206,6 +226,9 @@ void compDone()
 	u08 priorSeconds = 255;
 	while (secCount < COMPETITION_DURATION_SECS)
 	{
+		serviceExec();
+		mechanismExec();
+
 		// only print when the time has changed
 		if (secCount != priorSeconds)
 		{
@@ -254,76 +277,105 @@ void stop()
 {
 	wallMotor(0);
 	innerMotor(0);
-	brake0(255);
-	brake1(255);
+	brake0(MOTOR_SPEED_MAX);
+	brake1(MOTOR_SPEED_MAX);
 }
 
-//! Sets the speed of the launcher motors: 128-255 for forward operation.
+/*! Sets the speed of the launcher motors: 128-255 for forward operation.
+ *  Both wheels ramp to the new speed together, limited by ::LAUNCHER_VELOCITY and ::LAUNCHER_ACCELERATION.
+ */
 void launcherSpeed(u08 speed)
 {
-	requestedLauncherSpeed = speed;
+#if USE_ROBOCLAW_SERIAL == 1
+	launcherTargetSpeed = ((s32)speed - LAUNCHER_SPEED_STOPPED) * LAUNCHER_QPPS_PER_STEP;
+	roboclawSetSpeeds(LAUNCHER_QPPS_ACCELERATION, launcherTargetSpeed, launcherTargetSpeed);
+#else
+	const ServoCommand launcherCommands[] =
+	{
+		{SERVO_LEFT_LAUNCHER, speed},
+		{SERVO_RIGHT_LAUNCHER, speed}
+	};
+	servoMoveMany(launcherCommands, sizeof(launcherCommands) / sizeof(launcherCommands[0]));
+#endif
 }
 
-void launcherExec()
+/*! Checks whether both launcher wheels are up to speed, so a ball can be launched.
+ *  With the RoboClaw on packet serial, this compares the encoder speeds it reports against the requested speed,
+ *  so it also detects a wheel that has slowed down after launching the previous ball.
+ *  @return TRUE if the launcher is running and both wheels are within ::LAUNCHER_READY_TOLERANCE of the requested speed.
+ */
+bool launcherReady()
 {
-	u32 curTime = getMsCount();
-	static u32 lastUpdateTime;
+#if USE_ROBOCLAW_SERIAL == 1
+	if (launcherTargetSpeed == 0)
+		return FALSE;
 
-	if ((curTime - lastUpdateTime) > 20)
+	const s32 tolerance = ABS(launcherTargetSpeed) * LAUNCHER_READY_TOLERANCE / 100;
+	for (u08 motor = ROBOCLAW_M1; motor <= ROBOCLAW_M2; motor++)
 	{
-		lastUpdateTime = curTime;
-		if (ABS(requestedLauncherSpeed - curLauncherSpeed) <= LAUNCHER_SPEED_STEP)
-			curLauncherSpeed = requestedLauncherSpeed;
-		else if (requestedLauncherSpeed > curLauncherSpeed)
-			curLauncherSpeed += LAUNCHER_SPEED_STEP;
-		else if (requestedLauncherSpeed < curLauncherSpeed)
-			curLauncherSpeed -= LAUNCHER_SPEED_STEP;
-
-		servo(SERVO_LEFT_LAUNCHER, curLauncherSpeed);
-		servo(SERVO_RIGHT_LAUNCHER, curLauncherSpeed);
+		s32 speed;
+		if (!roboclawGetSpeed(motor, &speed) || ABS(speed - launcherTargetSpeed) > tolerance)
+			return FALSE;
 	}
-/*
-	//channel 1 or shutdown
-	uart1Transmit(curLauncherSpeed);
-	if (curLauncherSpeed != 0)
-	{
-		//channel 2
-		uart1Transmit(128 + curLauncherSpeed);
-	}*/
+	return TRUE;
+#else
+	//without speed feedback, assume the wheels are up to speed once the ramp has finished
+	return !servoMoving(SERVO_LEFT_LAUNCHER) && !servoMoving(SERVO_RIGHT_LAUNCHER);
+#endif
 }
 
+//! Lowers the scraper. The servo's motion profile slows it down before it reaches the trough.
 void scraperDown()
 {
 	if (robotID == LEFT_ROBOT)
-	{
-		servo(SERVO_SCRAPER, LSCRAPER_MOSTLY_DOWN);
-		delayMs(400);
-		servo(SERVO_SCRAPER, LSCRAPER_DOWN);
-	}
+		servoMoveTo(SERVO_SCRAPER, LSCRAPER_DOWN);
 	else
-	{
-		servo(SERVO_SCRAPER, RSCRAPER_MOSTLY_DOWN);
-		delayMs(400);
-		servo(SERVO_SCRAPER, RSCRAPER_DOWN);
-	}
+		servoMoveTo(SERVO_SCRAPER, RSCRAPER_DOWN);
 }
 
 void scraperUp()
 {
 	if (robotID == LEFT_ROBOT)
-		servo(SERVO_SCRAPER, LSCRAPER_UP);
+		servoMoveTo(SERVO_SCRAPER, LSCRAPER_UP);
 	else
-		servo(SERVO_SCRAPER, RSCRAPER_UP);
+		servoMoveTo(SERVO_SCRAPER, RSCRAPER_UP);
 }
 
+//! Starts feeding balls into the launcher. Balls are only fed while launcherReady() is TRUE, see feederExec().
 void feederOn()
 {
-	servo(SERVO_FEEDER, FEEDER_RUNNING);
+	feederRequested = TRUE;
+	feederExec();
 }
 
 void feederOff()
 {
 	servoOff(SERVO_FEEDER);
+	feederRunning = FALSE;
+	feederRequested = FALSE;
+	feederFeeding = FALSE;
+}
+
+/*! Runs the feeder while it is switched on and the launcher is ready, and holds it stopped while the
+ *  launcher wheels recover after a launch. Should be called regularly from the main loop.
+ */
+void feederExec()
+{
+	if (!feederRequested)
+		return;
+
+	const bool ready = launcherReady();
+	if (ready == feederFeeding)
+		return;
+
+	if (!feederRunning)
+	{
+		//the feeder output is off, so give its profile a starting point to ramp up from
+		servo(SERVO_FEEDER, FEEDER_STOPPED);
+		feederRunning = TRUE;
+	}
+	servoMoveTo(SERVO_FEEDER, ready ? FEEDER_RUNNING : FEEDER_STOPPED);
+	feederFeeding = ready;
 }
 
 void haltRobot()
@@ -339,11 +391,16 @@ void haltRobot()
 	feederOff();
 
 	//stop launchers
-	servo(SERVO_LEFT_LAUNCHER, LAUNCHER_SPEED_STOPPED);
-	servo(SERVO_RIGHT_LAUNCHER, LAUNCHER_SPEED_STOPPED);
+	launcherSpeed(LAUNCHER_SPEED_STOPPED);
 
-	//power off scraper after it has had time to raise
-	delayMs(500);
+	//power off scraper after it has finished its profiled move and had time to settle
+	while (servoMoving(SERVO_SCRAPER))
+	{
+		serviceExec();
+		//keep sending the launcher stop command meanwhile
+		mechanismExec();
+	}
+	waitMs(200);
 	servoOff(SERVO_SCRAPER);
 }
 
@@ -371,7 +428,7 @@ void calibrate(int ticksPerSec, s08* wallMotorSpeed, s08* innerMotorSpeed)
 		// reset encoder ticks and wait for encoder ticks to accumulate
 		totalInnerEncoderTicks = 0;
 		totalWallEncoderTicks = 0;
-		delayMs(1000);
+		waitMs(1000);
 
 		int innerTicksPerSec = totalInnerEncoderTicks;
 		int wallTicksPerSec = totalInnerEncoderTicks;
@@ -10,11 +10,12 @@ void turnLeft();
 void turnRight();
 void stop();
 void launcherSpeed(u08 speed);
-void launcherExec();
 void scraperDown();
 void scraperUp();
 void feederOn();
 void feederOff();
+void feederExec();
+bool launcherReady();
 void haltRobot();
 void resetEncoders();
 void calibrate(int ticksPerSec, s08* wallMotorSpeed, s08* innerMotorSpeed);
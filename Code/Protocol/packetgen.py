@@ -0,0 +1,420 @@
+#!/usr/bin/env python3
+"""Generates the packet definitions of both ends of the Launcher's PC link from packets.schema.
+
+usage: packetgen.py <schema> <firmware header> <firmware source> <host header> <bootloader header> <bootloader source>
+
+The firmware header has the packet type enums, an accessor for each field of an uplink packet (read in place from
+the received data section), and an encoder for the fixed fields of each downlink packet. The firmware source has a
+table with the allowed dataLength range of each uplink packet type, in program space for the Launcher, but in RAM for
+the bootloader: its flash is above 64 KiB, where pgm_read_byte() can't reach. The host header has the same
+enums, and a struct for each packet with fields that encodes and decodes its data section.
+The firmware files of the Launcher and of its bootloader each only have the packet sets of that firmware, while the host
+header has all of them, since the PC talks to both.
+"""
+
+import os
+import re
+import sys
+
+# The firmware images with their own packet sets. The first is the default.
+FIRMWARES = ('launcher', 'bootloader')
+
+SCALAR_TYPES = {
+    # schema type: (size, firmware type, host type)
+    'u8': (1, 'u08', 'uint8_t'),
+    's8': (1, 's08', 'int8_t'),
+    'u16': (2, 'u16', 'uint16_t'),
+    's16': (2, 's16', 'int16_t'),
+    'u32': (4, 'u32', 'uint32_t'),
+    's32': (4, 's32', 'int32_t'),
+}
+
+
+class SchemaError(Exception):
+    pass
+
+
+class Field:
+    def __init__(self, kind, name, minLength=None, maxLength=None):
+        self.kind = kind
+        self.name = name
+        self.variable = minLength is not None
+        self.minLength = minLength
+        self.maxLength = maxLength
+        self.offset = 0
+
+    @property
+    def size(self):
+        return SCALAR_TYPES[self.kind][0]
+
+
+class Packet:
+    def __init__(self, name, fields, doc):
+        self.name = name
+        self.fields = fields
+        self.doc = doc
+        self.fixed = [field for field in fields if not field.variable]
+        self.trailing = fields[-1] if fields and fields[-1].variable else None
+        offset = 0
+        for field in self.fixed:
+            field.offset = offset
+            offset += field.size
+        self.fixedLength = offset
+        if self.trailing:
+            self.trailing.offset = offset
+
+    @property
+    def minLength(self):
+        return self.fixedLength + (self.trailing.minLength if self.trailing else 0)
+
+    @property
+    def maxLength(self):
+        return self.fixedLength + (self.trailing.maxLength if self.trailing else 0)
+
+    @property
+    def structName(self):
+        return ''.join(word.capitalize() for word in self.name.split('_'))
+
+
+class PacketSet:
+    def __init__(self, cName, hostName, direction, first, end, firmware, doc):
+        self.cName = cName
+        self.hostName = hostName
+        self.direction = direction
+        self.first = first
+        self.end = end
+        self.firmware = firmware
+        self.doc = doc
+        # packets, and section comments as strings
+        self.entries = []
+
+    @property
+    def packets(self):
+        return [entry for entry in self.entries if isinstance(entry, Packet)]
+
+
+def parseField(text, isLast, lineNumber):
+    match = re.fullmatch(r'(u8|s8|u16|s16|u32|s32|char)\s+(\w+)(?:\[(\d+)\.\.(\d*)\])?', text.strip())
+    if not match:
+        raise SchemaError('line %d: bad field "%s"' % (lineNumber, text.strip()))
+    kind, name, minText, maxText = match.groups()
+    if minText is None:
+        if kind == 'char':
+            raise SchemaError('line %d: char fields must be variable-length' % lineNumber)
+        return Field(kind, name)
+    if not isLast:
+        raise SchemaError('line %d: only the last field can be variable-length' % lineNumber)
+    if kind not in ('u8', 'char'):
+        raise SchemaError('line %d: variable-length fields must be u8 or char' % lineNumber)
+    return Field(kind, name, int(minText), int(maxText) if maxText else None)
+
+
+def parseSchema(path):
+    constants = {}
+    constantDocs = {}
+    sets = []
+    doc = []
+    with open(path) as schema:
+        for lineNumber, line in enumerate(schema, 1):
+            stripped = line.strip()
+            if not stripped or (stripped.startswith('#') and not stripped.startswith('##')):
+                continue
+            text, _, lineDoc = stripped.partition('##')
+            text = text.strip()
+            if not text:
+                doc.append(lineDoc.strip())
+                continue
+            if lineDoc:
+                doc.append(lineDoc.strip())
+
+            words = text.split()
+            if words[0] == 'const':
+                constants[words[1]] = int(words[2], 0)
+                constantDocs[words[1]] = doc
+            elif words[0] == 'set':
+                if len(words) not in (6, 7) or words[3] not in ('uplink', 'downlink'):
+                    raise SchemaError('line %d: bad set' % lineNumber)
+                if len(words) == 7 and words[6] not in FIRMWARES:
+                    raise SchemaError('line %d: unknown firmware "%s"' % (lineNumber, words[6]))
+                firmware = words[6] if len(words) == 7 else FIRMWARES[0]
+                sets.append(PacketSet(words[1], words[2], words[3], words[4], words[5], firmware, doc))
+            elif words[0] == 'section':
+                if not sets:
+                    raise SchemaError('line %d: section outside of a set' % lineNumber)
+                sets[-1].entries.append(text[len('section'):].strip())
+            else:
+                if not sets:
+                    raise SchemaError('line %d: packet type outside of a set' % lineNumber)
+                name = words[0]
+                fieldTexts = text[len(name):].split(',') if len(words) > 1 else []
+                fields = [parseField(fieldText, index == len(fieldTexts) - 1, lineNumber)
+                          for index, fieldText in enumerate(fieldTexts)]
+                packet = Packet(name, fields, doc)
+                if packet.trailing and packet.trailing.maxLength is None:
+                    packet.trailing.maxLength = constants['MAX_PACKET_DATA'] - packet.fixedLength
+                if packet.maxLength > constants['MAX_PACKET_DATA']:
+                    raise SchemaError('line %d: %s is longer than MAX_PACKET_DATA' % (lineNumber, name))
+                sets[-1].entries.append(packet)
+            doc = []
+
+    # check that the packet types don't overlap
+    used = {}
+    for packetSet in sets:
+        first = constants.get(packetSet.first)
+        if first is None:
+            first = int(packetSet.first, 0)
+        for number, packet in enumerate(packetSet.packets, first):
+            if number in used:
+                raise SchemaError('%s and %s are both packet type %d' % (used[number], packet.name, number))
+            if number >= 0xF0:
+                raise SchemaError('%s is in the link control range' % packet.name)
+            used[number] = packet.name
+    return constants, constantDocs, sets
+
+
+def docComment(lines, indent):
+    if not lines:
+        return []
+    if len(lines) == 1:
+        return [indent + '//! ' + lines[0]]
+    return [indent + '/*! ' + lines[0]] + [indent + ' *  ' + line for line in lines[1:]] + [indent + ' */']
+
+
+def enumLines(packetSet, indent):
+    lines = []
+    first = True
+    for entry in packetSet.entries:
+        if isinstance(entry, str):
+            if not first:
+                lines.append('')
+            lines.append(indent + '//' + entry)
+            continue
+        lines += docComment(entry.doc, indent)
+        lines.append(indent + entry.name + (' = ' + packetSet.first if first else '') + ',')
+        first = False
+    return lines
+
+
+GENERATED_NOTE = 'Generated by Protocol/packetgen.py from Protocol/packets.schema. Do not edit; edit the schema instead.'
+
+
+def firmwareHeader(constants, constantDocs, sets):
+    out = ['/*! @file', '    ' + GENERATED_NOTE, '', '    The packet types of the PC link, with accessors for the fields of uplink packets and encoders for the',
+           '    fixed fields of downlink packets. All multi-byte fields are MSB first.', ' */',
+           '#ifndef PROTOCOL_H', '#define PROTOCOL_H', '', '#include "globals.h"', '']
+    for name, value in constants.items():
+        # packetprotocol.h owns MAX_PACKET_DATA, and protocol.c checks that it matches
+        if name != 'MAX_PACKET_DATA':
+            out += docComment(constantDocs[name], '')
+            out.append('#define %s 0x%02X' % (name, value))
+    out.append('')
+
+    for packetSet in sets:
+        out += docComment(packetSet.doc, '')
+        out += ['typedef enum', '{']
+        out += enumLines(packetSet, '\t')
+        out += ['\t' + packetSet.end, '} %s;' % packetSet.cName, '']
+
+    out.append('bool protocolUplinkLengthValid(const u08 packetType, const u08 dataLength);')
+    out.append('')
+
+    for packetSet in sets:
+        for packet in packetSet.packets:
+            if not packet.fields:
+                continue
+            out.append('//%s' % packet.name)
+            if packetSet.direction == 'uplink':
+                out += uplinkAccessors(packet)
+            else:
+                out += downlinkEncoder(packet)
+            out.append('')
+
+    out += ['#endif', '']
+    return '\n'.join(out)
+
+
+def readExpression(field):
+    size = field.size
+    ctype = SCALAR_TYPES[field.kind][1]
+    if size == 1:
+        return ('data[%d]' if ctype == 'u08' else '(' + ctype + ')data[%d]') % field.offset
+    unsignedType = 'u16' if size == 2 else 'u32'
+    parts = ['((%s)data[%d] << %d)' % (unsignedType, field.offset + i, 8 * (size - 1 - i)) for i in range(size - 1)]
+    parts.append('data[%d]' % (field.offset + size - 1))
+    return '(%s)(%s)' % (ctype, ' | '.join(parts))
+
+
+def uplinkAccessors(packet):
+    lines = []
+    for field in packet.fixed:
+        ctype = SCALAR_TYPES[field.kind][1]
+        lines.append('static inline %s %s_%s(const u08 *const data) { return %s; }'
+                     % (ctype, packet.name, field.name, readExpression(field)))
+    if packet.trailing:
+        field = packet.trailing
+        ctype = 'char' if field.kind == 'char' else 'u08'
+        lines.append('static inline const %s *%s_%s(const u08 *const data) { return (const %s *)&data[%d]; }'
+                     % (ctype, packet.name, field.name, ctype, field.offset))
+        lines.append('static inline u08 %s_%sLength(const u08 dataLength) { return dataLength%s; }'
+                     % (packet.name, field.name, (' - %d' % field.offset) if field.offset else ''))
+    return lines
+
+
+def downlinkEncoder(packet):
+    if not packet.fixed:
+        return ['//%s starts at data[0].' % packet.trailing.name]
+    params = ', '.join('const %s %s' % (SCALAR_TYPES[field.kind][1], field.name) for field in packet.fixed)
+    lines = ['/*! Writes the fixed fields of a %s into data. @return %d, the length written%s. */'
+             % (packet.name, packet.fixedLength,
+                (', where %s goes' % packet.trailing.name) if packet.trailing else ''),
+             'static inline u08 %s_encode(u08 *const data, %s)' % (packet.name, params), '{']
+    for field in packet.fixed:
+        for i in range(field.size):
+            shift = 8 * (field.size - 1 - i)
+            unsignedType = {1: 'u08', 2: 'u16', 4: 'u32'}[field.size]
+            value = '(%s)%s' % (unsignedType, field.name) if field.kind.startswith('s') else field.name
+            if shift:
+                value = '(u08)(%s >> %d)' % (value, shift)
+            elif field.kind != 'u8':
+                value = '(u08)' + field.name
+            lines.append('\tdata[%d] = %s;' % (field.offset + i, value))
+    lines += ['\treturn %d;' % packet.fixedLength, '}']
+    return lines
+
+
+def firmwareSource(firmware, constants, sets):
+    # the bootloader's tables are in the boot section above 64 KiB, so they are kept in RAM instead of read with near
+    # program space reads
+    inProgramSpace = (firmware != 'bootloader')
+    out = ['/*! @file', '    ' + GENERATED_NOTE, '', '    The allowed dataLength range of each uplink packet type.', ' */',
+           '#include "packetprotocol.h"', '#include "protocol.h"'] + (['#include <avr/pgmspace.h>'] if inProgramSpace else []) + ['',
+           '#if MAX_PACKET_DATA != %d' % constants['MAX_PACKET_DATA'],
+           '\t#error "MAX_PACKET_DATA doesn\'t match Protocol/packets.schema"', '#endif', '',
+           '//! The shortest and longest data section of a packet type.', 'typedef struct', '{', '\tu08 min;', '\tu08 max;',
+           '} LengthRange;', '']
+    uplinks = [packetSet for packetSet in sets if packetSet.direction == 'uplink']
+    for packetSet in uplinks:
+        if not inProgramSpace:
+            out.append('//! In RAM, since pgm_read_byte() can\'t reach the bootloader\'s flash above 64 KiB.')
+        out.append('static const LengthRange %sLengths[]%s =' % (lowerFirst(packetSet.cName), ' PROGMEM' if inProgramSpace else ''))
+        out.append('{')
+        for packet in packetSet.packets:
+            out.append('\t{%d, %d}, //%s' % (packet.minLength, packet.maxLength, packet.name))
+        out += ['};', '']
+
+    out += ['//! Checks if a packet type is one the PC can send, and if its dataLength is allowed.',
+            'bool protocolUplinkLengthValid(const u08 packetType, const u08 dataLength)', '{',
+            '\tconst LengthRange *range;']
+    for index, packetSet in enumerate(uplinks):
+        first = packetSet.packets[0].name
+        keyword = 'if' if index == 0 else 'else if'
+        condition = 'packetType < %s' % packetSet.end if packetSet.first in ('0', '0x00') else \
+            'packetType >= %s && packetType < %s' % (first, packetSet.end)
+        out += ['\t%s (%s)' % (keyword, condition),
+                '\t\trange = &%sLengths[packetType - %s];' % (lowerFirst(packetSet.cName), first)]
+    out += ['\telse', '\t\treturn FALSE;', '']
+    if inProgramSpace:
+        out.append('\treturn (dataLength >= pgm_read_byte(&range->min) && dataLength <= pgm_read_byte(&range->max));')
+    else:
+        out.append('\treturn (dataLength >= range->min && dataLength <= range->max);')
+    out += ['}', '']
+    return '\n'.join(out)
+
+
+def lowerFirst(name):
+    return name[0].lower() + name[1:]
+
+
+def hostHeader(constants, constantDocs, sets):
+    out = ['/*! @file', '    ' + GENERATED_NOTE, '', '    The packet types of the robot\'s PC link, and a struct for each packet with fields that encodes and',
+           '    decodes its data section. All multi-byte fields are MSB first.', ' */', '',
+           '#ifndef PROTOCOL_H', '#define PROTOCOL_H', '', '#include <cstddef>', '#include <cstdint>', '#include <stdexcept>',
+           '#include <string>', '#include <vector>', '', 'namespace robolink', '{', '']
+    for name, value in constants.items():
+        out += docComment(constantDocs[name], '')
+        out.append('constexpr unsigned %s = 0x%02X;' % (name, value) if name != 'MAX_PACKET_DATA' else
+                   'constexpr std::size_t %s = %d;' % (name, value))
+    out.append('')
+    for packetSet in sets:
+        out += docComment(packetSet.doc, '')
+        out += ['enum %s : uint8_t' % packetSet.hostName, '{']
+        out += enumLines(packetSet, '\t')
+        out += ['\t' + packetSet.end, '};', '']
+
+    out += ['namespace detail', '{', '',
+            'template <typename T>', 'T readField(const std::vector<uint8_t> &data, std::size_t offset)', '{',
+            '\tuint32_t value = 0;', '\tfor (std::size_t i = 0; i < sizeof(T); i++)', '\t\tvalue = (value << 8) | data[offset + i];',
+            '\treturn (T)value;', '}', '',
+            'template <typename T>', 'void writeField(std::vector<uint8_t> &data, T value)', '{',
+            '\tfor (std::size_t i = sizeof(T); i-- > 0;)', '\t\tdata.push_back((uint8_t)((uint32_t)value >> (8 * i)));', '}', '',
+            'inline void checkLength(const char *packet, std::size_t length, std::size_t min, std::size_t max)', '{',
+            '\tif (length < min || length > max)',
+            '\t\tthrow std::runtime_error(std::string("bad ") + packet + " data length " + std::to_string(length));', '}', '',
+            '} // namespace detail', '']
+
+    for packetSet in sets:
+        for packet in packetSet.packets:
+            if packet.fields:
+                out += hostStruct(packet, packetSet)
+    out += ['} // namespace robolink', '', '#endif', '']
+    return '\n'.join(out)
+
+
+def hostStruct(packet, packetSet):
+    lines = ['//! The data section of a %s packet.' % packet.name, 'struct %s' % packet.structName, '{',
+             '\tstatic constexpr uint8_t type = %s;' % packet.name, '']
+    for field in packet.fields:
+        if field.variable:
+            hostType = 'std::string' if field.kind == 'char' else 'std::vector<uint8_t>'
+            lines.append('\t%s %s; //!< %d to %d bytes.' % (hostType, field.name, field.minLength, field.maxLength))
+        else:
+            lines.append('\t%s %s;' % (SCALAR_TYPES[field.kind][2], field.name))
+    #the fields are reached through this, since one of them may be called data too
+    lines += ['', '\tstd::vector<uint8_t> encode() const', '\t{', '\t\tstd::vector<uint8_t> data;']
+    for field in packet.fixed:
+        lines.append('\t\tdetail::writeField(data, this->%s);' % field.name)
+    if packet.trailing:
+        lines.append('\t\tdata.insert(data.end(), this->%s.begin(), this->%s.end());' % (packet.trailing.name, packet.trailing.name))
+    lines += ['\t\treturn data;', '\t}', '',
+              '\t//! @throw std::runtime_error if the data section has the wrong length.%s'
+              % (' Trailing null characters are removed from text.' if packet.trailing and packet.trailing.kind == 'char' else ''),
+              '\tstatic %s decode(const std::vector<uint8_t> &data)' % packet.structName, '\t{',
+              '\t\tdetail::checkLength("%s", data.size(), %d, %d);' % (packet.name, packet.minLength, packet.maxLength),
+              '\t\t%s packet;' % packet.structName]
+    for field in packet.fixed:
+        lines.append('\t\tpacket.%s = detail::readField<%s>(data, %d);' % (field.name, SCALAR_TYPES[field.kind][2], field.offset))
+    if packet.trailing:
+        field = packet.trailing
+        lines.append('\t\tpacket.%s.assign(data.begin() + %d, data.end());' % (field.name, field.offset))
+        if field.kind == 'char':
+            lines += ['\t\twhile (!packet.%s.empty() && packet.%s.back() == \'\\0\')' % (field.name, field.name),
+                      '\t\t\tpacket.%s.pop_back();' % field.name]
+    lines += ['\t\treturn packet;', '\t}', '};', '']
+    return lines
+
+
+def writeIfChanged(path, text):
+    if os.path.exists(path):
+        with open(path) as existing:
+            if existing.read() == text:
+                return
+    with open(path, 'w') as output:
+        output.write(text)
+
+
+def main():
+    if len(sys.argv) != 7:
+        sys.exit(__doc__)
+    try:
+        constants, constantDocs, sets = parseSchema(sys.argv[1])
+    except SchemaError as error:
+        sys.exit('%s: %s' % (sys.argv[1], error))
+    for firmware, header, source in ((FIRMWARES[0], sys.argv[2], sys.argv[3]), (FIRMWARES[1], sys.argv[5], sys.argv[6])):
+        firmwareSets = [packetSet for packetSet in sets if packetSet.firmware == firmware]
+        writeIfChanged(header, firmwareHeader(constants, constantDocs, firmwareSets))
+        writeIfChanged(source, firmwareSource(firmware, constants, firmwareSets))
+    writeIfChanged(sys.argv[4], hostHeader(constants, constantDocs, sets))
+
+
+if __name__ == '__main__':
+    main()
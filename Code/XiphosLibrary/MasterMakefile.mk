@@ -1,7 +1,7 @@
 ##Copyright (C) 2009-2010  Patrick J. McCarty.
 ##Licensed under X11 License. See LICENSE.txt for details.
 
-# Specify the port name for your In-System Programmer (ISP) device or cable here.
+# Specify the port name for your In-System Programmer (ISP) device or cable here, unless the project Makefile does.
 #  For a FTDI USB-to-UART converter on Windows this is something like COM2 (check in the Windows Device Manager under Ports for the number)
 #    In XP: Right-click My Computer, click "Properties" then navigate to the "Hardware" tab followed by clicking "Device Manager".
 #    Scroll down to "Ports" and click the "+" to the left of the name. Finally read the "COM" number next to the name "USB Serial Port (COMx)".
@@ -12,9 +12,9 @@
 #  For a fancy Atmel AVRISP mkII In-System Programmer simply enter usb (lowercase is important).
 #    On Windows, you may need to install the LibUSB drivers included with WinAVR at: <WinAVR folder>\utils\libusb\bin\avrisp2.inf
 #  For a cheapo PonyProg or Futurlec style parallel port programmer enter lpt1 (lowercase is important).
-PORT = /dev/ttyUSB0
+PORT ?= /dev/ttyUSB0
 
-# Specify the type of In-System Programmer (ISP) device or cable you are using.
+# Specify the type of In-System Programmer (ISP) device or cable you are using, unless the project Makefile does.
 #  For the onboard FTDI USB-to-UART converter (used with a butterfly bootloader) use butterfly -b 57600
 #  For a cheap SparkFun AVR-PG1B serial programmer use ponyser
 #  For a fancy Atmel AVRISP mkII In-System Programmer use avrispmkII
@@ -22,7 +22,7 @@ PORT = /dev/ttyUSB0
 #  Avrdude supports many more types of programmers. For a complete list of valid options, open a commandline and run: avrdude -c ?
 #  You can see the hardware pinouts used for the various programmers and even define your own programmer in avrdude's config file at:
 #    <WinAVR folder>\bin\avrdude.conf
-ISP = butterfly -b 57600
+ISP ?= butterfly -b 57600
 
 # Enter the target microcontroller model.
 #  For Xiphos 1.0, this should always be atmega1281 unless you substituted a different microcontroller chip model.
@@ -54,6 +54,17 @@ ifeq ($(USE_MOTOR1), 1)
 endif
 ifeq ($(USE_MOTORS), 1)
 	FILES += $(LIB)/motors.c
+	# Motor PWM settings for Timer 1. Set these in the project Makefile to override the defaults.
+	#  MOTOR_PWM_BITS is the resolution: 8, 9, or 10 bits (motor speeds range from -255/-511/-1023 to 255/511/1023).
+	#  MOTOR_PWM_PRESCALER divides the I/O clock: 1, 8, 64, 256, or 1024.
+	#  MOTOR_PWM_PHASE_CORRECT selects phase correct PWM (1) instead of fast PWM (0), which halves the frequency.
+	#  The PWM frequency is 16MHz / prescaler / 2^bits for fast PWM, for example:
+	#    8-bit fast PWM, prescaler 64 = 976 Hz (the default), 10-bit fast PWM, prescaler 1 = 15.6 kHz,
+	#    10-bit phase correct PWM, prescaler 1 = 7.8 kHz. The VNH3SP30 H-Bridges are only specified up to 10 kHz.
+	MOTOR_PWM_BITS ?= 8
+	MOTOR_PWM_PRESCALER ?= 64
+	MOTOR_PWM_PHASE_CORRECT ?= 0
+	DEFINES += -D MOTOR_PWM_BITS=$(MOTOR_PWM_BITS) -D MOTOR_PWM_PRESCALER=$(MOTOR_PWM_PRESCALER) -D MOTOR_PWM_PHASE_CORRECT=$(MOTOR_PWM_PHASE_CORRECT)
 endif
 
 ifneq ($(NUM_SERVOS), 0)
@@ -61,11 +72,44 @@ ifneq ($(NUM_SERVOS), 0)
 	DEFINES += -D NUM_SERVOS=$(NUM_SERVOS)
 endif
 
+# UARTs use the buffered, interrupt-driven driver in uart.c. Set UARTn_BAUD in the project Makefile to change the baud rate.
+#  The build fails if the baud rate can't be generated accurately from the 16MHz clock.
+USE_UARTS = 0
+ifeq ($(USE_UART0), 1)
+	USE_UARTS = 1
+	UART0_BAUD ?= 38400
+	DEFINES += -D USE_UART0=1 -D UART0_BAUD=$(UART0_BAUD)UL
+endif
+ifeq ($(USE_UART1), 1)
+	USE_UARTS = 1
+	UART1_BAUD ?= 38400
+	DEFINES += -D USE_UART1=1 -D UART1_BAUD=$(UART1_BAUD)UL
+endif
+ifeq ($(USE_UARTS), 1)
+	FILES += $(LIB)/uart.c
+endif
+
 ifeq ($(USE_I2C), 1)
 	FILES += $(LIB)/I2C.c
 	DEFINES += -D USE_I2C=1
 endif
 
+# The interrupts and any marked main loop code record their start and end in a RAM ring (see trace.c).
+#  Set TRACE_LENGTH with -D in DEFINES to change how many events it holds.
+ifeq ($(USE_TRACE), 1)
+	FILES += $(LIB)/trace.c
+	DEFINES += -D USE_TRACE=1
+endif
+
+
+# Set these in the project Makefile for code outside of the project and library folders, or for special linking:
+#  INCLUDES lists extra folders to search for header files.
+#  LDFLAGS adds linker options, for example -Wl,--section-start=.text=<address> to place a bootloader.
+#  MAX_PROGRAM_BYTES fails the build if .text and .data (whose initial values are also stored in flash) add up to more.
+INCLUDES ?=
+LDFLAGS ?=
+MAX_PROGRAM_BYTES ?=
+
 
 # Makefile Targets
 
@@ -77,9 +121,12 @@ endif
 #tried unsuccessfully to remove unused code with: -Wl,-static -ffunction-sections -fdata-sections
 #the -g is required to get C code interspersed in the disassembly listing
 all:
-	avr-gcc -g -mmcu=$(MCU) $(DEFINES) -I . -I $(LIB) -Os -Wall -Werror -mcall-prologues -std=gnu99 -o $(PROJECTNAME).elf $(FILES) $(PROJECTNAME).c -lm
+	avr-gcc -g -mmcu=$(MCU) $(DEFINES) -I . -I $(LIB) $(addprefix -I ,$(INCLUDES)) -Os -Wall -Werror -mcall-prologues -std=gnu99 $(LDFLAGS) -o $(PROJECTNAME).elf $(FILES) $(PROJECTNAME).c -lm
 	avr-objcopy -O ihex $(PROJECTNAME).elf $(PROJECTNAME).hex
 	avr-size $(PROJECTNAME).elf
+ifneq ($(MAX_PROGRAM_BYTES),)
+	@avr-size $(PROJECTNAME).elf | awk 'NR == 2 && $$1 + $$2 > $(MAX_PROGRAM_BYTES) { print "$(PROJECTNAME) uses " $$1 + $$2 " bytes of flash, more than MAX_PROGRAM_BYTES = $(MAX_PROGRAM_BYTES)"; exit 1 }'
+endif
 
 # This target first executes the "all" target to compile your code, and then programs the hex file into the ATmega using avrdude.
 program: all
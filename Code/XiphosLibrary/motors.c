@@ -3,18 +3,171 @@
 
 /*! @file
     Implements support for controlling two brushed DC motors using two VNH3SP30 H-Bridges.
+    H-Bridge faults are detected by interrupt and the H-Bridge is restarted automatically, with an increasing delay
+    between attempts if the fault persists.
  */
-#include "globals.h"
+#include "motors.h"
+#include "trace.h"
+#include <stddef.h>
+#include <util/atomic.h>
+
+//Default to the original fast PWM at I/O clock / 64 (about 976 Hz at 8 bits) if the Makefile doesn't specify a PWM mode.
+#ifndef MOTOR_PWM_PRESCALER
+	#define MOTOR_PWM_PRESCALER 64
+#endif
+#ifndef MOTOR_PWM_PHASE_CORRECT
+	#define MOTOR_PWM_PHASE_CORRECT 0
+#endif
+
+//Select the Timer 1 waveform generation mode bits. Modes 1-3 are 8/9/10-bit phase correct PWM, modes 5-7 are 8/9/10-bit fast PWM.
+#if MOTOR_PWM_BITS == 8
+	#define PWM_WGM_A _BV(WGM10)
+#elif MOTOR_PWM_BITS == 9
+	#define PWM_WGM_A _BV(WGM11)
+#elif MOTOR_PWM_BITS == 10
+	#define PWM_WGM_A (_BV(WGM11) | _BV(WGM10))
+#endif
+#if MOTOR_PWM_PHASE_CORRECT == 1
+	#define PWM_WGM_B 0
+#else
+	#define PWM_WGM_B _BV(WGM12)
+#endif
+
+//Select the Timer 1 clock select bits for the prescaler.
+#if MOTOR_PWM_PRESCALER == 1
+	#define PWM_CS _BV(CS10)
+#elif MOTOR_PWM_PRESCALER == 8
+	#define PWM_CS _BV(CS11)
+#elif MOTOR_PWM_PRESCALER == 64
+	#define PWM_CS (_BV(CS11) | _BV(CS10))
+#elif MOTOR_PWM_PRESCALER == 256
+	#define PWM_CS _BV(CS12)
+#elif MOTOR_PWM_PRESCALER == 1024
+	#define PWM_CS (_BV(CS12) | _BV(CS10))
+#else
+	#error "MOTOR_PWM_PRESCALER must be 1, 8, 64, 256, or 1024"
+#endif
+
+//! The motor PWM frequency in Hz. Phase correct mode counts up and back down, so it runs at about half the frequency of fast PWM.
+//! Note the VNH3SP30 H-Bridges are only specified for PWM frequencies up to 10 kHz.
+#if MOTOR_PWM_PHASE_CORRECT == 1
+	#define PWM_FREQUENCY (F_CPU / MOTOR_PWM_PRESCALER / (2 * MOTOR_SPEED_MAX))
+#else
+	#define PWM_FREQUENCY (F_CPU / MOTOR_PWM_PRESCALER / (MOTOR_SPEED_MAX + 1))
+#endif
+//! Converts a time in milliseconds to a number of PWM periods (Timer 1 overflows).
+#define MS_TO_PWM_PERIODS(ms) ((u16)(((u32)(ms) * PWM_FREQUENCY) / 1000))
+
+//! The delay before the first attempt to restart a faulted H-bridge.
+#define FAULT_RETRY_MIN_PERIODS MS_TO_PWM_PERIODS(10)
+//! The longest delay between attempts to restart a faulted H-bridge. The delay doubles after each failed attempt.
+#define FAULT_RETRY_MAX_PERIODS MS_TO_PWM_PERIODS(1000)
+//! How long a restarted H-bridge must run without a fault before the retry delay is reset to its minimum.
+#define FAULT_PROBATION_PERIODS MS_TO_PWM_PERIODS(500)
+//! How long the DIAGA/DIAGB level is polled after enabling an H-bridge, to catch a fault that is already present.
+#define FAULT_SETTLE_PERIODS 2
+
+//! Fault detection and recovery state for one motor channel.
+typedef struct
+{
+	u16 faultCount;     //!< Number of faults detected since startup.
+	u16 retryCountdown; //!< PWM periods remaining until the H-bridge is restarted, or 0 when not waiting to retry.
+	u16 retryDelay;     //!< The current delay between a fault and the restart attempt, in PWM periods.
+	u16 watchPeriods;   //!< PWM periods remaining during which the DIAGA/DIAGB level is polled for a fault.
+	s16 command;        //!< The last commanded speed, re-applied when restarting.
+} MotorFaultState;
+
+//! Fault state for motor0 and motor1.
+static volatile MotorFaultState faultStates[2];
+//! Optional user function called (from interrupt context) whenever a fault is detected.
+static MotorFaultCallback_t faultCallback = NULL;
+
+//Local prototypes
+static void applyMotor0(const s16 speed);
+static void applyMotor1(const s16 speed);
+
+/*! Registers a function to be called whenever an H-bridge fault is detected.
+    The callback runs in interrupt context, so it must be short and must not wait on other interrupts.
+    @param callback The function to call, or NULL to remove the callback.
+ */
+void setMotorFaultCallback(MotorFaultCallback_t callback)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		faultCallback = callback;
+	}
+}
+
+/*! Gets the number of H-bridge faults detected on a motor since startup.
+    @param motorNum Selects the motor (0 or 1).
+    @return The fault count, or 0 if the motorNum argument was invalid.
+ */
+u16 getMotorFaultCount(const u08 motorNum)
+{
+	u16 count = 0;
+	if (motorNum < 2)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			count = faultStates[motorNum].faultCount;
+		}
+	}
+	return count;
+}
+
+/*! Records a fault and schedules a restart of the H-bridge. Must be called with interrupts disabled,
+    after the H-bridge has been forced off.
+    A fault that happens while the previous restart is still being watched doubles the retry delay,
+    otherwise the retry delay starts again at its minimum. The watch after the first enable has no
+    delay to double yet, so a fault there also starts at the minimum.
+ */
+static void registerFault(const u08 motorNum)
+{
+	volatile MotorFaultState *const state = &faultStates[motorNum];
+
+	state->faultCount++;
+	if (state->watchPeriods == 0 || state->retryDelay < FAULT_RETRY_MIN_PERIODS)
+	{
+		state->retryDelay = FAULT_RETRY_MIN_PERIODS;
+	}
+	else if (state->retryDelay < FAULT_RETRY_MAX_PERIODS / 2)
+	{
+		state->retryDelay *= 2;
+	}
+	else
+	{
+		state->retryDelay = FAULT_RETRY_MAX_PERIODS;
+	}
+	state->retryCountdown = state->retryDelay;
+	state->watchPeriods = 0;
+
+	//Enable the Timer 1 overflow interrupt, which counts down to the restart.
+	sbi(TIMSK1, TOIE1);
+
+	if (faultCallback != NULL)
+	{
+		faultCallback(motorNum, state->faultCount);
+	}
+}
+
+/*! Starts polling the DIAGA/DIAGB level of a newly enabled H-bridge for a fault.
+    Must be called with interrupts disabled.
+ */
+static void watchForFault(const u08 motorNum, const u16 periods)
+{
+	faultStates[motorNum].watchPeriods = periods;
+	sbi(TIMSK1, TOIE1);
+}
 
 /*! Initialize the enabled motor channels.
     Normally called only by the initialize() function in utility.c.
  */
 void motorInit()
 {
-	//Set up Timer 1 in 8-bit fast PWM mode with the prescaler at I/O clock / 64,
+	//Set up Timer 1 in the PWM mode and prescaler selected by the Makefile (8-bit fast PWM at I/O clock / 64 by default),
 	//with the PWM in normal polarity (meaning motor on or brake on is logic 1).
-	TCCR1A = (1 << WGM10);
-	TCCR1B = (1 << CS11) | (1 << CS10) | (1 << WGM12);
+	TCCR1A = PWM_WGM_A;
+	TCCR1B = PWM_WGM_B | PWM_CS;
 
 	#if USE_MOTOR0 == 1
 		//Configure INA and INB as outputs
@@ -25,8 +178,13 @@ void motorInit()
 		//Set OC1A (output compare unit 1A) for fast PWM, normal polarity
 		TCCR1A |= (1 << COM1A1);
 		//Set the duty cycle to zero
-		OCR1AH = 0;
-		OCR1AL = 0;
+		OCR1A = 0;
+
+		//Configure INT5 (the combined DIAGA/DIAGB pin) to interrupt on a falling edge, which signals a fault.
+		//The interrupt itself is only enabled while the H-bridge is enabled.
+		EICRB = (EICRB & ~(_BV(ISC50) | _BV(ISC51))) | _BV(ISC51);
+		//Start with the H-bridge forced off, so the first drive command enables it and arms the interrupt.
+		applyMotor0(0);
 	#endif
 
 	#if USE_MOTOR1 == 1
@@ -38,28 +196,31 @@ void motorInit()
 		//Set OC1B (output compare unit 1B) for fast PWM, normal polarity
 		TCCR1A |= (1 << COM1B1);
 		//Set the duty cycle to zero
-		OCR1BH = 0;
-		OCR1BL = 0;
+		OCR1B = 0;
+
+		//Configure INT4 (the combined DIAGA/DIAGB pin) to interrupt on a falling edge, which signals a fault.
+		//The interrupt itself is only enabled while the H-bridge is enabled.
+		EICRB = (EICRB & ~(_BV(ISC40) | _BV(ISC41))) | _BV(ISC41);
+		//Start with the H-bridge forced off, so the first drive command enables it and arms the interrupt.
+		applyMotor1(0);
 	#endif
 }
 
 //Don't compile the motor 0 functions if motor 0 is not enabled (prevents accidental use).
 #if USE_MOTOR0 == 1
-/*! Sets motor speed and direction for Motor 0.
-    @param speedAndDirection Values are interpreted such that:
-    0 = full speed reverse,
-    127 = glide to a stop (no braking),
-    255 = full speed forward
+/*! Drives the Motor 0 H-bridge and arms or disarms its fault interrupt. Must be called with interrupts disabled.
+    @param speed As for motor0().
  */
-void motor0(const u08 speedAndDirection)
+static void applyMotor0(const s16 speed)
 {
 	//Glide to a stop (no braking)
-	if (speedAndDirection == 127)
+	if (speed == 0)
 	{
-		//***TODO: disable the interrupt watching for a DIAGA/DIAGB fault condition
+		//Disable the interrupt watching for a DIAGA/DIAGB fault condition, since we are about to drive the pin low ourselves.
+		cbi(EIMSK, INT5);
 
 		//Set PWM to lowest duty cycle
-		OCR1AL = 0;
+		OCR1A = 0;
 
 		//Configure the combined DIAGA/DIAGB as an output so it can force the H-Bridge off.
 		sbi(DDRE, DDE5);
@@ -68,25 +229,32 @@ void motor0(const u08 speedAndDirection)
 	}
 	else
 	{
-		//***TODO: enable the interrupt watching for a DIAGA/DIAGB fault condition
+		//If the H-bridge is currently forced off, enable it and watch for a fault that is already present.
+		if (gbi(DDRE, DDE5))
+		{
+			//Configure the combined DIAGA/DIAGB pin as an input so it can detect a fault condition.
+			cbi(DDRE, DDE5);
+			//Enable pullup resistor to pull the combined DIAGA/DIAGB high to enable the H-bridge chip.
+			sbi(PORTE, PE5);
 
-		//Configure the combined DIAGA/DIAGB pin as an input so it can detect a fault condition.
-		cbi(DDRE, DDE5);
-		//Enable pullup resistor to pull the combined DIAGA/DIAGB high to enable the H-bridge chip.
-		sbi(PORTE, PE5);
+			//Enable the interrupt watching for a DIAGA/DIAGB fault condition, clearing any edge seen while it was driven low.
+			EIFR = _BV(INTF5);
+			sbi(EIMSK, INT5);
+			if (faultStates[0].watchPeriods < FAULT_SETTLE_PERIODS)
+			{
+				watchForFault(0, FAULT_SETTLE_PERIODS);
+			}
+		}
 
 		//Drive forward
-		if (speedAndDirection > 127)
+		if (speed > 0)
 		{
 			//set INA high and INB low to drive "clockwise"
 			PORTE = (PORTE & ~(_BV(PE6) | _BV(PE7))) | _BV(PE7);
 
 			//Set the duty cycle by writing to the output compare register for Timer 1,
-			//which is the duty cycle register when the timer is in 8-bit fast PWM mode.
-			//Subtract 128 from the parameter to produce a range of 0-127 from 128-255.
-			//Multiply the new 0-127 range by 2 to make it 0-254.
-			//Add 1 to make the final range 1-255.
-			OCR1AL = ((speedAndDirection - 128) * 2) + 1;
+			//which is the duty cycle register when the timer is in PWM mode.
+			OCR1A = (speed > MOTOR_SPEED_MAX) ? MOTOR_SPEED_MAX : speed;
 		}
 		//Drive backward
 		else
@@ -94,25 +262,54 @@ void motor0(const u08 speedAndDirection)
 			//set INA low and INB high to drive "counterclockwise"
 			PORTE = (PORTE & ~(_BV(PE6) | _BV(PE7))) | _BV(PE6);
 
-			//Set the duty cycle by writing to the output compare register for Timer 1,
-			//which is the duty cycle register when the timer is in 8-bit fast PWM mode.
-			//Subtract the parameter from 127 to produce a range of 127-1 from 0-126.
-			//Multiply the new 127-1 range by 2 to make it 254-2.
-			OCR1AL = (127 - speedAndDirection) * 2;
+			//Set the duty cycle from the magnitude of the speed.
+			OCR1A = (speed < -MOTOR_SPEED_MAX) ? MOTOR_SPEED_MAX : -speed;
+		}
+	}
+}
+
+/*! Sets motor speed and direction for Motor 0.
+    If the H-bridge is recovering from a fault, a drive command is saved and applied when the H-bridge restarts.
+    @param speed Values are interpreted such that:
+    -::MOTOR_SPEED_MAX = full speed reverse,
+    0 = glide to a stop (no braking),
+    ::MOTOR_SPEED_MAX = full speed forward
+ */
+void motor0(const s16 speed)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		faultStates[0].command = speed;
+
+		//A stop command cancels any pending restart, otherwise wait for the restart to apply the command.
+		if (speed == 0)
+		{
+			faultStates[0].retryCountdown = 0;
+		}
+		if (faultStates[0].retryCountdown == 0)
+		{
+			applyMotor0(speed);
 		}
 	}
 }
 
 /*! Shorts both of motor0's terminals to ground to oppose motor0 movement.
-    @param brakingPower Specifies the duty cycle to apply the brake at (0 to 255):
-	0 = no braking, 255 = maximum braking
+    @param brakingPower Specifies the duty cycle to apply the brake at (0 to ::MOTOR_SPEED_MAX):
+	0 = no braking, ::MOTOR_SPEED_MAX = maximum braking
  */
-void brake0(const u08 brakingPower)
+void brake0(const u16 brakingPower)
 {
-	//set PWM to specified braking duty cycle
-	OCR1AL = brakingPower;
-	//set INA low and INB low to brake to GND
-	PORTE &= ~(_BV(PE6) | _BV(PE7));
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		//braking takes over from any pending restart of a faulted H-bridge
+		faultStates[0].retryCountdown = 0;
+		faultStates[0].command = 0;
+
+		//set PWM to specified braking duty cycle
+		OCR1A = (brakingPower > MOTOR_SPEED_MAX) ? MOTOR_SPEED_MAX : brakingPower;
+		//set INA low and INB low to brake to GND
+		PORTE &= ~(_BV(PE6) | _BV(PE7));
+	}
 }
 
 /*! Checks if the H-Bridge for motor0 is in shutdown mode due to a fault.
@@ -133,25 +330,45 @@ u08 motor0Faulted()
 		return !gbi(PINE, PINE5);
 	}
 }
+
+/*! Forces the Motor 0 H-bridge off after a fault and schedules a restart.
+    Must be called with interrupts disabled.
+ */
+static void motor0FaultDetected()
+{
+	//Stop watching for further faults and force the H-bridge off, as a stop command would.
+	cbi(EIMSK, INT5);
+	OCR1A = 0;
+	sbi(DDRE, DDE5);
+	cbi(PORTE, PE5);
+
+	registerFault(0);
+}
+
+//! Fires when the Motor 0 H-bridge pulls its combined DIAGA/DIAGB pin low to signal a fault.
+ISR(INT5_vect)
+{
+	TRACE_ISR_ENTER(TRACE_MOTOR_FAULT0);
+	motor0FaultDetected();
+	TRACE_ISR_EXIT(TRACE_MOTOR_FAULT0);
+}
 #endif //USE_MOTOR0 == 1
 
 //Don't compile the motor 1 functions if motor 1 is not enabled (prevents accidental use).
 #if USE_MOTOR1 == 1
-/*! Sets motor speed and direction for Motor 1.
-    @param speedAndDirection Values are interpreted such that:
-    0 = full speed reverse,
-    127 = glide to a stop (no braking),
-    255 = full speed forward
+/*! Drives the Motor 1 H-bridge and arms or disarms its fault interrupt. Must be called with interrupts disabled.
+    @param speed As for motor1().
  */
-void motor1(const u08 speedAndDirection)
+static void applyMotor1(const s16 speed)
 {
 	//Glide to a stop (no braking)
-	if (speedAndDirection == 127)
+	if (speed == 0)
 	{
-		//***TODO: disable the interrupt watching for a DIAGA/DIAGB fault condition
+		//Disable the interrupt watching for a DIAGA/DIAGB fault condition, since we are about to drive the pin low ourselves.
+		cbi(EIMSK, INT4);
 
 		//Set PWM to lowest duty cycle
-		OCR1BL = 0;
+		OCR1B = 0;
 
 		//Configure the combined DIAGA/DIAGB as an output so it can force the H-Bridge off.
 		sbi(DDRE, DDE4);
@@ -160,25 +377,32 @@ void motor1(const u08 speedAndDirection)
 	}
 	else
 	{
-		//***TODO: enable the interrupt watching for a DIAGA/DIAGB fault condition
+		//If the H-bridge is currently forced off, enable it and watch for a fault that is already present.
+		if (gbi(DDRE, DDE4))
+		{
+			//Configure the combined DIAGA/DIAGB pin as an input so it can detect a fault condition.
+			cbi(DDRE, DDE4);
+			//Enable pullup resistor to pull the combined DIAGA/DIAGB high to enable the H-bridge chip.
+			sbi(PORTE, PE4);
 
-		//Configure the combined DIAGA/DIAGB pin as an input so it can detect a fault condition.
-		cbi(DDRE, DDE4);
-		//Enable pullup resistor to pull the combined DIAGA/DIAGB high to enable the H-bridge chip.
-		sbi(PORTE, PE4);
+			//Enable the interrupt watching for a DIAGA/DIAGB fault condition, clearing any edge seen while it was driven low.
+			EIFR = _BV(INTF4);
+			sbi(EIMSK, INT4);
+			if (faultStates[1].watchPeriods < FAULT_SETTLE_PERIODS)
+			{
+				watchForFault(1, FAULT_SETTLE_PERIODS);
+			}
+		}
 
 		//Drive forward
-		if (speedAndDirection > 127)
+		if (speed > 0)
 		{
 			//set INA high and INB low to drive "clockwise"
 			PORTE = (PORTE & ~(_BV(PE3) | _BV(PE2))) | _BV(PE2);
 
 			//Set the duty cycle by writing to the output compare register for Timer 1,
-			//which is the duty cycle register when the timer is in 8-bit fast PWM mode.
-			//Subtract 128 from the parameter to produce a range of 0-127 from 128-255.
-			//Multiply the new 0-127 range by 2 to make it 0-254.
-			//Add 1 to make the final range 1-255.
-			OCR1BL = ((speedAndDirection - 128) * 2) + 1;
+			//which is the duty cycle register when the timer is in PWM mode.
+			OCR1B = (speed > MOTOR_SPEED_MAX) ? MOTOR_SPEED_MAX : speed;
 		}
 		//Drive backward
 		else
@@ -186,25 +410,54 @@ void motor1(const u08 speedAndDirection)
 			//set INA low and INB high to drive "counterclockwise"
 			PORTE = (PORTE & ~(_BV(PE3) | _BV(PE2))) | _BV(PE3);
 
-			//Set the duty cycle by writing to the output compare register for Timer 1,
-			//which is the duty cycle register when the timer is in 8-bit fast PWM mode.
-			//Subtract the parameter from 127 to produce a range of 127-1 from 0-126.
-			//Multiply the new 127-1 range by 2 to make it 254-2.
-			OCR1BL = (127 - speedAndDirection) * 2;
+			//Set the duty cycle from the magnitude of the speed.
+			OCR1B = (speed < -MOTOR_SPEED_MAX) ? MOTOR_SPEED_MAX : -speed;
+		}
+	}
+}
+
+/*! Sets motor speed and direction for Motor 1.
+    If the H-bridge is recovering from a fault, a drive command is saved and applied when the H-bridge restarts.
+    @param speed Values are interpreted such that:
+    -::MOTOR_SPEED_MAX = full speed reverse,
+    0 = glide to a stop (no braking),
+    ::MOTOR_SPEED_MAX = full speed forward
+ */
+void motor1(const s16 speed)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		faultStates[1].command = speed;
+
+		//A stop command cancels any pending restart, otherwise wait for the restart to apply the command.
+		if (speed == 0)
+		{
+			faultStates[1].retryCountdown = 0;
+		}
+		if (faultStates[1].retryCountdown == 0)
+		{
+			applyMotor1(speed);
 		}
 	}
 }
 
 /*! Shorts both of motor1's terminals to ground to oppose motor1 movement.
-    @param brakingPower Specifies the duty cycle to apply the brake at (0 to 255):
-	0 = no braking, 255 = maximum braking
+    @param brakingPower Specifies the duty cycle to apply the brake at (0 to ::MOTOR_SPEED_MAX):
+	0 = no braking, ::MOTOR_SPEED_MAX = maximum braking
  */
-void brake1(const u08 brakingPower)
+void brake1(const u16 brakingPower)
 {
-	//set PWM to specified braking duty cycle
-	OCR1BL = brakingPower;
-	//set INA low and INB low to brake to GND
-	PORTE &= ~(_BV(PE2) | _BV(PE3));
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		//braking takes over from any pending restart of a faulted H-bridge
+		faultStates[1].retryCountdown = 0;
+		faultStates[1].command = 0;
+
+		//set PWM to specified braking duty cycle
+		OCR1B = (brakingPower > MOTOR_SPEED_MAX) ? MOTOR_SPEED_MAX : brakingPower;
+		//set INA low and INB low to brake to GND
+		PORTE &= ~(_BV(PE2) | _BV(PE3));
+	}
 }
 
 /*! Checks if the H-Bridge for motor1 is in shutdown mode due to a fault.
@@ -225,4 +478,108 @@ u08 motor1Faulted()
 		return !gbi(PINE, PINE4);
 	}
 }
+
+/*! Forces the Motor 1 H-bridge off after a fault and schedules a restart.
+    Must be called with interrupts disabled.
+ */
+static void motor1FaultDetected()
+{
+	//Stop watching for further faults and force the H-bridge off, as a stop command would.
+	cbi(EIMSK, INT4);
+	OCR1B = 0;
+	sbi(DDRE, DDE4);
+	cbi(PORTE, PE4);
+
+	registerFault(1);
+}
+
+//! Fires when the Motor 1 H-bridge pulls its combined DIAGA/DIAGB pin low to signal a fault.
+ISR(INT4_vect)
+{
+	TRACE_ISR_ENTER(TRACE_MOTOR_FAULT1);
+	motor1FaultDetected();
+	TRACE_ISR_EXIT(TRACE_MOTOR_FAULT1);
+}
 #endif //USE_MOTOR1 == 1
+
+#if USE_MOTOR0 == 1 || USE_MOTOR1 == 1
+/*! Advances the fault recovery state of one motor by a PWM period.
+    @return TRUE if the motor still needs the Timer 1 overflow interrupt.
+ */
+static inline bool updateFaultRecovery(const u08 motorNum, const bool diagLow)
+{
+	volatile MotorFaultState *const state = &faultStates[motorNum];
+
+	if (state->retryCountdown > 0)
+	{
+		if (--state->retryCountdown == 0)
+		{
+			//Restart the H-bridge with the most recent command, and watch it for a while before trusting it.
+			state->watchPeriods = FAULT_PROBATION_PERIODS;
+			if (motorNum == 0)
+			{
+				#if USE_MOTOR0 == 1
+					applyMotor0(state->command);
+				#endif
+			}
+			else
+			{
+				#if USE_MOTOR1 == 1
+					applyMotor1(state->command);
+				#endif
+			}
+		}
+		return TRUE;
+	}
+	else if (state->watchPeriods > 0)
+	{
+		//A DIAGA/DIAGB pin that stays low never produces a falling edge, so poll its level here.
+		if (diagLow)
+		{
+			if (motorNum == 0)
+			{
+				#if USE_MOTOR0 == 1
+					motor0FaultDetected();
+				#endif
+			}
+			else
+			{
+				#if USE_MOTOR1 == 1
+					motor1FaultDetected();
+				#endif
+			}
+			return TRUE;
+		}
+		if (--state->watchPeriods == 0)
+		{
+			//The H-bridge ran without a fault, so the next fault starts with the shortest retry delay again.
+			state->retryDelay = FAULT_RETRY_MIN_PERIODS;
+			return FALSE;
+		}
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/*! Fires once per PWM period, but is only enabled while a motor is waiting to restart after a fault
+    or is being watched after being enabled.
+ */
+ISR(TIMER1_OVF_vect)
+{
+	TRACE_ISR_ENTER(TRACE_MOTOR_PWM);
+	bool active = FALSE;
+
+	#if USE_MOTOR0 == 1
+		active |= updateFaultRecovery(0, motor0Faulted());
+	#endif
+	#if USE_MOTOR1 == 1
+		active |= updateFaultRecovery(1, motor1Faulted());
+	#endif
+
+	if (!active)
+	{
+		cbi(TIMSK1, TOIE1);
+	}
+	TRACE_ISR_EXIT(TRACE_MOTOR_PWM);
+}
+#endif
@@ -6,13 +6,37 @@
 
 #include "globals.h"
 
+//The PWM resolution is normally set by the MOTOR_PWM_BITS variable in the Makefile. Default to the original 8 bits.
+#ifndef MOTOR_PWM_BITS
+	#define MOTOR_PWM_BITS 8
+#endif
+#if MOTOR_PWM_BITS < 8 || MOTOR_PWM_BITS > 10
+	#error "MOTOR_PWM_BITS must be 8, 9, or 10"
+#endif
+
+//! The largest motor speed (and braking power), which is full duty cycle at the configured PWM resolution.
+#define MOTOR_SPEED_MAX ((1 << MOTOR_PWM_BITS) - 1)
+
+/*! Converts an 8-bit speedAndDirection value as used by older code and the remote control protocol
+    (0 = full speed reverse, 127 = glide to a stop, 255 = full speed forward) to a signed motor speed.
+ */
+#define MOTOR_SPEED_FROM_U08(speedAndDirection) ((s16)(((s32)(speedAndDirection) - 127) * MOTOR_SPEED_MAX / 128))
+
+/*! Defines a function pointer type for a function called when an H-Bridge fault is detected.
+    @param motorNum The motor that faulted (0 or 1).
+    @param faultCount The number of faults detected on that motor since startup.
+ */
+typedef void (*MotorFaultCallback_t)(const u08 motorNum, const u16 faultCount);
+
 //Prototypes
 void motorInit();
-void motor0(const u08 speedAndDirection);
-void brake0(const u08 brakingPower);
+void setMotorFaultCallback(MotorFaultCallback_t callback);
+u16 getMotorFaultCount(const u08 motorNum);
+void motor0(const s16 speed);
+void brake0(const u16 brakingPower);
 u08 motor0Faulted();
-void motor1(const u08 speedAndDirection);
-void brake1(const u08 brakingPower);
+void motor1(const s16 speed);
+void brake1(const u16 brakingPower);
 u08 motor1Faulted();
 
 #endif
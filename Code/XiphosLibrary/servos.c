@@ -5,9 +5,13 @@
     Software-based PWM implementation for controlling up to 8 PWM servo outputs via a 16-bit timer interrupt.
     To minimize interrupt overhead, the timeslots for the servos are spread out over 20ms (the standard servo period)
     such that only one servo output, if any, is high at any given time.
+    Pulse timings are precomputed outside the ISR into a double-buffered schedule, and the ISR switches
+    to a newly published schedule only at the end of a servo period.
+    Servos can also be moved with velocity and acceleration limits, which the ISR interpolates in the background.
  */
 
 #include "servos.h"
+#include "trace.h"
 #include <util/atomic.h>
 #include <util/delay.h>
 
@@ -37,13 +41,55 @@ static const u16 CENTER_TICKS = (F_CPU * 1.5) / (8 * 1000);
 static volatile u08 activeServoNumber = 0;
 //! State of the active servo's output pulse.
 static volatile bool high = FALSE;
-//! Array of the pulse widths (high times) of all servos, in timer counts.
-static u16 servoHighTime[NUM_SERVOS];
-//! Array of the pulse widths (low/off times) of all servos, in timer counts.
-static u16 servoLowTime[NUM_SERVOS];
+//! Low time of the active servo's current pulse, latched by the ISR when the pulse starts.
+static u16 activeLowTime;
+
+/*! A complete set of precomputed pulse timings for one servo period.
+ *  The ISR only ever reads these values, so it does no arithmetic beyond updating OCR3C.
+ */
+typedef struct
+{
+	u16 highTime[NUM_SERVOS]; //!< Pulse widths (high times) of all servos, in timer counts. 0 means the servo is off.
+	u16 lowTime[NUM_SERVOS];  //!< Remaining low/off times of all servos, in timer counts.
+} ServoSchedule;
+
+//! The most recently commanded timings. Only accessed outside the ISR, from within atomic blocks.
+static ServoSchedule commandedSchedule;
+//! Double-buffered schedules: one is read by the ISR while the other is prepared for the next period.
+static ServoSchedule servoSchedules[2];
+//! The schedule that the ISR is currently reading from.
+static ServoSchedule * volatile activeSchedule = &servoSchedules[0];
+//! Set when the inactive schedule holds new timings that the ISR should switch to at the end of the period.
+static volatile bool schedulePending = FALSE;
 //! Array of the range multipliers of all servos.
 static u08 servoRangeMultiplier[NUM_SERVOS];
 
+/*! The fastest profile velocity, in 1/8 timer ticks per servo period.
+ *  This is 512 timer ticks per period, which covers a full servo range in about 0.1 seconds,
+ *  and it keeps all of the 16-bit profile arithmetic in the ISR from overflowing.
+ */
+#define MAX_PROFILE_VELOCITY 4095
+
+/*! Motion profile state for a servo.
+ *  Positions are pulse widths in 1/8 timer ticks, so that slow velocities still make progress every period.
+ */
+typedef struct
+{
+	u16 maxVelocitySetting;     //!< Velocity limit set by setServoProfile(), in position units per second. 0 disables profiling.
+	u16 accelerationSetting;    //!< Acceleration set by setServoProfile(), in position units per second squared.
+	u16 position;               //!< Current interpolated pulse width.
+	u16 target;                 //!< Target pulse width.
+	u16 velocity;               //!< Current velocity, per servo period.
+	u16 maxVelocity;            //!< Velocity limit, per servo period.
+	u16 acceleration;           //!< Velocity change, per servo period.
+	u16 brakingDistance;        //!< Distance needed to decelerate from the current velocity to rest.
+} ServoProfile;
+
+//! Motion profiles of all servos.
+static ServoProfile servoProfiles[NUM_SERVOS];
+//! Bit mask of the servos whose profiles are still moving toward their targets.
+static volatile u08 movingMask = 0;
+
 /*
 Derivation of formula in servo()/servo2() and ServoRange enum values:
 
@@ -132,31 +178,66 @@ u08 getServoRange(const u08 servoNum)
 	}
 }
 
+/*! Calculates the pulse width for a servo from its configured range and a position offset from center.
+    This is kept outside of the atomic blocks so that interrupts are not held off during the multiply and divide.
+    @param servoNum Selects the servo (0 to NUM_SERVOS-1). Must already be validated.
+    @param offset The commanded position relative to center (-128 to +127).
+    @return The pulse width in timer counts.
+ */
+static inline u16 servoHighTicks(const u08 servoNum, const s16 offset)
+{
+	return CENTER_TICKS + ((servoRangeMultiplier[servoNum] * offset) / 8);
+}
+
+/*! Stores new timings for a servo into ::commandedSchedule, cancelling any profiled move in progress.
+    Must be called from within an atomic block.
+ */
+static inline void storeServoTiming(const u08 servoNum, const u16 highTime, const u16 lowTime)
+{
+	cbi(movingMask, servoNum);
+	commandedSchedule.highTime[servoNum] = highTime;
+	commandedSchedule.lowTime[servoNum] = lowTime;
+}
+
+/*! Copies ::commandedSchedule into the schedule that the ISR is not using, and flags it to be
+    swapped in when the current servo period ends. Must be called from within an atomic block.
+ */
+static inline void publishServoSchedule()
+{
+	ServoSchedule *const pending = (activeSchedule == &servoSchedules[0]) ? &servoSchedules[1] : &servoSchedules[0];
+	*pending = commandedSchedule;
+	schedulePending = TRUE;
+}
+
 /*! Sets the position of a servo using an unsigned integer.
+    The new position takes effect at the start of the next servo period.
     @param servoNum Selects the servo (0 to NUM_SERVOS-1).
     @param position Sets the servo position (0 to 255). 128 is the center value (1.5ms pulse width).
     @see Use servo2() instead if you prefer to pass position as a signed integer.
+    @see Use servoSetMany() to change several servos in the same servo period.
  */
 void servo(const u08 servoNum, const u08 position)
 {
 	//Validate servoNum parameter so that we don't overwrite other memory locations.
 	if (servoNum < NUM_SERVOS)
 	{
+		//Set the highTime for the servo, based on the configured range and commanded position.
+		const u16 highTime = servoHighTicks(servoNum, (s16)(position - CENTER_VALUE));
+
 		//Disable interrupts in this block to guarantee that the 16-bit high and low times get written atomically.
 		//ATOMIC_RESTORESTATE is used so that this function can be called from
 		//user code/ISRs without unexpected side effects.
 		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 		{
-			//Set the highTime for the servo, based on the configured range and commanded position.
-			servoHighTime[servoNum] = CENTER_TICKS + ((servoRangeMultiplier[servoNum] * (s16)(position - CENTER_VALUE)) / 8);
-
-			//Set the lowTime for the servo to fill the remaining time for this servo period.
-			servoLowTime[servoNum] = MAX_PERIOD - servoHighTime[servoNum];
+			//The lowTime fills the remaining time for this servo period.
+			storeServoTiming(servoNum, highTime, MAX_PERIOD - highTime);
+			publishServoSchedule();
 		}
 	}
 }
 
 /*! Sets the position of a servo using a signed integer.
+    The new position takes effect at the start of the next servo period.
     @param servoNum Selects the servo (0 to NUM_SERVOS-1).
     @param position Sets the servo position (-128 to +127). 0 is the center value (1.5ms pulse width).
     @see Use servo() instead if you prefer to pass position as an unsigned integer.
@@ -166,17 +247,56 @@ void servo2(const u08 servoNum, const s08 position)
 	//Validate servoNum parameter so that we don't overwrite other memory locations.
 	if (servoNum < NUM_SERVOS)
 	{
+		//Set the highTime for the servo based on the configured range and commanded position.
+		const u16 highTime = servoHighTicks(servoNum, position);
+
 		//Disable interrupts in this block to guarantee that the 16-bit high and low times get written atomically.
 		//ATOMIC_RESTORESTATE is used so that this function can be called from
 		//user code/ISRs without unexpected side effects.
 		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 		{
-			//Set the highTime for the servo based on the configured range and commanded position.
-			servoHighTime[servoNum] = CENTER_TICKS + ((servoRangeMultiplier[servoNum] * (s16)position) / 8);
+			//The lowTime fills the remaining time for this servo period.
+			storeServoTiming(servoNum, highTime, MAX_PERIOD - highTime);
+			publishServoSchedule();
+		}
+	}
+}
+
+/*! Sets the positions of several servos so that they all change in the same servo period.
+    All pulse widths are calculated before interrupts are disabled, and the new schedule is
+    committed in a single short critical section.
+    @param commands Array of servo numbers and positions (0 to 255, 128 is center), as for servo().
+    Commands with an invalid servoNum are ignored.
+    @param count The number of entries in the commands array.
+ */
+void servoSetMany(const ServoCommand *const commands, const u08 count)
+{
+	u16 highTimes[NUM_SERVOS];
+	u08 changedMask = 0;
+
+	//Calculate all of the pulse widths first, with interrupts still enabled.
+	for (u08 i = 0; i < count; i++)
+	{
+		const u08 servoNum = commands[i].servoNum;
+		//Validate servoNum parameter so that we don't overwrite other memory locations.
+		if (servoNum < NUM_SERVOS)
+		{
+			highTimes[servoNum] = servoHighTicks(servoNum, (s16)(commands[i].position - CENTER_VALUE));
+			changedMask |= _BV(servoNum);
+		}
+	}
 
-			//Set the lowTime for the servo to fill the remaining time for this servo period.
-			servoLowTime[servoNum] = MAX_PERIOD - servoHighTime[servoNum];
+	//Commit them all at once, so the ISR switches to the new positions together.
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		for (u08 servoNum = 0; servoNum < NUM_SERVOS; servoNum++)
+		{
+			if (gbi(changedMask, servoNum))
+			{
+				storeServoTiming(servoNum, highTimes[servoNum], MAX_PERIOD - highTimes[servoNum]);
+			}
 		}
+		publishServoSchedule();
 	}
 }
 
@@ -194,12 +314,146 @@ void servoOff(const u08 servoNum)
 		//user code/ISRs without unexpected side effects.
 		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 		{
-			servoHighTime[servoNum] = 0;
-			servoLowTime[servoNum] = MAX_PERIOD;
+			storeServoTiming(servoNum, 0, MAX_PERIOD);
+			publishServoSchedule();
+		}
+	}
+}
+
+/*! Sets the motion profile used by servoMoveTo() and servoMoveMany() for a servo.
+    The servo accelerates up to maxVelocity and decelerates so that it comes to rest at the target.
+    The profile is interpolated once per servo period by the servo ISR, so moves do not block the caller.
+    @param servoNum Selects the servo (0 to NUM_SERVOS-1).
+    @param maxVelocity The velocity limit, in position units (as for servo()) per second.
+    0 disables profiling, so moves jump straight to the target like servo() does.
+    @param acceleration The acceleration and deceleration, in position units per second squared.
+    0 means the servo starts and stops moving at maxVelocity without ramping.
+    @return TRUE if the profile was set, FALSE if the servoNum argument was invalid.
+ */
+bool setServoProfile(const u08 servoNum, const u16 maxVelocity, const u16 acceleration)
+{
+	if (servoNum < NUM_SERVOS)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			servoProfiles[servoNum].maxVelocitySetting = maxVelocity;
+			servoProfiles[servoNum].accelerationSetting = acceleration;
 		}
+		return TRUE;
+	}
+	else
+	{
+		return FALSE;
 	}
 }
 
+/*! Starts a profiled move of a servo toward a new position, limited by its setServoProfile() settings.
+    Must be called from within an atomic block, with a validated servoNum.
+    @param servoNum Selects the servo (0 to NUM_SERVOS-1).
+    @param targetTime The pulse width of the target position, in timer counts.
+ */
+static void startServoProfile(const u08 servoNum, const u16 targetTime)
+{
+	ServoProfile *const profile = &servoProfiles[servoNum];
+	const u16 currentTime = commandedSchedule.highTime[servoNum];
+
+	//A servo that is off or has no profile has no known position to ramp from, so it jumps to the target.
+	if (profile->maxVelocitySetting == 0 || currentTime == 0)
+	{
+		storeServoTiming(servoNum, targetTime, MAX_PERIOD - targetTime);
+		publishServoSchedule();
+		return;
+	}
+
+	//Convert the settings from position units to 1/8 timer ticks per servo period.
+	//One position unit is range/8 timer ticks, and there are 1000/SERVO_PERIOD servo periods per second.
+	const u08 range = servoRangeMultiplier[servoNum];
+	u32 maxVelocity = ((u32)profile->maxVelocitySetting * range) / (1000 / SERVO_PERIOD);
+	u32 acceleration = ((u32)profile->accelerationSetting * range) / ((1000UL / SERVO_PERIOD) * (1000UL / SERVO_PERIOD));
+	if (maxVelocity > MAX_PROFILE_VELOCITY)
+		maxVelocity = MAX_PROFILE_VELOCITY;
+	else if (maxVelocity == 0)
+		maxVelocity = 1;
+	if (acceleration == 0 || acceleration > maxVelocity)
+		acceleration = maxVelocity;
+
+	const u16 target = targetTime << 3;
+	const bool wasMoving = gbi(movingMask, servoNum);
+	const bool wasMovingUp = profile->target > profile->position;
+
+	if (!wasMoving)
+	{
+		profile->position = currentTime << 3;
+	}
+
+	//Keep the current velocity when the new target is in the same direction with the same acceleration,
+	//otherwise start again from rest.
+	if (!wasMoving || wasMovingUp != (target > profile->position) || profile->acceleration != acceleration)
+	{
+		profile->velocity = 0;
+		profile->brakingDistance = 0;
+	}
+	profile->target = target;
+	profile->maxVelocity = maxVelocity;
+	profile->acceleration = acceleration;
+	sbi(movingMask, servoNum);
+}
+
+/*! Moves a servo toward a new position using its motion profile, without waiting for the move to finish.
+    @param servoNum Selects the servo (0 to NUM_SERVOS-1).
+    @param position The target position (0 to 255). 128 is the center value (1.5ms pulse width).
+    @see setServoProfile() configures the velocity and acceleration limits.
+    @see servoMoving() checks whether the move has finished.
+ */
+void servoMoveTo(const u08 servoNum, const u08 position)
+{
+	const ServoCommand command = {servoNum, position};
+	servoMoveMany(&command, 1);
+}
+
+/*! Moves several servos toward new positions using their motion profiles, starting them in the same servo period.
+    @param commands Array of servo numbers and target positions (0 to 255, 128 is center), as for servoSetMany().
+    Commands with an invalid servoNum are ignored.
+    @param count The number of entries in the commands array.
+ */
+void servoMoveMany(const ServoCommand *const commands, const u08 count)
+{
+	u16 targetTimes[NUM_SERVOS];
+	u08 changedMask = 0;
+
+	//Calculate all of the target pulse widths first, with interrupts still enabled.
+	for (u08 i = 0; i < count; i++)
+	{
+		const u08 servoNum = commands[i].servoNum;
+		//Validate servoNum parameter so that we don't overwrite other memory locations.
+		if (servoNum < NUM_SERVOS)
+		{
+			targetTimes[servoNum] = servoHighTicks(servoNum, (s16)(commands[i].position - CENTER_VALUE));
+			changedMask |= _BV(servoNum);
+		}
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		for (u08 servoNum = 0; servoNum < NUM_SERVOS; servoNum++)
+		{
+			if (gbi(changedMask, servoNum))
+			{
+				startServoProfile(servoNum, targetTimes[servoNum]);
+			}
+		}
+	}
+}
+
+/*! Checks whether a profiled move started by servoMoveTo() or servoMoveMany() is still in progress.
+    @param servoNum Selects the servo (0 to NUM_SERVOS-1).
+    @return TRUE if the servo has not reached its target yet, otherwise FALSE.
+ */
+bool servoMoving(const u08 servoNum)
+{
+	return servoNum < NUM_SERVOS && gbi(movingMask, servoNum);
+}
+
 /*! Writes to the octal D flip-flop that maintains the servo pin output values.
     @param servoOutput The new servo pin output values (only one will be high, if any).
  */
@@ -215,14 +469,80 @@ static inline void writeServoOutput(const u08 servoOutput)
 	cbi(PORTD, PD5);
 }
 
-//! This is the interrupt service routine to control 1-8 servos.
+/*! Advances every moving servo profile by one servo period. Called by the ISR at the start of each period.
+    The new pulse widths are written to ::commandedSchedule and to both schedule buffers, so they are used
+    from this period onward and are not overwritten by a schedule that was published before this step.
+ */
+static inline void stepServoProfiles()
+{
+	for (u08 servoNum = 0; servoNum < NUM_SERVOS; servoNum++)
+	{
+		if (!gbi(movingMask, servoNum))
+		{
+			continue;
+		}
+
+		ServoProfile *const profile = &servoProfiles[servoNum];
+		const bool movingUp = profile->target > profile->position;
+		const u16 remaining = movingUp ? (profile->target - profile->position) : (profile->position - profile->target);
+
+		if (profile->brakingDistance >= remaining)
+		{
+			//Decelerate, so the servo comes to rest at the target.
+			if (profile->velocity >= profile->acceleration)
+			{
+				profile->velocity -= profile->acceleration;
+				profile->brakingDistance -= profile->velocity;
+			}
+		}
+		else if (profile->velocity + profile->acceleration <= profile->maxVelocity)
+		{
+			//Accelerate. Stopping from the new velocity takes the old velocity's worth of extra distance.
+			profile->brakingDistance += profile->velocity;
+			profile->velocity += profile->acceleration;
+		}
+
+		if (profile->velocity == 0 || profile->velocity >= remaining)
+		{
+			//Arrived, so land exactly on the target.
+			profile->position = profile->target;
+			profile->velocity = 0;
+			profile->brakingDistance = 0;
+			cbi(movingMask, servoNum);
+		}
+		else if (movingUp)
+		{
+			profile->position += profile->velocity;
+		}
+		else
+		{
+			profile->position -= profile->velocity;
+		}
+
+		const u16 highTime = profile->position >> 3;
+		const u16 lowTime = MAX_PERIOD - highTime;
+		commandedSchedule.highTime[servoNum] = highTime;
+		commandedSchedule.lowTime[servoNum] = lowTime;
+		servoSchedules[0].highTime[servoNum] = highTime;
+		servoSchedules[0].lowTime[servoNum] = lowTime;
+		servoSchedules[1].highTime[servoNum] = highTime;
+		servoSchedules[1].lowTime[servoNum] = lowTime;
+	}
+}
+
+/*! This is the interrupt service routine to control 1-8 servos.
+    It only reads the precomputed ::activeSchedule, and switches to a newly published schedule
+    at the end of each servo period so that all servos in a period use a consistent set of timings.
+    At the start of each period, after servo 0's pulse has started, it also advances any profiled moves.
+ */
 ISR(TIMER3_COMPC_vect)
 {
+	TRACE_ISR_ENTER(TRACE_SERVOS);
 	if (high == TRUE)
 	{
 		//servo output was previously high, so set it low
 		writeServoOutput(0);
-		OCR3C += servoLowTime[activeServoNumber];
+		OCR3C += activeLowTime;
 		high = FALSE;
 	}
 	else
@@ -233,20 +553,40 @@ ISR(TIMER3_COMPC_vect)
 		if (activeServoNumber >= NUM_SERVOS)
 		{
 			activeServoNumber = 0;
+
+			//A servo period has ended, so this is the point where new timings can be switched in.
+			if (schedulePending == TRUE)
+			{
+				activeSchedule = (activeSchedule == &servoSchedules[0]) ? &servoSchedules[1] : &servoSchedules[0];
+				schedulePending = FALSE;
+			}
 		}
 
+		const ServoSchedule *const schedule = activeSchedule;
+		const u16 highTime = schedule->highTime[activeServoNumber];
+
 		//if the servo was not turned off via servoOff()
-		if (servoHighTime[activeServoNumber] > 0)
+		if (highTime > 0)
 		{
 			writeServoOutput(_BV(activeServoNumber));
-			OCR3C += servoHighTime[activeServoNumber];
+			OCR3C += highTime;
+			//latch the matching low time, so the pulse and its low time always come from the same schedule
+			activeLowTime = schedule->lowTime[activeServoNumber];
 			high = TRUE;
 		}
 		else
 		{
-			OCR3C += servoLowTime[activeServoNumber];
+			OCR3C += schedule->lowTime[activeServoNumber];
+		}
+
+		//Step the motion profiles once per period. This is done after servo 0's pulse has started,
+		//so the extra time spent here does not shorten the pulse.
+		if (activeServoNumber == 0 && movingMask != 0)
+		{
+			stepServoProfiles();
 		}
 	}
+	TRACE_ISR_EXIT(TRACE_SERVOS);
 }
 
 /*! Initializes the servo timer and variables.
@@ -260,6 +600,10 @@ inline void servoInit()
 		servoOff(i);
 		setServoRange(i, SERVO_RANGE_DEFAULT);
 	}
+	//Start both schedule buffers with every servo off, so the ISR has valid timings from its first interrupt.
+	servoSchedules[0] = commandedSchedule;
+	servoSchedules[1] = commandedSchedule;
+	schedulePending = FALSE;
 
 	//configure 74LS374 (D Flip-Flop) clock pin as an output
 	sbi(DDRD, DDD5);
@@ -34,12 +34,24 @@ typedef enum
 
 } ServoRange;
 
+//! A single servo position command, for use with servoSetMany().
+typedef struct
+{
+	u08 servoNum; //!< Selects the servo (0 to NUM_SERVOS-1).
+	u08 position; //!< Sets the servo position (0 to 255). 128 is the center value (1.5ms pulse width).
+} ServoCommand;
+
 //Prototypes
 bool setServoRange(const u08 servoNum, const ServoRange range);
 u08 getServoRange(const u08 servoNum);
 void servo(const u08 servoNum, const u08 position);
 void servo2(const u08 servoNum, const s08 position);
+void servoSetMany(const ServoCommand *const commands, const u08 count);
 void servoOff(const u08 servoNum);
+bool setServoProfile(const u08 servoNum, const u16 maxVelocity, const u16 acceleration);
+void servoMoveTo(const u08 servoNum, const u08 position);
+void servoMoveMany(const ServoCommand *const commands, const u08 count);
+bool servoMoving(const u08 servoNum);
 void servoInit();
 
 #endif
@@ -0,0 +1,95 @@
+//Copyright (C) 2009-2011  Patrick J. McCarty.
+//Licensed under X11 License. See LICENSE.txt for details.
+
+/*! @file
+    Records timestamped start and end events of interrupts and main loop tasks in a RAM ring, to find out where the
+    time goes: interrupt storms, slow handlers, and main loop stalls.
+    Events are marked with the TRACE_ISR_* and TRACE_TASK_* macros in trace.h, and are taken out of the ring by the
+    project (such as to send them to the PC). When nothing takes them, the ring keeps the latest ::TRACE_LENGTH events,
+    so it can be read after something goes wrong. Enabled by USE_TRACE in the project Makefile.
+ */
+#include "trace.h"
+#include <util/atomic.h>
+
+#if (TRACE_LENGTH & (TRACE_LENGTH - 1)) != 0 || TRACE_LENGTH > 128
+	#error "TRACE_LENGTH must be a power of 2, up to 128"
+#endif
+
+TraceState traceState;
+
+/*! Empties the ring and starts recording.
+ *  @param mask Bit n is set to trace ::TraceId n.
+ *  @return The ::TRACE_CLOCK at the start, which the wraparound counts of the events are from.
+ */
+u16 traceStart(const u32 mask)
+{
+	u16 clock;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		clock = TRACE_CLOCK;
+		traceState.head = 0;
+		traceState.tail = 0;
+		traceState.wraps = 0;
+		traceState.lastClock = clock;
+		traceState.lost = 0;
+		traceState.mask = mask;
+	}
+	return clock;
+}
+
+//! Stops recording. The events recorded so far can still be taken.
+void traceStop()
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		traceState.mask = 0;
+	}
+}
+
+//! Gets the number of events waiting to be taken.
+u08 traceCount()
+{
+	u08 count;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		count = traceState.head - traceState.tail;
+	}
+	return count;
+}
+
+/*! Takes the oldest events out of the ring.
+ *  @return The number of events copied to events, up to maxEvents.
+ */
+u08 traceTake(TraceEvent *events, const u08 maxEvents)
+{
+	u08 count;
+	//one at a time, so interrupts are only held off briefly
+	for (count = 0; count < maxEvents; count++)
+	{
+		bool taken = FALSE;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			if (traceState.tail != traceState.head)
+			{
+				events[count] = traceState.events[traceState.tail & (TRACE_LENGTH - 1)];
+				traceState.tail++;
+				taken = TRUE;
+			}
+		}
+		if (!taken)
+			break;
+	}
+	return count;
+}
+
+//! Gets the number of events that were overwritten before they could be taken, since the last call.
+u16 traceTakeLost()
+{
+	u16 lost;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		lost = traceState.lost;
+		traceState.lost = 0;
+	}
+	return lost;
+}
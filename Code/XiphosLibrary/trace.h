@@ -0,0 +1,131 @@
+//Copyright (C) 2009-2011  Patrick J. McCarty.
+//Licensed under X11 License. See LICENSE.txt for details.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "globals.h"
+#include <util/atomic.h>
+
+/*! The number of events the trace ring holds, 4 bytes each. Can be overridden with -D in the Makefile.
+ *  Must be a power of 2, up to 128.
+ */
+#ifndef TRACE_LENGTH
+	#define TRACE_LENGTH 64
+#endif
+
+/*! The free running 16-bit counter that timestamps the events. Can be overridden with -D in the Makefile.
+ *  The Launcher runs timer5 this way, at 2 MHz (see its rtcTimer.c).
+ */
+#ifndef TRACE_CLOCK
+	#define TRACE_CLOCK TCNT5
+#endif
+
+/*! The things that can be traced: the interrupts, then the project's own events (such as its main loop tasks),
+ *  numbered from ::TRACE_FIRST_TASK. There can be up to ::TRACE_MAX_IDS of them.
+ */
+typedef enum
+{
+	TRACE_ADC,          //!< ADC_vect, which the project handles itself.
+	TRACE_TICK,         //!< The project's timer tick interrupt.
+	TRACE_SERVOS,       //!< TIMER3_COMPC_vect in servos.c.
+	TRACE_UART0_RX,     //!< USART0_RX_vect in uart.c.
+	TRACE_UART0_UDRE,   //!< USART0_UDRE_vect in uart.c.
+	TRACE_UART1_RX,     //!< USART1_RX_vect in uart.c.
+	TRACE_UART1_UDRE,   //!< USART1_UDRE_vect in uart.c.
+	TRACE_MOTOR_FAULT0, //!< INT5_vect in motors.c.
+	TRACE_MOTOR_FAULT1, //!< INT4_vect in motors.c.
+	TRACE_MOTOR_PWM,    //!< TIMER1_OVF_vect in motors.c.
+	TRACE_FIRST_TASK = 16
+} TraceId;
+
+//! The most ids, so each one has a bit in the mask passed to traceStart().
+#define TRACE_MAX_IDS 32
+//! Set in an event's code when it marks the end of an interrupt or task, rather than the start.
+#define TRACE_EXIT 0x80
+
+/*! One recorded event. The time is the 16-bit ::TRACE_CLOCK, extended with the number of times it has wrapped around
+ *  since traceStart(). Wraparounds are only noticed by recording events, so something must be traced at least once
+ *  per wraparound of the clock (such as ::TRACE_TICK).
+ */
+typedef struct
+{
+	u08 code;   //!< The ::TraceId, OR'd with ::TRACE_EXIT at the end.
+	u08 wraps;  //!< The low 8 bits of the wraparound count.
+	u16 clock;  //!< The ::TRACE_CLOCK.
+} TraceEvent;
+
+/*! The state of the trace ring. Treat it as private: it is only here so recording can be inlined into the interrupts,
+ *  which then don't have to save every register for a function call.
+ */
+typedef struct
+{
+	u32 mask;                        //!< Bit n is set if ::TraceId n is traced. 0 when stopped.
+	u08 head, tail;                  //!< Count the events put into and taken out of the ring. Masked to index it.
+	u08 wraps;                       //!< The wraparounds of the clock since traceStart().
+	u16 lastClock;                   //!< The clock at the last event, to notice wraparounds.
+	u16 lost;                        //!< Events overwritten before being taken, since traceTakeLost().
+	TraceEvent events[TRACE_LENGTH];
+} TraceState;
+
+extern TraceState traceState;
+
+/*! Records an event, overwriting the oldest one if the ring is full. Must be called with interrupts disabled.
+ *  Inlined with a constant id, checking the mask only tests one bit, so an id that isn't traced costs very little.
+ */
+static inline void traceRecord(const u08 id, const u08 exit)
+{
+	if (!(traceState.mask & ((u32)1 << id)))
+		return;
+
+	const u16 clock = TRACE_CLOCK;
+	if (clock < traceState.lastClock)
+		traceState.wraps++;
+	traceState.lastClock = clock;
+
+	TraceEvent *const event = &traceState.events[traceState.head & (TRACE_LENGTH - 1)];
+	event->code = id | exit;
+	event->wraps = traceState.wraps;
+	event->clock = clock;
+	traceState.head++;
+	if ((u08)(traceState.head - traceState.tail) > TRACE_LENGTH)
+	{
+		traceState.tail++;
+		traceState.lost++;
+	}
+}
+
+//! Records an event from code that runs with interrupts enabled, such as a main loop task.
+static inline void traceRecordAtomic(const u08 id, const u08 exit)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		traceRecord(id, exit);
+	}
+}
+
+/*! Mark the start and end of an interrupt (TRACE_ISR_*) or of main loop code (TRACE_TASK_*) with these.
+ *  They do nothing unless USE_TRACE = 1 in the Makefile.
+ */
+#if USE_TRACE == 1
+	#define TRACE_ISR_ENTER(id) traceRecord((id), 0)
+	#define TRACE_ISR_EXIT(id) traceRecord((id), TRACE_EXIT)
+	#define TRACE_TASK_BEGIN(id) traceRecordAtomic((id), 0)
+	#define TRACE_TASK_END(id) traceRecordAtomic((id), TRACE_EXIT)
+#else
+	#define TRACE_ISR_ENTER(id)
+	#define TRACE_ISR_EXIT(id)
+	#define TRACE_TASK_BEGIN(id)
+	#define TRACE_TASK_END(id)
+#endif
+//! Runs a statement of main loop code between a TRACE_TASK_BEGIN() and a TRACE_TASK_END().
+#define TRACE_TASK(id, statement) do { TRACE_TASK_BEGIN(id); statement; TRACE_TASK_END(id); } while (0)
+
+//Prototypes
+u16 traceStart(const u32 mask);
+void traceStop();
+u08 traceCount();
+u08 traceTake(TraceEvent *events, const u08 maxEvents);
+u16 traceTakeLost();
+
+#endif
@@ -0,0 +1,491 @@
+//Copyright (C) 2009-2011  Patrick J. McCarty.
+//Licensed under X11 License. See LICENSE.txt for details.
+
+/*! @file
+    Implements an interrupt-driven, buffered driver for the ATmega's two UARTs.
+    Received bytes are stored in a receive buffer by the Receive Complete interrupt, and queued bytes are sent
+    by the Data Register Empty interrupt, so none of these functions ever wait on the UART.
+    Each port is enabled and given a baud rate by the USE_UARTn and UARTn_BAUD variables in the project Makefile.
+    The baud rate can be changed at runtime with uartSetBaud().
+    All ports use asynchronous mode with 8 data bits, no parity, and 1 stop bit.
+    Each port supports one writer and one reader, so don't write to (or read from) the same port both from the main
+    loop and from another interrupt.
+ */
+#include "trace.h"
+#include "uart.h"
+#include <stddef.h>
+#include <util/atomic.h>
+
+//The buffer sizes can be overridden with -D in the Makefile. Each must be a power of 2, up to 256.
+#ifndef UART0_RX_BUFFER_SIZE
+	#define UART0_RX_BUFFER_SIZE 128
+#endif
+#ifndef UART0_TX_BUFFER_SIZE
+	#define UART0_TX_BUFFER_SIZE 256
+#endif
+#ifndef UART1_RX_BUFFER_SIZE
+	#define UART1_RX_BUFFER_SIZE 64
+#endif
+#ifndef UART1_TX_BUFFER_SIZE
+	#define UART1_TX_BUFFER_SIZE 64
+#endif
+
+//! The largest acceptable baud rate error, in tenths of a percent. The receiver tolerates about 2% in total.
+#define UART_BAUD_TOLERANCE 20
+
+//! The UBRR value that best approximates a baud rate, with a divisor of 16 (normal speed) or 8 (double speed).
+#define UART_UBRR(baud, divisor) ((F_CPU + (divisor) * (baud) / 2) / ((divisor) * (baud)) - 1)
+//! The baud rate that is actually generated from UART_UBRR().
+#define UART_ACTUAL_BAUD(baud, divisor) (F_CPU / ((divisor) * (UART_UBRR(baud, divisor) + 1)))
+//! The absolute baud rate error of UART_UBRR(), in tenths of a percent. Written without casts so it can be used in #if.
+#define UART_BAUD_ERROR(baud, divisor) \
+	((UART_ACTUAL_BAUD(baud, divisor) > (baud) ? UART_ACTUAL_BAUD(baud, divisor) - (baud) : (baud) - UART_ACTUAL_BAUD(baud, divisor)) * 1000 / (baud))
+
+//Pick normal or double speed mode for each enabled port at compile time, preferring normal speed
+//since the receiver samples each bit more times. Fail the build if neither is accurate enough.
+#if USE_UART0 == 1
+	#ifndef UART0_BAUD
+		#define UART0_BAUD 38400
+	#endif
+	#if UART_BAUD_ERROR(UART0_BAUD, 16) <= UART_BAUD_TOLERANCE
+		#define UART0_DIVISOR 16
+	#elif UART_BAUD_ERROR(UART0_BAUD, 8) <= UART_BAUD_TOLERANCE
+		#define UART0_DIVISOR 8
+	#else
+		#error "UART0_BAUD cannot be generated from F_CPU within 2%"
+	#endif
+#endif
+#if USE_UART1 == 1
+	#ifndef UART1_BAUD
+		#define UART1_BAUD 38400
+	#endif
+	#if UART_BAUD_ERROR(UART1_BAUD, 16) <= UART_BAUD_TOLERANCE
+		#define UART1_DIVISOR 16
+	#elif UART_BAUD_ERROR(UART1_BAUD, 8) <= UART_BAUD_TOLERANCE
+		#define UART1_DIVISOR 8
+	#else
+		#error "UART1_BAUD cannot be generated from F_CPU within 2%"
+	#endif
+#endif
+
+//! The buffers and statistics for one UART.
+typedef struct
+{
+	u08 *rxBuffer;          //!< Circular buffer of received bytes.
+	u08 rxMask;             //!< The receive buffer size minus 1, to wrap indexes.
+	volatile u08 rxHead;    //!< Index of the oldest received byte. Only changed by the reading functions.
+	volatile u08 rxTail;    //!< Index where the next received byte will be stored. Only changed by the ISR.
+	u08 *txBuffer;          //!< Circular buffer of bytes waiting to be sent.
+	u08 txMask;             //!< The transmit buffer size minus 1, to wrap indexes.
+	volatile u08 txHead;    //!< Index where the next queued byte will be stored. Only changed by the writing functions.
+	volatile u08 txTail;    //!< Index of the next byte to send. Only changed by the ISR.
+	volatile bool txStarted;//!< Set once the ISR has sent a byte, after which the Transmit Complete flag is meaningful.
+	u32 baud;               //!< The baud rate currently in use.
+	volatile UartStats stats;
+} UartState;
+
+#if USE_UART0 == 1
+	static u08 uart0RxBuffer[UART0_RX_BUFFER_SIZE];
+	static u08 uart0TxBuffer[UART0_TX_BUFFER_SIZE];
+	static UartState uart0 = {uart0RxBuffer, UART0_RX_BUFFER_SIZE - 1, 0, 0, uart0TxBuffer, UART0_TX_BUFFER_SIZE - 1, 0, 0, FALSE, UART0_BAUD, {0}};
+#endif
+#if USE_UART1 == 1
+	static u08 uart1RxBuffer[UART1_RX_BUFFER_SIZE];
+	static u08 uart1TxBuffer[UART1_TX_BUFFER_SIZE];
+	static UartState uart1 = {uart1RxBuffer, UART1_RX_BUFFER_SIZE - 1, 0, 0, uart1TxBuffer, UART1_TX_BUFFER_SIZE - 1, 0, 0, FALSE, UART1_BAUD, {0}};
+#endif
+
+//! Gets the state of a port, or NULL if the port is not enabled.
+static UartState *getState(const UartPort port)
+{
+	switch (port)
+	{
+		#if USE_UART0 == 1
+		case UART_PORT0:
+			return &uart0;
+		#endif
+		#if USE_UART1 == 1
+		case UART_PORT1:
+			return &uart1;
+		#endif
+		default:
+			return NULL;
+	}
+}
+
+//! Enables the Data Register Empty interrupt of a port, so it starts sending queued bytes.
+static void startTransmit(const UartPort port)
+{
+	#if USE_UART0 == 1
+		if (port == UART_PORT0)
+			sbi(UCSR0B, UDRIE0);
+	#endif
+	#if USE_UART1 == 1
+		if (port == UART_PORT1)
+			sbi(UCSR1B, UDRIE1);
+	#endif
+}
+
+/*! Initializes the enabled UARTs.
+    Normally called only by the initialize() function in utility.c.
+ */
+void uartInit()
+{
+	#if USE_UART0 == 1
+		UBRR0 = UART_UBRR(UART0_BAUD, UART0_DIVISOR);
+		#if UART0_DIVISOR == 8
+			UCSR0A = _BV(U2X0);
+		#else
+			UCSR0A = 0;
+		#endif
+		//asynchronous, 8 data bits, no parity, 1 stop bit
+		UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+		//Enable receiver and transmitter, and the Receive Complete Interrupt
+		UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+	#endif
+
+	#if USE_UART1 == 1
+		UBRR1 = UART_UBRR(UART1_BAUD, UART1_DIVISOR);
+		#if UART1_DIVISOR == 8
+			UCSR1A = _BV(U2X1);
+		#else
+			UCSR1A = 0;
+		#endif
+		//asynchronous, 8 data bits, no parity, 1 stop bit
+		UCSR1C = _BV(UCSZ11) | _BV(UCSZ10);
+		//Enable receiver and transmitter, and the Receive Complete Interrupt
+		UCSR1B = _BV(RXEN1) | _BV(TXEN1) | _BV(RXCIE1);
+	#endif
+}
+
+/*! Changes the baud rate of a port at runtime. Bytes being sent or received at the time are garbled,
+    so wait for uartTxIdle() first, and only change the rate at a point where the other end expects it.
+    @return FALSE if the port is not enabled, or the rate cannot be generated from F_CPU within 2%.
+ */
+bool uartSetBaud(const UartPort port, const u32 baud)
+{
+	UartState *const state = getState(port);
+	if (state == NULL || !uartBaudSupported(baud))
+		return FALSE;
+
+	//prefer the normal speed mode, which samples each bit more times
+	const bool doubleSpeed = (UART_BAUD_ERROR(baud, 16) > UART_BAUD_TOLERANCE);
+	const u16 ubrr = doubleSpeed ? UART_UBRR(baud, 8) : UART_UBRR(baud, 16);
+
+	#if USE_UART0 == 1
+		if (port == UART_PORT0)
+		{
+			UBRR0 = ubrr;
+			UCSR0A = doubleSpeed ? _BV(U2X0) : 0;
+		}
+	#endif
+	#if USE_UART1 == 1
+		if (port == UART_PORT1)
+		{
+			UBRR1 = ubrr;
+			UCSR1A = doubleSpeed ? _BV(U2X1) : 0;
+		}
+	#endif
+	state->baud = baud;
+	return TRUE;
+}
+
+//! Gets the baud rate a port is currently using, or 0 if the port is not enabled.
+u32 uartGetBaud(const UartPort port)
+{
+	UartState *const state = getState(port);
+	if (state == NULL)
+		return 0;
+	return state->baud;
+}
+
+//! Checks if a baud rate can be generated from F_CPU within 2%, with either divisor.
+bool uartBaudSupported(const u32 baud)
+{
+	//UBRR is 12 bits, and the fastest rate is F_CPU / 8
+	if (baud == 0 || baud > F_CPU / 8 || UART_UBRR(baud, 16) > 4095)
+		return FALSE;
+	return (UART_BAUD_ERROR(baud, 16) <= UART_BAUD_TOLERANCE || UART_BAUD_ERROR(baud, 8) <= UART_BAUD_TOLERANCE);
+}
+
+/*! Checks if a port has finished sending everything that was queued, including the last byte in the shift register.
+    @return TRUE if the port is idle or not enabled.
+ */
+bool uartTxIdle(const UartPort port)
+{
+	UartState *const state = getState(port);
+	if (state == NULL)
+		return TRUE;
+	if (state->txHead != state->txTail)
+		return FALSE;
+	if (!state->txStarted)
+		return TRUE;
+
+	//the ISR clears the Transmit Complete flag with each byte, so it is set once the last byte has been shifted out
+	#if USE_UART0 == 1
+		if (port == UART_PORT0)
+			return bit_is_set(UCSR0A, TXC0);
+	#endif
+	#if USE_UART1 == 1
+		if (port == UART_PORT1)
+			return bit_is_set(UCSR1A, TXC1);
+	#endif
+	return TRUE;
+}
+
+/*! Gets the number of bytes that can currently be queued for transmission on a port.
+    @return The free space in the transmit buffer, or 0 if the port is not enabled.
+ */
+u08 uartTxFree(const UartPort port)
+{
+	UartState *const state = getState(port);
+	if (state == NULL)
+		return 0;
+	return (state->txTail - state->txHead - 1) & state->txMask;
+}
+
+/*! Gets the number of bytes waiting in the transmit buffer of a port, not counting the one being shifted out.
+    @return The bytes still to send, or 0 if the port is not enabled.
+ */
+u08 uartTxPending(const UartPort port)
+{
+	UartState *const state = getState(port);
+	if (state == NULL)
+		return 0;
+	return (state->txHead - state->txTail) & state->txMask;
+}
+
+/*! Gets the number of received bytes waiting to be read from a port.
+    @return The number of bytes in the receive buffer, or 0 if the port is not enabled.
+ */
+u08 uartRxAvailable(const UartPort port)
+{
+	UartState *const state = getState(port);
+	if (state == NULL)
+		return 0;
+	return (state->rxTail - state->rxHead) & state->rxMask;
+}
+
+//! Copies bytes into the transmit buffer, which must have room for them, and starts transmitting.
+static void queueBytes(const UartPort port, UartState *const state, const u08 *data, u08 length)
+{
+	u08 head = state->txHead;
+	const u08 mask = state->txMask;
+
+	while (length--)
+	{
+		state->txBuffer[head] = *data++;
+		head = (head + 1) & mask;
+	}
+	//the atomic block is also a memory barrier, so the ISR can't see the new head before the data it covers
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		state->txHead = head;
+	}
+
+	startTransmit(port);
+}
+
+/*! Queues as many bytes as will fit in the transmit buffer of a port, without waiting.
+    @param port The port to send on.
+    @param data The bytes to send.
+    @param length The number of bytes to send.
+    @return The number of bytes queued. Any bytes that didn't fit are counted in UartStats::txDropped.
+ */
+u08 uartWrite(const UartPort port, const u08 *data, const u08 length)
+{
+	UartState *const state = getState(port);
+	if (state == NULL)
+		return 0;
+
+	u08 count = uartTxFree(port);
+	if (count > length)
+		count = length;
+	queueBytes(port, state, data, count);
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		state->stats.txBytes += count;
+		state->stats.txDropped += length - count;
+	}
+	return count;
+}
+
+/*! Queues a block of bytes for transmission only if all of them fit in the transmit buffer, without waiting.
+    Use this for packets, which are useless if partially sent.
+    @return TRUE if the bytes were queued, FALSE if they were all dropped (and counted in UartStats::txDropped).
+ */
+bool uartWriteAll(const UartPort port, const u08 *data, const u08 length)
+{
+	UartState *const state = getState(port);
+	if (state == NULL)
+		return FALSE;
+
+	const bool fits = (uartTxFree(port) >= length);
+	if (fits)
+		queueBytes(port, state, data, length);
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (fits)
+			state->stats.txBytes += length;
+		else
+			state->stats.txDropped += length;
+	}
+	return fits;
+}
+
+//! Queues a single byte for transmission without waiting. @return FALSE if the transmit buffer was full.
+bool uartPutChar(const UartPort port, const u08 data)
+{
+	return uartWriteAll(port, &data, 1);
+}
+
+/*! Reads up to maxLength received bytes from a port, without waiting.
+    @return The number of bytes copied into data.
+ */
+u08 uartRead(const UartPort port, u08 *data, const u08 maxLength)
+{
+	UartState *const state = getState(port);
+	if (state == NULL)
+		return 0;
+
+	u08 count;
+	u08 head;
+	//the atomic blocks are also memory barriers, so the data isn't read before the tail index that covers it,
+	//and the ISR can't reuse the space before the data has been copied
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		head = state->rxHead;
+		count = (state->rxTail - head) & state->rxMask;
+	}
+	if (count > maxLength)
+		count = maxLength;
+
+	for (u08 i = 0; i < count; i++)
+	{
+		data[i] = state->rxBuffer[head];
+		head = (head + 1) & state->rxMask;
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		state->rxHead = head;
+	}
+
+	return count;
+}
+
+//! Reads one received byte from a port without waiting. @return FALSE if no byte was available.
+bool uartGetChar(const UartPort port, u08 *data)
+{
+	return (uartRead(port, data, 1) == 1);
+}
+
+//! Copies the statistics of a port. The statistics of a disabled port are all zero.
+void uartGetStats(const UartPort port, UartStats *stats)
+{
+	UartState *const state = getState(port);
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (state == NULL)
+			*stats = (UartStats){0};
+		else
+			*stats = state->stats;
+	}
+}
+
+/*! Stores a received byte, or counts it as an overrun if the receive buffer is full.
+    The newest byte is the one discarded, so a reader that falls behind doesn't see a corrupted sequence.
+ */
+static inline void receiveByte(UartState *const state, const u08 status, const u08 data, const u08 dorBit, const u08 feBit)
+{
+	if (status & _BV(dorBit))
+		state->stats.rxHardwareOverruns++;
+	if (status & _BV(feBit))
+		state->stats.rxFramingErrors++;
+
+	const u08 tail = state->rxTail;
+	const u08 next = (tail + 1) & state->rxMask;
+	if (next == state->rxHead)
+	{
+		state->stats.rxOverruns++;
+	}
+	else
+	{
+		state->rxBuffer[tail] = data;
+		state->rxTail = next;
+		state->stats.rxBytes++;
+	}
+}
+
+/*! Gets the next byte to transmit, if any.
+    @return FALSE when the transmit buffer is empty, meaning the Data Register Empty interrupt should be disabled.
+ */
+static inline bool transmitByte(UartState *const state, u08 *data)
+{
+	const u08 tail = state->txTail;
+	if (tail == state->txHead)
+		return FALSE;
+
+	*data = state->txBuffer[tail];
+	state->txTail = (tail + 1) & state->txMask;
+	return TRUE;
+}
+
+#if USE_UART0 == 1
+//! Fires when a byte has been received on UART0.
+ISR(USART0_RX_vect)
+{
+	TRACE_ISR_ENTER(TRACE_UART0_RX);
+	//the status flags must be read before the data register
+	const u08 status = UCSR0A;
+	receiveByte(&uart0, status, UDR0, DOR0, FE0);
+	TRACE_ISR_EXIT(TRACE_UART0_RX);
+}
+
+//! Fires when UART0 is ready to accept another byte to send.
+ISR(USART0_UDRE_vect)
+{
+	TRACE_ISR_ENTER(TRACE_UART0_UDRE);
+	u08 data;
+	if (transmitByte(&uart0, &data))
+	{
+		//clear Transmit Complete (by writing a 1 to it), keeping the speed mode, so uartTxIdle() can tell when this byte is done
+		UCSR0A = (UCSR0A & _BV(U2X0)) | _BV(TXC0);
+		UDR0 = data;
+		uart0.txStarted = TRUE;
+	}
+	else
+		cbi(UCSR0B, UDRIE0);
+	TRACE_ISR_EXIT(TRACE_UART0_UDRE);
+}
+#endif
+
+#if USE_UART1 == 1
+//! Fires when a byte has been received on UART1.
+ISR(USART1_RX_vect)
+{
+	TRACE_ISR_ENTER(TRACE_UART1_RX);
+	//the status flags must be read before the data register
+	const u08 status = UCSR1A;
+	receiveByte(&uart1, status, UDR1, DOR1, FE1);
+	TRACE_ISR_EXIT(TRACE_UART1_RX);
+}
+
+//! Fires when UART1 is ready to accept another byte to send.
+ISR(USART1_UDRE_vect)
+{
+	TRACE_ISR_ENTER(TRACE_UART1_UDRE);
+	u08 data;
+	if (transmitByte(&uart1, &data))
+	{
+		//clear Transmit Complete (by writing a 1 to it), keeping the speed mode, so uartTxIdle() can tell when this byte is done
+		UCSR1A = (UCSR1A & _BV(U2X1)) | _BV(TXC1);
+		UDR1 = data;
+		uart1.txStarted = TRUE;
+	}
+	else
+		cbi(UCSR1B, UDRIE1);
+	TRACE_ISR_EXIT(TRACE_UART1_UDRE);
+}
+#endif
@@ -0,0 +1,44 @@
+//Copyright (C) 2009-2011  Patrick J. McCarty.
+//Licensed under X11 License. See LICENSE.txt for details.
+
+#ifndef UART_H
+#define UART_H
+
+#include "globals.h"
+
+//! Selects one of the ATmega's UARTs.
+typedef enum
+{
+	UART_PORT0 = 0, //!< UART0, connected to the onboard FTDI USB-to-UART converter.
+	UART_PORT1 = 1, //!< UART1, available on the expansion header.
+	NUM_UART_PORTS
+} UartPort;
+
+//! Counters kept for each UART, for development/testing purposes. All counters wrap around.
+typedef struct
+{
+	u16 rxBytes;        //!< Bytes received and stored in the receive buffer.
+	u16 txBytes;        //!< Bytes queued in the transmit buffer.
+	u16 rxOverruns;     //!< Bytes received while the receive buffer was full, which were discarded.
+	u16 rxHardwareOverruns; //!< Times the UART hardware lost a byte because the receive interrupt was delayed too long.
+	u16 rxFramingErrors;//!< Bytes received with a framing error (usually a baud rate mismatch or line noise).
+	u16 txDropped;      //!< Bytes that could not be queued because the transmit buffer was full.
+} UartStats;
+
+//Prototypes
+void uartInit();
+u08 uartWrite(const UartPort port, const u08 *data, const u08 length);
+bool uartWriteAll(const UartPort port, const u08 *data, const u08 length);
+bool uartPutChar(const UartPort port, const u08 data);
+u08 uartRead(const UartPort port, u08 *data, const u08 maxLength);
+bool uartGetChar(const UartPort port, u08 *data);
+u08 uartRxAvailable(const UartPort port);
+u08 uartTxFree(const UartPort port);
+u08 uartTxPending(const UartPort port);
+void uartGetStats(const UartPort port, UartStats *stats);
+bool uartSetBaud(const UartPort port, const u32 baud);
+u32 uartGetBaud(const UartPort port);
+bool uartBaudSupported(const u32 baud);
+bool uartTxIdle(const UartPort port);
+
+#endif
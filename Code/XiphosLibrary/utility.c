@@ -9,6 +9,7 @@
 #include "LCD.h"
 #include "motors.h"
 #include "servos.h"
+#include "uart.h"
 #include "utility.h"
 #include <util/delay.h>
 #include <avr/wdt.h>
@@ -63,6 +64,11 @@ inline void initialize()
 		//initialize ADC
 		adcInit();
 	#endif
+
+	#if USE_UART0 == 1 || USE_UART1 == 1
+		//initialize enabled UARTs
+		uartInit();
+	#endif
 }
 
 //! Provides a busy wait loop for an approximate number of milliseconds.